@@ -43,43 +43,49 @@ namespace dk
 
 
 
+	CameraData Camera::get_camera_data()
+	{
+		calculate_vp_matrices();
+		calculate_frustum();
+
+		CameraData data = {};
+		data.frustum = m_view_frustum;
+		data.position = m_transform->get_position();
+		data.vp_mat = m_projection * m_view;
+		data.view_mat = m_view;
+		data.proj_mat = m_projection;
+		data.near_plane = m_near_clipping_plane;
+		data.far_plane = m_far_clipping_plane;
+		data.sky_box = m_sky_box;
+
+		return data;
+	}
+
+
+
 	void CameraSystem::on_begin()
 	{
 		Handle<Camera> camera = get_active_component();
 		camera->m_transform = camera->get_entity().get_component<Transform>();
-		camera->m_command_buffers =
-		{
-			engine::graphics.get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary),
-			engine::graphics.get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary)
-		};
 	}
 
 	void CameraSystem::on_pre_render(float delta_time)
 	{
 		for (Handle<Camera> camera : *this)
 		{
-			camera->calculate_vp_matrices();
-			camera->calculate_frustum();
-
 			if (camera == CameraSystem::main_camera)
+				engine::get_renderer().set_main_camera(camera->get_camera_data());
+			else
 			{
-				CameraData data = {};
-				data.frustum = camera->m_view_frustum;
-				data.position = camera->m_transform->get_position();
-				data.vp_mat = camera->m_projection * camera->m_view;
-				data.sky_box = camera->m_sky_box;
-				data.command_buffers = camera->m_command_buffers;
-
-				engine::renderer.set_main_camera(data);
+				camera->calculate_vp_matrices();
+				camera->calculate_frustum();
 			}
 		}
 	}
 
 	void CameraSystem::on_end()
 	{
-		Handle<Camera> camera = get_active_component();
-		for (auto& command_buffer : camera->m_command_buffers)
-			command_buffer.free();
+
 	}
 
 	void CameraSystem::serialize(ReflectionContext& r)
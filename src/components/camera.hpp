@@ -69,6 +69,12 @@ namespace dk
 			return m_view_frustum;
 		}
 
+		/**
+		 * @brief Get the data the renderer needs to draw from this camera.
+		 * @return Camera data, calculated from the transform as it is now.
+		 */
+		CameraData get_camera_data();
+
 		/**
 		 * Get sky box.
 		 * @return Sky box.
@@ -154,9 +160,6 @@ namespace dk
 		/** View frustum. */
 		Frustum m_view_frustum = {};
 
-		/** Command buffers for rendering the skybox. */
-		std::vector<VkManagedCommandBuffer> m_command_buffers = {};
-
 		/** Skybox. */
 		HSkyBox m_sky_box = {};
 
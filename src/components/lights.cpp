@@ -23,7 +23,7 @@ namespace dk
 		for (Handle<DirectionalLight> light : *this)
 		{
 			light->m_light_data.direction = glm::vec4(light->m_transform->get_forward(), 1.0f);
-			dk::engine::renderer.draw(light->m_light_data);
+			dk::engine::get_renderer().draw(light->m_light_data);
 		}
 	}
 
@@ -54,7 +54,7 @@ namespace dk
 		for (Handle<PointLight> light : *this)
 		{
 			light->m_light_data.position = glm::vec4(light->m_transform->get_position(), light->m_light_data.position.w);
-			dk::engine::renderer.draw(light->m_light_data);
+			dk::engine::get_renderer().draw(light->m_light_data);
 		}
 	}
 
@@ -5,211 +5,273 @@
  */
 
 /** Includes. */
+#include <algorithm>
+#include <cstring>
 #include <engine/common.hpp>
 #include "transform.hpp"
 #include <engine/config.hpp>
+#include <utilities\mesh_lod.hpp>
 #include "camera.hpp"
 #include "mesh_renderer.hpp"
 
 namespace dk
 {
-	void MeshRenderer::generate_resources()
-	{
-		if (m_material.allocator && m_mesh.allocator)
-		{
-			// Free old resources
-			free_resources();
-
-			// Create buffers
-			m_vertex_uniform_buffer = engine::graphics.create_buffer
-			(
-				m_material->get_shader()->get_inst_vertex_buffer_size(),
-				vk::BufferUsageFlagBits::eUniformBuffer,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-			);
-
-			m_fragment_uniform_buffer = engine::graphics.create_buffer
-			(
-				m_material->get_shader()->get_inst_fragment_buffer_size(),
-				vk::BufferUsageFlagBits::eUniformBuffer,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-			);
-
-			// Map buffers
-			m_vertex_map = engine::graphics.get_logical_device().mapMemory(m_vertex_uniform_buffer.memory, 0, sizeof(VertexShaderData));
-			m_fragment_map = engine::graphics.get_logical_device().mapMemory(m_fragment_uniform_buffer.memory, 0, sizeof(FragmentShaderData));
-
-			vk::DescriptorPoolSize pool_size = {};
-			pool_size.type = vk::DescriptorType::eUniformBuffer;
-			pool_size.descriptorCount = 4;
-
-			// Create descriptor pool
-			vk::DescriptorPoolCreateInfo pool_info = {};
-			pool_info.poolSizeCount = 1;
-			pool_info.pPoolSizes = &pool_size;
-			pool_info.maxSets = 1;
-
-			m_vk_descriptor_pool = engine::graphics.get_logical_device().createDescriptorPool(pool_info);
-			dk_assert(m_vk_descriptor_pool);
-
-			// Allocate descriptor set
-			vk::DescriptorSetAllocateInfo alloc_info = {};
-			alloc_info.descriptorPool = m_vk_descriptor_pool;
-			alloc_info.descriptorSetCount = 1;
-			alloc_info.pSetLayouts = &m_material->get_shader()->get_descriptor_set_layout();
-
-			m_vk_descriptor_set = engine::graphics.get_logical_device().allocateDescriptorSets(alloc_info)[0];
-			dk_assert(m_vk_descriptor_set);
-
-			// Update descriptor set
-			std::array<vk::DescriptorBufferInfo, 4> buffer_infos = {};
-			buffer_infos[0].buffer = m_material->get_vertex_uniform_buffer().buffer;
-			buffer_infos[0].offset = 0;
-			buffer_infos[0].range = m_material->get_shader()->get_vertex_buffer_size();
-
-			buffer_infos[1].buffer = m_vertex_uniform_buffer.buffer;
-			buffer_infos[1].offset = 0;
-			buffer_infos[1].range = m_material->get_shader()->get_inst_vertex_buffer_size();
-
-			buffer_infos[2].buffer = m_material->get_fragment_uniform_buffer().buffer;
-			buffer_infos[2].offset = 0;
-			buffer_infos[2].range = m_material->get_shader()->get_fragment_buffer_size();
-
-			buffer_infos[3].buffer = m_fragment_uniform_buffer.buffer;
-			buffer_infos[3].offset = 0;
-			buffer_infos[3].range = m_material->get_shader()->get_inst_fragment_buffer_size();
-
-			std::array<vk::WriteDescriptorSet, 4> writes = {};
-
-			for (size_t i = 0; i < 4; ++i)
-			{
-				writes[i].dstSet = m_vk_descriptor_set;
-				writes[i].dstBinding = static_cast<uint32_t>(i);
-				writes[i].dstArrayElement = 0;
-				writes[i].descriptorType = vk::DescriptorType::eUniformBuffer;
-				writes[i].descriptorCount = 1;
-				writes[i].pBufferInfo = &buffer_infos[i];
-			}
+	/** Fraction a screen size must pass a detail level threshold by before the level changes. */
+	static const float LOD_HYSTERESIS = 0.1f;
 
-			engine::graphics.get_logical_device().updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
-		}
-	}
-
-	void MeshRenderer::free_resources()
+	const AABB& MeshRenderer::get_world_bounds()
 	{
-		if (m_vertex_map)
+		// Placeholders of streamed meshes don't have bounds yet
+		if (m_mesh.allocator && m_mesh->is_resident() && (m_bounds_dirty || m_bounds_version != m_transform->get_version()))
 		{
-			engine::graphics.get_logical_device().unmapMemory(m_vertex_uniform_buffer.memory);
-			m_vertex_map = nullptr;
+			m_world_bounds = m_mesh->get_aabb();
+			m_world_bounds.transform(m_transform->get_model_matrix());
+			m_bounds_version = m_transform->get_version();
+			m_bounds_dirty = false;
 		}
 
-		if (m_fragment_map)
-		{
-			engine::graphics.get_logical_device().unmapMemory(m_fragment_uniform_buffer.memory);
-			m_fragment_map = nullptr;
-		}
-
-		if (m_vertex_uniform_buffer.buffer)
-		{
-			m_vertex_uniform_buffer.free(engine::graphics.get_logical_device());
-			m_vertex_uniform_buffer.buffer = vk::Buffer();
-		}
+		return m_world_bounds;
+	}
 
-		if (m_fragment_uniform_buffer.buffer)
-		{
-			m_fragment_uniform_buffer.free(engine::graphics.get_logical_device());
-			m_fragment_uniform_buffer.buffer = vk::Buffer();
-		}
+	void MeshRenderer::queue_update()
+	{
+		if (m_update_queued)
+			return;
 
-		if (m_vk_descriptor_pool)
-		{
-			engine::graphics.get_logical_device().destroyDescriptorPool(m_vk_descriptor_pool);
-			m_vk_descriptor_pool = vk::DescriptorPool();
-			m_vk_descriptor_set = vk::DescriptorSet();
-		}
+		auto& system = static_cast<MeshRendererSystem&>(get_system());
+		auto& allocator = static_cast<ResourceAllocator<MeshRenderer>&>(system.get_component_allocator());
+		system.m_update_queue.push_back(allocator.get_id(this));
+		m_update_queued = true;
 	}
 
 	void MeshRendererSystem::on_begin()
 	{
 		Handle<MeshRenderer> mesh_renderer = get_active_component();
 		mesh_renderer->m_transform = mesh_renderer->get_entity().get_component<Transform>();
-		mesh_renderer->m_command_buffer = engine::graphics.get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary);
-		mesh_renderer->m_depth_prepass_command_buffer = engine::graphics.get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary);
-		mesh_renderer->generate_resources();
+		m_transform_renderers[mesh_renderer->m_transform.id] = mesh_renderer.id;
+		mesh_renderer->queue_update();
 	}
 
 	void MeshRendererSystem::on_pre_render(float delta_time)
 	{
-#if !DK_EDITOR
+		// Keep the hierarchy in sync with the mesh renderers
+		update_hierarchy();
+
+#if DK_EDITOR
+		// The scene view sets the editor camera
+		const CameraData camera = engine::get_renderer().get_main_camera();
+#else
 		if (!CameraSystem::get_main_camera().allocator)
 			return;
+
+		// The camera system may not have updated the renderer's camera yet this frame
+		const CameraData camera = CameraSystem::get_main_camera()->get_camera_data();
 #endif
 
-		for (Handle<MeshRenderer> mesh_renderer : *this)
+		// Find visible mesh renderers
+		m_visible_renderers.clear();
+		m_bvh.query(camera.frustum, m_visible_renderers);
+
+		auto& allocator = static_cast<ResourceAllocator<MeshRenderer>&>(get_component_allocator());
+		m_instance_uniforms.clear();
+
+		for (const uint32_t id : m_visible_renderers)
 		{
-			if (
-				!mesh_renderer->m_mesh.allocator || 
-				!mesh_renderer->m_material.allocator || 
-				!mesh_renderer->m_fragment_map || 
-				!mesh_renderer->m_vertex_map
-				)
+			Handle<MeshRenderer> mesh_renderer = Handle<MeshRenderer>(id, &allocator);
+
+			// Resources the mesh renderer uses were removed since its leaf was updated
+			if (!is_drawable(mesh_renderer))
+			{
+				m_bvh.remove(mesh_renderer->m_bvh_proxy);
+				mesh_renderer->m_bvh_proxy = DynamicBVH::null_node;
+				mesh_renderer->queue_update();
 				continue;
+			}
 
-			bool textures_unbound = false;
-			for (size_t i = 0; i < mesh_renderer->m_material->get_shader()->get_texture_count(); ++i)
-				if (!mesh_renderer->m_material->get_texture(i).allocator)
+			// Draw. Per instance vertex data is written by the renderer.
+			dk::RenderableObject renderable = {};
+			renderable.mesh = select_mesh(mesh_renderer, camera);
+			renderable.model = mesh_renderer->m_transform->get_model_matrix();
+			renderable.bounds = mesh_renderer->m_world_bounds;
+			renderable.occluder = mesh_renderer->m_occluder;
+
+			// Materials aren't loaded when headless, so the null renderer only sees meshes
+			if (!engine::graphics.is_headless())
+			{
+				const HMaterialShader shader = mesh_renderer->m_material->get_shader();
+
+				// Upload per instance data. Every mesh renderer sends the same data, so it
+				// is shared by everything using the same shader to keep batches together.
+				auto uniforms = m_instance_uniforms.find(shader.id);
+				if (uniforms == m_instance_uniforms.end())
 				{
-					textures_unbound = true;
-					break;
+					std::array<uint32_t, 2> offsets = {};
+					auto& ring = engine::renderer.get_uniform_ring();
+
+					std::memset(ring.allocate(shader->get_inst_vertex_buffer_size(), offsets[0]), 0, shader->get_inst_vertex_buffer_size());
+
+					FragmentShaderData f_data = {};
+					void* f_map = ring.allocate(shader->get_inst_fragment_buffer_size(), offsets[1]);
+					std::memset(f_map, 0, shader->get_inst_fragment_buffer_size());
+					std::memcpy(f_map, &f_data, std::min(sizeof(FragmentShaderData), shader->get_inst_fragment_buffer_size()));
+
+					uniforms = m_instance_uniforms.insert({ shader.id, offsets }).first;
 				}
 
-			if (textures_unbound)
+				renderable.shader = shader;
+				renderable.material = mesh_renderer->m_material;
+				renderable.descriptor_sets =
+				{
+					mesh_renderer->m_material->get_descriptor_set(),
+					dk::engine::renderer.get_descriptor_set(),
+					dk::engine::renderer.get_texture_descriptor_set()
+				};
+				renderable.dynamic_offsets = uniforms->second;
+			}
+
+			// Split meshes submit every sub mesh so the renderer can cull them separately
+			const auto& sub_meshes = renderable.mesh->get_sub_meshes();
+			if (sub_meshes.size() == 1)
+			{
+				engine::get_renderer().draw(renderable);
 				continue;
+			}
 
-			// Upload vertex shader data
+			for (size_t i = 0; i < sub_meshes.size(); ++i)
 			{
-				VertexShaderData v_data = {};
-				v_data.model = mesh_renderer->m_transform->get_model_matrix();
-#if DK_EDITOR
-				v_data.mvp = editor::renderer.get_main_camera().vp_mat * mesh_renderer->m_transform->get_model_matrix();
-#else
-				v_data.mvp = CameraSystem::get_main_camera()->get_pv_matrix() * mesh_renderer->m_transform->get_model_matrix();
-#endif
-				memcpy(mesh_renderer->m_vertex_map, &v_data, sizeof(VertexShaderData));
+				renderable.sub_mesh = static_cast<uint32_t>(i);
+				renderable.bounds = sub_meshes[i].aabb;
+				renderable.bounds.transform(renderable.model);
+				engine::get_renderer().draw(renderable);
 			}
+		}
+	}
+
+	void MeshRendererSystem::on_end()
+	{
+		Handle<MeshRenderer> mesh_renderer = get_active_component();
 
-			// Upload fragment shader data
+		if (mesh_renderer->m_bvh_proxy != DynamicBVH::null_node)
+		{
+			m_bvh.remove(mesh_renderer->m_bvh_proxy);
+			mesh_renderer->m_bvh_proxy = DynamicBVH::null_node;
+		}
+
+		// Stale IDs left in the update queue are skipped because the flag is cleared
+		mesh_renderer->m_update_queued = false;
+		m_transform_renderers.erase(mesh_renderer->m_transform.id);
+	}
+
+	void MeshRendererSystem::update_hierarchy()
+	{
+		auto& allocator = static_cast<ResourceAllocator<MeshRenderer>&>(get_component_allocator());
+
+		// Mesh renderers whose transform moved need their leaves updated
+		auto* transform_system = static_cast<TransformSystem*>(get_scene().get_system_by_id(TypeID<Transform>::id()));
+		if (transform_system)
+		{
+			transform_system->take_changed(m_changed_transforms);
+
+			for (const auto transform : m_changed_transforms)
 			{
-				FragmentShaderData f_data = {};
-				memcpy(mesh_renderer->m_fragment_map, &f_data, sizeof(FragmentShaderData));
+				auto renderer = m_transform_renderers.find(transform.id);
+				if (transform.is_valid() && renderer != m_transform_renderers.end())
+					Handle<MeshRenderer>(renderer->second, &allocator)->queue_update();
 			}
+		}
+
+		m_updating.clear();
+		m_updating.swap(m_update_queue);
+
+		for (const uint32_t id : m_updating)
+		{
+			if (!allocator.is_allocated(id))
+				continue;
+
+			Handle<MeshRenderer> mesh_renderer = Handle<MeshRenderer>(id, &allocator);
+			if (!mesh_renderer->m_update_queued)
+				continue;
 
-			// Draw
-			dk::RenderableObject renderable =
+			mesh_renderer->m_update_queued = false;
+
+			// Mesh renderers waiting on a mesh, material, or streaming are checked again next frame
+			if (!is_drawable(mesh_renderer))
 			{
+				if (mesh_renderer->m_bvh_proxy != DynamicBVH::null_node)
 				{
-					mesh_renderer->m_command_buffer,
-					mesh_renderer->m_depth_prepass_command_buffer
-				},
-				mesh_renderer->m_material->get_shader(),
-				mesh_renderer->m_mesh,
-				{ mesh_renderer->m_vk_descriptor_set, dk::engine::renderer.get_descriptor_set() },
-				mesh_renderer->m_transform->get_model_matrix()
-			};
-
-			if (mesh_renderer->m_material->get_shader()->get_texture_count() > 0)
-				renderable.descriptor_sets.push_back(mesh_renderer->m_material->get_texture_descriptor_set());
-
-			engine::renderer.draw(renderable);
+					m_bvh.remove(mesh_renderer->m_bvh_proxy);
+					mesh_renderer->m_bvh_proxy = DynamicBVH::null_node;
+				}
+
+				mesh_renderer->queue_update();
+				continue;
+			}
+
+			const AABB old_bounds = mesh_renderer->m_world_bounds;
+			const AABB& bounds = mesh_renderer->get_world_bounds();
+
+			if (mesh_renderer->m_bvh_proxy == DynamicBVH::null_node)
+				mesh_renderer->m_bvh_proxy = m_bvh.insert(bounds, mesh_renderer.id);
+			else if (bounds.center != old_bounds.center || bounds.extent != old_bounds.extent)
+				m_bvh.move(mesh_renderer->m_bvh_proxy, bounds);
 		}
 	}
 
-	void MeshRendererSystem::on_end()
+	Handle<MeshRenderer> MeshRendererSystem::raycast(glm::vec3 origin, glm::vec3 direction, float max_distance)
 	{
-		Handle<MeshRenderer> mesh_renderer = get_active_component();
-		mesh_renderer->m_command_buffer.free();
-		mesh_renderer->m_depth_prepass_command_buffer.free();
-		mesh_renderer->free_resources();
+		uint32_t id = 0;
+		float distance = 0.0f;
+
+		if (!m_bvh.raycast(origin, direction, max_distance, id, distance))
+			return Handle<MeshRenderer>();
+
+		return Handle<MeshRenderer>(id, &static_cast<ResourceAllocator<MeshRenderer>&>(get_component_allocator()));
+	}
+
+	HMesh MeshRendererSystem::select_mesh(Handle<MeshRenderer> mesh_renderer, const CameraData& camera)
+	{
+		const HMesh mesh = mesh_renderer->m_mesh;
+		const size_t lod_count = mesh->get_lod_count();
+
+		if (lod_count < 2)
+			return mesh;
+
+		// Bounds are world space, so scaling is already accounted for
+		const AABB& bounds = mesh_renderer->m_world_bounds;
+		const float screen_size = get_screen_size(glm::length(bounds.center - camera.position), glm::length(bounds.extent), camera.proj_mat);
+
+		mesh_renderer->m_lod = select_lod
+		(
+			screen_size,
+			mesh->get_lod_screen_sizes().data(),
+			static_cast<uint32_t>(lod_count - 1),
+			mesh_renderer->m_lod,
+			LOD_HYSTERESIS
+		);
+
+		return mesh_renderer->m_lod == 0 ? mesh : mesh->get_lod(mesh_renderer->m_lod);
+	}
+
+	bool MeshRendererSystem::is_drawable(Handle<MeshRenderer> mesh_renderer)
+	{
+		// Skip meshes that are still streaming
+		if (!mesh_renderer->m_mesh.allocator || !mesh_renderer->m_mesh->is_resident())
+			return false;
+
+		// Only meshes are loaded when headless, so they're all that's needed
+		if (engine::graphics.is_headless())
+			return true;
+
+		if (!mesh_renderer->m_material.allocator)
+			return false;
+
+		// Textures that are still streaming are substituted by the texture
+		// table, so they don't stop the mesh being drawn.
+		for (size_t i = 0; i < mesh_renderer->m_material->get_shader()->get_texture_count(); ++i)
+			if (!mesh_renderer->m_material->get_texture(i).allocator)
+				return false;
+
+		return true;
 	}
 
 	void MeshRendererSystem::serialize(ReflectionContext& r)
@@ -218,6 +280,7 @@ namespace dk
 		r.set_name("Mesh Renderer");
 		r.set_field("Mesh", mesh_renderer->m_mesh);
 		r.set_field("Material", mesh_renderer->m_material);
+		r.set_field("Occluder", mesh_renderer->m_occluder);
 	}
 
 	void MeshRendererSystem::inspect(ReflectionContext& r)
@@ -226,5 +289,6 @@ namespace dk
 		r.set_name("Mesh Renderer");
 		r.set_field("Mesh", mesh_renderer->m_mesh);
 		r.set_field("Material", mesh_renderer->m_material);
+		r.set_field("Occluder", mesh_renderer->m_occluder);
 	}
 }
\ No newline at end of file
@@ -10,6 +10,10 @@
 #include <ecs\scene.hpp>
 #include <graphics\material.hpp>
 #include <graphics\mesh.hpp>
+#include <graphics\renderer.hpp>
+#include <unordered_map>
+#include <array>
+#include <utilities\bvh.hpp>
 #include "transform.hpp"
 
 namespace dk
@@ -33,7 +37,7 @@ namespace dk
 		HMaterial set_material(HMaterial material)
 		{
 			m_material = material;
-			generate_resources();
+			queue_update();
 			return m_material;
 		}
 
@@ -45,7 +49,9 @@ namespace dk
 		HMesh set_mesh(HMesh mesh)
 		{
 			m_mesh = mesh;
-			generate_resources();
+			m_bounds_dirty = true;
+			m_lod = 0;
+			queue_update();
 			return m_mesh;
 		}
 
@@ -67,19 +73,51 @@ namespace dk
 			return m_mesh;
 		}
 
-	private:
+		/**
+		 * @brief Get the detail level drawn last frame.
+		 * @return Detail level. Zero is the mesh itself.
+		 */
+		uint32_t get_lod() const
+		{
+			return m_lod;
+		}
 
 		/**
-		 * @brief Generate resources.
+		 * @brief Set whether the mesh hides objects behind it.
+		 * @param If the mesh is an occluder.
+		 * @return If the mesh is an occluder.
+		 * @note Occluders should be large, simple, and solid.
+		 * @note Cooked meshes only occlude if their mesh file sets "occluder", since only then
+		 *       are positions and indices kept on the CPU to rasterize.
 		 */
-		void generate_resources();
+		bool set_occluder(bool occluder)
+		{
+			m_occluder = occluder;
+			return m_occluder;
+		}
 
 		/**
-		 * @brief Free resources.
+		 * @brief Check if the mesh hides objects behind it.
+		 * @return If the mesh is an occluder.
 		 */
-		void free_resources();
+		bool is_occluder() const
+		{
+			return m_occluder;
+		}
 
-		
+		/**
+		 * @brief Get the world space bounding box of the mesh.
+		 * @return World space bounding box.
+		 * @note Only recalculated when the transform or mesh changes.
+		 */
+		const AABB& get_world_bounds();
+
+	private:
+
+		/**
+		 * @brief Queue the mesh renderer to have its bounding volume hierarchy leaf updated before rendering.
+		 */
+		void queue_update();
 
 		/** Transform. */
 		Handle<Transform> m_transform = {};
@@ -90,29 +128,26 @@ namespace dk
 		/** Mesh used when rendering. */
 		HMesh m_mesh = {};
 
-		/** Command buffer used for rendering. */
-		VkManagedCommandBuffer m_command_buffer = {};
+		/** Detail level drawn last frame. */
+		uint32_t m_lod = 0;
 
-		/** Depth prepass command buffer. */
-		VkManagedCommandBuffer m_depth_prepass_command_buffer = {};
+		/** Is the mesh used for occlusion culling? */
+		bool m_occluder = false;
 
-		/** Meshes descriptor pool. */
-		vk::DescriptorPool m_vk_descriptor_pool = {};
+		/** Cached world space bounding box. */
+		AABB m_world_bounds = {};
 
-		/** Descriptor set. */
-		vk::DescriptorSet m_vk_descriptor_set = {};
+		/** Transform version the world bounds were calculated with. */
+		uint64_t m_bounds_version = 0;
 
-		/** Per instance vertex uniform buffer. */
-		VkMemBuffer m_vertex_uniform_buffer = {};
+		/** Flag to force the world bounds to be recalculated. */
+		bool m_bounds_dirty = true;
 
-		/** Per instance fragment uniform buffer. */
-		VkMemBuffer m_fragment_uniform_buffer = {};
+		/** Proxy in the systems bounding volume hierarchy. */
+		int32_t m_bvh_proxy = DynamicBVH::null_node;
 
-		/** Vertex buffer mapping. */
-		void* m_vertex_map = nullptr;
-
-		/** Fragment buffer mapping. */
-		void* m_fragment_map = nullptr;
+		/** Is the mesh renderer in its systems update queue? */
+		bool m_update_queued = false;
 	};
 
 	/**
@@ -120,6 +155,8 @@ namespace dk
 	 */
 	class MeshRendererSystem : public System<MeshRenderer>
 	{
+		friend class MeshRenderer;
+
 	public:
 
 		DK_SYSTEM_BODY(MeshRendererSystem, MeshRenderer, true)
@@ -151,5 +188,60 @@ namespace dk
 		 * @param Reflection context.
 		 */
 		void inspect(ReflectionContext& r) override;
+
+		/**
+		 * Find the closest mesh renderer hit by a ray.
+		 * @param Ray origin.
+		 * @param Ray direction.
+		 * @param Maximum distance along the ray.
+		 * @return Closest mesh renderer hit.
+		 * @note Tests against world space bounding boxes. A null handle is returned if nothing is hit.
+		 */
+		Handle<MeshRenderer> raycast(glm::vec3 origin, glm::vec3 direction, float max_distance);
+
+	private:
+
+		/**
+		 * Pick the detail level of a visible mesh renderer.
+		 * @param Mesh renderer.
+		 * @param Main camera.
+		 * @return Mesh to draw.
+		 */
+		HMesh select_mesh(Handle<MeshRenderer> mesh_renderer, const CameraData& camera);
+
+		/**
+		 * Check if a mesh renderer has everything it needs to be drawn.
+		 * @param Mesh renderer.
+		 * @return If the mesh renderer can be drawn.
+		 */
+		bool is_drawable(Handle<MeshRenderer> mesh_renderer);
+
+		/**
+		 * Update the hierarchy leaves of mesh renderers whose transform, mesh, or material changed.
+		 */
+		void update_hierarchy();
+
+
+
+		/** Hierarchy of mesh renderer bounds. Stores component IDs. */
+		DynamicBVH m_bvh = {};
+
+		/** Mesh renderers whose hierarchy leaves need updating. Stores component IDs. */
+		std::vector<uint32_t> m_update_queue = {};
+
+		/** Update queue being processed. */
+		std::vector<uint32_t> m_updating = {};
+
+		/** Mesh renderer used by each transform. */
+		std::unordered_map<resource_id, resource_id> m_transform_renderers = {};
+
+		/** Transforms that changed since the last frame. */
+		std::vector<Handle<Transform>> m_changed_transforms = {};
+
+		/** Mesh renderers that passed culling this frame. */
+		std::vector<uint32_t> m_visible_renderers = {};
+
+		/** Per instance uniform data offsets for each shader this frame. */
+		std::unordered_map<resource_id, std::array<uint32_t, 2>> m_instance_uniforms = {};
 	};
 }
\ No newline at end of file
@@ -156,6 +156,10 @@ namespace dk
 			m_unscaled_model_matrix = m_parent->m_unscaled_model_matrix * m_unscaled_model_matrix;
 		}
 
+		// Model matrix changed
+		++m_version;
+		static_cast<TransformSystem&>(get_system()).add_changed(this);
+
 		// Update childrens model matrix
 		for (auto child : m_children)
 			if(child.is_valid())
@@ -249,6 +253,26 @@ namespace dk
 		transform->set_parent(Handle<Transform>(0, nullptr));
 	}
 
+	void TransformSystem::take_changed(std::vector<Handle<Transform>>& changed)
+	{
+		changed.clear();
+		changed.swap(m_changed);
+
+		for (auto transform : changed)
+			if (transform.is_valid())
+				transform->m_change_queued = false;
+	}
+
+	void TransformSystem::add_changed(Transform* transform)
+	{
+		if (transform->m_change_queued)
+			return;
+
+		auto& allocator = static_cast<ResourceAllocator<Transform>&>(get_component_allocator());
+		m_changed.push_back(Handle<Transform>(allocator.get_id(transform), &allocator));
+		transform->m_change_queued = true;
+	}
+
 	void TransformSystem::serialize(ReflectionContext& r)
 	{
 		Handle<Transform> transform = get_active_component();
@@ -97,6 +97,16 @@ namespace dk
 			return m_model_matrix;
 		}
 
+		/**
+		 * @brief Get the transforms version.
+		 * @return Version.
+		 * @note Incremented every time the model matrix changes.
+		 */
+		uint64_t get_version() const
+		{
+			return m_version;
+		}
+
 		/**
 		 * @brief Get a forward vector realative to the transform.
 		 * @return Forward vector.
@@ -373,6 +383,12 @@ namespace dk
 		/** Model matrix without scale applied (Used for hierarchy.) */
 		glm::mat4 m_unscaled_model_matrix = {};
 
+		/** Model matrix version. */
+		uint64_t m_version = 0;
+
+		/** Is the transform in its systems change list? */
+		bool m_change_queued = false;
+
 		/** Children. */
 		std::vector<Handle<Transform>> m_children = {};
 
@@ -388,6 +404,8 @@ namespace dk
 	 */
 	class TransformSystem : public System<Transform>
 	{
+		friend class Transform;
+
 	public:
 
 		DK_SYSTEM_BODY(TransformSystem, Transform, true)
@@ -420,5 +438,24 @@ namespace dk
 		 * @param Reflection context.
 		 */
 		void inspect(ReflectionContext& r) override;
+
+		/**
+		 * Take the transforms whose model matrices changed since the last call.
+		 * @param List the changed transforms are swapped into. Its old contents are discarded.
+		 * @note Each transform is listed once however often it changed. Transforms removed
+		 *       after they changed may be listed, so check handles are valid before using them.
+		 */
+		void take_changed(std::vector<Handle<Transform>>& changed);
+
+	private:
+
+		/**
+		 * Add a transform to the change list.
+		 * @param Transform.
+		 */
+		void add_changed(Transform* transform);
+
+		/** Transforms whose model matrices changed since the last take_changed(). */
+		std::vector<Handle<Transform>> m_changed = {};
 	};
 }
\ No newline at end of file
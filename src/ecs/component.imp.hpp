@@ -27,7 +27,7 @@ namespace dk
 	template<class T>
 	System<T>& Component<T>::get_system() const
 	{
-		return m_system;
+		return *m_system;
 	}
 
 	template<class T>
@@ -40,6 +40,21 @@ namespace
 	float delta_time;
 
 	std::unique_ptr<dk::EditorWindow> editor_window;
+
+	/** Path renderer statistics are written to on shutdown. Empty if they aren't written. */
+	std::string render_statistics_path = "";
+
+	/**
+	 * Get the statistics history of the active renderer.
+	 * @return Statistics history.
+	 */
+	dk::FrameStatisticsHistory& get_statistics_history()
+	{
+		if (dk::editor::graphics.is_headless())
+			return dk::editor::null_renderer.get_statistics_history();
+
+		return dk::editor::renderer.get_statistics_history();
+	}
 }
 
 namespace dk
@@ -52,6 +67,8 @@ namespace dk
 
 		EditorRenderer editor_renderer;
 
+		NullRenderer null_renderer;
+
 		ResourceManager resource_manager;
 
 		Physics physics;
@@ -62,6 +79,14 @@ namespace dk
 
 
 
+		Renderer& get_renderer()
+		{
+			if (graphics.is_headless())
+				return null_renderer;
+
+			return renderer;
+		}
+
 		void initialize(const std::string& path)
 		{
 			// Read config file
@@ -70,28 +95,54 @@ namespace dk
 			json j;
 			stream >> j;
 
+			// The null renderer runs without a window or GPU, so the scene runs without the editor UI
+			const std::string backend = j.value("renderer", std::string("forward"));
+			dk_assert(backend == "forward" || backend == "null");
+			const bool headless = backend == "null";
+
 			// Init graphics
-			::new(&graphics)(Graphics)(j["thread_count"], j["title"], j["width"], j["height"], SDL_WINDOW_RESIZABLE);
+			if (headless)
+				::new(&graphics)(Graphics)(j["width"].get<int>(), j["height"].get<int>());
+			else
+				::new(&graphics)(Graphics)(j["thread_count"], j["title"], j["width"], j["height"], SDL_WINDOW_RESIZABLE);
 
-			// Init resource manager
-			::new(&resource_manager)(ResourceManager)(&renderer);
+			// Init resource manager. Resources are made for whichever renderer is active.
+			::new(&resource_manager)(ResourceManager)(&get_renderer());
 
 			// Create physics engine
 			::new(&physics)(Physics)(glm::vec3(j["gravity"][0], j["gravity"][1], j["gravity"][2]));
 
-			// Init renderers
-			::new(&renderer)(OffScreenForwardRenderer)
-			(
-				&graphics, 
-				graphics.get_width(), 
-				graphics.get_height(), 
-				&resource_manager.get_texture_allocator(), 
-				&resource_manager.get_mesh_allocator()
-			);
-			
-			::new(&editor_renderer)(EditorRenderer)(&graphics, graphics.get_width(), graphics.get_height());
+			if (headless)
+			{
+				// Init renderer. Only meshes are loaded without a device, and nothing is uploaded.
+				::new(&null_renderer)(NullRenderer)(&graphics);
+			}
+			else
+			{
+				// Init renderers
+				::new(&renderer)(OffScreenForwardRenderer)
+				(
+					&graphics, 
+					graphics.get_width(), 
+					graphics.get_height(), 
+					&resource_manager.get_texture_allocator(), 
+					&resource_manager.get_mesh_allocator(),
+					j.value("frames_in_flight", 2)
+				);
+				renderer.set_point_light_budget(j.value("point_light_budget", static_cast<size_t>(0)));
+
+				::new(&editor_renderer)(EditorRenderer)(&graphics, graphics.get_width(), graphics.get_height(), j.value("frames_in_flight", 2));
+			}
+
+			// Keep statistics for whichever renderer is active
+			get_statistics_history().set_capacity(j.value("render_statistics_frames", FrameStatisticsHistory::default_capacity));
+			render_statistics_path = j.value("render_statistics_csv", std::string(""));
+
+			// Load resources. Files missing from the pack are read from disk.
+			const std::string pack = j.value("pack", std::string(""));
+			if (pack != "" && !resource_manager.open_pack(pack))
+				dk_log("Failed to open " << pack);
 
-			// Load resources
 			resource_manager.load_resources
 			(
 				j["meshes"],
@@ -111,9 +162,13 @@ namespace dk
 			// Create threads
 			rendering_thread = std::make_unique<SimulationThread>([]() 
 			{ 
-				renderer.render(); 
-				editor_window->draw(delta_time);
-				editor_renderer.render();
+				get_renderer().render(); 
+
+				if (editor_window)
+				{
+					editor_window->draw(delta_time);
+					editor_renderer.render();
+				}
 			});
 
 			physics_thread = std::make_unique<SimulationThread>([]() 
@@ -130,23 +185,24 @@ namespace dk
 			physics_clock.get_delta_time();
 
 			// Create editor window (We do this here so the transform system can be added to the scene)
-			editor_window = std::make_unique<EditorWindow>
-			(
-				&graphics, 
-				&editor_renderer, 
-				&renderer, 
-				&input, 
-				&scene, 
-				&resource_manager
-			);
+			if (!graphics.is_headless())
+				editor_window = std::make_unique<EditorWindow>
+				(
+					&graphics, 
+					&editor_renderer, 
+					&renderer, 
+					&input, 
+					&scene, 
+					&resource_manager
+				);
 			
-			while (!input.is_closing() && !editor_window->get_toolbar().is_closing())
+			while (!input.is_closing() && !(editor_window && editor_window->get_toolbar().is_closing()))
 			{
 				// Gather input
 				input.poll_events();
 				
 				// Resize window if needed
-				if (input.is_resizing())
+				if (editor_window && input.is_resizing())
 				{
 					rendering_thread->wait();
 					ImGuiIO& io = ImGui::GetIO();
@@ -156,6 +212,9 @@ namespace dk
 					io.DisplaySize = ImVec2(static_cast<float>(w), static_cast<float>(h));
 				}
 				
+				// Swap in streamed resources while nothing is rendering
+				resource_manager.update_streaming();
+
 				// Get delta time
 				delta_time = game_clock.get_delta_time();
 				
@@ -180,7 +239,9 @@ namespace dk
 			// Wait for threads to finish
 			rendering_thread->wait();
 			physics_thread->wait();
-			graphics.get_device_manager().get_present_queue().waitIdle();
+
+			if (!graphics.is_headless())
+				graphics.get_device_manager().get_present_queue().waitIdle();
 		}
 
 		void shutdown()
@@ -189,11 +250,18 @@ namespace dk
 			rendering_thread.reset();
 			physics_thread.reset();
 
+			// Dump renderer statistics
+			if (render_statistics_path != "" && !get_statistics_history().write_csv(render_statistics_path))
+				dk_log("Failed to write renderer statistics to " << render_statistics_path);
+
 			// Shutdown systems
 			editor_window.reset();
 			scene.shutdown();
-			editor_renderer.shutdown();
-			renderer.shutdown();
+
+			if (!graphics.is_headless())
+				editor_renderer.shutdown();
+
+			get_renderer().shutdown();
 			physics.shutdown();
 			resource_manager.shutdown();
 			graphics.shutdown();
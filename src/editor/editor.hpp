@@ -10,6 +10,7 @@
 #include <engine\config.hpp>
 #include <graphics\graphics.hpp>
 #include <graphics\forward_renderer.hpp>
+#include <graphics\null_renderer.hpp>
 #include <engine\input.hpp>
 #include <ecs\scene.hpp>
 #include <physics\physics.hpp>
@@ -30,6 +31,9 @@ namespace dk
 		/** Editor rendering engine. */
 		extern EditorRenderer editor_renderer;
 
+		/** Rendering engine used when running headless. */
+		extern NullRenderer null_renderer;
+
 		/** Resource manager. */
 		extern ResourceManager resource_manager;
 
@@ -44,6 +48,13 @@ namespace dk
 
 
 
+		/**
+		 * Get the renderer scene data is submitted to.
+		 * @return The null renderer when running headless, or the scene rendering engine otherwise.
+		 * @note The editor UI needs a window, so it only runs with the scene rendering engine.
+		 */
+		extern Renderer& get_renderer();
+
 		/**
 		 * Initialize the engine.
 		 * @param Path to config file.
@@ -12,12 +12,17 @@
 
 namespace dk
 {
+	/** Default number of frames the CPU can record ahead of the GPU. */
+	static const size_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+
+
 	EditorRenderer::EditorRenderer()
 	{
 
 	}
 
-	EditorRenderer::EditorRenderer(Graphics* graphics, int width, int height) :
+	EditorRenderer::EditorRenderer(Graphics* graphics, int width, int height, size_t frames_in_flight) :
 		Renderer(graphics, width, height),
 		m_vk_framebuffers({})
 	{
@@ -28,14 +33,33 @@ namespace dk
 		m_vk_command_pool = get_graphics().get_logical_device().createCommandPool(pool_info);
 		dk_assert(m_vk_command_pool);
 
-		// Create command buffer
+		// Every frame in flight gets its own resources
+		m_frames.resize(frames_in_flight > 0 ? frames_in_flight : DEFAULT_FRAMES_IN_FLIGHT);
+
 		vk::CommandBufferAllocateInfo alloc_info = {};
 		alloc_info.commandPool = m_vk_command_pool;
 		alloc_info.level = vk::CommandBufferLevel::ePrimary;
 		alloc_info.commandBufferCount = 1;
-		auto command_buffers = get_graphics().get_logical_device().allocateCommandBuffers(alloc_info);
 
-		m_vk_primary_command_buffer = command_buffers[0];
+		for (auto& frame : m_frames)
+		{
+			// Create command buffer
+			frame.command_buffer = get_graphics().get_logical_device().allocateCommandBuffers(alloc_info)[0];
+			dk_assert(frame.command_buffer);
+
+			// Create semaphores
+			vk::SemaphoreCreateInfo semaphore_info = {};
+			frame.image_available = get_graphics().get_logical_device().createSemaphore(semaphore_info);
+			frame.rendering_finished = get_graphics().get_logical_device().createSemaphore(semaphore_info);
+			dk_assert(frame.image_available);
+			dk_assert(frame.rendering_finished);
+
+			// Create fence. It starts signaled since the frame has never been submitted.
+			vk::FenceCreateInfo fence_info = {};
+			fence_info.flags = vk::FenceCreateFlagBits::eSignaled;
+			frame.fence = get_graphics().get_logical_device().createFence(fence_info);
+			dk_assert(frame.fence);
+		}
 
 		m_swapchain_manager = std::make_unique<VkSwapchainManager>
 		(
@@ -46,13 +70,6 @@ namespace dk
 			height
 		);
 
-		// Create semaphores
-		vk::SemaphoreCreateInfo semaphore_info = {};
-		m_vk_image_available = get_graphics().get_logical_device().createSemaphore(semaphore_info);
-		m_vk_rendering_finished = get_graphics().get_logical_device().createSemaphore(semaphore_info);
-		dk_assert(m_vk_image_available);
-		dk_assert(m_vk_rendering_finished);
-
 		// Create the render pass
 		{
 			vk::AttachmentDescription attachment = {};
@@ -217,16 +234,30 @@ namespace dk
 
 	void EditorRenderer::shutdown()
 	{
-		// Wait for presentation to finish
+		// Wait for every frame in flight to finish
 		get_graphics().get_device_manager().get_present_queue().waitIdle();
+		get_graphics().get_logical_device().waitIdle();
 
 		// Destroy shader
 		m_ui_shader->free();
 		m_ui_shader.reset();
 
-		// Destroy buffers
-		m_draw_data.index_buffer.free(get_graphics().get_logical_device());
-		m_draw_data.vertex_buffer.free(get_graphics().get_logical_device());
+		for (auto& frame : m_frames)
+		{
+			// Destroy buffers
+			if (frame.index_buffer.buffer)
+				frame.index_buffer.free(get_graphics().get_logical_device());
+
+			if (frame.vertex_buffer.buffer)
+				frame.vertex_buffer.free(get_graphics().get_logical_device());
+
+			// Destroy synchronization objects
+			get_graphics().get_logical_device().destroySemaphore(frame.image_available);
+			get_graphics().get_logical_device().destroySemaphore(frame.rendering_finished);
+			get_graphics().get_logical_device().destroyFence(frame.fence);
+		}
+
+		m_frames.clear();
 
 		// Destroy descriptor set layout
 		get_graphics().get_logical_device().destroyDescriptorSetLayout(m_vk_font_descriptor_set_layout);
@@ -237,10 +268,6 @@ namespace dk
 		// Destroy command pool
 		get_graphics().get_logical_device().destroyCommandPool(m_vk_command_pool);
 
-		// Destroy semaphores
-		get_graphics().get_logical_device().destroySemaphore(m_vk_image_available);
-		get_graphics().get_logical_device().destroySemaphore(m_vk_rendering_finished);
-
 		// Destroy framebuffers
 		for (auto& framebuffer : m_vk_framebuffers)
 			get_graphics().get_logical_device().destroyFramebuffer(framebuffer);
@@ -251,8 +278,13 @@ namespace dk
 
 	void EditorRenderer::render()
 	{
-		// Wait for present queue to finish if needed
-		get_graphics().get_device_manager().get_present_queue().waitIdle();
+		// Wait for the GPU to finish the last frame that used these resources.
+		// The fence is reset right before submitting, since frames with nothing to draw submit nothing.
+		auto& frame = m_frames[m_frame];
+		get_graphics().get_logical_device().waitForFences(1, &frame.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+		// Submit pending uploads so the draws below see them
+		get_graphics().get_upload_manager().flush();
 
 		// Get IMGUI
 		ImGuiIO& io = ImGui::GetIO();
@@ -271,7 +303,7 @@ namespace dk
 			(
 				get_swapchain_manager().get_swapchain(),
 				std::numeric_limits<uint64_t>::max(),
-				m_vk_image_available,
+				frame.image_available,
 				vk::Fence()
 			);
 		}
@@ -293,57 +325,51 @@ namespace dk
 
 			// Create the Vertex Buffer:
 			size_t vertex_size = draw_data->TotalVtxCount * sizeof(ImDrawVert);
-			if (!m_draw_data.vertex_buffer.buffer || m_draw_data.vertex_buffer_size < vertex_size)
+			if (!frame.vertex_buffer.buffer || frame.vertex_buffer_size < vertex_size)
 			{
 				// Free old buffer
-				if (m_draw_data.vertex_buffer.buffer)
-					get_graphics().get_logical_device().destroyBuffer(m_draw_data.vertex_buffer.buffer);
-
-				if (m_draw_data.vertex_buffer.memory)
-					get_graphics().get_logical_device().freeMemory(m_draw_data.vertex_buffer.memory);
+				if (frame.vertex_buffer.buffer)
+					frame.vertex_buffer.free(get_graphics().get_logical_device());
 
 				// Create new buffer
 				VkDeviceSize vertex_buffer_size = ((vertex_size - 1) / allignment + 1) * allignment;
 
-				m_draw_data.vertex_buffer = get_graphics().create_buffer
+				frame.vertex_buffer = get_graphics().create_buffer
 				(
 					vertex_buffer_size, 
 					vk::BufferUsageFlagBits::eVertexBuffer, 
 					vk::MemoryPropertyFlagBits::eHostVisible
 				);
 
-				m_draw_data.vertex_buffer_size = static_cast<size_t>(vertex_buffer_size);
+				frame.vertex_buffer_size = static_cast<size_t>(vertex_buffer_size);
 			}
 
 			// Create the Index Buffer:
 			size_t index_size = draw_data->TotalIdxCount * sizeof(ImDrawIdx);
-			if (!m_draw_data.index_buffer.buffer || m_draw_data.index_buffer_size < index_size)
+			if (!frame.index_buffer.buffer || frame.index_buffer_size < index_size)
 			{
 				// Free old buffer
-				if (m_draw_data.index_buffer.buffer)
-					get_graphics().get_logical_device().destroyBuffer(m_draw_data.index_buffer.buffer);
-
-				if (m_draw_data.index_buffer.memory)
-					get_graphics().get_logical_device().freeMemory(m_draw_data.index_buffer.memory);
+				if (frame.index_buffer.buffer)
+					frame.index_buffer.free(get_graphics().get_logical_device());
 
 				// Create new buffer
 				vk::DeviceSize index_buffer_size = ((index_size - 1) / allignment + 1) * allignment;
 
-				m_draw_data.index_buffer = get_graphics().create_buffer
+				frame.index_buffer = get_graphics().create_buffer
 				(
 					index_buffer_size,
 					vk::BufferUsageFlagBits::eIndexBuffer,
 					vk::MemoryPropertyFlagBits::eHostVisible
 				);
 
-				m_draw_data.index_buffer_size = static_cast<size_t>(index_buffer_size);
+				frame.index_buffer_size = static_cast<size_t>(index_buffer_size);
 			}
 
 			// Upload Vertex and index Data:
 			{
-				// Map memory
-				ImDrawVert* vtx_dst = (ImDrawVert*)get_graphics().get_logical_device().mapMemory(m_draw_data.vertex_buffer.memory, 0, vertex_size);
-				ImDrawIdx* idx_dst = (ImDrawIdx*)get_graphics().get_logical_device().mapMemory(m_draw_data.index_buffer.memory, 0, index_size);;
+				// Buffers are persistently mapped
+				ImDrawVert* vtx_dst = static_cast<ImDrawVert*>(frame.vertex_buffer.memory.mapped);
+				ImDrawIdx* idx_dst = static_cast<ImDrawIdx*>(frame.index_buffer.memory.mapped);
 
 				// Copy data
 				for (int n = 0; n < draw_data->CmdListsCount; ++n)
@@ -355,16 +381,9 @@ namespace dk
 					idx_dst += cmd_list->IdxBuffer.Size;
 				}
 
-				// Unmap memory
-				std::array<vk::MappedMemoryRange, 2> range = {};
-				range[0].memory = m_draw_data.vertex_buffer.memory;
-				range[0].size = VK_WHOLE_SIZE;
-				range[1].memory = m_draw_data.index_buffer.memory;
-				range[1].size = VK_WHOLE_SIZE;
-
-				get_graphics().get_logical_device().flushMappedMemoryRanges(range);
-				get_graphics().get_logical_device().unmapMemory(m_draw_data.vertex_buffer.memory);
-				get_graphics().get_logical_device().unmapMemory(m_draw_data.index_buffer.memory);
+				// Make writes visible to the device
+				get_graphics().get_memory_manager().flush(frame.vertex_buffer.memory);
+				get_graphics().get_memory_manager().flush(frame.index_buffer.memory);
 			}
 		}
 
@@ -375,7 +394,7 @@ namespace dk
 			cmd_buf_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
 			cmd_buf_info.pInheritanceInfo = nullptr;
 
-			m_vk_primary_command_buffer.begin(cmd_buf_info);
+			frame.command_buffer.begin(cmd_buf_info);
 
 			// Clear values for all attachments written in the fragment shader
 			vk::ClearValue clear_value = {};
@@ -392,13 +411,13 @@ namespace dk
 			viewport.setWidth(static_cast<float>(extent.width));
 			viewport.setMinDepth(0);
 			viewport.setMaxDepth(1);
-			m_vk_primary_command_buffer.setViewport(0, 1, &viewport);
+			frame.command_buffer.setViewport(0, 1, &viewport);
 
 			// Set scissor
 			vk::Rect2D scissor = {};
 			scissor.setExtent(extent);
 			scissor.setOffset({ 0, 0 });
-			m_vk_primary_command_buffer.setScissor(0, 1, &scissor);
+			frame.command_buffer.setScissor(0, 1, &scissor);
 
 			// Begin render pass
 			vk::RenderPassBeginInfo render_pass_begin_info = {};
@@ -409,16 +428,16 @@ namespace dk
 			render_pass_begin_info.clearValueCount = 1;
 			render_pass_begin_info.pClearValues = &clear_value;
 
-			m_vk_primary_command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
+			frame.command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
 
 			// Bind pipeline
-			m_vk_primary_command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ui_shader->get_pipeline(0).pipeline);
+			frame.command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_ui_shader->get_pipeline(0).pipeline);
 
 			// Bind Vertex And Index Buffer:
 			{
 				vk::DeviceSize vertex_offset = 0;
-				m_vk_primary_command_buffer.bindVertexBuffers(0, m_draw_data.vertex_buffer.buffer, vertex_offset);
-				m_vk_primary_command_buffer.bindIndexBuffer(m_draw_data.index_buffer.buffer, 0, vk::IndexType::eUint16);
+				frame.command_buffer.bindVertexBuffers(0, frame.vertex_buffer.buffer, vertex_offset);
+				frame.command_buffer.bindIndexBuffer(frame.index_buffer.buffer, 0, vk::IndexType::eUint16);
 			}
 
 			// Setup scale and translation:
@@ -431,8 +450,8 @@ namespace dk
 				translate[0] = -1.0f;
 				translate[1] = -1.0f;
 
-				m_vk_primary_command_buffer.pushConstants<float>(m_ui_shader->get_pipeline(0).layout, vk::ShaderStageFlagBits::eVertex, 0, scale);
-				m_vk_primary_command_buffer.pushConstants<float>(m_ui_shader->get_pipeline(0).layout, vk::ShaderStageFlagBits::eVertex, sizeof(float) * 2, translate);
+				frame.command_buffer.pushConstants<float>(m_ui_shader->get_pipeline(0).layout, vk::ShaderStageFlagBits::eVertex, 0, scale);
+				frame.command_buffer.pushConstants<float>(m_ui_shader->get_pipeline(0).layout, vk::ShaderStageFlagBits::eVertex, sizeof(float) * 2, translate);
 			}
 
 			// Render the command lists:
@@ -451,7 +470,7 @@ namespace dk
 					else
 					{
 						vk::DescriptorSet desc_set = (VkDescriptorSet)pcmd->TextureId;
-						m_vk_primary_command_buffer.bindDescriptorSets
+						frame.command_buffer.bindDescriptorSets
 						(
 							vk::PipelineBindPoint::eGraphics,
 							m_ui_shader->get_pipeline(0).layout,
@@ -465,40 +484,41 @@ namespace dk
 						scissor.offset.y = (int32_t)(pcmd->ClipRect.y) > 0 ? (int32_t)(pcmd->ClipRect.y) : 0;
 						scissor.extent.width = (uint32_t)(pcmd->ClipRect.z - pcmd->ClipRect.x);
 						scissor.extent.height = (uint32_t)(pcmd->ClipRect.w - pcmd->ClipRect.y + 1); // FIXME: Why +1 here?
-						m_vk_primary_command_buffer.setScissor(0, scissor);
-						m_vk_primary_command_buffer.drawIndexed(pcmd->ElemCount, 1, idx_offset, vtx_offset, 0);
+						frame.command_buffer.setScissor(0, scissor);
+						frame.command_buffer.drawIndexed(pcmd->ElemCount, 1, idx_offset, vtx_offset, 0);
 					}
 					idx_offset += pcmd->ElemCount;
 				}
 				vtx_offset += cmd_list->VtxBuffer.Size;
 			}
 
-			m_vk_primary_command_buffer.endRenderPass();
-			m_vk_primary_command_buffer.end();
+			frame.command_buffer.endRenderPass();
+			frame.command_buffer.end();
 
 			vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eAllGraphics;
 
 			vk::SubmitInfo submit_info = {};
 			submit_info.commandBufferCount = 1;
-			submit_info.pCommandBuffers = &m_vk_primary_command_buffer;
+			submit_info.pCommandBuffers = &frame.command_buffer;
 			submit_info.signalSemaphoreCount = 1;
-			submit_info.pSignalSemaphores = &m_vk_rendering_finished;
+			submit_info.pSignalSemaphores = &frame.rendering_finished;
 			submit_info.pWaitDstStageMask = &wait_stage;
-			submit_info.pWaitSemaphores = &m_vk_image_available;
+			submit_info.pWaitSemaphores = &frame.image_available;
 			submit_info.waitSemaphoreCount = 1;
 
-			// Submit draw command
-			get_graphics().get_device_manager().get_graphics_queue().submit(1, &submit_info, { nullptr });
+			// Submit draw command. The fence tells us when the frame's resources are free again.
+			get_graphics().get_logical_device().resetFences(1, &frame.fence);
+			get_graphics().get_device_manager().get_graphics_queue().submit(submit_info, frame.fence);
 		}
 
-		// Wait for graphics queue to finish rendering
-		get_graphics().get_device_manager().get_graphics_queue().waitIdle();
+		// Move on to the next frame's resources
+		m_frame = (m_frame + 1) % m_frames.size();
 
 		// Present to screen
 		{
 			vk::PresentInfoKHR present_info = {};
 			present_info.waitSemaphoreCount = 1;
-			present_info.pWaitSemaphores = &m_vk_rendering_finished;
+			present_info.pWaitSemaphores = &frame.rendering_finished;
 			present_info.swapchainCount = 1;
 			present_info.pSwapchains = &get_swapchain_manager().get_swapchain();
 			present_info.pImageIndices = &image_index;
@@ -31,8 +31,9 @@ namespace dk
 		 * @param Graphics context.
 		 * @param Width.
 		 * @param Height.
+		 * @param Maximum number of frames the CPU can record ahead of the GPU.
 		 */
-		EditorRenderer(Graphics* graphics, int width, int height);
+		EditorRenderer(Graphics* graphics, int width, int height, size_t frames_in_flight = 2);
 
 		/**
 		 * @brief Destructor.
@@ -102,21 +103,12 @@ namespace dk
 		/** Framebuffers. */
 		std::vector<vk::Framebuffer> m_vk_framebuffers;
 
-		/** Semaphore to indicate an image is available for rendering too. */
-		vk::Semaphore m_vk_image_available;
-
-		/** Semaphore to indicate rendering has finished. */
-		vk::Semaphore m_vk_rendering_finished;
-
 		/** Render pass. */
 		vk::RenderPass m_vk_render_pass;
 
 		/** Command pool. */
 		vk::CommandPool m_vk_command_pool;
 
-		/** Primary graphics command buffer. */
-		vk::CommandBuffer m_vk_primary_command_buffer;
-
 		/** UI shader. */
 		std::unique_ptr<Shader> m_ui_shader;
 
@@ -124,22 +116,40 @@ namespace dk
 		vk::DescriptorSetLayout m_vk_font_descriptor_set_layout;
 
 		/**
-		 * Draw data.
+		 * @brief Resources owned by a single frame in flight.
+		 * @note None of these may be touched until the frame's fence is signaled.
 		 */
-		struct
+		struct FrameData
 		{
+			/** Signaled when the GPU finishes the frame. */
+			vk::Fence fence = {};
+
+			/** Command buffer. */
+			vk::CommandBuffer command_buffer = {};
+
+			/** Semaphore to indicate an image is available for rendering too. */
+			vk::Semaphore image_available = {};
+
+			/** Semaphore to indicate rendering has finished. */
+			vk::Semaphore rendering_finished = {};
+
 			/** Vertex buffer. */
-			VkMemBuffer vertex_buffer;
+			VkMemBuffer vertex_buffer = {};
 
 			/** Size of data last sent to the vertex buffer. */
 			size_t vertex_buffer_size = 0;
 
 			/** Index buffer. */
-			VkMemBuffer index_buffer;
+			VkMemBuffer index_buffer = {};
 
 			/** Size of data last sent to the index buffer. */
 			size_t index_buffer_size = 0;
+		};
+
+		/** Resources for each frame in flight. */
+		std::vector<FrameData> m_frames;
 
-		} m_draw_data;
+		/** Index of the frame being recorded. */
+		size_t m_frame = 0;
 	};
 }
\ No newline at end of file
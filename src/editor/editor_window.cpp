@@ -72,7 +72,7 @@ namespace dk
 
 			// Create image
 			vk::Image image;
-			vk::DeviceMemory memory;
+			VkMemAllocation memory;
 			m_graphics->create_image
 			(
 				static_cast<uint32_t>(width),
@@ -85,40 +85,14 @@ namespace dk
 				memory
 			);
 			dk_assert(image);
-			dk_assert(memory);
+			dk_assert(memory.memory);
 
 			// Create image view
 			vk::ImageView view = m_graphics->create_image_view(image, vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor);
 			dk_assert(view);
 
-			// Create staging buffer
-			VkMemBuffer staging_buffer = m_graphics->create_buffer
-			(
-				static_cast<vk::DeviceSize>(upload_size),
-				vk::BufferUsageFlagBits::eTransferSrc,
-				vk::MemoryPropertyFlagBits::eHostVisible
-			);
-
-			// Transition to transfer mode
-			m_graphics->transition_image_layout(image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-
-			// Upload to buffer
-			void* map = m_graphics->get_logical_device().mapMemory(staging_buffer.memory, 0, upload_size);
-			memcpy(map, pixels, upload_size);
-			vk::MappedMemoryRange range[1] = {};
-			range[0].memory = staging_buffer.memory;
-			range[0].size = upload_size;
-			m_graphics->get_logical_device().flushMappedMemoryRanges(1, range);
-			m_graphics->get_logical_device().unmapMemory(staging_buffer.memory);
-
-			// Copy image data
-			m_graphics->copy_buffer_to_image(staging_buffer.buffer, image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
-
-			// Transition back to sampling
-			m_graphics->transition_image_layout(image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
-
-			// Destroy staging buffer
-			staging_buffer.free(m_graphics->get_logical_device());
+			// Upload image data and transition to sampling
+			m_graphics->get_upload_manager().upload_image(pixels, static_cast<vk::DeviceSize>(upload_size), image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
 
 			// Sampler creation info
 			vk::SamplerCreateInfo sampler_info = {};
@@ -234,7 +208,7 @@ namespace dk
 		// Create widgets
 		m_inspector = std::make_unique<Inspector>(m_graphics, m_scene, m_resource_manager);
 		m_hierarchy = std::make_unique<EditorHierarchy>(m_graphics, m_scene, m_inspector.get());
-		m_scene_view = std::make_unique<SceneView>(m_scene_renderer, m_editor_renderer, m_input);
+		m_scene_view = std::make_unique<SceneView>(m_scene_renderer, m_editor_renderer, m_input, m_scene, m_inspector.get());
 		m_toolbar = std::make_unique<Toolbar>(m_graphics, m_scene);
 		m_file_explorer = std::make_unique<FileExplorer>(m_graphics);
 	}
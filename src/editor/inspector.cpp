@@ -132,8 +132,11 @@ namespace dk
 	{
 		bool run_callback = false;
 
+		// Boolean
+		if (field->type_id == TypeID<bool>::id())
+			run_callback = ImGui::Checkbox(field->name.data(), static_cast<bool*>(field->data));
 		// 32 bit integer
-		if (field->type_id == TypeID<int32_t>::id())
+		else if (field->type_id == TypeID<int32_t>::id())
 			run_callback = ImGui::InputScalar(field->name.data(), ImGuiDataType_S32, static_cast<int32_t*>(field->data));
 		// 64 bit integer
 		else if (field->type_id == TypeID<int64_t>::id())
@@ -6,14 +6,17 @@
 
 /** Includes. */
 #include <glm\gtc\matrix_transform.hpp>
+#include <components\mesh_renderer.hpp>
 #include "scene_view.hpp"
 
 namespace dk
 {
-	SceneView::SceneView(OffScreenForwardRenderer* renderer, EditorRenderer* editor_renderer, Input* input) : 
+	SceneView::SceneView(OffScreenForwardRenderer* renderer, EditorRenderer* editor_renderer, Input* input, Scene* scene, Inspector* inspector) : 
 		m_renderer(renderer),
 		m_editor_renderer(editor_renderer),
-		m_input(input)
+		m_input(input),
+		m_scene(scene),
+		m_inspector(inspector)
 	{
 		// Create descriptor pool
 		vk::DescriptorPoolSize pool_size = { vk::DescriptorType::eCombinedImageSampler, 1 };
@@ -48,13 +51,6 @@ namespace dk
 
 		renderer->get_graphics().get_logical_device().updateDescriptorSets(write_desc, {});
 
-		// Create camera command buffers
-		m_camera.command_buffers =
-		{
-			m_renderer->get_graphics().get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary),
-			m_renderer->get_graphics().get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary)
-		};
-
 		// Default camera data
 		const glm::mat4 rot_mat = glm::mat4_cast(glm::quat(glm::radians(m_camera.rotation)));
 		const glm::vec3 up = glm::vec3(rot_mat[1].x, rot_mat[1].y, rot_mat[1].z);
@@ -63,21 +59,13 @@ namespace dk
 		const float view_width = static_cast<float>(m_renderer->get_color_texture()->get_width());
 		const float view_aspect = view_height / view_width;
 		
-		CameraData camera_data = {};
-		camera_data.vp_mat = generate_vp_matrix(view_aspect, forward, up);
-		camera_data.position = m_camera.position;
-		camera_data.frustum = Frustum(camera_data.vp_mat);
-		camera_data.command_buffers = m_camera.command_buffers;
-		m_renderer->set_main_camera(camera_data);
+		m_renderer->set_main_camera(generate_camera_data(view_aspect, forward, up));
 	}
 
 	SceneView::~SceneView()
 	{
 		// Cleanup
 		m_renderer->get_graphics().get_logical_device().destroyDescriptorPool(m_vk_descriptor_pool);
-
-		for (auto& command_buffer : m_camera.command_buffers)
-			command_buffer.free();
 	}
 
 	void SceneView::draw(float delta_time)
@@ -147,21 +135,56 @@ namespace dk
 			m_camera.position += right * x * delta_time * 6.0f;
 
 			// Update camera data
-			CameraData camera_data = {};
-			camera_data.vp_mat = generate_vp_matrix(view_aspect, forward, up);
-			camera_data.position = m_camera.position;
-			camera_data.frustum = Frustum(camera_data.vp_mat);
-			camera_data.command_buffers = m_camera.command_buffers;
-			m_renderer->set_main_camera(camera_data);
+			m_renderer->set_main_camera(generate_camera_data(view_aspect, forward, up));
 		}
 
 		// Begin window
 		ImGui::Image(m_vk_descriptor_set, ImVec2(win_dim.x, win_dim.x * view_aspect), ImVec2(1, 1), ImVec2(0, 0));
+
+		// Pick entities. The image is flipped on both axes.
+		if (ImGui::IsItemClicked(0))
+		{
+			const ImVec2 mouse = ImGui::GetMousePos();
+			const ImVec2 image_min = ImGui::GetItemRectMin();
+			const ImVec2 image_size = ImGui::GetItemRectSize();
+			const float u = (mouse.x - image_min.x) / image_size.x;
+			const float v = (mouse.y - image_min.y) / image_size.y;
+			pick(glm::vec2(1.0f - 2.0f * u, 1.0f - 2.0f * v));
+		}
+	}
+
+	void SceneView::pick(glm::vec2 ndc)
+	{
+		auto system = static_cast<MeshRendererSystem*>(m_scene->get_system_by_id(TypeID<MeshRenderer>::id()));
+		if (!system)
+			return;
+
+		// Unproject the near and far plane
+		const glm::mat4 inv_vp = glm::inverse(m_renderer->get_main_camera().vp_mat);
+		glm::vec4 near_point = inv_vp * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+		glm::vec4 far_point = inv_vp * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+		near_point /= near_point.w;
+		far_point /= far_point.w;
+
+		const glm::vec3 origin = glm::vec3(near_point);
+		const glm::vec3 direction = glm::vec3(far_point) - origin;
+		const float distance = glm::length(direction);
+
+		Handle<MeshRenderer> mesh_renderer = system->raycast(origin, direction / distance, distance);
+		if (mesh_renderer.allocator)
+			m_inspector->inspect_entity(mesh_renderer->get_entity());
 	}
 
-	glm::mat4 SceneView::generate_vp_matrix(float aspect_ratio, glm::vec3 forward, glm::vec3 up)
+	CameraData SceneView::generate_camera_data(float aspect_ratio, glm::vec3 forward, glm::vec3 up)
 	{
-		return  glm::perspective(glm::radians(m_camera.field_of_view), 1.0f/aspect_ratio, m_camera.near_clipping, m_camera.far_clipping) *
-				glm::lookAt(m_camera.position, m_camera.position + forward, up);
+		CameraData camera_data = {};
+		camera_data.proj_mat = glm::perspective(glm::radians(m_camera.field_of_view), 1.0f/aspect_ratio, m_camera.near_clipping, m_camera.far_clipping);
+		camera_data.view_mat = glm::lookAt(m_camera.position, m_camera.position + forward, up);
+		camera_data.vp_mat = camera_data.proj_mat * camera_data.view_mat;
+		camera_data.near_plane = m_camera.near_clipping;
+		camera_data.far_plane = m_camera.far_clipping;
+		camera_data.position = m_camera.position;
+		camera_data.frustum = Frustum(camera_data.vp_mat);
+		return camera_data;
 	}
 }
\ No newline at end of file
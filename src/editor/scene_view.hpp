@@ -13,6 +13,7 @@
 #include <ecs\scene.hpp>
 #include <engine\input.hpp>
 #include "editor_renderer.hpp"
+#include "inspector.hpp"
 #include "imgui\imgui.h"
 
 namespace dk
@@ -26,8 +27,10 @@ namespace dk
 		 * @param Forward renderer to display.
 		 * @param Editor renderer to display on.
 		 * @param Input manager.
+		 * @param Scene to pick entities from.
+		 * @param Inspector to show picked entities in.
 		 */
-		SceneView(OffScreenForwardRenderer* renderer, EditorRenderer* editor_renderer, Input* input);
+		SceneView(OffScreenForwardRenderer* renderer, EditorRenderer* editor_renderer, Input* input, Scene* scene, Inspector* inspector);
 
 		/**
 		 * Destructor.
@@ -43,13 +46,19 @@ namespace dk
 	private:
 
 		/**
-		 * Generate a view-projection matrix for a camera.
+		 * Generate camera data for the scene camera.
 		 * @param Window aspect ratio.
 		 * @param Forward vector.
 		 * @param Up vector.
-		 * @return View-projection matrix.
+		 * @return Camera data.
 		 */
-		glm::mat4 generate_vp_matrix(float aspect_ratio, glm::vec3 forward, glm::vec3 up);
+		CameraData generate_camera_data(float aspect_ratio, glm::vec3 forward, glm::vec3 up);
+
+		/**
+		 * Inspect the entity under a point in the viewport.
+		 * @param Point in normalized device coordinates.
+		 */
+		void pick(glm::vec2 ndc);
 
 
 
@@ -62,6 +71,12 @@ namespace dk
 		/** Input manager. */
 		Input* m_input;
 
+		/** Scene. */
+		Scene* m_scene;
+
+		/** Inspector. */
+		Inspector* m_inspector;
+
 		/** Descriptor pool. */
 		vk::DescriptorPool m_vk_descriptor_pool;
 
@@ -88,9 +103,6 @@ namespace dk
 			/** Far clipping plane. */
 			float far_clipping = 1000.0f;
 
-			/** Command buffers. */
-			std::vector<VkManagedCommandBuffer> command_buffers = {};
-
 		} m_camera;
 	};
 }
\ No newline at end of file
@@ -15,6 +15,9 @@
 /** Path to editor fragment shader. */
 #define DK_EDITOR_FRAGMENT_SHADER ("shaders/editor-shader.frag.spv")
 
+/** Path prefix of the pipeline and shader reflection cache files. */
+#define DK_SHADER_CACHE_PREFIX ("shader-cache")
+
 /** Tell Duck Graphics whether to use debugging for Vulkan. */
 #define DK_DEBUG_VULKAN 1
 
@@ -33,6 +33,21 @@ namespace
 
 	/** Physics timer. */
 	float physics_timer = 0.0f;
+
+	/** Path renderer statistics are written to on shutdown. Empty if they aren't written. */
+	std::string render_statistics_path = "";
+
+	/**
+	 * Get the statistics history of the active renderer.
+	 * @return Statistics history.
+	 */
+	dk::FrameStatisticsHistory& get_statistics_history()
+	{
+		if (dk::engine::graphics.is_headless())
+			return dk::engine::null_renderer.get_statistics_history();
+
+		return dk::engine::renderer.get_statistics_history();
+	}
 }
 
 namespace dk
@@ -43,6 +58,8 @@ namespace dk
 
 		ForwardRenderer renderer;
 
+		NullRenderer null_renderer;
+
 		ResourceManager resource_manager;
 
 		Physics physics;
@@ -53,6 +70,14 @@ namespace dk
 
 
 
+		Renderer& get_renderer()
+		{
+			if (graphics.is_headless())
+				return null_renderer;
+
+			return renderer;
+		}
+
 		void initialize(const std::string& path)
 		{
 			// Read config file
@@ -61,19 +86,50 @@ namespace dk
 			json j;
 			stream >> j;
 
+			// The null renderer runs without a window or GPU
+			const std::string backend = j.value("renderer", std::string("forward"));
+			dk_assert(backend == "forward" || backend == "null");
+			const bool headless = backend == "null";
+
 			// Init graphics
-			::new(&graphics)(Graphics)(j["thread_count"], j["title"], j["width"], j["height"]);
+			if (headless)
+				::new(&graphics)(Graphics)(j["width"].get<int>(), j["height"].get<int>());
+			else
+				::new(&graphics)(Graphics)(j["thread_count"], j["title"], j["width"], j["height"]);
 
-			// Init resource manager
-			::new(&resource_manager)(ResourceManager)(&renderer);
+			// Init resource manager. Resources are made for whichever renderer is active.
+			::new(&resource_manager)(ResourceManager)(&get_renderer());
 
 			// Create physics engine
 			::new(&physics)(Physics)(glm::vec3(j["gravity"][0], j["gravity"][1], j["gravity"][2]));
 
-			// Init renderer
-			::new(&renderer)(ForwardRenderer)(&graphics, &resource_manager.get_texture_allocator(), &resource_manager.get_mesh_allocator());
+			if (headless)
+			{
+				// Init renderer. Only meshes are loaded without a device, and nothing is uploaded.
+				::new(&null_renderer)(NullRenderer)(&graphics);
+			}
+			else
+			{
+				// Init renderer
+				::new(&renderer)(ForwardRenderer)
+				(
+					&graphics, 
+					&resource_manager.get_texture_allocator(), 
+					&resource_manager.get_mesh_allocator(),
+					j.value("frames_in_flight", 2)
+				);
+				renderer.set_point_light_budget(j.value("point_light_budget", static_cast<size_t>(0)));
+			}
+
+			// Keep statistics for whichever renderer is active
+			get_statistics_history().set_capacity(j.value("render_statistics_frames", FrameStatisticsHistory::default_capacity));
+			render_statistics_path = j.value("render_statistics_csv", std::string(""));
+
+			// Load resources. Files missing from the pack are read from disk.
+			const std::string pack = j.value("pack", std::string(""));
+			if (pack != "" && !resource_manager.open_pack(pack))
+				dk_log("Failed to open " << pack);
 
-			// Load resources
 			resource_manager.load_resources
 			(
 				j["meshes"],
@@ -91,7 +147,7 @@ namespace dk
 			scene = {};
 
 			// Create threads
-			rendering_thread = std::make_unique<SimulationThread>([]() { renderer.render(); });
+			rendering_thread = std::make_unique<SimulationThread>([]() { get_renderer().render(); });
 			physics_thread = std::make_unique<SimulationThread>([]() { physics.step(physics_timer); physics_timer = 0.0f; });
 		}
 
@@ -114,6 +170,9 @@ namespace dk
 				rendering_thread->wait();
 				physics_thread->wait();
 
+				// Swap in streamed resources while nothing is rendering
+				resource_manager.update_streaming();
+
 				// Get delta time
 				float dt = game_clock.get_delta_time();
 				fps_timer += dt;
@@ -144,7 +203,9 @@ namespace dk
 			// Wait for threads to finish
 			rendering_thread->wait();
 			physics_thread->wait();
-			graphics.get_device_manager().get_present_queue().waitIdle();
+
+			if (!graphics.is_headless())
+				graphics.get_device_manager().get_present_queue().waitIdle();
 		}
 
 		void shutdown()
@@ -153,9 +214,13 @@ namespace dk
 			rendering_thread.reset();
 			physics_thread.reset();
 
+			// Dump renderer statistics
+			if (render_statistics_path != "" && !get_statistics_history().write_csv(render_statistics_path))
+				dk_log("Failed to write renderer statistics to " << render_statistics_path);
+
 			// Shutdown systems
 			scene.shutdown();
-			renderer.shutdown();
+			get_renderer().shutdown();
 			physics.shutdown();
 			resource_manager.shutdown();
 			graphics.shutdown();
@@ -10,6 +10,7 @@
 #include <engine\config.hpp>
 #include <graphics\graphics.hpp>
 #include <graphics\forward_renderer.hpp>
+#include <graphics\null_renderer.hpp>
 #include <engine\input.hpp>
 #include <ecs\scene.hpp>
 #include <physics\physics.hpp>
@@ -26,6 +27,9 @@ namespace dk
 		/** Rendering engine. */
 		extern ForwardRenderer renderer;
 
+		/** Rendering engine used when running headless. */
+		extern NullRenderer null_renderer;
+
 		/** Resource manager. */
 		extern ResourceManager resource_manager;
 
@@ -40,6 +44,12 @@ namespace dk
 
 
 
+		/**
+		 * @brief Get the renderer scene data is submitted to.
+		 * @return The null renderer when running headless, or the forward renderer otherwise.
+		 */
+		extern Renderer& get_renderer();
+
 		/**
 		 * @brief Initialize the engine.
 		 * @param Path to config file.
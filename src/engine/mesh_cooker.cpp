@@ -0,0 +1,725 @@
+/**
+ * @file mesh_cooker.cpp
+ * @brief Mesh importing and cooking source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+#include <json.hpp>
+#include <fstream>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <utilities\debugging.hpp>
+#include <utilities\mesh_lod.hpp>
+#include <utilities\mesh_optimize.hpp>
+#include "mesh_cooker.hpp"
+
+/** For convenience */
+using json = nlohmann::json;
+
+namespace dk
+{
+	const uint32_t CookedMesh::magic;
+	const uint32_t CookedMesh::version;
+
+	/**
+	 * @brief Start of a cooked mesh file.
+	 */
+	struct CookedMeshHeader
+	{
+		/** CookedMesh::magic. */
+		uint32_t magic = 0;
+
+		/** CookedMesh::version. */
+		uint32_t version = 0;
+
+		/** Hash of the sources. */
+		uint64_t source_hash = 0;
+
+		/** Vertex format. */
+		uint32_t vertex_format = 0;
+
+		/** Number of detail levels. A level header for each follows the file header. */
+		uint32_t level_count = 0;
+	};
+
+	/**
+	 * @brief Where a detail level is in a cooked mesh file.
+	 * @note Offsets are from the start of the file and keep the data 4 byte aligned.
+	 */
+	struct CookedMeshLevelHeader
+	{
+		/** Offset of the vertices. */
+		uint64_t vertex_offset = 0;
+
+		/** Offset of the indices. */
+		uint64_t index_offset = 0;
+
+		/** Offset of the sub meshes. */
+		uint64_t sub_mesh_offset = 0;
+
+		/** Number of vertices. */
+		uint32_t vertex_count = 0;
+
+		/** Number of indices. */
+		uint32_t index_count = 0;
+
+		/** Number of sub meshes. */
+		uint32_t sub_mesh_count = 0;
+
+		/** Size of each index in bytes. 2 or 4. */
+		uint32_t index_size = 0;
+
+		/** Screen size the level is used below. */
+		float screen_size = 0.0f;
+
+		/** AABB of every vertex. */
+		AABB aabb = {};
+
+		/** Unused. Keeps the header a multiple of 8 bytes without uninitialized padding. */
+		uint32_t reserved = 0;
+
+		/** Offset of the occluder positions. One per vertex. Zero if the mesh isn't an occluder. */
+		uint64_t occluder_position_offset = 0;
+
+		/** Offset of the 32 bit occluder indices. One per index. Zero if the mesh isn't an occluder. */
+		uint64_t occluder_index_offset = 0;
+	};
+
+
+
+	void MeshLevel::encode(VertexFormat format, bool occluder)
+	{
+		vertex_format = format;
+		index_type = choose_index_type(vertices.size());
+		encode_vertices(vertices, aabb, vertex_format, vertex_data);
+		encode_indices(indices, index_type, index_data);
+
+		// Packed vertices are too coarse to rasterize, so occluders keep full positions
+		occluder_positions.clear();
+		if (occluder)
+			for (const auto& vertex : vertices)
+				occluder_positions.push_back(vertex.position);
+	}
+
+	MeshView MeshLevel::get_view() const
+	{
+		dk_assert(vertex_data.size() == get_vertex_size(vertex_format) * vertices.size());
+		dk_assert(index_data.size() == get_index_size(index_type) * indices.size());
+
+		MeshView view = {};
+		view.vertices = vertex_data.data();
+		view.vertex_count = vertices.size();
+		view.vertex_format = vertex_format;
+		view.indices = index_data.data();
+		view.index_count = indices.size();
+		view.index_type = index_type;
+		view.sub_meshes = sub_meshes.data();
+		view.sub_mesh_count = sub_meshes.size();
+		view.aabb = aabb;
+
+		if (occluder_positions.size() > 0)
+		{
+			view.occluder_positions = occluder_positions.data();
+			view.occluder_indices = indices.data();
+		}
+
+		return view;
+	}
+
+	VertexFormat parse_vertex_format(const std::string& name)
+	{
+		if (name == "packed")
+			return VertexFormat::Packed;
+
+		dk_assert(name == "standard");
+		return VertexFormat::Standard;
+	}
+
+	void import_obj(const std::string& path, bool optimize, std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string err;
+	
+		// Load OBJ
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str()))
+			dk_err(err);
+	
+		// Every shape is read in one pass, so make room for all of them up front
+		size_t index_count = 0;
+		for (const auto& shape : shapes)
+			index_count += shape.mesh.indices.size();
+
+		std::vector<Vertex> face_vertices = {};
+		face_vertices.reserve(index_count);
+	
+		for (const auto& shape : shapes)
+			for (const auto& index : shape.mesh.indices)
+			{
+				Vertex vertex = {};
+	
+				// Get position
+				vertex.position =
+				{
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2]
+				};
+	
+				// Get UV. Faces without one have a negative index.
+				if (index.texcoord_index >= 0)
+					vertex.uv =
+				{
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+				};
+	
+				// Get normal
+				if (index.normal_index >= 0)
+					vertex.normal =
+				{
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2]
+				};
+
+				face_vertices.push_back(vertex);
+			}
+
+		// Reuse duplicate vertices
+		static_assert(sizeof(Vertex) == sizeof(float) * 11, "Vertices must be tightly packed floats to be deduplicated.");
+		const size_t unique_count = deduplicate_vertices(reinterpret_cast<const float*>(face_vertices.data()), face_vertices.size(), sizeof(Vertex), indices);
+
+		std::vector<Vertex> unique_vertices = {};
+		unique_vertices.reserve(unique_count);
+
+		for (size_t i = 0; i < face_vertices.size(); ++i)
+			if (indices[i] == unique_vertices.size())
+				unique_vertices.push_back(face_vertices[i]);
+
+		face_vertices.clear();
+		face_vertices.shrink_to_fit();
+
+		// Reorder for the post transform cache, overdraw, and vertex fetching
+		if (optimize && indices.size() > 0)
+		{
+			const VertexCacheStatistics before = analyze_vertex_cache(indices, unique_vertices.size());
+
+			const auto clusters = optimize_vertex_cache(indices, unique_vertices.size());
+			optimize_overdraw(indices, &unique_vertices[0].position.x, sizeof(Vertex), clusters);
+			const auto remap = optimize_vertex_fetch(indices, unique_vertices.size());
+
+			// Every vertex is used since they came from the triangles
+			std::vector<Vertex> vertices(unique_vertices.size());
+			for (size_t i = 0; i < remap.size(); ++i)
+				vertices[remap[i]] = unique_vertices[i];
+
+			unique_vertices = std::move(vertices);
+
+			const VertexCacheStatistics after = analyze_vertex_cache(indices, unique_vertices.size());
+			dk_log
+			(
+				"Optimized " << path << " : ACMR " << before.acmr << " -> " << after.acmr << 
+				", ATVR " << before.atvr << " -> " << after.atvr
+			);
+		}
+
+		vertices = std::move(unique_vertices);
+	}
+
+	void build_simplified_mesh
+	(
+		const std::vector<uint32_t>& indices,
+		const std::vector<Vertex>& vertices,
+		float ratio,
+		float max_error,
+		std::vector<uint32_t>& simplified_indices,
+		std::vector<Vertex>& simplified_vertices
+	)
+	{
+		dk_assert(ratio > 0.0f && ratio <= 1.0f);
+
+		const size_t target = static_cast<size_t>(static_cast<float>(indices.size() / 3) * ratio) * 3;
+		simplified_indices = simplify_mesh
+		(
+			indices,
+			vertices.size() > 0 ? &vertices[0].position.x : nullptr,
+			sizeof(Vertex),
+			vertices.size(),
+			target,
+			max_error
+		);
+
+		// Collapses break up the source order, so optimize again
+		const auto clusters = optimize_vertex_cache(simplified_indices, vertices.size());
+		optimize_overdraw
+		(
+			simplified_indices, 
+			vertices.size() > 0 ? &vertices[0].position.x : nullptr, 
+			sizeof(Vertex), 
+			clusters
+		);
+
+		// Drop vertices that are no longer used, keeping the rest in first use order
+		const auto remap = optimize_vertex_fetch(simplified_indices, vertices.size());
+		simplified_vertices.assign(std::count_if(remap.begin(), remap.end(), [](uint32_t index)
+		{
+			return index != std::numeric_limits<uint32_t>::max();
+		}), Vertex());
+
+		for (size_t i = 0; i < remap.size(); ++i)
+			if (remap[i] != std::numeric_limits<uint32_t>::max())
+				simplified_vertices[remap[i]] = vertices[i];
+	}
+
+	void log_packing_error(const std::string& name, const std::vector<Vertex>& vertices, const AABB& aabb)
+	{
+		const VertexPackingError error = measure_packing_error(vertices, aabb);
+		dk_log
+		(
+			"Packed " << name << " : " << (sizeof(Vertex) * vertices.size()) << " -> " << 
+			(sizeof(PackedVertex) * vertices.size()) << " bytes, max error position " << error.position << 
+			", UV " << error.uv << ", normal " << error.normal << " deg, tangent " << error.tangent << " deg"
+		);
+	}
+
+	/**
+	 * @brief Read a mesh file.
+	 * @param Mesh directory.
+	 * @param Path to the mesh file relative to the mesh directory.
+	 * @return Mesh file.
+	 */
+	static json read_mesh_file(const std::string& meshes, const std::string& path)
+	{
+		std::ifstream stream(meshes + path);
+		dk_assert(stream.is_open());
+		json j;
+		stream >> j;
+		return j;
+	}
+
+	/**
+	 * @brief Find the OBJ files a mesh file uses.
+	 * @param Mesh file.
+	 * @param List the paths, relative to the mesh directory, are appended to.
+	 * @return If the mesh file names its OBJ files properly.
+	 */
+	static bool get_mesh_sources(const json& j, std::vector<std::string>& sources)
+	{
+		if (!j.is_object() || j.find("path") == j.end() || !j["path"].is_string())
+			return false;
+
+		sources.push_back(j["path"].get<std::string>());
+
+		if (j.find("lods") != j.end())
+			for (const json& lod_j : j["lods"])
+				if (lod_j.find("path") != lod_j.end())
+				{
+					if (!lod_j["path"].is_string())
+						return false;
+
+					sources.push_back(lod_j["path"].get<std::string>());
+				}
+
+		return true;
+	}
+
+	MeshLevels build_mesh(const std::string& meshes, const std::string& path)
+	{
+		const json j = read_mesh_file(meshes, path);
+		const bool optimize = j.value("optimize", true);
+
+		MeshLevels mesh = {};
+		mesh.vertex_format = parse_vertex_format(j.value("vertex_format", std::string("standard")));
+		mesh.occluder = j.value("occluder", false);
+		mesh.levels.resize(1);
+
+		// Load file. Tangents come before normals are calculated, like meshes loaded at runtime.
+		MeshLevel& base = mesh.levels[0];
+		import_obj(meshes + j["path"].get<std::string>(), optimize, base.indices, base.vertices);
+		calculate_tangents(base.indices, base.vertices);
+		base.aabb = calculate_aabb(base.vertices);
+
+		// Calculate normals if requested
+		if (j["calc_normals"]) calculate_normals(base.indices, base.vertices);
+
+		// Split into sub meshes that are culled separately if requested
+		if (j.find("split_triangles") != j.end())
+			base.sub_meshes = split_sub_meshes(base.indices, base.vertices, j["split_triangles"]);
+		else
+		{
+			SubMesh sub_mesh = {};
+			sub_mesh.index_count = static_cast<uint32_t>(base.indices.size());
+			sub_mesh.aabb = base.aabb;
+			base.sub_meshes.push_back(sub_mesh);
+		}
+
+		if (mesh.vertex_format == VertexFormat::Packed)
+			log_packing_error(path, base.vertices, base.aabb);
+
+		// Load less detailed levels. Levels without a file are simplified from the mesh.
+		if (j.find("lods") != j.end())
+			for (const json& lod_j : j["lods"])
+			{
+				MeshLevel lod = {};
+				lod.screen_size = lod_j["screen_size"];
+
+				if (lod_j.find("path") != lod_j.end())
+				{
+					import_obj(meshes + lod_j["path"].get<std::string>(), optimize, lod.indices, lod.vertices);
+					calculate_tangents(lod.indices, lod.vertices);
+					if (j["calc_normals"]) calculate_normals(lod.indices, lod.vertices);
+				}
+				else
+				{
+					const MeshLevel& source = mesh.levels[0];
+					build_simplified_mesh(source.indices, source.vertices, lod_j["ratio"], lod_j.value("max_error", 0.05f), lod.indices, lod.vertices);
+					calculate_tangents(lod.indices, lod.vertices);
+				}
+
+				lod.aabb = calculate_aabb(lod.vertices);
+
+				SubMesh sub_mesh = {};
+				sub_mesh.index_count = static_cast<uint32_t>(lod.indices.size());
+				sub_mesh.aabb = lod.aabb;
+				lod.sub_meshes.push_back(sub_mesh);
+
+				mesh.levels.push_back(std::move(lod));
+			}
+
+		// Lay every level out the way it's uploaded
+		for (auto& level : mesh.levels)
+			level.encode(mesh.vertex_format, mesh.occluder);
+
+		return mesh;
+	}
+
+	uint64_t hash_mesh_sources(const std::string& meshes, const std::string& path)
+	{
+		uint64_t hash = hash_binary(reinterpret_cast<const char*>(&CookedMesh::version), sizeof(CookedMesh::version));
+
+		// Options and the order of the files are part of the mesh file
+		std::vector<char> data = {};
+		if (!try_read_binary_file(meshes + path, data))
+			return hash;
+
+		hash = hash_binary(data.data(), data.size(), hash);
+
+		// Broken mesh files are only hashed by their contents
+		const json j = json::parse(data.begin(), data.end(), nullptr, false);
+		std::vector<std::string> sources = {};
+		if (j.is_discarded() || !get_mesh_sources(j, sources))
+			return hash;
+
+		for (const auto& source : sources)
+		{
+			if (!try_read_binary_file(meshes + source, data))
+				data.clear();
+
+			hash = hash_binary(data.data(), data.size(), hash);
+		}
+
+		return hash;
+	}
+
+	bool check_mesh_sources(const std::string& meshes, const std::string& path)
+	{
+		std::vector<char> data = {};
+		if (!try_read_binary_file(meshes + path, data))
+			return false;
+
+		const json j = json::parse(data.begin(), data.end(), nullptr, false);
+		std::vector<std::string> sources = {};
+		if (j.is_discarded() || !get_mesh_sources(j, sources))
+			return false;
+
+		for (const auto& source : sources)
+			if (!std::ifstream(meshes + source).is_open())
+				return false;
+
+		return true;
+	}
+
+	std::string get_cooked_mesh_path(const std::string& meshes, const std::string& path)
+	{
+		const size_t extension = path.find_last_of('.');
+		const size_t directory = path.find_last_of("/\\");
+
+		if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+			return meshes + path + ".dkmesh";
+
+		return meshes + path.substr(0, extension) + ".dkmesh";
+	}
+
+	/**
+	 * @brief Append raw data to a buffer.
+	 * @param Buffer.
+	 * @param Data.
+	 * @param Data length.
+	 */
+	static void append(std::vector<char>& buffer, const void* data, size_t len)
+	{
+		const char* bytes = static_cast<const char*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + len);
+	}
+
+	/**
+	 * @brief Round a size up to a multiple of 4 bytes.
+	 * @param Size.
+	 * @return Aligned size.
+	 */
+	static uint64_t align_4(uint64_t size)
+	{
+		return (size + 3) & ~static_cast<uint64_t>(3);
+	}
+
+	bool write_cooked_mesh(const std::string& path, uint64_t source_hash, const MeshLevels& mesh)
+	{
+		CookedMeshHeader header = {};
+		header.magic = CookedMesh::magic;
+		header.version = CookedMesh::version;
+		header.source_hash = source_hash;
+		header.vertex_format = static_cast<uint32_t>(mesh.vertex_format);
+		header.level_count = static_cast<uint32_t>(mesh.levels.size());
+
+		// Lay out the data after the headers. 16 bit index blocks are padded to keep every block 4 byte aligned.
+		std::vector<CookedMeshLevelHeader> level_headers(mesh.levels.size());
+		uint64_t offset = sizeof(CookedMeshHeader) + (sizeof(CookedMeshLevelHeader) * level_headers.size());
+
+		for (size_t i = 0; i < mesh.levels.size(); ++i)
+		{
+			const MeshLevel& level = mesh.levels[i];
+			CookedMeshLevelHeader& level_header = level_headers[i];
+
+			dk_assert(level.vertex_format == mesh.vertex_format);
+			const MeshView view = level.get_view();
+
+			level_header.vertex_count = static_cast<uint32_t>(view.vertex_count);
+			level_header.index_count = static_cast<uint32_t>(view.index_count);
+			level_header.sub_mesh_count = static_cast<uint32_t>(view.sub_mesh_count);
+			level_header.index_size = static_cast<uint32_t>(get_index_size(view.index_type));
+			level_header.screen_size = level.screen_size;
+			level_header.aabb = level.aabb;
+
+			level_header.vertex_offset = offset;
+			offset += level.vertex_data.size();
+
+			level_header.index_offset = offset;
+			offset += align_4(level.index_data.size());
+
+			level_header.sub_mesh_offset = offset;
+			offset += sizeof(SubMesh) * level.sub_meshes.size();
+
+			if (view.occluder_positions)
+			{
+				level_header.occluder_position_offset = offset;
+				offset += sizeof(glm::vec3) * view.vertex_count;
+
+				level_header.occluder_index_offset = offset;
+				offset += sizeof(uint32_t) * view.index_count;
+			}
+		}
+
+		std::vector<char> buffer = {};
+		buffer.reserve(static_cast<size_t>(offset));
+		append(buffer, &header, sizeof(header));
+		append(buffer, level_headers.data(), sizeof(CookedMeshLevelHeader) * level_headers.size());
+
+		for (const auto& level : mesh.levels)
+		{
+			append(buffer, level.vertex_data.data(), level.vertex_data.size());
+			append(buffer, level.index_data.data(), level.index_data.size());
+			buffer.resize(static_cast<size_t>(align_4(buffer.size())), 0);
+			append(buffer, level.sub_meshes.data(), sizeof(SubMesh) * level.sub_meshes.size());
+
+			if (level.occluder_positions.size() > 0)
+			{
+				append(buffer, level.occluder_positions.data(), sizeof(glm::vec3) * level.occluder_positions.size());
+				append(buffer, level.indices.data(), sizeof(uint32_t) * level.indices.size());
+			}
+		}
+
+		dk_assert(buffer.size() == offset);
+		return write_binary_file(path, buffer.data(), buffer.size());
+	}
+
+	bool cook_mesh(const std::string& meshes, const std::string& path, bool force)
+	{
+		const std::string cooked_path = get_cooked_mesh_path(meshes, path);
+		const uint64_t source_hash = hash_mesh_sources(meshes, path);
+
+		// Nothing to do if the sources haven't changed
+		if (!force)
+		{
+			CookedMesh cooked = {};
+			if (cooked.open(cooked_path) && cooked.get_source_hash() == source_hash)
+				return true;
+		}
+
+		dk_log("Cooking " << path);
+		return write_cooked_mesh(cooked_path, source_hash, build_mesh(meshes, path));
+	}
+
+	size_t cook_meshes(const std::string& meshes, bool force)
+	{
+		std::ifstream stream(meshes + "resources.json");
+		if (!stream.is_open())
+		{
+			dk_log("Failed to open " << meshes << "resources.json");
+			return 1;
+		}
+
+		json j;
+		stream >> j;
+
+		size_t failed = 0;
+		for (const std::string& path : j["files"])
+			if (!cook_mesh(meshes, path, force))
+			{
+				dk_log("Failed to write " << get_cooked_mesh_path(meshes, path));
+				++failed;
+			}
+
+		return failed;
+	}
+
+
+
+	bool CookedMesh::open(const std::string& path)
+	{
+		m_levels.clear();
+		m_screen_sizes.clear();
+
+		if (!m_file.open(path))
+			return false;
+
+		if (!read(m_file.get_data(), m_file.get_size()))
+		{
+			m_file.close();
+			return false;
+		}
+
+		return true;
+	}
+
+	bool CookedMesh::open(const FileSpan& file)
+	{
+		m_file.close();
+		return read(file.data, file.size);
+	}
+
+	bool CookedMesh::read(const char* data, size_t size)
+	{
+		m_levels.clear();
+		m_screen_sizes.clear();
+
+		// Views point straight into the data, so it must be aligned for them
+		if (size < sizeof(CookedMeshHeader) || reinterpret_cast<uintptr_t>(data) % 4 != 0)
+			return false;
+
+		CookedMeshHeader header = {};
+		memcpy(&header, data, sizeof(header));
+
+		// Throw away files from other versions or that were cut short
+		if 
+		(
+			header.magic != magic || 
+			header.version != version ||
+			header.level_count == 0 ||
+			header.vertex_format > static_cast<uint32_t>(VertexFormat::Packed) ||
+			size < sizeof(CookedMeshHeader) + (sizeof(CookedMeshLevelHeader) * header.level_count)
+		)
+			return false;
+
+		// Blocks must be inside the file and aligned for their types
+		const auto valid_block = [size](uint64_t offset, uint64_t count, uint64_t element_size)
+		{
+			return offset % 4 == 0 && offset <= size && count <= (size - offset) / element_size;
+		};
+
+		for (uint32_t i = 0; i < header.level_count; ++i)
+		{
+			CookedMeshLevelHeader level_header = {};
+			memcpy(&level_header, data + sizeof(CookedMeshHeader) + (sizeof(CookedMeshLevelHeader) * i), sizeof(level_header));
+
+			if 
+			(
+				(level_header.index_size != sizeof(uint16_t) && level_header.index_size != sizeof(uint32_t)) ||
+				!valid_block(level_header.vertex_offset, level_header.vertex_count, get_vertex_size(static_cast<VertexFormat>(header.vertex_format))) ||
+				!valid_block(level_header.index_offset, level_header.index_count, level_header.index_size) ||
+				!valid_block(level_header.sub_mesh_offset, level_header.sub_mesh_count, sizeof(SubMesh)) ||
+				level_header.sub_mesh_count == 0
+			)
+			{
+				m_levels.clear();
+				m_screen_sizes.clear();
+				return false;
+			}
+
+			MeshView view = {};
+			view.vertices = data + level_header.vertex_offset;
+			view.vertex_count = level_header.vertex_count;
+			view.vertex_format = static_cast<VertexFormat>(header.vertex_format);
+			view.indices = data + level_header.index_offset;
+			view.index_count = level_header.index_count;
+			view.index_type = level_header.index_size == sizeof(uint16_t) ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+			view.sub_meshes = reinterpret_cast<const SubMesh*>(data + level_header.sub_mesh_offset);
+			view.sub_mesh_count = level_header.sub_mesh_count;
+			view.aabb = level_header.aabb;
+
+			// Indices are checked so a damaged file can't make the GPU read past the vertex buffer
+			bool valid_indices = true;
+			if (view.index_type == vk::IndexType::eUint16)
+			{
+				const uint16_t* indices = static_cast<const uint16_t*>(view.indices);
+				for (size_t j = 0; j < view.index_count; ++j)
+					valid_indices &= indices[j] < view.vertex_count;
+			}
+			else
+			{
+				const uint32_t* indices = static_cast<const uint32_t*>(view.indices);
+				for (size_t j = 0; j < view.index_count; ++j)
+					valid_indices &= indices[j] < view.vertex_count;
+			}
+
+			for (size_t j = 0; j < view.sub_mesh_count; ++j)
+				valid_indices &= static_cast<uint64_t>(view.sub_meshes[j].first_index) + view.sub_meshes[j].index_count <= view.index_count;
+
+			// Occluder data is optional, but the CPU reads positions by its indices too
+			if (level_header.occluder_position_offset != 0 || level_header.occluder_index_offset != 0)
+			{
+				valid_indices &= 
+					valid_block(level_header.occluder_position_offset, level_header.vertex_count, sizeof(glm::vec3)) &&
+					valid_block(level_header.occluder_index_offset, level_header.index_count, sizeof(uint32_t));
+
+				if (valid_indices)
+				{
+					view.occluder_positions = reinterpret_cast<const glm::vec3*>(data + level_header.occluder_position_offset);
+					view.occluder_indices = reinterpret_cast<const uint32_t*>(data + level_header.occluder_index_offset);
+
+					for (size_t j = 0; j < view.index_count; ++j)
+						valid_indices &= view.occluder_indices[j] < view.vertex_count;
+				}
+			}
+
+			if (!valid_indices)
+			{
+				m_levels.clear();
+				m_screen_sizes.clear();
+				return false;
+			}
+
+			m_levels.push_back(view);
+			m_screen_sizes.push_back(level_header.screen_size);
+		}
+
+		m_source_hash = header.source_hash;
+		m_vertex_format = static_cast<VertexFormat>(header.vertex_format);
+		return true;
+	}
+}
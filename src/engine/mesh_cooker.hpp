@@ -0,0 +1,297 @@
+#pragma once
+
+/**
+ * @file mesh_cooker.hpp
+ * @brief Mesh importing and cooking header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include <utilities\file_io.hpp>
+#include <graphics\mesh.hpp>
+
+namespace dk
+{
+	/**
+	 * @brief A detail level of a mesh built on the CPU.
+	 */
+	struct MeshLevel
+	{
+		/** Indices. */
+		std::vector<uint32_t> indices = {};
+
+		/** Vertices with tangents. */
+		std::vector<Vertex> vertices = {};
+
+		/** Sub meshes. */
+		std::vector<SubMesh> sub_meshes = {};
+
+		/** AABB of every vertex. */
+		AABB aabb = {};
+
+		/** Screen size the level is used below. Zero for the first level. */
+		float screen_size = 0.0f;
+
+		/** Vertex buffer contents. Filled by encode(). */
+		std::vector<char> vertex_data = {};
+
+		/** Index buffer contents. Filled by encode(). */
+		std::vector<char> index_data = {};
+
+		/** Vertex positions rasterized when the mesh is an occluder. Filled by encode() for occluders. */
+		std::vector<glm::vec3> occluder_positions = {};
+
+		/** Layout of the vertex buffer contents. */
+		VertexFormat vertex_format = VertexFormat::Standard;
+
+		/** Type of the index buffer contents. */
+		vk::IndexType index_type = vk::IndexType::eUint32;
+
+		/**
+		 * @brief Lay the vertices and indices out the way the GPU reads them.
+		 * @param Vertex format.
+		 * @param Keep positions for the CPU to rasterize the level as an occluder?
+		 */
+		void encode(VertexFormat format, bool occluder = false);
+
+		/**
+		 * @brief Get a view of the level.
+		 * @return Mesh view of the encoded data. Valid while the level is alive and unchanged.
+		 */
+		MeshView get_view() const;
+	};
+
+	/**
+	 * @brief Every detail level of a mesh built on the CPU.
+	 */
+	struct MeshLevels
+	{
+		/** Layout the vertex buffers should use. */
+		VertexFormat vertex_format = VertexFormat::Standard;
+
+		/** Does the mesh hide objects behind it? Every level keeps occluder data if so. */
+		bool occluder = false;
+
+		/** Detail levels from most to least detailed. */
+		std::vector<MeshLevel> levels = {};
+	};
+
+	/**
+	 * @brief Read a vertex format name.
+	 * @param "standard" or "packed".
+	 * @return Vertex format.
+	 */
+	extern VertexFormat parse_vertex_format(const std::string& name);
+
+	/**
+	 * @brief Import an OBJ file.
+	 * @param Path to the OBJ file.
+	 * @param Reorder triangles and vertices for the GPU?
+	 * @param Indices to fill.
+	 * @param Vertices to fill. Tangents are not calculated.
+	 * @note Optimizing reorders triangles for the vertex cache and overdraw, then
+	 *       vertices for fetching. Vertex cache statistics are logged before and after.
+	 */
+	extern void import_obj(const std::string& path, bool optimize, std::vector<uint32_t>& indices, std::vector<Vertex>& vertices);
+
+	/**
+	 * @brief Simplify a mesh.
+	 * @param Indices.
+	 * @param Vertices.
+	 * @param Fraction of the triangles to keep.
+	 * @param Largest distance the surface may move as a fraction of the meshes size.
+	 * @param Simplified indices to fill.
+	 * @param Simplified vertices to fill. Only vertices the simplified triangles use are copied.
+	 */
+	extern void build_simplified_mesh
+	(
+		const std::vector<uint32_t>& indices,
+		const std::vector<Vertex>& vertices,
+		float ratio,
+		float max_error,
+		std::vector<uint32_t>& simplified_indices,
+		std::vector<Vertex>& simplified_vertices
+	);
+
+	/**
+	 * @brief Log the size and largest error of packed vertices.
+	 * @param Name of the mesh.
+	 * @param Vertices with tangents.
+	 * @param AABB of the vertices.
+	 */
+	extern void log_packing_error(const std::string& name, const std::vector<Vertex>& vertices, const AABB& aabb);
+
+	/**
+	 * @brief Build every detail level a mesh file describes.
+	 * @param Mesh directory.
+	 * @param Path to the mesh file relative to the mesh directory.
+	 * @return Detail levels, encoded in the mesh files vertex format.
+	 * @note Does the same work loading the mesh file without cooking it would, without a GPU.
+	 * @note Mesh files with "occluder" set keep positions and indices for occlusion culling.
+	 */
+	extern MeshLevels build_mesh(const std::string& meshes, const std::string& path);
+
+	/**
+	 * @brief Hash everything a cooked mesh is built from.
+	 * @param Mesh directory.
+	 * @param Path to the mesh file relative to the mesh directory.
+	 * @return Hash of the mesh file, every OBJ file it uses, and the cooked format version.
+	 */
+	extern uint64_t hash_mesh_sources(const std::string& meshes, const std::string& path);
+
+	/**
+	 * @brief Check that a mesh file can be read and every OBJ file it uses exists.
+	 * @param Mesh directory.
+	 * @param Path to the mesh file relative to the mesh directory.
+	 * @return If the mesh can be built. Building or cooking a mesh that fails this is fatal.
+	 */
+	extern bool check_mesh_sources(const std::string& meshes, const std::string& path);
+
+	/**
+	 * @brief Get the path of a cooked mesh.
+	 * @param Mesh directory.
+	 * @param Path to the mesh file relative to the mesh directory.
+	 * @return Path to the cooked mesh. The mesh files extension is replaced with ".dkmesh".
+	 */
+	extern std::string get_cooked_mesh_path(const std::string& meshes, const std::string& path);
+
+	/**
+	 * @brief Write a cooked mesh file.
+	 * @param Path to the cooked mesh.
+	 * @param Hash of the sources.
+	 * @param Encoded detail levels.
+	 * @return If the file could be written.
+	 */
+	extern bool write_cooked_mesh(const std::string& path, uint64_t source_hash, const MeshLevels& mesh);
+
+	/**
+	 * @brief Cook a mesh if its sources changed since it was last cooked.
+	 * @param Mesh directory.
+	 * @param Path to the mesh file relative to the mesh directory.
+	 * @param Cook even if the cooked mesh is up to date?
+	 * @return If the cooked mesh is up to date. False if it couldn't be written.
+	 */
+	extern bool cook_mesh(const std::string& meshes, const std::string& path, bool force = false);
+
+	/**
+	 * @brief Cook every mesh a mesh directory lists.
+	 * @param Mesh directory. Must have a resources.json.
+	 * @param Cook even if the cooked meshes are up to date?
+	 * @return Number of meshes that couldn't be cooked.
+	 */
+	extern size_t cook_meshes(const std::string& meshes, bool force = false);
+
+
+
+	/**
+	 * @brief Memory mapped cooked mesh file.
+	 * @note Levels hold vertex and index buffer contents exactly as they're uploaded. Views
+	 *       point straight into the mapping, so nothing is parsed or copied to read them.
+	 * @note Levels of occluders also hold float positions and 32 bit indices for the CPU to rasterize.
+	 */
+	class CookedMesh
+	{
+	public:
+
+		/** Identifies a cooked mesh file. */
+		static const uint32_t magic = 0x534D4B44;
+
+		/** Cooked mesh format version. Bump when the format or how meshes are built changes. */
+		static const uint32_t version = 3;
+
+		/**
+		 * @brief Default constructor.
+		 */
+		CookedMesh() = default;
+
+		/**
+		 * @brief Map a cooked mesh file.
+		 * @param Path to the cooked mesh.
+		 * @return If the file is a valid cooked mesh of the current version.
+		 */
+		bool open(const std::string& path);
+
+		/**
+		 * @brief Read a cooked mesh held in memory, such as a file in an asset pack.
+		 * @param Contents of the cooked mesh. Must be aligned to 4 bytes and outlive the views.
+		 * @return If the data is a valid cooked mesh of the current version.
+		 */
+		bool open(const FileSpan& file);
+
+		/**
+		 * @brief Get the hash of the sources the mesh was cooked from.
+		 * @return Source hash.
+		 */
+		uint64_t get_source_hash() const
+		{
+			return m_source_hash;
+		}
+
+		/**
+		 * @brief Get the layout the vertex buffers should use.
+		 * @return Vertex format.
+		 */
+		VertexFormat get_vertex_format() const
+		{
+			return m_vertex_format;
+		}
+
+		/**
+		 * @brief Get the number of detail levels.
+		 * @return Number of detail levels.
+		 */
+		size_t get_level_count() const
+		{
+			return m_levels.size();
+		}
+
+		/**
+		 * @brief Get a detail level.
+		 * @param Detail level.
+		 * @return Mesh view. Valid while the file is mapped.
+		 */
+		const MeshView& get_level(size_t level) const
+		{
+			dk_assert(level < m_levels.size());
+			return m_levels[level];
+		}
+
+		/**
+		 * @brief Get the screen size a detail level is used below.
+		 * @param Detail level.
+		 * @return Screen size. Zero for the first level.
+		 */
+		float get_screen_size(size_t level) const
+		{
+			dk_assert(level < m_screen_sizes.size());
+			return m_screen_sizes[level];
+		}
+
+	private:
+
+		/**
+		 * @brief Check a cooked mesh and find its detail levels.
+		 * @param Contents of the cooked mesh.
+		 * @param Length of the contents.
+		 * @return If the data is a valid cooked mesh of the current version.
+		 */
+		bool read(const char* data, size_t size);
+
+		/** Mapped file. Closed if the mesh is read from memory. */
+		MappedFile m_file = {};
+
+		/** Hash of the sources. */
+		uint64_t m_source_hash = 0;
+
+		/** Layout the vertex buffers should use. */
+		VertexFormat m_vertex_format = VertexFormat::Standard;
+
+		/** Detail levels. */
+		std::vector<MeshView> m_levels = {};
+
+		/** Screen size each level is used below. */
+		std::vector<float> m_screen_sizes = {};
+	};
+}
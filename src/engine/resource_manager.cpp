@@ -5,12 +5,12 @@
  */
 
 /** Includes. */
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
 #include <json.hpp>
-#include <fstream>
+#include <algorithm>
 #include <utilities\debugging.hpp>
 #include <utilities\file_io.hpp>
+#include <utilities\threading.hpp>
+#include "mesh_cooker.hpp"
 #include "resource_manager.hpp"
 
 /** For convenience */
@@ -18,7 +18,426 @@ using json = nlohmann::json;
 
 namespace dk
 {
-	ResourceManager::ResourceManager(ForwardRendererBase* renderer) :
+	/**
+	 * @brief Read a vertex format from a resource file.
+	 * @param Resource file.
+	 * @return Vertex format. Standard if the file doesn't have one.
+	 */
+	static VertexFormat read_vertex_format(const json& j)
+	{
+		return parse_vertex_format(j.value("vertex_format", std::string("standard")));
+	}
+
+	/**
+	 * @brief Read the filtering mode from a texture or cube map file.
+	 * @param Texture or cube map file.
+	 * @return Filtering mode. Linear if the file doesn't have one.
+	 */
+	static vk::Filter read_filter(const json& j)
+	{
+		if (j.value("filter", std::string("linear")) == "nearest")
+			return vk::Filter::eNearest;
+
+		return vk::Filter::eLinear;
+	}
+
+	/**
+	 * @brief Read a file from an asset pack, or from disk if the pack doesn't have it.
+	 * @param Asset pack. May be closed.
+	 * @param Path to the file.
+	 * @param Span to point at the file.
+	 * @param Storage for the file if it isn't read straight from the pack.
+	 * @return If the file could be read.
+	 */
+	static bool read_file(const AssetPack& pack, const std::string& path, FileSpan& file, std::vector<char>& storage)
+	{
+		if (pack.get(path, file, storage))
+			return true;
+
+		if (!try_read_binary_file(path, storage))
+			return false;
+
+		file.data = storage.data();
+		file.size = storage.size();
+		return true;
+	}
+
+	/**
+	 * @brief Read a JSON file without failing on missing or malformed files.
+	 * @param Asset pack. May be closed.
+	 * @param Path to the file.
+	 * @param Parsed file.
+	 * @return If the file could be read and parsed.
+	 */
+	static bool try_read_json(const AssetPack& pack, const std::string& path, json& j)
+	{
+		FileSpan file = {};
+		std::vector<char> storage = {};
+
+		if (!read_file(pack, path, file, storage))
+			return false;
+
+		j = json::parse(file.data, file.data + file.size, nullptr, false);
+		return !j.is_discarded();
+	}
+
+	/**
+	 * @brief Read a JSON file.
+	 * @param Asset pack. May be closed.
+	 * @param Path to the file.
+	 * @return Parsed file.
+	 */
+	static json read_json(const AssetPack& pack, const std::string& path)
+	{
+		json j = {};
+		if (!try_read_json(pack, path, j))
+			dk_err("Failed to read " << path);
+
+		return j;
+	}
+
+	/**
+	 * @brief Read a binary file.
+	 * @param Asset pack. May be closed.
+	 * @param Path to the file.
+	 * @return Contents of the file.
+	 */
+	static std::vector<char> read_binary(const AssetPack& pack, const std::string& path)
+	{
+		FileSpan file = {};
+		std::vector<char> storage = {};
+
+		if (!read_file(pack, path, file, storage))
+			dk_err("Failed to read " << path);
+
+		// Files read from disk are already in the storage
+		if (file.data != storage.data())
+			storage.assign(file.data, file.data + file.size);
+
+		return storage;
+	}
+
+	/**
+	 * @brief Decode the images of a texture or cube map.
+	 * @param Asset pack. May be closed.
+	 * @param Paths to the images, one per layer.
+	 * @return Image data. Empty if an image couldn't be read or decoded.
+	 */
+	static ImageData read_image(const AssetPack& pack, const std::vector<std::string>& paths)
+	{
+		std::vector<FileSpan> files(paths.size());
+		std::vector<std::vector<char>> storage(paths.size());
+
+		for (size_t i = 0; i < paths.size(); ++i)
+			if (!read_file(pack, paths[i], files[i], storage[i]))
+				return {};
+
+		return decode_image(files);
+	}
+
+
+
+	/**
+	 * @brief A mesh decoded for loading.
+	 */
+	struct MeshLoad
+	{
+		/** Path to the mesh file. */
+		std::string path = "";
+
+		/** Cooked mesh. */
+		CookedMesh cooked = {};
+
+		/** Cooked mesh decompressed from an asset pack. */
+		std::vector<char> storage = {};
+
+		/** Detail levels built in memory if the mesh couldn't be cooked. */
+		MeshLevels levels = {};
+
+		/** Was the mesh built in memory? */
+		bool built = false;
+
+		/**
+		 * @brief Get the number of detail levels.
+		 * @return Number of detail levels.
+		 */
+		size_t get_level_count() const
+		{
+			return built ? levels.levels.size() : cooked.get_level_count();
+		}
+
+		/**
+		 * @brief Get a detail level.
+		 * @param Detail level.
+		 * @return Mesh view.
+		 */
+		MeshView get_level(size_t level) const
+		{
+			return built ? levels.levels[level].get_view() : cooked.get_level(level);
+		}
+
+		/**
+		 * @brief Get the screen size a detail level is used below.
+		 * @param Detail level.
+		 * @return Screen size.
+		 */
+		float get_screen_size(size_t level) const
+		{
+			return built ? levels.levels[level].screen_size : cooked.get_screen_size(level);
+		}
+
+		/**
+		 * @brief Get the size of every detail level.
+		 * @return Size in bytes of the vertices and indices.
+		 */
+		size_t get_size() const
+		{
+			size_t size = 0;
+
+			for (size_t i = 0; i < get_level_count(); ++i)
+			{
+				const MeshView view = get_level(i);
+				size += (view.vertex_count * get_vertex_size(view.vertex_format)) + (view.index_count * get_index_size(view.index_type));
+			}
+
+			return size;
+		}
+	};
+
+	/**
+	 * @brief A texture or cube map decoded for loading.
+	 */
+	struct TextureLoad
+	{
+		/** Path to the texture or cube map file. */
+		std::string path = "";
+
+		/** Decoded image. */
+		ImageData image = {};
+
+		/** Filtering mode. */
+		vk::Filter filter = vk::Filter::eLinear;
+
+		/** Mip map levels. */
+		uint32_t mip_map_levels = 1;
+	};
+
+	/**
+	 * @brief A shader read for loading.
+	 */
+	struct ShaderLoad
+	{
+		/** Path to the shader file. */
+		std::string path = "";
+
+		/** Vertex shader byte code. */
+		std::vector<char> vert_byte_code = {};
+
+		/** Fragment shader byte code. */
+		std::vector<char> frag_byte_code = {};
+
+		/** Does the shader use the depth buffer? */
+		bool depth = false;
+
+		/** Vertex format. */
+		VertexFormat vertex_format = VertexFormat::Standard;
+	};
+
+	/**
+	 * @brief A material or sky box file parsed for loading.
+	 */
+	struct FileLoad
+	{
+		/** Path to the file. */
+		std::string path = "";
+
+		/** Parsed file. */
+		json j = {};
+	};
+
+	/**
+	 * @brief Runs load jobs on a thread pool and hands their results out in order.
+	 */
+	class LoadQueue
+	{
+	public:
+
+		/**
+		 * @brief Add a job. Must be called before run().
+		 * @param Job.
+		 */
+		void add(std::function<void()> job)
+		{
+			m_jobs.push_back(std::move(job));
+		}
+
+		/**
+		 * @brief Start running jobs in the order they were added.
+		 * @param Thread pool. Must outlive the jobs.
+		 */
+		void run(ThreadPool& thread_pool)
+		{
+			m_finished.resize(m_jobs.size(), false);
+
+			// Workers take the next job when they finish one, so slow jobs don't hold up the rest
+			for (auto worker : thread_pool.workers)
+				worker->add_job([this]()
+				{
+					for (size_t job = m_next++; job < m_jobs.size(); job = m_next++)
+					{
+						m_jobs[job]();
+
+						std::lock_guard<std::mutex> lock(m_mutex);
+						m_finished[job] = true;
+						m_condition.notify_all();
+					}
+				});
+		}
+
+		/**
+		 * @brief Wait for a job to finish.
+		 * @param Index of the job in the order it was added.
+		 */
+		void wait(size_t job)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this, job]() { return m_finished[job]; });
+		}
+
+	private:
+
+		/** Jobs. */
+		std::vector<std::function<void()>> m_jobs = {};
+
+		/** Has each job finished? */
+		std::vector<bool> m_finished = {};
+
+		/** Next job to run. */
+		std::atomic<size_t> m_next{ 0 };
+
+		/** Lock for finished jobs. */
+		std::mutex m_mutex;
+
+		/** Signaled when a job finishes. */
+		std::condition_variable m_condition;
+	};
+
+	/**
+	 * @brief Load a mesh, cooking it first if its sources changed.
+	 * @param Asset pack. May be closed.
+	 * @param Mesh directory.
+	 * @param Mesh to load. The path must be set.
+	 * @return If the mesh was loaded. False if the mesh file or its OBJ files can't be read.
+	 * @note Meshes in the pack are read as they are, without checking their sources.
+	 */
+	static bool load_mesh(const AssetPack& pack, const std::string& meshes, MeshLoad& load)
+	{
+		FileSpan file = {};
+		if (pack.get(get_cooked_mesh_path(meshes, load.path), file, load.storage) && load.cooked.open(file))
+			return true;
+
+		// Cooking and building treat missing sources as fatal
+		if (!check_mesh_sources(meshes, load.path))
+			return false;
+
+		if (cook_mesh(meshes, load.path) && load.cooked.open(get_cooked_mesh_path(meshes, load.path)))
+			return true;
+
+		// Build the mesh in memory if it can't be cooked
+		dk_log("Failed to cook " << load.path);
+		load.levels = build_mesh(meshes, load.path);
+		load.built = true;
+		return true;
+	}
+
+	/**
+	 * @brief Read a texture file and decode its image.
+	 * @param Asset pack. May be closed.
+	 * @param Texture directory.
+	 * @param Texture to load. The path must be set.
+	 * @return If the texture file was read. False if it's missing or malformed.
+	 * @note The image is left empty if it can't be decoded.
+	 */
+	static bool load_texture(const AssetPack& pack, const std::string& textures, TextureLoad& load)
+	{
+		json j = {};
+		if (!try_read_json(pack, textures + load.path, j) || !j.is_object())
+			return false;
+
+		// Cube map files list six faces instead, so they leave the image empty
+		if (j.find("path") == j.end())
+			return true;
+
+		if (!j["path"].is_string() || j.find("mip") == j.end() || !j["mip"].is_number_unsigned())
+			return false;
+
+		const std::string tex_path = j["path"];
+		load.filter = read_filter(j);
+		load.mip_map_levels = j["mip"];
+		load.image = read_image(pack, { textures + tex_path });
+		return true;
+	}
+
+	/**
+	 * @brief Create the less detailed levels of a mesh.
+	 * @param Resource manager.
+	 * @param Mesh.
+	 * @param Loaded mesh.
+	 */
+	static void add_lods(ResourceManager& resource_manager, HMesh mesh, const MeshLoad& load)
+	{
+		for (size_t i = 1; i < load.get_level_count(); ++i)
+		{
+			// Created before touching the mesh since creating a mesh can move the others
+			const std::string lod_name = load.path + "#lod" + std::to_string(i);
+			HMesh lod = resource_manager.create_mesh(lod_name, load.get_level(i));
+			mesh->add_lod(lod, load.get_screen_size(i));
+		}
+	}
+
+	/** Number of threads streaming resources. */
+	static const size_t STREAM_THREAD_COUNT = 2;
+
+
+
+	struct ResourceManager::StreamRequest
+	{
+		/** Type of the resource. */
+		StreamType type = StreamType::Mesh;
+
+		/** ID of the placeholder. */
+		resource_id id = 0;
+
+		/** Priority. Higher priorities are loaded first. */
+		int32_t priority = 0;
+
+		/** Order the request was made in. */
+		uint64_t order = 0;
+
+		/** Has a streaming thread taken the request? */
+		bool started = false;
+
+		/** Has the resource finished loading? */
+		bool finished = false;
+
+		/** Did loading fail? Set before the request finishes. */
+		bool failed = false;
+
+		/** Was the request cancelled? A streaming thread that took it drops what it loaded. */
+		bool cancelled = false;
+
+		/** Mesh being loaded. */
+		MeshLoad mesh = {};
+
+		/** Texture being loaded. */
+		TextureLoad texture = {};
+	};
+
+	const size_t ResourceManager::default_stream_budget;
+
+
+
+	ResourceManager::ResourceManager(Renderer* renderer) :
 		m_renderer(renderer),
 		m_mesh_map({}),
 		m_shader_map({}),
@@ -38,6 +457,16 @@ namespace dk
 
 	void ResourceManager::shutdown()
 	{
+		// Drop requests so queued jobs find nothing to do, then wait for the ones already loading.
+		// Placeholders are freed like any other resource.
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			m_stream_requests.clear();
+		}
+
+		m_stream_pool.reset();
+		m_pack.close();
+
 		for(resource_id i = 0; i < m_mesh_allocator->max_allocated(); ++i)
 			if (m_mesh_allocator->is_allocated(i))
 			{
@@ -95,6 +524,15 @@ namespace dk
 		m_cube_map_allocator.reset();
 	}
 
+	bool ResourceManager::open_pack(const std::string& path)
+	{
+		if (!m_pack.open(path))
+			return false;
+
+		dk_log("Opened " << path << " with " << m_pack.get_file_count() << " files");
+		return true;
+	}
+
 	void ResourceManager::load_resources
 	(
 		const std::string& meshes,
@@ -105,194 +543,455 @@ namespace dk
 		const std::string& sky_boxes
 	)
 	{
-		// Resource JSON
-		json mesh_j;
-		json shader_j;
-		json material_j;
-		json texture_j;
-		json cube_map_j;
-		json sky_box_j;
-
-		// Load resource files
-		{
-			// Meshes
-			std::ifstream stream(meshes + "resources.json");
-			dk_assert(stream.is_open());
-			stream >> mesh_j;
-			stream.close();
-
-			// Textures
-			stream.open(textures + "resources.json");
-			dk_assert(stream.is_open());
-			stream >> texture_j;
-			stream.close();
-
-			// Shaders
-			stream.open(shaders + "resources.json");
-			dk_assert(stream.is_open());
-			stream >> shader_j;
-			stream.close();
-
-			// Materials
-			stream.open(materials + "resources.json");
-			dk_assert(stream.is_open());
-			stream >> material_j;
-			stream.close();
-
-			// Cube maps
-			stream.open(cube_maps + "resources.json");
-			dk_assert(stream.is_open());
-			stream >> cube_map_j;
-			stream.close();
-
-			// Sky boxes
-			stream.open(sky_boxes + "resources.json");
-			dk_assert(stream.is_open());
-			stream >> sky_box_j;
-			stream.close();
+		// Streamed resources are loaded from the same directories
+		m_mesh_directory = meshes;
+		m_texture_directory = textures;
+
+		// Only meshes have a CPU side. Everything else is skipped without a device.
+		const bool headless = m_renderer->get_graphics().is_headless();
+		const json no_files_j = { { "files", json::array() } };
+
+		// Resource files. Read from the pack if it has them.
+		const json mesh_j = read_json(m_pack, meshes + "resources.json");
+		const json texture_j = headless ? no_files_j : read_json(m_pack, textures + "resources.json");
+		const json shader_j = headless ? no_files_j : read_json(m_pack, shaders + "resources.json");
+		const json material_j = headless ? no_files_j : read_json(m_pack, materials + "resources.json");
+		const json cube_map_j = headless ? no_files_j : read_json(m_pack, cube_maps + "resources.json");
+		const json sky_box_j = headless ? no_files_j : read_json(m_pack, sky_boxes + "resources.json");
+
+		// Decoded resources. Sized up front since jobs write into them while they're read.
+		std::vector<MeshLoad> mesh_loads(mesh_j["files"].size());
+		std::vector<TextureLoad> texture_loads(texture_j["files"].size());
+		std::vector<TextureLoad> cube_map_loads(cube_map_j["files"].size());
+		std::vector<ShaderLoad> shader_loads(shader_j["files"].size());
+		std::vector<FileLoad> material_loads(material_j["files"].size());
+		std::vector<FileLoad> sky_box_loads(sky_box_j["files"].size());
+
+		// Jobs are added in the order their resources are created
+		LoadQueue queue = {};
+
+		// Meshes are cooked the first time they're loaded and whenever their sources change
+		for (size_t i = 0; i < mesh_loads.size(); ++i)
+		{
+			MeshLoad& load = mesh_loads[i];
+			load.path = mesh_j["files"][i].get<std::string>();
+			queue.add([this, &meshes, &load]()
+			{
+				if (!load_mesh(m_pack, meshes, load))
+					dk_err("Failed to read " << meshes << load.path);
+			});
 		}
 
-		// Load meshes
-		for (const std::string& path : mesh_j["files"])
+		for (size_t i = 0; i < texture_loads.size(); ++i)
 		{
-			// Load mesh file
-			std::ifstream stream(meshes + path);
-			dk_assert(stream.is_open());
-			json j;
-			stream >> j;
-			stream.close();
+			TextureLoad& load = texture_loads[i];
+			load.path = texture_j["files"][i].get<std::string>();
+			queue.add([this, &textures, &load]()
+			{
+				if (!load_texture(m_pack, textures, load))
+					dk_err("Failed to read " << textures << load.path);
+			});
+		}
 
-			// Load file
-			std::string mesh_path = j["path"];
-			HMesh mesh = create_mesh(path, meshes + mesh_path);
+		for (size_t i = 0; i < cube_map_loads.size(); ++i)
+		{
+			TextureLoad& load = cube_map_loads[i];
+			load.path = cube_map_j["files"][i].get<std::string>();
+			queue.add([this, &cube_maps, &load]()
+			{
+				json j = read_json(m_pack, cube_maps + load.path);
+				const std::string top_path = j["top"];
+				const std::string bottom_path = j["bottom"];
+				const std::string north_path = j["north"];
+				const std::string east_path = j["east"];
+				const std::string south_path = j["south"];
+				const std::string west_path = j["west"];
+				load.filter = read_filter(j);
+				load.image = read_image
+				(
+					m_pack,
+					{
+						cube_maps + west_path,
+						cube_maps + east_path,
+						cube_maps + top_path,
+						cube_maps + bottom_path,
+						cube_maps + north_path,
+						cube_maps + south_path
+					}
+				);
+			});
+		}
 
-			// Calculate normals if requested
-			if (j["calc_normals"]) mesh->compute_normals();
+		for (size_t i = 0; i < shader_loads.size(); ++i)
+		{
+			ShaderLoad& load = shader_loads[i];
+			load.path = shader_j["files"][i].get<std::string>();
+			queue.add([this, &shaders, &load]()
+			{
+				json j = read_json(m_pack, shaders + load.path);
+				const std::string vert_path = j["vertex"];
+				const std::string frag_path = j["fragment"];
+				load.vert_byte_code = read_binary(m_pack, shaders + vert_path);
+				load.frag_byte_code = read_binary(m_pack, shaders + frag_path);
+				load.depth = j["depth"];
+				load.vertex_format = read_vertex_format(j);
+
+				// Reflect here so creating the shader finds the results in the cache
+				m_renderer->get_graphics().get_shader_cache().reflect(load.vert_byte_code, load.frag_byte_code);
+			});
 		}
 
-		// Load textures
-		for (const std::string& path : texture_j["files"])
+		for (size_t i = 0; i < material_loads.size(); ++i)
 		{
-			// Load texture file
-			std::ifstream stream(textures + path);
-			dk_assert(stream.is_open());
-			json j;
-			stream >> j;
-			stream.close();
+			FileLoad& load = material_loads[i];
+			load.path = material_j["files"][i].get<std::string>();
+			queue.add([this, &materials, &load]() { load.j = read_json(m_pack, materials + load.path); });
+		}
 
-			// Find filtering mode
-			vk::Filter filter = vk::Filter::eLinear;
+		for (size_t i = 0; i < sky_box_loads.size(); ++i)
+		{
+			FileLoad& load = sky_box_loads[i];
+			load.path = sky_box_j["files"][i].get<std::string>();
+			queue.add([this, &sky_boxes, &load]() { load.j = read_json(m_pack, sky_boxes + load.path); });
+		}
 
-			if (j["filter"] == "nearest")
-				filter = vk::Filter::eNearest;
-			else if (j["filter"] == "linear")
-				filter = vk::Filter::eLinear;
+		ThreadPool thread_pool(std::max<size_t>(std::thread::hardware_concurrency(), 1));
+		queue.run(thread_pool);
+		size_t job = 0;
 
-			// Create texture
-			std::string tex_path = j["path"];
-			create_texture(path, textures + tex_path, filter, j["mip"]);
+		// Create meshes. Uploads are recorded into the upload managers pending batch.
+		for (auto& load : mesh_loads)
+		{
+			// Cooked meshes upload straight from the mapping
+			queue.wait(job++);
+			HMesh mesh = create_mesh(load.path, load.get_level(0));
+			add_lods(*this, mesh, load);
 		}
 
-		// Load cube maps
-		for (const std::string& path : cube_map_j["files"])
-		{
-			// Load cube map file
-			std::ifstream stream(cube_maps + path);
-			dk_assert(stream.is_open());
-			json j;
-			stream >> j;
-			stream.close();
-
-			// Find filtering mode
-			vk::Filter filter = vk::Filter::eLinear;
-
-			if (j["filter"] == "nearest")
-				filter = vk::Filter::eNearest;
-			else if (j["filter"] == "linear")
-				filter = vk::Filter::eLinear;
-
-			// Create cube map
-			std::string top_path = j["top"];
-			std::string bottom_path = j["bottom"];
-			std::string north_path = j["north"];
-			std::string east_path = j["east"];
-			std::string south_path = j["south"];
-			std::string west_path = j["west"];
-			create_cube_map
-			(
-				path,
-				cube_maps + top_path,
-				cube_maps + bottom_path,
-				cube_maps + north_path,
-				cube_maps + east_path,
-				cube_maps + south_path,
-				cube_maps + west_path,
-				filter
-			);
+		// Create textures
+		for (auto& load : texture_loads)
+		{
+			queue.wait(job++);
+			create_texture(load.path, load.image, load.filter, load.mip_map_levels);
+			load.image = {};
 		}
 
-		// Load shaders
-		for (const std::string& path : shader_j["files"])
+		// Create cube maps
+		for (auto& load : cube_map_loads)
 		{
-			// Load shader file
-			std::ifstream stream(shaders + path);
-			dk_assert(stream.is_open());
-			json j;
-			stream >> j;
-			stream.close();
+			queue.wait(job++);
+			create_cube_map(load.path, load.image, load.filter);
+			load.image = {};
+		}
 
-			// Create shader
-			std::string vert_path = j["vertex"];
-			std::string frag_path = j["fragment"];
+		// Create shaders
+		for (auto& load : shader_loads)
+		{
+			queue.wait(job++);
 			create_shader
 			(
-				path,
-				read_binary_file(shaders + vert_path),
-				read_binary_file(shaders + frag_path),
-				j["depth"]
+				load.path,
+				load.vert_byte_code,
+				load.frag_byte_code,
+				load.depth,
+				load.vertex_format
 			);
 		}
 
-		// Load materials
-		for (const std::string& path : material_j["files"])
+		// Create materials. Every shader, texture, and cube map exists by now.
+		for (auto& load : material_loads)
 		{
-			// Load material file
-			std::ifstream stream(materials + path);
-			dk_assert(stream.is_open());
-			json j;
-			stream >> j;
-			stream.close();
-
-			// Create material
-			HMaterial material = create_material(path, get_shader(j["shader"]));
+			queue.wait(job++);
+			HMaterial material = create_material(load.path, get_shader(load.j["shader"]));
 
 			// Set textures
-			for (auto& texture : j["textures"])
+			for (auto& texture : load.j["textures"])
 				material->set_texture(texture["index"], get_texture(texture["path"]));
 
 			// Set cube maps
-			for (auto& cube_map : j["cubemaps"])
+			for (auto& cube_map : load.j["cubemaps"])
 				material->set_cube_map(cube_map["index"], get_cube_map(cube_map["path"]));
 		}
 
-		// Load sky boxes
-		for (const std::string& path : sky_box_j["files"])
+		// Create sky boxes. Every material and mesh exists by now.
+		for (auto& load : sky_box_loads)
 		{
-			// Load sky box file
-			std::ifstream stream(sky_boxes + path);
-			dk_assert(stream.is_open());
-			json j;
-			stream >> j;
-			stream.close();
+			queue.wait(job++);
+			HSkyBox sky_box = create_sky_box(load.path);
+			sky_box->set_material(get_material(load.j["material"]));
+			sky_box->set_mesh(get_mesh(load.j["mesh"]));
+		}
+	}
+
+	HMesh ResourceManager::request_mesh(const std::string& path, int32_t priority)
+	{
+		auto it = m_mesh_map.find(path);
+		if (it != m_mesh_map.end())
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			const size_t index = find_stream_request(StreamType::Mesh, it->second);
+
+			if (index < m_stream_requests.size() && !m_stream_requests[index]->started)
+				m_stream_requests[index]->priority = std::max(m_stream_requests[index]->priority, priority);
 
-			// Create sky box
-			HSkyBox sky_box = create_sky_box(path);
-			sky_box->set_material(get_material(j["material"]));
-			sky_box->set_mesh(get_mesh(j["mesh"]));
+			return HMesh(it->second, m_mesh_allocator.get());
 		}
+
+		if (m_mesh_allocator->num_allocated() + 1 > m_mesh_allocator->max_allocated())
+			m_mesh_allocator->resize(m_mesh_allocator->max_allocated() + 16);
+
+		// The placeholder isn't resident until the mesh is swapped in
+		auto mesh = HMesh(m_mesh_allocator->allocate(), m_mesh_allocator.get());
+		::new(m_mesh_allocator->get_resource_by_handle(mesh.id))(Mesh)();
+
+		m_mesh_map[path] = mesh.id;
+
+		auto request = std::make_shared<StreamRequest>();
+		request->type = StreamType::Mesh;
+		request->id = mesh.id;
+		request->priority = priority;
+		request->mesh.path = path;
+		add_stream_request(request);
+
+		return mesh;
+	}
+
+	HTexture ResourceManager::request_texture(const std::string& path, int32_t priority)
+	{
+		auto it = m_texture_map.find(path);
+		if (it != m_texture_map.end())
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			const size_t index = find_stream_request(StreamType::Texture, it->second);
+
+			if (index < m_stream_requests.size() && !m_stream_requests[index]->started)
+				m_stream_requests[index]->priority = std::max(m_stream_requests[index]->priority, priority);
+
+			return HTexture(it->second, m_texture_allocator.get());
+		}
+
+		// Textures have nowhere to go without a device
+		if (m_renderer->get_graphics().is_headless())
+			return HTexture(0, nullptr);
+
+		if (m_texture_allocator->num_allocated() + 1 > m_texture_allocator->max_allocated())
+			m_texture_allocator->resize(m_texture_allocator->max_allocated() + 16);
+
+		// The placeholder isn't resident, or in the texture table, until the texture is swapped in
+		auto texture = HTexture(m_texture_allocator->allocate(), m_texture_allocator.get());
+		::new(m_texture_allocator->get_resource_by_handle(texture.id))(Texture)();
+
+		m_texture_map[path] = texture.id;
+
+		auto request = std::make_shared<StreamRequest>();
+		request->type = StreamType::Texture;
+		request->id = texture.id;
+		request->priority = priority;
+		request->texture.path = path;
+		add_stream_request(request);
+
+		return texture;
+	}
+
+	bool ResourceManager::cancel(HMesh mesh)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			const size_t index = find_stream_request(StreamType::Mesh, mesh.id);
+
+			if (index == m_stream_requests.size())
+				return false;
+
+			// A streaming thread that already took the request keeps it alive until it's done, but won't publish it
+			m_stream_requests[index]->cancelled = true;
+			m_stream_requests.erase(m_stream_requests.begin() + index);
+		}
+
+		discard_mesh_placeholder(mesh.id);
+		return true;
+	}
+
+	bool ResourceManager::cancel(HTexture texture)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			const size_t index = find_stream_request(StreamType::Texture, texture.id);
+
+			if (index == m_stream_requests.size())
+				return false;
+
+			// A streaming thread that already took the request keeps it alive until it's done, but won't publish it
+			m_stream_requests[index]->cancelled = true;
+			m_stream_requests.erase(m_stream_requests.begin() + index);
+		}
+
+		discard_texture_placeholder(texture.id);
+		return true;
+	}
+
+	void ResourceManager::update_streaming(size_t budget)
+	{
+		std::vector<std::shared_ptr<StreamRequest>> finished = {};
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			for (const auto& request : m_stream_requests)
+				if (request->finished)
+					finished.push_back(request);
+		}
+
+		std::sort
+		(
+			finished.begin(),
+			finished.end(),
+			[](const std::shared_ptr<StreamRequest>& a, const std::shared_ptr<StreamRequest>& b)
+			{
+				return a->priority != b->priority ? a->priority > b->priority : a->order < b->order;
+			}
+		);
+
+		size_t swapped = 0;
+		for (const auto& request : finished)
+		{
+			const size_t size =
+				request->failed ? 0 :
+				request->type == StreamType::Mesh ? request->mesh.get_size() :
+				request->texture.image.pixels.size();
+
+			// The rest wait for the next frame
+			if (swapped > 0 && swapped + size > budget)
+				break;
+
+			swapped += size;
+
+			if (request->type == StreamType::Mesh && request->failed)
+			{
+				dk_log("Failed to stream " << request->mesh.path);
+				discard_mesh_placeholder(request->id);
+			}
+			else if (request->type == StreamType::Mesh)
+			{
+				const MeshLoad& load = request->mesh;
+				::new(m_mesh_allocator->get_resource_by_handle(request->id))(Mesh)(&m_renderer->get_graphics(), load.get_level(0));
+				add_lods(*this, HMesh(request->id, m_mesh_allocator.get()), load);
+			}
+			else if (!request->failed && request->texture.image.layer_count == 1)
+			{
+				const TextureLoad& load = request->texture;
+				::new(m_texture_allocator->get_resource_by_handle(request->id))(Texture)
+				(
+					&m_renderer->get_graphics(),
+					load.image,
+					load.filter,
+					load.mip_map_levels
+				);
+				get_forward_renderer().get_texture_table().set_texture(HTexture(request->id, m_texture_allocator.get()));
+			}
+			else
+			{
+				// The file couldn't be read, nothing was decoded, or the file wasn't a single image
+				dk_log("Failed to stream " << request->texture.path);
+				discard_texture_placeholder(request->id);
+			}
+
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			m_stream_requests.erase(std::find(m_stream_requests.begin(), m_stream_requests.end(), request));
+		}
+	}
+
+	void ResourceManager::add_stream_request(std::shared_ptr<StreamRequest> request)
+	{
+		if (!m_stream_pool)
+			m_stream_pool = std::make_unique<ThreadPool>(STREAM_THREAD_COUNT);
+
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+			request->order = m_next_stream_order++;
+			m_stream_requests.push_back(std::move(request));
+		}
+
+		// Jobs load whichever request has the highest priority when they start, not this one
+		m_stream_pool->workers[m_next_stream_worker]->add_job([this]() { run_stream_request(); });
+		m_next_stream_worker = (m_next_stream_worker + 1) % m_stream_pool->workers.size();
+	}
+
+	void ResourceManager::run_stream_request()
+	{
+		std::shared_ptr<StreamRequest> request = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_stream_mutex);
+
+			for (const auto& candidate : m_stream_requests)
+				if 
+				(
+					!candidate->started && 
+					(
+						!request || 
+						candidate->priority > request->priority || 
+						(candidate->priority == request->priority && candidate->order < request->order)
+					)
+				)
+					request = candidate;
+
+			// Cancelled requests leave a job with nothing to do
+			if (!request)
+				return;
+
+			request->started = true;
+		}
+
+		// Failures are handed to update_streaming, which discards the placeholder
+		const bool loaded = request->type == StreamType::Mesh ?
+			load_mesh(m_pack, m_mesh_directory, request->mesh) :
+			load_texture(m_pack, m_texture_directory, request->texture);
+
+		// Cancelled requests are no longer listed, so there's nothing to publish
+		std::lock_guard<std::mutex> lock(m_stream_mutex);
+		request->failed = !loaded;
+		if (!request->cancelled)
+			request->finished = true;
+	}
+
+	size_t ResourceManager::find_stream_request(StreamType type, resource_id id) const
+	{
+		for (size_t i = 0; i < m_stream_requests.size(); ++i)
+			if (m_stream_requests[i]->type == type && m_stream_requests[i]->id == id)
+				return i;
+
+		return m_stream_requests.size();
+	}
+
+	void ResourceManager::discard_mesh_placeholder(resource_id id)
+	{
+		// The placeholder is kept so handles to it never point at a mesh made later
+		for (auto mesh_id : m_mesh_map)
+			if (mesh_id.second == id)
+			{
+				m_mesh_map.erase(mesh_id.first);
+				break;
+			}
 	}
 
-	HMesh ResourceManager::create_mesh(const std::string& name, const std::vector<uint16_t>& indices, const std::vector<Vertex>& vertices)
+	void ResourceManager::discard_texture_placeholder(resource_id id)
+	{
+		for (auto texture_id : m_texture_map)
+			if (texture_id.second == id)
+			{
+				m_texture_map.erase(texture_id.first);
+				break;
+			}
+
+		// Materials may have been given a slot for the placeholder. The placeholder itself
+		// is kept so handles to it never point at a texture made later.
+		get_forward_renderer().get_texture_table().remove_texture(id);
+	}
+
+	HMesh ResourceManager::create_mesh
+	(
+		const std::string& name,
+		const std::vector<uint32_t>& indices,
+		const std::vector<Vertex>& vertices,
+		VertexFormat vertex_format
+	)
 	{
 		dk_assert(m_mesh_map.find(name) == m_mesh_map.end());
 
@@ -300,97 +999,69 @@ namespace dk
 			m_mesh_allocator->resize(m_mesh_allocator->max_allocated() + 16);
 
 		auto mesh = HMesh(m_mesh_allocator->allocate(), m_mesh_allocator.get());
-		::new(m_mesh_allocator->get_resource_by_handle(mesh.id))(Mesh)(&m_renderer->get_graphics(), indices, vertices);
+		::new(m_mesh_allocator->get_resource_by_handle(mesh.id))(Mesh)(&m_renderer->get_graphics(), indices, vertices, vertex_format);
 		
 		m_mesh_map[name] = mesh.id;
 
 		return mesh;
 	}
 
-	HMesh ResourceManager::create_mesh(const std::string& name, const std::string& path)
+	HMesh ResourceManager::create_mesh(const std::string& name, const MeshView& data)
 	{
 		dk_assert(m_mesh_map.find(name) == m_mesh_map.end());
 
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string err;
-	
-		// Load OBJ
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str()))
-			dk_err(err);
-	
-		std::vector<uint16_t> indices = {};
-	
-		std::vector<glm::vec3> vertices = {};
-		std::vector<glm::vec2> uvs = {};
-		std::vector<glm::vec3> normals = {};
-	
-		std::vector<Vertex> unique_vertices = {};
-	
-		for (const auto& shape : shapes)
-			for (const auto& index : shape.mesh.indices)
-			{
-				Vertex vertex = {};
-	
-				// Get position
-				vertex.position =
-				{
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-	
-				// Get UV
-				if (attrib.texcoords.size() > 0)
-					vertex.uv =
-				{
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-				};
-	
-				// Get normal
-				if (attrib.normals.size() > 0)
-					vertex.normal =
-				{
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-	
-				// Check if duplicate vertex
-				bool isUnique = true;
-	
-				for (size_t i = 0; i < unique_vertices.size(); ++i)
-					if (unique_vertices[i] == vertex)
-					{
-						indices.push_back(static_cast<uint16_t>(i));
-						isUnique = false;
-						break;
-					}
-	
-				if (isUnique)
-				{
-					indices.push_back(static_cast<uint16_t>(vertices.size()));
-					vertices.push_back(vertex.position);
-					uvs.push_back(vertex.uv);
-					normals.push_back(vertex.normal);
-					unique_vertices.push_back(vertex);
-				}
-			}
-
 		if (m_mesh_allocator->num_allocated() + 1 > m_mesh_allocator->max_allocated())
 			m_mesh_allocator->resize(m_mesh_allocator->max_allocated() + 16);
 
 		auto mesh = HMesh(m_mesh_allocator->allocate(), m_mesh_allocator.get());
-		::new(m_mesh_allocator->get_resource_by_handle(mesh.id))(Mesh)(&m_renderer->get_graphics(), indices, unique_vertices);
-
+		::new(m_mesh_allocator->get_resource_by_handle(mesh.id))(Mesh)(&m_renderer->get_graphics(), data);
+		
 		m_mesh_map[name] = mesh.id;
 
 		return mesh;
 	}
 
-	HMaterialShader ResourceManager::create_shader(const std::string& name, const std::vector<char>& vert_byte_code, const std::vector<char>& frag_byte_code, bool depth)
+	HMesh ResourceManager::create_mesh(const std::string& name, const std::string& path, bool optimize, VertexFormat vertex_format)
+	{
+		dk_assert(m_mesh_map.find(name) == m_mesh_map.end());
+
+		std::vector<uint32_t> indices = {};
+		std::vector<Vertex> vertices = {};
+		import_obj(path, optimize, indices, vertices);
+
+		HMesh mesh = create_mesh(name, indices, vertices, vertex_format);
+
+		// Measured after the mesh calculates tangents so every packed attribute is covered
+		if (vertex_format == VertexFormat::Packed)
+			log_packing_error(path, mesh->get_vertices(), mesh->get_aabb());
+
+		return mesh;
+	}
+
+	HMesh ResourceManager::create_simplified_mesh(const std::string& name, HMesh mesh, float ratio, float max_error)
+	{
+		dk_assert(ratio > 0.0f && ratio <= 1.0f);
+		dk_assert(mesh->has_cpu_data());
+
+		// Copied since creating a mesh can move the source
+		const std::vector<uint32_t> source_indices = mesh->get_indices();
+		const std::vector<Vertex> source_vertices = mesh->get_vertices();
+
+		std::vector<uint32_t> indices = {};
+		std::vector<Vertex> vertices = {};
+		build_simplified_mesh(source_indices, source_vertices, ratio, max_error, indices, vertices);
+
+		return create_mesh(name, indices, vertices, mesh->get_vertex_format());
+	}
+
+	HMaterialShader ResourceManager::create_shader
+	(
+		const std::string& name,
+		const std::vector<char>& vert_byte_code,
+		const std::vector<char>& frag_byte_code,
+		bool depth,
+		VertexFormat vertex_format
+	)
 	{
 		dk_assert(m_shader_map.find(name) == m_shader_map.end());
 
@@ -401,15 +1072,15 @@ namespace dk
 		create_info[0].depth_test = depth;
 		create_info[0].depth_write = depth;
 		create_info[0].depth_compare = vk::CompareOp::eLess;
-		create_info[0].descriptor_set_layouts = { m_renderer->get_descriptor_set_layout() };
-		create_info[0].render_pass = m_renderer->get_depth_prepass();
+		create_info[0].descriptor_set_layouts = { get_forward_renderer().get_descriptor_set_layout(), get_forward_renderer().get_texture_table().get_descriptor_set_layout() };
+		create_info[0].render_pass = get_forward_renderer().get_depth_prepass();
 		create_info[0].stage_flags = vk::ShaderStageFlagBits::eVertex;
 
 		create_info[1].depth_test = depth;
 		create_info[1].depth_write = false;
 		create_info[1].depth_compare = vk::CompareOp::eEqual;
-		create_info[1].descriptor_set_layouts = { m_renderer->get_descriptor_set_layout() };
-		create_info[1].render_pass = m_renderer->get_shader_render_pass();
+		create_info[1].descriptor_set_layouts = { get_forward_renderer().get_descriptor_set_layout(), get_forward_renderer().get_texture_table().get_descriptor_set_layout() };
+		create_info[1].render_pass = get_forward_renderer().get_shader_render_pass();
 		create_info[1].stage_flags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
 
 		auto shader = HMaterialShader(m_shader_allocator->allocate(), m_shader_allocator.get());
@@ -418,7 +1089,8 @@ namespace dk
 			&m_renderer->get_graphics(),
 			create_info,
 			vert_byte_code,
-			frag_byte_code
+			frag_byte_code,
+			vertex_format
 		);
 
 		m_shader_map[name] = shader.id;
@@ -434,7 +1106,13 @@ namespace dk
 			m_material_allocator->resize(m_material_allocator->max_allocated() + 16);
 
 		auto material = HMaterial(m_material_allocator->allocate(), m_material_allocator.get());
-		::new(m_material_allocator->get_resource_by_handle(material.id))(Material)(&m_renderer->get_graphics(), shader);
+		::new(m_material_allocator->get_resource_by_handle(material.id))(Material)
+		(
+			&m_renderer->get_graphics(),
+			shader,
+			get_forward_renderer().get_uniform_ring(),
+			get_forward_renderer().get_texture_table()
+		);
 
 		m_material_map[name] = material.id;
 
@@ -442,6 +1120,11 @@ namespace dk
 	}
 
 	HTexture ResourceManager::create_texture(const std::string& name, const std::string& path, vk::Filter filtering, uint32_t mip_map_level)
+	{
+		return create_texture(name, read_image(m_pack, { path }), filtering, mip_map_level);
+	}
+
+	HTexture ResourceManager::create_texture(const std::string& name, const ImageData& image, vk::Filter filtering, uint32_t mip_map_level)
 	{
 		dk_assert(m_texture_map.find(name) == m_texture_map.end());
 
@@ -449,9 +1132,10 @@ namespace dk
 			m_texture_allocator->resize(m_texture_allocator->max_allocated() + 16);
 
 		auto texture = HTexture(m_texture_allocator->allocate(), m_texture_allocator.get());
-		::new(m_texture_allocator->get_resource_by_handle(texture.id))(Texture)(&m_renderer->get_graphics(), path, filtering, mip_map_level);
+		::new(m_texture_allocator->get_resource_by_handle(texture.id))(Texture)(&m_renderer->get_graphics(), image, filtering, mip_map_level);
 
 		m_texture_map[name] = texture.id;
+		get_forward_renderer().get_texture_table().set_texture(texture);
 
 		return texture;
 	}
@@ -462,7 +1146,7 @@ namespace dk
 		vk::Image image,
 		vk::ImageView image_view,
 		vk::Sampler sampler,
-		vk::DeviceMemory memory,
+		VkMemAllocation memory,
 		vk::Filter filter,
 		uint32_t width,
 		uint32_t height,
@@ -488,6 +1172,7 @@ namespace dk
 		);
 
 		m_texture_map[name] = texture.id;
+		get_forward_renderer().get_texture_table().set_texture(texture);
 
 		return texture;
 	}
@@ -518,6 +1203,11 @@ namespace dk
 		const std::string& west,
 		vk::Filter filter
 	)
+	{
+		return create_cube_map(name, read_image(m_pack, { west, east, top, bottom, north, south }), filter);
+	}
+
+	HCubeMap ResourceManager::create_cube_map(const std::string& name, const ImageData& image, vk::Filter filter)
 	{
 		dk_assert(m_cube_map_map.find(name) == m_cube_map_map.end());
 
@@ -525,16 +1215,10 @@ namespace dk
 			m_cube_map_allocator->resize(m_cube_map_allocator->max_allocated() + 2);
 
 		auto cube_map = HCubeMap(m_cube_map_allocator->allocate(), m_cube_map_allocator.get());
-		::new(m_cube_map_allocator->get_resource_by_handle(cube_map.id))(CubeMap)
-		(
-			&m_renderer->get_graphics(),
-			top, bottom,
-			north, east,
-			south, west,
-			filter
-		);
+		::new(m_cube_map_allocator->get_resource_by_handle(cube_map.id))(CubeMap)(&m_renderer->get_graphics(), image, filter);
 
 		m_cube_map_map[name] = cube_map.id;
+		get_forward_renderer().get_texture_table().set_cube_map(cube_map);
 
 		return cube_map;
 	}
@@ -543,6 +1227,13 @@ namespace dk
 	{
 		dk_assert(m_mesh_allocator->is_allocated(mesh.id));
 
+		// Stop streaming. The placeholder is freed like any other mesh.
+		cancel(mesh);
+
+		// Detail levels belong to the mesh
+		for (size_t i = 1; i < mesh->get_lod_count(); ++i)
+			destroy(mesh->get_lod(i));
+
 		for(auto mesh_id : m_mesh_map)
 			if (mesh_id.second == mesh.id)
 			{
@@ -550,8 +1241,12 @@ namespace dk
 				break;
 			}
 
-		mesh->free();
-		m_mesh_allocator->deallocate(mesh.id);
+		// Frames in flight may still draw the mesh. The slot is kept until then so it isn't reused.
+		m_renderer->defer_deletion([this, id = mesh.id]()
+		{
+			m_mesh_allocator->get_resource_by_handle(id)->free();
+			m_mesh_allocator->deallocate(id);
+		});
 	}
 
 	void ResourceManager::destroy(HMaterialShader shader)
@@ -565,8 +1260,12 @@ namespace dk
 				break;
 			}
 
-		shader->free();
-		m_shader_allocator->deallocate(shader.id);
+		// Frames in flight may still bind the shader
+		m_renderer->defer_deletion([this, id = shader.id]()
+		{
+			m_shader_allocator->get_resource_by_handle(id)->free();
+			m_shader_allocator->deallocate(id);
+		});
 	}
 
 	void ResourceManager::destroy(HMaterial material)
@@ -580,14 +1279,21 @@ namespace dk
 				break;
 			}
 
-		material->free();
-		m_material_allocator->deallocate(material.id);
+		// Frames in flight may still bind the material
+		m_renderer->defer_deletion([this, id = material.id]()
+		{
+			m_material_allocator->get_resource_by_handle(id)->free();
+			m_material_allocator->deallocate(id);
+		});
 	}
 
 	void ResourceManager::destroy(HTexture texture)
 	{
 		dk_assert(m_texture_allocator->is_allocated(texture.id));
 
+		// Stop streaming. The placeholder is freed like any other texture.
+		cancel(texture);
+
 		for (auto texture_id : m_texture_map)
 			if (texture_id.second == texture.id)
 			{
@@ -595,8 +1301,13 @@ namespace dk
 				break;
 			}
 
-		texture->free();
-		m_texture_allocator->deallocate(texture.id);
+		// Frames in flight may still sample the texture. Later frames' copies of the table won't.
+		get_forward_renderer().get_texture_table().remove_texture(texture.id);
+		m_renderer->defer_deletion([this, id = texture.id]()
+		{
+			m_texture_allocator->get_resource_by_handle(id)->free();
+			m_texture_allocator->deallocate(id);
+		});
 	}
 
 	void ResourceManager::destroy(HSkyBox sky_box)
@@ -625,7 +1336,12 @@ namespace dk
 				break;
 			}
 
-		cube_map->free();
-		m_cube_map_allocator->deallocate(cube_map.id);
+		// Frames in flight may still sample the cube map. Later frames' copies of the table won't.
+		get_forward_renderer().get_texture_table().remove_cube_map(cube_map.id);
+		m_renderer->defer_deletion([this, id = cube_map.id]()
+		{
+			m_cube_map_allocator->get_resource_by_handle(id)->free();
+			m_cube_map_allocator->deallocate(id);
+		});
 	}
 }
\ No newline at end of file
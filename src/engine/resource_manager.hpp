@@ -8,7 +8,11 @@
 
 /** Includes. */
 #include <unordered_map>
+#include <memory>
+#include <mutex>
 #include <utilities\resource_allocator.hpp>
+#include <utilities\asset_pack.hpp>
+#include <utilities\threading.hpp>
 #include <graphics\forward_renderer.hpp>
 #include <graphics\material.hpp>
 #include <graphics\material_shader.hpp>
@@ -24,6 +28,9 @@ namespace dk
 	class ResourceManager
 	{
 	public:
+
+		/** Bytes of streamed resources update_streaming() swaps in by default. */
+		static const size_t default_stream_budget = 16 * 1024 * 1024;
 		
 		/**
 		 * @brief Default constructor.
@@ -32,15 +39,27 @@ namespace dk
 
 		/**
 		 * @brief Constructor.
-		 * @param Renderer.
+		 * @param Renderer. Must be a forward renderer unless its graphics context is headless.
+		 * @note With a headless graphics context only meshes are loaded, and nothing is uploaded.
 		 */
-		ResourceManager(ForwardRendererBase* renderer);
+		ResourceManager(Renderer* renderer);
 
 		/**
 		 * @brief Shutdown the resource manager.
 		 */
 		void shutdown();
 
+		/**
+		 * @brief Open an asset pack to load resources from.
+		 * @param Path to the pack.
+		 * @return If the pack could be opened.
+		 * @note Files are looked up in the pack by the same path they'd be read from on disk,
+		 *       and read from disk if the pack doesn't have them. Meshes in a pack are already
+		 *       cooked and are never cooked again.
+		 * @note Must be called before load_resources() and before any resource is streamed.
+		 */
+		bool open_pack(const std::string& path);
+
 		/**
 		 * @brief Load resource files.
 		 * @param Path to folder containing meshes.
@@ -49,6 +68,11 @@ namespace dk
 		 * @param Path to folder containing materials.
 		 * @param Path to folder containing cube maps.
 		 * @param Path to folder containing sky boxes.
+		 * @note Meshes are cooked into .dkmesh files next to their mesh files the first time
+		 *       they're loaded and whenever their sources change. See cook_meshes().
+		 * @note Files are read, decoded, and reflected on by a thread pool. Resources are
+		 *       created on the calling thread in the same order as they'd be loaded one by
+		 *       one, as soon as each is decoded, so handles don't depend on thread timing.
 		 */
 		void load_resources
 		(
@@ -60,6 +84,60 @@ namespace dk
 			const std::string& sky_boxes
 		);
 
+		/**
+		 * @brief Request a mesh to be streamed in the background.
+		 * @param Path to the mesh file relative to the mesh directory given to load_resources().
+		 * @param Priority. Higher priorities are loaded first.
+		 * @return Mesh handle. Bound to a placeholder that isn't resident until the mesh is swapped in.
+		 * @note Requesting a mesh that's already loaded or requested returns the same handle,
+		 *       raising the priority of the request if it hasn't started loading yet.
+		 * @note Mesh files that can't be read, or whose OBJ files are missing, fail to stream. The
+		 *       handle stays bound to a placeholder that never becomes resident until it's destroyed.
+		 * @note Must be called from the main thread.
+		 */
+		HMesh request_mesh(const std::string& path, int32_t priority = 0);
+
+		/**
+		 * @brief Request a texture to be streamed in the background.
+		 * @param Path to the texture file relative to the texture directory given to load_resources().
+		 * @param Priority. Higher priorities are loaded first.
+		 * @return Texture handle. Bound to a placeholder that isn't resident until the texture is swapped in.
+		 * @note Requesting a texture that's already loaded or requested returns the same handle,
+		 *       raising the priority of the request if it hasn't started loading yet.
+		 * @note Until it's resident, the texture table samples another texture in its slot.
+		 * @note A null handle is returned with a headless graphics context.
+		 * @note Files that can't be read or don't hold a single image, like cube maps, fail to stream.
+		 *       The handle stays bound to a placeholder that never becomes resident until it's destroyed.
+		 * @note Must be called from the main thread.
+		 */
+		HTexture request_texture(const std::string& path, int32_t priority = 0);
+
+		/**
+		 * @brief Cancel a mesh request.
+		 * @param Mesh handle.
+		 * @return If the mesh was still streaming.
+		 * @note A cancelled mesh's placeholder never becomes resident, and keeps its slot until
+		 *       it's destroyed. Requesting the same path again makes a new request.
+		 */
+		bool cancel(HMesh mesh);
+
+		/**
+		 * @brief Cancel a texture request.
+		 * @param Texture handle.
+		 * @return If the texture was still streaming.
+		 * @note A cancelled texture's placeholder never becomes resident, and keeps its slot until
+		 *       it's destroyed. Requesting the same path again makes a new request.
+		 */
+		bool cancel(HTexture texture);
+
+		/**
+		 * @brief Swap streamed resources that finished loading into their placeholders.
+		 * @param Bytes of resources to swap in. At least one resource is swapped in if any are ready.
+		 * @note Call at a frame boundary while nothing is being rendered. Resources are swapped
+		 *       in highest priority first, and the rest wait for the next call.
+		 */
+		void update_streaming(size_t budget = default_stream_budget);
+
 		/**
 		 * @brief Get mesh allocator.
 		 * @return Mesh allocator.
@@ -281,17 +359,50 @@ namespace dk
 		 * @param Name.
 		 * @param Indices.
 		 * @param Vertices.
+		 * @param Layout of the vertex buffer.
 		 * @return Mesh handle.
 		 */
-		HMesh create_mesh(const std::string& name, const std::vector<uint16_t>& indices, const std::vector<Vertex>& vertices);
+		HMesh create_mesh
+		(
+			const std::string& name,
+			const std::vector<uint32_t>& indices,
+			const std::vector<Vertex>& vertices,
+			VertexFormat vertex_format = VertexFormat::Standard
+		);
+
+		/**
+		 * @brief Create a mesh from prepared data.
+		 * @param Name.
+		 * @param Mesh data, like a level of a cooked mesh. Uploaded as it is.
+		 * @return Mesh handle.
+		 * @note Only the bounds and sub meshes are kept on the CPU.
+		 */
+		HMesh create_mesh(const std::string& name, const MeshView& data);
 
 		/**
 		 * @brief Create a mesh.
 		 * @param Name.
 		 * @param Path to the OBJ file.
+		 * @param Reorder triangles and vertices for the GPU?
+		 * @param Layout of the vertex buffer.
 		 * @return Mesh handle.
+		 * @note Optimizing reorders triangles for the vertex cache and overdraw, then
+		 *       vertices for fetching. Vertex cache statistics are logged before and after.
+		 * @note The size and largest error of packed vertices are logged.
 		 */
-		HMesh create_mesh(const std::string& name, const std::string& path);
+		HMesh create_mesh(const std::string& name, const std::string& path, bool optimize = true, VertexFormat vertex_format = VertexFormat::Standard);
+
+		/**
+		 * @brief Create a less detailed copy of a mesh.
+		 * @param Name.
+		 * @param Mesh to simplify.
+		 * @param Fraction of the triangles to keep.
+		 * @param Largest distance the surface may move as a fraction of the meshes size.
+		 * @return Mesh handle.
+		 * @note Only vertices the simplified triangles use are copied. The vertex format is kept.
+		 * @note The mesh must have CPU data, so it can't come from a cooked mesh.
+		 */
+		HMesh create_simplified_mesh(const std::string& name, HMesh mesh, float ratio, float max_error);
 
 		/**
 		 * @brief Create a shader.
@@ -299,9 +410,17 @@ namespace dk
 		 * @param Vertex shader byte code.
 		 * @param Fragment shader byte code.
 		 * @param Should the shader perform depth testing?
+		 * @param Layout of the vertices the vertex shader reads.
 		 * @return Shader handle.
 		 */
-		HMaterialShader create_shader(const std::string& name, const std::vector<char>& vert_byte_code, const std::vector<char>& frag_byte_code, bool depth = true);
+		HMaterialShader create_shader
+		(
+			const std::string& name,
+			const std::vector<char>& vert_byte_code,
+			const std::vector<char>& frag_byte_code,
+			bool depth = true,
+			VertexFormat vertex_format = VertexFormat::Standard
+		);
 
 		/**
 		 * @brief Create a material.
@@ -321,6 +440,16 @@ namespace dk
 		 */
 		HTexture create_texture(const std::string& name, const std::string& path, vk::Filter filtering, uint32_t mip_map_level = 1);
 
+		/**
+		 * @brief Create a texture.
+		 * @param Name.
+		 * @param Decoded image. Must have one layer.
+		 * @param Filtering mode.
+		 * @param Mip map level.
+		 * @return Texture handle.
+		 */
+		HTexture create_texture(const std::string& name, const ImageData& image, vk::Filter filtering, uint32_t mip_map_level = 1);
+
 		/**
 		 * @brief Create a texture
 		 * @param Name.
@@ -339,7 +468,7 @@ namespace dk
 			vk::Image image,
 			vk::ImageView image_view,
 			vk::Sampler sampler,
-			vk::DeviceMemory memory,
+			VkMemAllocation memory,
 			vk::Filter filter,
 			uint32_t width,
 			uint32_t height,
@@ -375,27 +504,41 @@ namespace dk
 			vk::Filter filter
 		);
 
+		/**
+		 * Create a cube map.
+		 * @param Name.
+		 * @param Decoded image. Must have six layers, ordered west, east, top, bottom, north, south.
+		 * @param Texture filtering.
+		 */
+		HCubeMap create_cube_map(const std::string& name, const ImageData& image, vk::Filter filter);
+
 		/**
 		 * @brief Destroy a mesh.
 		 * @param Mesh handle.
+		 * @note Meshes that are still streaming are cancelled.
+		 * @note GPU resources are freed once the frames in flight are done with them.
 		 */
 		void destroy(HMesh mesh);
 
 		/**
 		 * @brief Destroy a shader.
 		 * @param Shader handle.
+		 * @note GPU resources are freed once the frames in flight are done with them.
 		 */
 		void destroy(HMaterialShader shader);
 
 		/**
 		 * @brief Destroy a material.
 		 * @param Material handle.
+		 * @note GPU resources are freed once the frames in flight are done with them.
 		 */
 		void destroy(HMaterial material);
 
 		/**
 		 * @brief Destroy a texture.
 		 * @param Texture handle.
+		 * @note Textures that are still streaming are cancelled.
+		 * @note GPU resources are freed once the frames in flight are done with them.
 		 */
 		void destroy(HTexture texture);
 
@@ -408,13 +551,78 @@ namespace dk
 		/**
 		 * Destroy a cube map.
 		 * @param Cube map handle.
+		 * @note GPU resources are freed once the frames in flight are done with them.
 		 */
 		void destroy(HCubeMap cube_map);
 
 	private:
+
+		/**
+		 * @brief Types of streamed resources.
+		 */
+		enum class StreamType
+		{
+			Mesh = 0,
+			Texture = 1
+		};
+
+		/** A resource being streamed. Defined in the source. */
+		struct StreamRequest;
+
+		/**
+		 * @brief Add a streaming request and give its job to a streaming thread.
+		 * @param Request.
+		 */
+		void add_stream_request(std::shared_ptr<StreamRequest> request);
+
+		/**
+		 * @brief Load the highest priority request that hasn't started loading.
+		 * @note Run by the streaming threads.
+		 */
+		void run_stream_request();
+
+		/**
+		 * @brief Find the request for a resource.
+		 * @param Resource type.
+		 * @param Resource ID.
+		 * @return Index of the request. The number of requests if the resource isn't streaming.
+		 * @note Must be called with the streaming lock held.
+		 */
+		size_t find_stream_request(StreamType type, resource_id id) const;
+
+		/**
+		 * @brief Forget a mesh placeholder that will never be swapped in.
+		 * @param Placeholder ID.
+		 * @note Frees its name. The placeholder keeps its slot until it's destroyed.
+		 */
+		void discard_mesh_placeholder(resource_id id);
+
+		/**
+		 * @brief Forget a texture placeholder that will never be swapped in.
+		 * @param Placeholder ID.
+		 * @note Frees its name and its texture table slot. The placeholder keeps its slot until it's destroyed.
+		 */
+		void discard_texture_placeholder(resource_id id);
+
+		/**
+		 * @brief Get the renderer as the forward renderer GPU resources are made for.
+		 * @return Forward renderer.
+		 * @note Must not be called with a headless graphics context.
+		 */
+		ForwardRendererBase& get_forward_renderer() const
+		{
+			dk_assert(!m_renderer->get_graphics().is_headless());
+			return *static_cast<ForwardRendererBase*>(m_renderer);
+		}
 		
 		/** Rendering engine. */
-		ForwardRendererBase* m_renderer;
+		Renderer* m_renderer;
+
+		/** Directory meshes are loaded from. */
+		std::string m_mesh_directory = "";
+
+		/** Directory textures are loaded from. */
+		std::string m_texture_directory = "";
 
 		/** Mesh allocator. */
 		std::unique_ptr<ResourceAllocator<Mesh>> m_mesh_allocator;
@@ -451,5 +659,23 @@ namespace dk
 
 		/** Cube map map. */
 		std::unordered_map<std::string, resource_id> m_cube_map_map;
+
+		/** Asset pack resources are loaded from. Closed if resources are loaded from disk. */
+		AssetPack m_pack = {};
+
+		/** Resources being streamed, including finished ones that haven't been swapped in. */
+		std::vector<std::shared_ptr<StreamRequest>> m_stream_requests = {};
+
+		/** Order the next request was made in. Breaks ties between priorities. */
+		uint64_t m_next_stream_order = 0;
+
+		/** Worker the next requests job is given to. */
+		size_t m_next_stream_worker = 0;
+
+		/** Lock for streaming requests. */
+		std::mutex m_stream_mutex;
+
+		/** Threads streaming resources. Created by the first request. Destroyed first, since jobs use everything above. */
+		std::unique_ptr<ThreadPool> m_stream_pool = nullptr;
 	};
 }
\ No newline at end of file
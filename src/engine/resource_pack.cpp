@@ -0,0 +1,160 @@
+/**
+ * @file resource_pack.cpp
+ * @brief Resource pack building source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <json.hpp>
+#include <fstream>
+#include <unordered_set>
+#include <utilities\debugging.hpp>
+#include <utilities\asset_pack.hpp>
+#include "mesh_cooker.hpp"
+#include "resource_pack.hpp"
+
+/** For convenience */
+using json = nlohmann::json;
+
+namespace dk
+{
+	/**
+	 * @brief Files being packed.
+	 */
+	struct PackFiles
+	{
+		/** Pack being built. */
+		AssetPackWriter writer = {};
+
+		/** Normalized paths already added. */
+		std::unordered_set<std::string> paths = {};
+
+		/** Compress files that get smaller? */
+		bool compress = false;
+
+		/** Number of files that couldn't be read or cooked. */
+		size_t failed = 0;
+
+		/**
+		 * @brief Add a file from disk.
+		 * @param Path to the file.
+		 * @note Files shared between resources are only added once.
+		 */
+		void add(const std::string& path)
+		{
+			if (!paths.insert(normalize_pack_path(path)).second)
+				return;
+
+			if (!writer.add_file(path, compress))
+			{
+				dk_log("Failed to read " << path);
+				++failed;
+			}
+		}
+	};
+
+	/**
+	 * @brief Read a JSON file.
+	 * @param Path to the file.
+	 * @param JSON to fill.
+	 * @return If the file could be read.
+	 */
+	static bool read_json(const std::string& path, json& j)
+	{
+		std::ifstream stream(path);
+		if (!stream.is_open())
+			return false;
+
+		stream >> j;
+		return true;
+	}
+
+	/**
+	 * @brief Add a resource directories resources.json and every resource file it lists.
+	 * @param Files being packed.
+	 * @param Resource directory.
+	 * @return Every resource file that could be read.
+	 */
+	static std::vector<json> add_directory(PackFiles& files, const std::string& directory)
+	{
+		std::vector<json> resources = {};
+
+		files.add(directory + "resources.json");
+
+		json j;
+		if (!read_json(directory + "resources.json", j))
+			return resources;
+
+		for (const std::string& path : j["files"])
+		{
+			files.add(directory + path);
+
+			json resource;
+			if (read_json(directory + path, resource))
+				resources.push_back(std::move(resource));
+		}
+
+		return resources;
+	}
+
+	size_t write_resource_pack
+	(
+		const std::string& meshes,
+		const std::string& textures,
+		const std::string& shaders,
+		const std::string& materials,
+		const std::string& cube_maps,
+		const std::string& sky_boxes,
+		const std::string& path,
+		bool compress
+	)
+	{
+		PackFiles files = {};
+		files.compress = compress;
+
+		// Meshes are packed cooked, so their mesh files and sources aren't needed
+		files.add(meshes + "resources.json");
+
+		json mesh_j;
+		if (read_json(meshes + "resources.json", mesh_j))
+			for (const std::string& mesh : mesh_j["files"])
+			{
+				if (cook_mesh(meshes, mesh))
+					files.add(get_cooked_mesh_path(meshes, mesh));
+				else
+				{
+					dk_log("Failed to cook " << mesh);
+					++files.failed;
+				}
+			}
+
+		for (const json& texture : add_directory(files, textures))
+			files.add(textures + texture["path"].get<std::string>());
+
+		for (const json& shader : add_directory(files, shaders))
+		{
+			files.add(shaders + shader["vertex"].get<std::string>());
+			files.add(shaders + shader["fragment"].get<std::string>());
+		}
+
+		add_directory(files, materials);
+
+		for (const json& cube_map : add_directory(files, cube_maps))
+			for (const char* face : { "top", "bottom", "north", "east", "south", "west" })
+				files.add(cube_maps + cube_map[face].get<std::string>());
+
+		add_directory(files, sky_boxes);
+
+		if (files.failed > 0)
+			return files.failed;
+
+		if (!files.writer.write(path))
+		{
+			dk_log("Failed to write " << path);
+			return 1;
+		}
+
+		dk_log("Packed " << files.writer.get_file_count() << " files into " << path);
+		return 0;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+/**
+ * @file resource_pack.hpp
+ * @brief Resource pack building header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+
+namespace dk
+{
+	/**
+	 * @brief Build an asset pack holding every resource the resource directories list.
+	 * @param Path to folder containing meshes.
+	 * @param Path to folder containing textures.
+	 * @param Path to folder containing shaders.
+	 * @param Path to folder containing materials.
+	 * @param Path to folder containing cube maps.
+	 * @param Path to folder containing sky boxes.
+	 * @param Path to the pack.
+	 * @param Compress files that get smaller?
+	 * @return Number of files that couldn't be read or cooked, in which case nothing is written.
+	 *         One if the pack couldn't be written.
+	 * @note Meshes are cooked first and only their cooked files are packed. Files keep the
+	 *       paths they'd be read from on disk, so ResourceManager::open_pack() finds them
+	 *       with the same directories given to ResourceManager::load_resources().
+	 */
+	extern size_t write_resource_pack
+	(
+		const std::string& meshes,
+		const std::string& textures,
+		const std::string& shaders,
+		const std::string& materials,
+		const std::string& cube_maps,
+		const std::string& sky_boxes,
+		const std::string& path,
+		bool compress = false
+	);
+}
@@ -44,7 +44,10 @@ namespace dk
 			queue_create_infos.push_back(queue_create_info);
 		}
 
+		// Materials index into the texture table from their shaders
 		vk::PhysicalDeviceFeatures device_features = {};
+		dk_assert(m_vk_physical_device.getFeatures().shaderSampledImageArrayDynamicIndexing);
+		device_features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
 
 		// Create logical device
 		vk::DeviceCreateInfo create_info = {};
@@ -6,12 +6,31 @@
 
 /** Includes. */
 #include <array>
+#include <algorithm>
+#include <cstring>
 #include <utilities\file_io.hpp>
 #include <glm\gtc\matrix_transform.hpp>
 #include "forward_renderer.hpp"
 
 namespace dk
 {
+	/** Minimum number of bounding boxes a worker thread tests during visibility culling. */
+	static const size_t MIN_VISIBILITY_JOB_SIZE = 1024;
+
+	/** Width of the occlusion culling depth buffer. The height follows the aspect ratio. */
+	static const uint32_t OCCLUSION_BUFFER_WIDTH = 256;
+
+	/** Minimum number of objects tested against the occlusion buffer on one thread. */
+	static const size_t MIN_OCCLUSION_JOB_SIZE = 256;
+
+	/** Size in bytes of each frame's region of the uniform ring buffer. */
+	static const size_t UNIFORM_RING_FRAME_SIZE = 1024 * 1024;
+
+	/** Default number of frames the CPU can record ahead of the GPU. */
+	static const size_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+
+
 	ForwardRendererBase::ForwardRendererBase()
 	{
 
@@ -23,7 +42,8 @@ namespace dk
 		int width,
 		int height,
 		ResourceAllocator<Texture>* texture_allocator,
-		ResourceAllocator<Mesh>* mesh_allocator
+		ResourceAllocator<Mesh>* mesh_allocator,
+		size_t frames_in_flight
 	) :
 		Renderer(graphics, width, height),
 		m_texture_allocator(texture_allocator),
@@ -36,30 +56,44 @@ namespace dk
 		m_vk_command_pool = get_graphics().get_logical_device().createCommandPool(pool_info);
 		dk_assert(m_vk_command_pool);
 
-		// Create command buffer
+		// Every frame in flight gets its own resources
+		m_frames.resize(frames_in_flight > 0 ? frames_in_flight : DEFAULT_FRAMES_IN_FLIGHT);
+
 		vk::CommandBufferAllocateInfo alloc_info = {};
 		alloc_info.commandPool = m_vk_command_pool;
 		alloc_info.level = vk::CommandBufferLevel::ePrimary;
-		alloc_info.commandBufferCount = 3;
-		auto command_buffers = get_graphics().get_logical_device().allocateCommandBuffers(alloc_info);
-
-		m_vk_primary_command_buffer = command_buffers[0];
-		m_vk_depth_prepass_command_buffer = command_buffers[1];
-		m_vk_rendering_command_buffer = command_buffers[2];
-
-		dk_assert(m_vk_primary_command_buffer);
-		dk_assert(m_vk_depth_prepass_command_buffer);
-		dk_assert(m_vk_rendering_command_buffer);
+		alloc_info.commandBufferCount = 2;
 
-		// Create semaphores
-		vk::SemaphoreCreateInfo semaphore_info = {};
-		m_semaphores.color_rendering_finished = get_graphics().get_logical_device().createSemaphore(semaphore_info);
-		m_semaphores.depth_prepass_finished = get_graphics().get_logical_device().createSemaphore(semaphore_info);
-		dk_assert(m_semaphores.color_rendering_finished);
-		dk_assert(m_semaphores.depth_prepass_finished);
+		for (auto& frame : m_frames)
+		{
+			// Create command buffers
+			auto command_buffers = get_graphics().get_logical_device().allocateCommandBuffers(alloc_info);
+
+			frame.depth_prepass_command_buffer = command_buffers[0];
+			frame.rendering_command_buffer = command_buffers[1];
+
+			dk_assert(frame.depth_prepass_command_buffer);
+			dk_assert(frame.rendering_command_buffer);
+
+			// Create semaphores
+			vk::SemaphoreCreateInfo semaphore_info = {};
+			frame.color_rendering_finished = get_graphics().get_logical_device().createSemaphore(semaphore_info);
+			frame.depth_prepass_finished = get_graphics().get_logical_device().createSemaphore(semaphore_info);
+			dk_assert(frame.color_rendering_finished);
+			dk_assert(frame.depth_prepass_finished);
+
+			// Create fence. It starts signaled since the frame has never been submitted.
+			vk::FenceCreateInfo fence_info = {};
+			fence_info.flags = vk::FenceCreateFlagBits::eSignaled;
+			frame.fence = get_graphics().get_logical_device().createFence(fence_info);
+			dk_assert(frame.fence);
+		}
 
 		// Create lighting manager
-		m_lighting_manager = std::make_unique<LightingManager>(&get_graphics(), 128, 8);
+		m_lighting_manager = std::make_unique<LightingManager>(&get_graphics(), 128, 8, m_frames.size());
+
+		// Create texture table
+		m_texture_table = std::make_unique<TextureTable>(&get_graphics(), m_frames.size());
 
 		// Create depth prepass
 		{
@@ -87,10 +121,12 @@ namespace dk
 			vk::SubpassDependency dependency = {};
 			dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 			dependency.dstSubpass = 0;
-			dependency.srcStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
-			dependency.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-			dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-			dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+			// The depth image is shared by every frame in flight, so wait for the
+			// previous frame's color pass to stop testing against it
+			dependency.srcStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+			dependency.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+			dependency.dstStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+			dependency.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
 			dependency.dependencyFlags = vk::DependencyFlagBits::eByRegion;
 
 			vk::RenderPassCreateInfo render_pass_info = {};
@@ -109,7 +145,7 @@ namespace dk
 
 		// Create descriptor set
 		{
-			std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {};
+			std::array<vk::DescriptorSetLayoutBinding, 5> bindings = {};
 			bindings[0].binding = 0;
 			bindings[0].descriptorType = vk::DescriptorType::eStorageBuffer;
 			bindings[0].descriptorCount = 1;
@@ -125,6 +161,16 @@ namespace dk
 			bindings[2].descriptorCount = 1;
 			bindings[2].stageFlags = vk::ShaderStageFlagBits::eFragment;
 
+			bindings[3].binding = 3;
+			bindings[3].descriptorType = vk::DescriptorType::eStorageBuffer;
+			bindings[3].descriptorCount = 1;
+			bindings[3].stageFlags = vk::ShaderStageFlagBits::eVertex;
+
+			bindings[4].binding = 4;
+			bindings[4].descriptorType = vk::DescriptorType::eStorageBuffer;
+			bindings[4].descriptorCount = 1;
+			bindings[4].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
 			vk::DescriptorSetLayoutCreateInfo layout_info = {};
 			layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
 			layout_info.pBindings = bindings.data();
@@ -132,53 +178,80 @@ namespace dk
 			m_descriptor.layout = get_graphics().get_logical_device().createDescriptorSetLayout(layout_info);
 			dk_assert(m_descriptor.layout);
 
+			const uint32_t frame_count = static_cast<uint32_t>(m_frames.size());
+
 			std::array<vk::DescriptorPoolSize, 3> pool_sizes = {};
 			pool_sizes[0].type = vk::DescriptorType::eStorageBuffer;
-			pool_sizes[0].descriptorCount = 1;
+			pool_sizes[0].descriptorCount = frame_count;
 
 			pool_sizes[1].type = vk::DescriptorType::eStorageBuffer;
-			pool_sizes[1].descriptorCount = 1;
+			pool_sizes[1].descriptorCount = 3 * frame_count;
 
 			pool_sizes[2].type = vk::DescriptorType::eUniformBuffer;
-			pool_sizes[2].descriptorCount = 1;
+			pool_sizes[2].descriptorCount = frame_count;
 
 			// Create descriptor pool
 			vk::DescriptorPoolCreateInfo pool_info = {};
 			pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
 			pool_info.pPoolSizes = pool_sizes.data();
-			pool_info.maxSets = 1;
+			pool_info.maxSets = frame_count;
 
 			m_descriptor.pool = get_graphics().get_logical_device().createDescriptorPool(pool_info);
 			dk_assert(m_descriptor.pool);
 
-			// Allocate descriptor set
-			vk::DescriptorSetAllocateInfo alloc_info = {};
-			alloc_info.descriptorPool = m_descriptor.pool;
-			alloc_info.descriptorSetCount = 1;
-			alloc_info.pSetLayouts = &m_descriptor.layout;
-
-			m_descriptor.set = get_graphics().get_logical_device().allocateDescriptorSets(alloc_info)[0];
-			dk_assert(m_descriptor.set);
-
-			// Update descriptor set
-			vk::DescriptorBufferInfo buffer_info = {};
-			buffer_info.buffer = m_lighting_manager->get_lighting_data_ubo().buffer;
-			buffer_info.offset = 0;
-			buffer_info.range = static_cast<uint32_t>(m_lighting_manager->get_lighting_data_size());
-
-			vk::WriteDescriptorSet write = {};
-			write.dstSet = m_descriptor.set;
-			write.dstBinding = static_cast<uint32_t>(2);
-			write.dstArrayElement = 0;
-			write.descriptorType = vk::DescriptorType::eUniformBuffer;
-			write.descriptorCount = 1;
-			write.pBufferInfo = &buffer_info;
-
-			get_graphics().get_logical_device().updateDescriptorSets(1, &write, 0, nullptr);
+			for (size_t i = 0; i < m_frames.size(); ++i)
+			{
+				// Allocate descriptor set
+				vk::DescriptorSetAllocateInfo alloc_info = {};
+				alloc_info.descriptorPool = m_descriptor.pool;
+				alloc_info.descriptorSetCount = 1;
+				alloc_info.pSetLayouts = &m_descriptor.layout;
+
+				m_frames[i].descriptor_set = get_graphics().get_logical_device().allocateDescriptorSets(alloc_info)[0];
+				dk_assert(m_frames[i].descriptor_set);
+
+				// Update descriptor set
+				vk::DescriptorBufferInfo buffer_info = {};
+				buffer_info.buffer = m_lighting_manager->get_lighting_data_ubo(i).buffer;
+				buffer_info.offset = 0;
+				buffer_info.range = static_cast<uint32_t>(m_lighting_manager->get_lighting_data_size());
+
+				vk::WriteDescriptorSet write = {};
+				write.dstSet = m_frames[i].descriptor_set;
+				write.dstBinding = static_cast<uint32_t>(2);
+				write.dstArrayElement = 0;
+				write.descriptorType = vk::DescriptorType::eUniformBuffer;
+				write.descriptorCount = 1;
+				write.pBufferInfo = &buffer_info;
+
+				get_graphics().get_logical_device().updateDescriptorSets(1, &write, 0, nullptr);
+			}
 		}
 
+		// Create instance buffers
+		for (m_frame = 0; m_frame < m_frames.size(); ++m_frame)
+			reserve_instances(256);
+		m_frame = 0;
+
+		// Create uniform ring buffer. Per instance data for the next frame is written 
+		// before its fence is waited on, so one more region than there are frames in flight is needed.
+		m_uniform_ring = UniformRingBuffer(&get_graphics(), UNIFORM_RING_FRAME_SIZE, m_frames.size() + 1);
+
 		// Create thread pool
 		m_thread_pool = std::make_unique<ThreadPool>(get_graphics().get_command_manager().get_pool_count());
+
+		// Allocate secondary command buffers
+		for (auto& frame : m_frames)
+		{
+			for (size_t i = 0; i < get_graphics().get_command_manager().get_pool_count(); ++i)
+			{
+				frame.depth_prepass_batches.push_back(get_graphics().get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary));
+				frame.color_batches.push_back(get_graphics().get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary));
+			}
+
+			frame.sky_box_depth_prepass = get_graphics().get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary);
+			frame.sky_box_color = get_graphics().get_command_manager().allocate_command_buffer(vk::CommandBufferLevel::eSecondary);
+		}
 	}
 
 	void ForwardRendererBase::shutdown()
@@ -187,10 +260,57 @@ namespace dk
 		get_graphics().get_device_manager().get_graphics_queue().waitIdle();
 		get_graphics().get_logical_device().waitIdle();
 
+		// Free deferred deletions. Later ones are freed right away.
+		{
+			std::lock_guard<std::mutex> lock(m_deletion_mutex);
+			for (auto& frame : m_frames)
+			{
+				for (auto& deletion : frame.deletions)
+					deletion();
+				frame.deletions.clear();
+			}
+		}
+
 		// Destroy thread pool
 		m_thread_pool->wait();
 		m_thread_pool.reset();
 
+		for (auto& frame : m_frames)
+		{
+			// Free secondary command buffers
+			for (auto& command_buffer : frame.depth_prepass_batches)
+				command_buffer.free();
+
+			for (auto& command_buffer : frame.color_batches)
+				command_buffer.free();
+
+			frame.depth_prepass_batches.clear();
+			frame.color_batches.clear();
+			frame.sky_box_depth_prepass.free();
+			frame.sky_box_color.free();
+
+			// Destroy instance buffer
+			if (frame.instances.map)
+			{
+				frame.instances.buffer.free(get_graphics().get_logical_device());
+				frame.instances.map = nullptr;
+				frame.instances.capacity = 0;
+			}
+
+			// Destroy synchronization objects
+			get_graphics().get_logical_device().destroySemaphore(frame.color_rendering_finished);
+			get_graphics().get_logical_device().destroySemaphore(frame.depth_prepass_finished);
+			get_graphics().get_logical_device().destroyFence(frame.fence);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_deletion_mutex);
+			m_frames.clear();
+		}
+
+		// Destroy uniform ring buffer
+		m_uniform_ring.free();
+
 		// Destroy descriptor set and pool
 		get_graphics().get_logical_device().destroyDescriptorPool(m_descriptor.pool);
 		get_graphics().get_logical_device().destroyDescriptorSetLayout(m_descriptor.layout);
@@ -198,9 +318,8 @@ namespace dk
 		// Destroy lighting manager
 		m_lighting_manager.reset();
 
-		// Destroy semaphores
-		get_graphics().get_logical_device().destroySemaphore(m_semaphores.color_rendering_finished);
-		get_graphics().get_logical_device().destroySemaphore(m_semaphores.depth_prepass_finished);
+		// Free texture table
+		m_texture_table->free();
 
 		// Depth depth image
 		destroy_depth_data();
@@ -213,112 +332,399 @@ namespace dk
 		get_graphics().get_logical_device().destroyRenderPass(m_render_passes.depth_prepass);
 	}
 
-	void ForwardRendererBase::draw(const RenderableObject& obj) { m_renderable_objects.push_back(obj); }
+	void ForwardRendererBase::draw(const RenderableObject& obj) 
+	{ 
+		m_renderable_objects.push_back(obj);
+		m_object_bounds.push_back(obj.bounds);
+	}
+
+	void ForwardRendererBase::defer_deletion(std::function<void()> deletion)
+	{
+		std::unique_lock<std::mutex> lock(m_deletion_mutex);
+
+		// Nothing is in flight after shutdown
+		if (m_frames.empty())
+		{
+			lock.unlock();
+			deletion();
+			return;
+		}
+
+		// Frames are submitted in order, so once the last submitted frame is done every earlier one is too
+		const size_t last_frame = (m_frame + m_frames.size() - 1) % m_frames.size();
+		m_frames[last_frame].deletions.push_back(std::move(deletion));
+	}
 
 	void ForwardRendererBase::flush_queues()
 	{
 		m_lighting_manager->flush_queues();
 		m_renderable_objects.clear();
+		m_object_bounds.clear();
+		m_visible_objects.clear();
+		m_render_batches.clear();
+
+		// Per instance data for the next frame goes in the next region
+		m_uniform_ring.next_frame();
+
+		// Finish the frame's statistics
+		m_frame_statistics.cpu_time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - m_frame_start_time).count();
+		m_statistics_history.push(m_frame_statistics);
+
+		// Move on to the next frame's resources
+		m_frame = (m_frame + 1) % m_frames.size();
+	}
+
+	void ForwardRendererBase::begin_frame()
+	{
+		auto& frame = m_frames[m_frame];
+
+		// Start the frame's statistics
+		m_frame_start_time = std::chrono::high_resolution_clock::now();
+		const uint64_t frame_number = m_frame_statistics.frame + 1;
+		m_frame_statistics = {};
+		m_frame_statistics.frame = frame_number;
+		m_frame_statistics.submitted_objects = m_renderable_objects.size();
+		m_frame_statistics.worker_record_times.resize(m_thread_pool->workers.size(), 0.0f);
+
+		// Wait for the GPU to finish the last frame that used these resources
+		get_graphics().get_logical_device().waitForFences(1, &frame.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		get_graphics().get_logical_device().resetFences(1, &frame.fence);
+
+		// Free resources the GPU was still using when they were destroyed
+		std::vector<std::function<void()>> deletions = {};
+		{
+			std::lock_guard<std::mutex> lock(m_deletion_mutex);
+			deletions.swap(frame.deletions);
+		}
+
+		for (auto& deletion : deletions)
+			deletion();
+
+		// Bring the frame's copy of the texture table up to date
+		m_texture_table->update(m_frame);
+
+		// Submit pending uploads ahead of the frame's rendering work
+		get_graphics().get_upload_manager().flush();
+
+		const uint64_t staged_bytes = get_graphics().get_upload_manager().get_staged_bytes();
+		m_frame_statistics.upload_bytes = staged_bytes - m_staged_bytes;
+		m_staged_bytes = staged_bytes;
 	}
 
 	void ForwardRendererBase::upate_lighting_data()
 	{
-		// Submit lighting data
-		m_lighting_manager->upload();
+		// Cluster and submit lighting data
+		m_lighting_manager->set_viewport_size(get_width(), get_height());
+		m_lighting_manager->upload(m_frame, m_thread_pool.get());
 
 		// Update lighting descriptor sets
-		std::array<vk::DescriptorBufferInfo, 2> buffer_infos = {};
-		buffer_infos[0].buffer = m_lighting_manager->get_point_light_ssbo().buffer;
+		std::array<vk::DescriptorBufferInfo, 3> buffer_infos = {};
+		buffer_infos[0].buffer = m_lighting_manager->get_point_light_ssbo(m_frame).buffer;
 		buffer_infos[0].offset = 0;
-		buffer_infos[0].range = static_cast<uint32_t>(m_lighting_manager->get_point_light_data_size());
+		buffer_infos[0].range = static_cast<uint32_t>(m_lighting_manager->get_point_light_data_size(m_frame));
 
-		buffer_infos[1].buffer = m_lighting_manager->get_directional_light_ssbo().buffer;
+		buffer_infos[1].buffer = m_lighting_manager->get_directional_light_ssbo(m_frame).buffer;
 		buffer_infos[1].offset = 0;
-		buffer_infos[1].range = static_cast<uint32_t>(m_lighting_manager->get_directional_light_data_size());
+		buffer_infos[1].range = static_cast<uint32_t>(m_lighting_manager->get_directional_light_data_size(m_frame));
+
+		buffer_infos[2].buffer = m_lighting_manager->get_cluster_ssbo(m_frame).buffer;
+		buffer_infos[2].offset = 0;
+		buffer_infos[2].range = static_cast<uint32_t>(m_lighting_manager->get_cluster_data_size(m_frame));
 
-		std::array<vk::WriteDescriptorSet, 2> writes = {};
-		writes[0].dstSet = m_descriptor.set;
+		std::array<vk::WriteDescriptorSet, 3> writes = {};
+		writes[0].dstSet = m_frames[m_frame].descriptor_set;
 		writes[0].dstBinding = 0;
 		writes[0].dstArrayElement = 0;
 		writes[0].descriptorType = vk::DescriptorType::eStorageBuffer;
 		writes[0].descriptorCount = 1;
 		writes[0].pBufferInfo = &buffer_infos[0];
 
-		writes[1].dstSet = m_descriptor.set;
+		writes[1].dstSet = m_frames[m_frame].descriptor_set;
 		writes[1].dstBinding = 1;
 		writes[1].dstArrayElement = 0;
 		writes[1].descriptorType = vk::DescriptorType::eStorageBuffer;
 		writes[1].descriptorCount = 1;
 		writes[1].pBufferInfo = &buffer_infos[1];
 
+		writes[2].dstSet = m_frames[m_frame].descriptor_set;
+		writes[2].dstBinding = 4;
+		writes[2].dstArrayElement = 0;
+		writes[2].descriptorType = vk::DescriptorType::eStorageBuffer;
+		writes[2].descriptorCount = 1;
+		writes[2].pBufferInfo = &buffer_infos[2];
+
 		get_graphics().get_logical_device().updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 	}
 
-	void ForwardRendererBase::generate_depth_prepass_command_buffer(vk::Extent2D extent)
+	void ForwardRendererBase::compute_visibility()
 	{
-		// Begin command buffer
-		vk::CommandBufferBeginInfo cmd_buf_info = {};
-		cmd_buf_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
-		cmd_buf_info.pInheritanceInfo = nullptr;
+		m_visible_objects.clear();
 
-		m_vk_depth_prepass_command_buffer.begin(cmd_buf_info);
+		const size_t count = m_object_bounds.size();
+		const size_t worker_count = m_thread_pool->workers.size();
 
-		// Clear values for all attachments written in the fragment shader
-		vk::ClearValue clear_value = {};
-		clear_value.setDepthStencil({ 1.0f, 0 });
+		// Small workloads aren't worth splitting up
+		if (count < MIN_VISIBILITY_JOB_SIZE * 2 || worker_count < 2)
+		{
+			cull_aabbs(m_main_camera.frustum, m_object_bounds, 0, count, m_visible_objects);
+			return;
+		}
 
-		// Begin render pass
-		vk::RenderPassBeginInfo render_pass_begin_info = {};
-		render_pass_begin_info.renderPass = m_render_passes.depth_prepass;
-		render_pass_begin_info.framebuffer = m_depth_prepass_image.framebuffer;
-		render_pass_begin_info.renderArea.extent = extent;
-		render_pass_begin_info.renderArea.offset = vk::Offset2D(0, 0);
-		render_pass_begin_info.clearValueCount = 1;
-		render_pass_begin_info.pClearValues = &clear_value;
+		// Number of bounding boxes per worker
+		const size_t job_size = std::max(MIN_VISIBILITY_JOB_SIZE, (count + worker_count - 1) / worker_count);
+		m_worker_visible_objects.resize(worker_count);
 
-		m_vk_depth_prepass_command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eSecondaryCommandBuffers);
+		for (size_t i = 0; i < worker_count; ++i)
+		{
+			auto& visible = m_worker_visible_objects[i];
+			visible.clear();
 
-		// Inheritance info for the meshes command buffers
-		vk::CommandBufferInheritanceInfo inheritance_info = {};
-		inheritance_info.renderPass = m_render_passes.depth_prepass;
-		inheritance_info.framebuffer = m_depth_prepass_image.framebuffer;
+			const size_t begin = i * job_size;
+			const size_t end = std::min(begin + job_size, count);
 
-		// List of command buffers to execute
-		std::vector<vk::CommandBuffer> command_buffers = {};
+			if (begin >= end)
+				continue;
 
-		// Draw skybox if allowed
-		if (m_main_camera.sky_box.allocator &&
-			m_main_camera.sky_box->get_material() != HMaterial() &&
-			m_main_camera.sky_box->get_mesh() != HMesh())
+			m_thread_pool->workers[i]->add_job([this, &visible, begin, end]()
+			{
+				cull_aabbs(m_main_camera.frustum, m_object_bounds, begin, end, visible);
+			});
+		}
+
+		// Wait for threads to finish
+		m_thread_pool->wait();
+
+		// Ranges are in order, so concatenating keeps the indices sorted
+		for (const auto& visible : m_worker_visible_objects)
+			m_visible_objects.insert(m_visible_objects.end(), visible.begin(), visible.end());
+	}
+
+	void ForwardRendererBase::compute_occlusion()
+	{
+		m_frame_statistics.frustum_culled_objects = m_renderable_objects.size() - m_visible_objects.size();
+
+		// Resizing also clears the buffer
+		const size_t height = (OCCLUSION_BUFFER_WIDTH * get_height()) / std::max<size_t>(get_width(), 1);
+		m_occlusion_buffer.resize(OCCLUSION_BUFFER_WIDTH, static_cast<uint32_t>(height));
+
+		// Gather visible occluders
+		for (const uint32_t i : m_visible_objects)
+		{
+			const auto& obj = m_renderable_objects[i];
+			if (!obj.occluder)
+				continue;
+
+			const auto& sub_mesh = obj.mesh->get_sub_meshes()[obj.sub_mesh];
+			const float* positions = nullptr;
+			size_t stride = 0;
+			const uint32_t* indices = nullptr;
+
+			// Cooked meshes only have triangles to rasterize if their mesh file marks them as occluders
+			if (sub_mesh.index_count > 0 && obj.mesh->get_occluder(positions, stride, indices))
+				m_occlusion_buffer.add_occluder
+				(
+					m_main_camera.vp_mat * obj.model,
+					positions,
+					stride,
+					indices + sub_mesh.first_index,
+					sub_mesh.index_count
+				);
+		}
+
+		if (m_occlusion_buffer.get_triangle_count() == 0)
+			return;
+
+		const size_t worker_count = m_thread_pool->workers.size();
+		m_worker_visible_objects.resize(worker_count);
+
+		// Each worker rasterizes every occluder into its own band of rows
+		const uint32_t rows = m_occlusion_buffer.get_block_rows();
+		const uint32_t rows_per_worker = static_cast<uint32_t>((rows + worker_count - 1) / worker_count);
+
+		for (size_t i = 0; i < worker_count; ++i)
 		{
-			command_buffers.push_back(m_main_camera.command_buffers[1].get_command_buffer());
-			draw_sky_box(m_main_camera.command_buffers[1], extent, inheritance_info, true);
+			const uint32_t first_row = static_cast<uint32_t>(i) * rows_per_worker;
+			const uint32_t last_row = std::min(first_row + rows_per_worker, rows);
+
+			if (first_row >= last_row)
+				continue;
+
+			m_thread_pool->workers[i]->add_job([this, first_row, last_row]()
+			{
+				m_occlusion_buffer.rasterize(first_row, last_row);
+			});
 		}
 
-		// List of jobs.
-		// First dimension is the queue.
-		// Second dimension is the job list.
-		std::vector<std::vector<std::function<void(void)>>> jobs(get_graphics().get_command_manager().get_pool_count());
+		m_thread_pool->wait();
+
+		// Test visible objects against the occluders
+		const size_t count = m_visible_objects.size();
+		const size_t job_size = count < MIN_OCCLUSION_JOB_SIZE * 2 ? 
+			count : 
+			std::max(MIN_OCCLUSION_JOB_SIZE, (count + worker_count - 1) / worker_count);
 
-		// Loop over every mesh
-		for (size_t i = 0; i < m_renderable_objects.size(); ++i)
+		for (size_t i = 0; i < worker_count; ++i)
 		{
-			// Easy to reference
-			auto& obj = m_renderable_objects[i];
+			auto& visible = m_worker_visible_objects[i];
+			visible.clear();
+
+			const size_t begin = i * job_size;
+			const size_t end = std::min(begin + job_size, count);
+
+			if (begin >= end)
+				continue;
+
+			m_thread_pool->workers[i]->add_job([this, &visible, begin, end]()
+			{
+				for (size_t j = begin; j < end; ++j)
+					if (m_occlusion_buffer.test(m_main_camera.vp_mat, m_renderable_objects[m_visible_objects[j]].bounds))
+						visible.push_back(m_visible_objects[j]);
+			});
+		}
+
+		m_thread_pool->wait();
+
+		// Ranges are in order, so concatenating keeps the indices sorted
+		m_visible_objects.clear();
+		for (const auto& visible : m_worker_visible_objects)
+			m_visible_objects.insert(m_visible_objects.end(), visible.begin(), visible.end());
+	}
+
+	void ForwardRendererBase::build_render_batches()
+	{
+		m_render_batches.clear();
+
+		// Sort by state and then front-to-back
+		sort_draws(m_renderable_objects, m_visible_objects, m_main_camera.position, m_draw_state, m_draw_keys, m_draw_indices);
+
+		// Make room for the sky box and every visible object
+		reserve_instances(m_draw_indices.size() + 1);
+		auto& instances = m_frames[m_frame].instances;
+
+		// Sky box instance
+		instances.map[0].model = glm::translate({}, m_main_camera.position);
+		instances.map[0].mvp = m_main_camera.vp_mat * instances.map[0].model;
+
+		// Group objects into batches
+		for (size_t i = 0; i < m_draw_indices.size(); ++i)
+		{
+			const auto& obj = m_renderable_objects[m_draw_indices[i]];
+			const uint32_t instance = static_cast<uint32_t>(i + 1);
+
+			// Write instance data
+			instances.map[instance].model = obj.model;
+			instances.map[instance].mvp = m_main_camera.vp_mat * obj.model;
+
+			// Extend the current batch if possible
+			if (m_render_batches.size() > 0)
+			{
+				auto& batch = m_render_batches.back();
+
+				if (can_batch(m_renderable_objects[batch.object], obj))
+				{
+					++batch.instance_count;
+					continue;
+				}
+			}
+
+			// Start a new batch
+			RenderBatch batch = {};
+			batch.sort_key = m_draw_keys[i];
+			batch.object = m_draw_indices[i];
+			batch.first_instance = instance;
+			batch.instance_count = 1;
+			m_render_batches.push_back(batch);
+		}
+
+		m_frame_statistics.occlusion_culled_objects = 
+			m_renderable_objects.size() - m_frame_statistics.frustum_culled_objects - m_visible_objects.size();
+		m_frame_statistics.drawn_objects = m_visible_objects.size();
+		m_frame_statistics.batches = m_render_batches.size();
+	}
+
+	void ForwardRendererBase::reserve_instances(size_t count)
+	{
+		auto& frame = m_frames[m_frame];
+
+		if (count <= frame.instances.capacity)
+			return;
+
+		// Grow geometrically
+		size_t new_capacity = frame.instances.capacity > 0 ? frame.instances.capacity : 1;
+		while (new_capacity < count)
+			new_capacity *= 2;
+
+		// Free old buffer. The frame's fence has been waited on so the GPU is done with it.
+		if (frame.instances.map)
+			frame.instances.buffer.free(get_graphics().get_logical_device());
+
+		const vk::DeviceSize size = static_cast<vk::DeviceSize>(sizeof(VertexShaderData) * new_capacity);
+
+		// Create new buffer
+		frame.instances.buffer = get_graphics().create_buffer
+		(
+			size,
+			vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		);
 
-			// Frustum culling
-			AABB new_aabb = obj.mesh->get_aabb();
-			new_aabb.transform(obj.model);
+		frame.instances.map = static_cast<VertexShaderData*>(frame.instances.buffer.memory.mapped);
+		frame.instances.capacity = new_capacity;
 
-			if (!m_main_camera.frustum.check_inside(new_aabb)) continue;
+		// Update instance descriptor
+		vk::DescriptorBufferInfo buffer_info = {};
+		buffer_info.buffer = frame.instances.buffer.buffer;
+		buffer_info.offset = 0;
+		buffer_info.range = size;
+
+		vk::WriteDescriptorSet write = {};
+		write.dstSet = frame.descriptor_set;
+		write.dstBinding = 3;
+		write.dstArrayElement = 0;
+		write.descriptorType = vk::DescriptorType::eStorageBuffer;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &buffer_info;
+
+		get_graphics().get_logical_device().updateDescriptorSets(1, &write, 0, nullptr);
+	}
+
+	void ForwardRendererBase::record_render_batches
+	(
+		std::vector<VkManagedCommandBuffer>& managed_command_buffers,
+		vk::CommandBufferInheritanceInfo inheritance_info,
+		vk::Extent2D extent,
+		size_t pipeline,
+		std::vector<vk::CommandBuffer>& command_buffers
+	)
+	{
+		if (m_render_batches.size() == 0)
+			return;
+
+		// Number of batches per command buffer
+		const size_t batches_per_buffer = (m_render_batches.size() + managed_command_buffers.size() - 1) / managed_command_buffers.size();
+
+		// Each job counts what it records separately
+		m_record_statistics.clear();
+		m_record_statistics.resize(managed_command_buffers.size());
+
+		for (size_t i = 0; i < managed_command_buffers.size(); ++i)
+		{
+			const size_t begin = i * batches_per_buffer;
+			const size_t end = std::min(begin + batches_per_buffer, m_render_batches.size());
+
+			if (begin >= end)
+				break;
 
 			// Add command buffer to list
-			auto& command_buffer = obj.command_buffers[1].get_command_buffer();
+			auto command_buffer = managed_command_buffers[i].get_command_buffer();
 			command_buffers.push_back(command_buffer);
 
 			// Create job
-			jobs[obj.command_buffers[1].get_thread_index()].push_back(([this, &obj, command_buffer, inheritance_info, extent]()
+			RecordStatistics* statistics = &m_record_statistics[i];
+			m_thread_pool->workers[managed_command_buffers[i].get_thread_index()]->add_job([this, command_buffer, inheritance_info, extent, pipeline, begin, end, statistics]()
 			{
+				const auto start_time = std::chrono::high_resolution_clock::now();
+
 				// Begin command buffer
 				vk::CommandBufferBeginInfo begin_info = {};
 				begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
@@ -336,63 +742,200 @@ namespace dk
 
 				// Set scissor
 				vk::Rect2D scissor = {};
-				scissor.extent = extent;
+				scissor.setExtent(extent);
 				scissor.setOffset({ 0, 0 });
 				command_buffer.setScissor(0, 1, &scissor);
 
-				// Bind shader
-				command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, obj.shader->get_pipeline(0).pipeline);
-
-				// Bind descriptor sets
-				command_buffer.bindDescriptorSets
-				(
-					vk::PipelineBindPoint::eGraphics,
-					obj.shader->get_pipeline(0).layout,
-					0,
-					static_cast<uint32_t>(obj.descriptor_sets.size()),
-					obj.descriptor_sets.data(),
-					0,
-					nullptr
-				);
-
-				// Draw mesh
-				const auto& mem_buffer = obj.mesh->get_vertex_buffer();
-				vk::DeviceSize offsets[] = { 0 };
-
-				command_buffer.bindVertexBuffers(0, 1, &mem_buffer.buffer, offsets);
-				command_buffer.bindIndexBuffer(obj.mesh->get_index_buffer().buffer, 0, vk::IndexType::eUint16);
-				command_buffer.drawIndexed(static_cast<uint32_t>(obj.mesh->get_index_count()), 1, 0, 0, 0);
+				// Currently bound state
+				vk::Pipeline bound_pipeline = {};
+				const std::vector<vk::DescriptorSet>* bound_sets = nullptr;
+				const std::array<uint32_t, 2>* bound_offsets = nullptr;
+				uint32_t bound_material = 0;
+				HMesh bound_mesh = {};
+
+				for (size_t j = begin; j < end; ++j)
+				{
+					const auto& batch = m_render_batches[j];
+					const auto& obj = m_renderable_objects[batch.object];
+					const auto& shader_pipeline = obj.shader->get_pipeline(pipeline);
+
+					// Bind shader
+					if (shader_pipeline.pipeline != bound_pipeline)
+					{
+						command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, shader_pipeline.pipeline);
+						bound_pipeline = shader_pipeline.pipeline;
+						++statistics->pipeline_binds;
+					}
+
+					// Find the range of descriptor sets that changed. Material pipelines all have
+					// compatible layouts, so sets outside the range stay bound across pipelines.
+					// The first set must also be rebound if its dynamic offsets changed.
+					size_t first_set = 0;
+					size_t last_set = obj.descriptor_sets.size();
+					if (bound_sets && bound_sets->size() == obj.descriptor_sets.size())
+					{
+						while (
+							first_set < last_set &&
+							obj.descriptor_sets[first_set] == (*bound_sets)[first_set] &&
+							(first_set > 0 || obj.dynamic_offsets == *bound_offsets)
+							)
+							++first_set;
+
+						while (last_set > first_set && obj.descriptor_sets[last_set - 1] == (*bound_sets)[last_set - 1])
+							--last_set;
+					}
+
+					// Bind descriptor sets. Only the first set has dynamic offsets.
+					if (first_set < last_set)
+					{
+						command_buffer.bindDescriptorSets
+						(
+							vk::PipelineBindPoint::eGraphics,
+							shader_pipeline.layout,
+							static_cast<uint32_t>(first_set),
+							static_cast<uint32_t>(last_set - first_set),
+							obj.descriptor_sets.data() + first_set,
+							first_set == 0 ? static_cast<uint32_t>(obj.dynamic_offsets.size()) : 0,
+							first_set == 0 ? obj.dynamic_offsets.data() : nullptr
+						);
+						++statistics->descriptor_binds;
+					}
+
+					// Tell the fragment shader where the materials texture slots are
+					const uint32_t material = obj.material->get_table_slot();
+					if (!bound_sets || material != bound_material)
+					{
+						command_buffer.pushConstants(shader_pipeline.layout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t), &material);
+						bound_material = material;
+					}
+
+					bound_sets = &obj.descriptor_sets;
+					bound_offsets = &obj.dynamic_offsets;
+
+					// Bind mesh
+					dk_assert(obj.mesh->get_vertex_format() == obj.shader->get_vertex_format());
+					if (obj.mesh != bound_mesh)
+					{
+						const auto& mem_buffer = obj.mesh->get_vertex_buffer();
+						vk::DeviceSize offsets[] = { 0 };
+
+						command_buffer.bindVertexBuffers(0, 1, &mem_buffer.buffer, offsets);
+						command_buffer.bindIndexBuffer(obj.mesh->get_index_buffer().buffer, 0, obj.mesh->get_index_type());
+						bound_mesh = obj.mesh;
+
+						// Tell the vertex shader how to unpack positions
+						if (obj.mesh->get_vertex_format() == VertexFormat::Packed)
+						{
+							const PackedVertexBounds bounds = obj.mesh->get_packed_vertex_bounds();
+							command_buffer.pushConstants
+							(
+								shader_pipeline.layout,
+								vk::ShaderStageFlagBits::eVertex,
+								PackedVertexBounds::push_constant_offset,
+								sizeof(PackedVertexBounds),
+								&bounds
+							);
+						}
+					}
+
+					// Draw every instance in the batch
+					const auto& sub_mesh = obj.mesh->get_sub_meshes()[obj.sub_mesh];
+					command_buffer.drawIndexed(sub_mesh.index_count, batch.instance_count, sub_mesh.first_index, 0, batch.first_instance);
+					++statistics->draw_calls;
+					statistics->triangles += static_cast<uint64_t>(sub_mesh.index_count / 3) * batch.instance_count;
+				}
 
 				// End command buffer
 				command_buffer.end();
-			}));
+				statistics->record_time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+			});
 		}
 
-		// Add jobs to thread pool
-		for (size_t i = 0; i < jobs.size(); ++i)
-			m_thread_pool->workers[i]->add_jobs(jobs[i]);
-
 		// Wait for threads to finish
 		m_thread_pool->wait();
 
+		// Gather statistics. Unused command buffers have nothing recorded.
+		for (size_t i = 0; i < m_record_statistics.size(); ++i)
+		{
+			const auto& statistics = m_record_statistics[i];
+			if (statistics.draw_calls == 0)
+				continue;
+
+			m_frame_statistics.draw_calls += statistics.draw_calls;
+			m_frame_statistics.triangles += statistics.triangles;
+			m_frame_statistics.pipeline_binds += statistics.pipeline_binds;
+			m_frame_statistics.descriptor_binds += statistics.descriptor_binds;
+			m_frame_statistics.worker_record_times[managed_command_buffers[i].get_thread_index()] += statistics.record_time;
+			++m_frame_statistics.secondary_command_buffers;
+		}
+	}
+
+	void ForwardRendererBase::generate_depth_prepass_command_buffer(vk::Extent2D extent)
+	{
+		auto& frame = m_frames[m_frame];
+
+		// Begin command buffer
+		vk::CommandBufferBeginInfo cmd_buf_info = {};
+		cmd_buf_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+		cmd_buf_info.pInheritanceInfo = nullptr;
+
+		frame.depth_prepass_command_buffer.begin(cmd_buf_info);
+
+		// Clear values for all attachments written in the fragment shader
+		vk::ClearValue clear_value = {};
+		clear_value.setDepthStencil({ 1.0f, 0 });
+
+		// Begin render pass
+		vk::RenderPassBeginInfo render_pass_begin_info = {};
+		render_pass_begin_info.renderPass = m_render_passes.depth_prepass;
+		render_pass_begin_info.framebuffer = m_depth_prepass_image.framebuffer;
+		render_pass_begin_info.renderArea.extent = extent;
+		render_pass_begin_info.renderArea.offset = vk::Offset2D(0, 0);
+		render_pass_begin_info.clearValueCount = 1;
+		render_pass_begin_info.pClearValues = &clear_value;
+
+		frame.depth_prepass_command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eSecondaryCommandBuffers);
+
+		// Inheritance info for the meshes command buffers
+		vk::CommandBufferInheritanceInfo inheritance_info = {};
+		inheritance_info.renderPass = m_render_passes.depth_prepass;
+		inheritance_info.framebuffer = m_depth_prepass_image.framebuffer;
+
+		// List of command buffers to execute
+		std::vector<vk::CommandBuffer> command_buffers = {};
+
+		// Draw skybox if allowed
+		if (m_main_camera.sky_box.allocator &&
+			m_main_camera.sky_box->get_material() != HMaterial() &&
+			m_main_camera.sky_box->get_mesh() != HMesh())
+		{
+			command_buffers.push_back(frame.sky_box_depth_prepass.get_command_buffer());
+			draw_sky_box(frame.sky_box_depth_prepass, extent, inheritance_info, true);
+		}
+
+		// Record batches
+		record_render_batches(frame.depth_prepass_batches, inheritance_info, extent, 0, command_buffers);
+
 		// Execute command buffers
 		if (command_buffers.size() > 0)
-			m_vk_depth_prepass_command_buffer.executeCommands(command_buffers);
+			frame.depth_prepass_command_buffer.executeCommands(command_buffers);
 
 		// End render pas
-		m_vk_depth_prepass_command_buffer.endRenderPass();
+		frame.depth_prepass_command_buffer.endRenderPass();
 
 		// End command buffer
-		m_vk_depth_prepass_command_buffer.end();
+		frame.depth_prepass_command_buffer.end();
 	}
 
 	void ForwardRendererBase::generate_rendering_command_buffer(const vk::Framebuffer& framebuffer, vk::Extent2D extent)
 	{
+		auto& frame = m_frames[m_frame];
+
 		// Begin recording to primary command buffer
 		vk::CommandBufferBeginInfo begin_info = {};
 		begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
 
-		m_vk_rendering_command_buffer.begin(begin_info);
+		frame.rendering_command_buffer.begin(begin_info);
 
 		// Inheritance info for the meshes command buffers
 		vk::CommandBufferInheritanceInfo inheritance_info = {};
@@ -411,7 +954,7 @@ namespace dk
 		render_pass_info.clearValueCount = 1;
 		render_pass_info.pClearValues = &clear_color;
 
-		m_vk_rendering_command_buffer.beginRenderPass(render_pass_info, vk::SubpassContents::eSecondaryCommandBuffers);
+		frame.rendering_command_buffer.beginRenderPass(render_pass_info, vk::SubpassContents::eSecondaryCommandBuffers);
 
 		// Command buffers to execute
 		std::vector<vk::CommandBuffer> command_buffers = {};
@@ -421,117 +964,40 @@ namespace dk
 			m_main_camera.sky_box->get_material() != HMaterial() &&
 			m_main_camera.sky_box->get_mesh() != HMesh())
 		{
-			command_buffers.push_back(m_main_camera.command_buffers[0].get_command_buffer());
-			draw_sky_box(m_main_camera.command_buffers[0], extent, inheritance_info, false);
+			command_buffers.push_back(frame.sky_box_color.get_command_buffer());
+			draw_sky_box(frame.sky_box_color, extent, inheritance_info, false);
 		}
 
-		// List of jobs.
-		// First dimension is the queue.
-		// Second dimension is the job list.
-		std::vector<std::vector<std::function<void(void)>>> jobs(get_graphics().get_command_manager().get_pool_count());
-
-		// Loop over every mesh
-		for (size_t i = 0; i < m_renderable_objects.size(); ++i)
-		{
-			// Easy reference
-			auto& obj = m_renderable_objects[i];
-
-			// Frustum culling
-			AABB new_aabb = obj.mesh->get_aabb();
-			new_aabb.transform(obj.model);
-
-			if (!m_main_camera.frustum.check_inside(new_aabb)) continue;
-
-			// Add command buffer to list
-			auto& command_buffer = obj.command_buffers[0].get_command_buffer();
-			command_buffers.push_back(command_buffer);
-
-			// Create job
-			jobs[obj.command_buffers[0].get_thread_index()].push_back(([this, &obj, command_buffer, inheritance_info, extent]()
-			{
-				// Begin command buffer
-				vk::CommandBufferBeginInfo begin_info = {};
-				begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
-				begin_info.pInheritanceInfo = &inheritance_info;
-
-				command_buffer.begin(begin_info);
-
-				// Set viewport
-				vk::Viewport viewport = {};
-				viewport.setHeight(static_cast<float>(extent.height));
-				viewport.setWidth(static_cast<float>(extent.width));
-				viewport.setMinDepth(0);
-				viewport.setMaxDepth(1);
-				command_buffer.setViewport(0, 1, &viewport);
-
-				// Set scissor
-				vk::Rect2D scissor = {};
-				scissor.setExtent(extent);
-				scissor.setOffset({ 0, 0 });
-				command_buffer.setScissor(0, 1, &scissor);
-
-				// Bind shader
-				command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, obj.shader->get_pipeline(1).pipeline);
-
-				// Bind descriptor sets
-				command_buffer.bindDescriptorSets
-				(
-					vk::PipelineBindPoint::eGraphics,
-					obj.shader->get_pipeline(1).layout,
-					0,
-					static_cast<uint32_t>(obj.descriptor_sets.size()),
-					obj.descriptor_sets.data(),
-					0,
-					nullptr
-				);
-
-				// Draw mesh
-				const auto& mem_buffer = obj.mesh->get_vertex_buffer();
-				vk::DeviceSize offsets[] = { 0 };
-
-				command_buffer.bindVertexBuffers(0, 1, &mem_buffer.buffer, offsets);
-				command_buffer.bindIndexBuffer(obj.mesh->get_index_buffer().buffer, 0, vk::IndexType::eUint16);
-				command_buffer.drawIndexed(static_cast<uint32_t>(obj.mesh->get_index_count()), 1, 0, 0, 0);
-
-				// End command buffer
-				command_buffer.end();
-			}));
-		}
-
-		// Add jobs to worker threads
-		for (size_t i = 0; i < jobs.size(); ++i)
-			m_thread_pool->workers[i]->add_jobs(jobs[i]);
-
-		// Wait for threads to finish
-		m_thread_pool->wait();
+		// Record batches
+		record_render_batches(frame.color_batches, inheritance_info, extent, 1, command_buffers);
 
 		// Execute command buffers
 		if (command_buffers.size() > 0)
-			m_vk_rendering_command_buffer.executeCommands(command_buffers);
+			frame.rendering_command_buffer.executeCommands(command_buffers);
 
 		// End render pass and command buffer
-		m_vk_rendering_command_buffer.endRenderPass();
-		m_vk_rendering_command_buffer.end();
+		frame.rendering_command_buffer.endRenderPass();
+		frame.rendering_command_buffer.end();
 	}
 
 	void ForwardRendererBase::draw_sky_box(VkManagedCommandBuffer& managed_command_buffer, vk::Extent2D extent, vk::CommandBufferInheritanceInfo inheritance_info, bool depth_prepass)
 	{
-		// Update sky box data
-		VertexShaderData data = {};
-		data.model = glm::translate({}, m_main_camera.position);
-		data.mvp = m_main_camera.vp_mat * data.model;
-		m_main_camera.sky_box->set_vertex_data(data);
-
 		auto& command_buffer = managed_command_buffer.get_command_buffer();
 
 		// Descriptor sets
 		std::vector<vk::DescriptorSet> descriptor_sets =
 		{
-			m_main_camera.sky_box->get_descriptor_set(),
-			m_descriptor.set,
-			m_main_camera.sky_box->get_material()->get_texture_descriptor_set()
+			m_main_camera.sky_box->get_material()->get_descriptor_set(),
+			m_frames[m_frame].descriptor_set,
+			m_texture_table->get_descriptor_set(m_frame)
 		};
 
+		// Per instance data
+		const auto& shader = m_main_camera.sky_box->get_material()->get_shader();
+		std::array<uint32_t, 2> dynamic_offsets = {};
+		std::memset(m_uniform_ring.allocate(shader->get_inst_vertex_buffer_size(), dynamic_offsets[0]), 0, shader->get_inst_vertex_buffer_size());
+		std::memset(m_uniform_ring.allocate(shader->get_inst_fragment_buffer_size(), dynamic_offsets[1]), 0, shader->get_inst_fragment_buffer_size());
+
 		// Begin command buffer
 		vk::CommandBufferBeginInfo begin_info = {};
 		begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
@@ -564,8 +1030,8 @@ namespace dk
 				0,
 				static_cast<uint32_t>(descriptor_sets.size()),
 				descriptor_sets.data(),
-				0,
-				nullptr
+				static_cast<uint32_t>(dynamic_offsets.size()),
+				dynamic_offsets.data()
 			);
 		}
 		else
@@ -578,19 +1044,53 @@ namespace dk
 				0,
 				static_cast<uint32_t>(descriptor_sets.size()),
 				descriptor_sets.data(),
-				0,
-				nullptr
+				static_cast<uint32_t>(dynamic_offsets.size()),
+				dynamic_offsets.data()
+			);
+		}
+
+		// Tell the fragment shader where the materials texture slots are
+		const uint32_t material = m_main_camera.sky_box->get_material()->get_table_slot();
+		command_buffer.pushConstants
+		(
+			m_main_camera.sky_box->get_material()->get_shader()->get_pipeline(depth_prepass ? 0 : 1).layout,
+			vk::ShaderStageFlagBits::eFragment,
+			0,
+			sizeof(uint32_t),
+			&material
+		);
+
+		// Tell the vertex shader how to unpack positions
+		HMesh sky_box_mesh = m_main_camera.sky_box->get_mesh();
+		dk_assert(sky_box_mesh->get_vertex_format() == m_main_camera.sky_box->get_material()->get_shader()->get_vertex_format());
+		if (sky_box_mesh->get_vertex_format() == VertexFormat::Packed)
+		{
+			const PackedVertexBounds bounds = sky_box_mesh->get_packed_vertex_bounds();
+			command_buffer.pushConstants
+			(
+				m_main_camera.sky_box->get_material()->get_shader()->get_pipeline(depth_prepass ? 0 : 1).layout,
+				vk::ShaderStageFlagBits::eVertex,
+				PackedVertexBounds::push_constant_offset,
+				sizeof(PackedVertexBounds),
+				&bounds
 			);
 		}
 
-		// Draw mesh
+		// Draw mesh using the reserved first instance
 		const auto& mem_buffer = m_main_camera.sky_box->get_mesh()->get_vertex_buffer();
 		vk::DeviceSize offsets[] = { 0 };
 
 		command_buffer.bindVertexBuffers(0, 1, &mem_buffer.buffer, offsets);
-		command_buffer.bindIndexBuffer(m_main_camera.sky_box->get_mesh()->get_index_buffer().buffer, 0, vk::IndexType::eUint16);
+		command_buffer.bindIndexBuffer(m_main_camera.sky_box->get_mesh()->get_index_buffer().buffer, 0, m_main_camera.sky_box->get_mesh()->get_index_type());
 		command_buffer.drawIndexed(static_cast<uint32_t>(m_main_camera.sky_box->get_mesh()->get_index_count()), 1, 0, 0, 0);
 
+		// Record statistics
+		++m_frame_statistics.draw_calls;
+		++m_frame_statistics.pipeline_binds;
+		++m_frame_statistics.descriptor_binds;
+		++m_frame_statistics.secondary_command_buffers;
+		m_frame_statistics.triangles += m_main_camera.sky_box->get_mesh()->get_index_count() / 3;
+
 		// End command buffer
 		command_buffer.end();
 	}
@@ -680,8 +1180,14 @@ namespace dk
 
 	}
 
-	ForwardRenderer::ForwardRenderer(Graphics* graphics, ResourceAllocator<Texture>* texture_allocator, ResourceAllocator<Mesh>* mesh_allocator) :
-		ForwardRendererBase(graphics, graphics->get_width(), graphics->get_height(), texture_allocator, mesh_allocator),
+	ForwardRenderer::ForwardRenderer
+	(
+		Graphics* graphics, 
+		ResourceAllocator<Texture>* texture_allocator, 
+		ResourceAllocator<Mesh>* mesh_allocator,
+		size_t frames_in_flight
+	) :
+		ForwardRendererBase(graphics, graphics->get_width(), graphics->get_height(), texture_allocator, mesh_allocator, frames_in_flight),
 		m_vk_framebuffers({})
 	{
 		// Create swapchain manager
@@ -694,10 +1200,14 @@ namespace dk
 			get_height()
 		);
 
-		// Create semaphore
+		// Create semaphores
 		vk::SemaphoreCreateInfo semaphore_info = {};
-		m_vk_image_available = get_graphics().get_logical_device().createSemaphore(semaphore_info);
-		dk_assert(m_vk_image_available);
+		m_vk_image_available.resize(m_frames.size());
+		for (auto& semaphore : m_vk_image_available)
+		{
+			semaphore = get_graphics().get_logical_device().createSemaphore(semaphore_info);
+			dk_assert(semaphore);
+		}
 
 		// Resize framebuffers
 		m_vk_framebuffers.resize(m_swapchain_manager->get_image_count());
@@ -803,8 +1313,9 @@ namespace dk
 
 		ForwardRendererBase::shutdown();
 
-		// Destroy semaphore
-		get_graphics().get_logical_device().destroySemaphore(m_vk_image_available);
+		// Destroy semaphores
+		for (auto& semaphore : m_vk_image_available)
+			get_graphics().get_logical_device().destroySemaphore(semaphore);
 
 		// Destroy swapchain data
 		destroy_swapchain_data();
@@ -812,21 +1323,28 @@ namespace dk
 
 	void ForwardRenderer::render()
 	{
-		// Wait for present queue to finish if needed
-		get_graphics().get_device_manager().get_present_queue().waitIdle();
+		// Wait until the GPU is done with this frame's resources
+		begin_frame();
+		auto& frame = m_frames[m_frame];
+		vk::Semaphore& image_available = m_vk_image_available[m_frame];
 
 		// Get image index to render too
 		uint32_t image_index = get_graphics().get_logical_device().acquireNextImageKHR
 		(
 			get_swapchain_manager().get_swapchain(),
 			std::numeric_limits<uint64_t>::max(),
-			m_vk_image_available,
+			image_available,
 			vk::Fence()
 		).value;
 
 		// Update lights
 		upate_lighting_data();
 
+		// Cull and batch objects
+		compute_visibility();
+		compute_occlusion();
+		build_render_batches();
+
 		// Window extent
 		vk::Extent2D extent = {};
 		extent.width = static_cast<uint32_t>(get_width());
@@ -839,11 +1357,11 @@ namespace dk
 
 			vk::SubmitInfo submit_info = {};
 			submit_info.commandBufferCount = 1;
-			submit_info.pCommandBuffers = &m_vk_depth_prepass_command_buffer;
+			submit_info.pCommandBuffers = &frame.depth_prepass_command_buffer;
 			submit_info.signalSemaphoreCount = 1;
-			submit_info.pSignalSemaphores = &m_semaphores.depth_prepass_finished;
+			submit_info.pSignalSemaphores = &frame.depth_prepass_finished;
 			submit_info.pWaitDstStageMask = &wait_stage;
-			submit_info.pWaitSemaphores = &m_vk_image_available;
+			submit_info.pWaitSemaphores = &image_available;
 			submit_info.waitSemaphoreCount = 1;
 
 			// Submit draw command
@@ -857,25 +1375,22 @@ namespace dk
 
 			vk::SubmitInfo submit_info = {};
 			submit_info.waitSemaphoreCount = 1;
-			submit_info.pWaitSemaphores = &m_semaphores.depth_prepass_finished;
+			submit_info.pWaitSemaphores = &frame.depth_prepass_finished;
 			submit_info.pWaitDstStageMask = &wait_stage;
 			submit_info.commandBufferCount = 1;
-			submit_info.pCommandBuffers = &m_vk_rendering_command_buffer;
+			submit_info.pCommandBuffers = &frame.rendering_command_buffer;
 			submit_info.signalSemaphoreCount = 1;
-			submit_info.pSignalSemaphores = &m_semaphores.color_rendering_finished;
+			submit_info.pSignalSemaphores = &frame.color_rendering_finished;
 
-			// Submit to queue
-			get_graphics().get_device_manager().get_graphics_queue().submit(submit_info, vk::Fence());
+			// Submit to queue. The fence tells us when the frame's resources are free again.
+			get_graphics().get_device_manager().get_graphics_queue().submit(submit_info, frame.fence);
 		}
 
-		// Wait for graphics queue to finish rendering
-		get_graphics().get_device_manager().get_graphics_queue().waitIdle();
-
 		// Present to screen
 		{
 			vk::PresentInfoKHR present_info = {};
 			present_info.waitSemaphoreCount = 1;
-			present_info.pWaitSemaphores = &m_semaphores.color_rendering_finished;
+			present_info.pWaitSemaphores = &frame.color_rendering_finished;
 			present_info.swapchainCount = 1;
 			present_info.pSwapchains = &get_swapchain_manager().get_swapchain();
 			present_info.pImageIndices = &image_index;
@@ -950,8 +1465,9 @@ namespace dk
 		int width,
 		int height,
 		ResourceAllocator<Texture>* texture_allocator,
-		ResourceAllocator<Mesh>* mesh_allocator
-	) : ForwardRendererBase(graphics, width, height, texture_allocator, mesh_allocator)
+		ResourceAllocator<Mesh>* mesh_allocator,
+		size_t frames_in_flight
+	) : ForwardRendererBase(graphics, width, height, texture_allocator, mesh_allocator, frames_in_flight)
 	{
 		// Get swapchain details
 		SwapChainSupportDetails swap_chain_support = query_swap_chain_support
@@ -1003,16 +1519,19 @@ namespace dk
 			subpass.pColorAttachments = &attachment_refs[0];
 			subpass.pDepthStencilAttachment = &attachment_refs[1];
 
-			// Use subpass dependencies for attachment layput transitions
+			// Use subpass dependencies for attachment layput transitions. The color texture 
+			// is sampled after rendering without waiting for the queue to go idle, so 
+			// reads of the previous frame must finish before writing and writes must 
+			// finish before the next read.
 			std::array<vk::SubpassDependency, 2> dependencies =
 			{
 				vk::SubpassDependency
 				(
 					VK_SUBPASS_EXTERNAL,
 					0,
-					vk::PipelineStageFlagBits::eBottomOfPipe,
+					vk::PipelineStageFlagBits::eFragmentShader,
 					vk::PipelineStageFlagBits::eColorAttachmentOutput,
-					vk::AccessFlagBits::eMemoryRead,
+					vk::AccessFlagBits::eShaderRead,
 					vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
 					vk::DependencyFlagBits::eByRegion
 				),
@@ -1021,9 +1540,9 @@ namespace dk
 					0,
 					VK_SUBPASS_EXTERNAL,
 					vk::PipelineStageFlagBits::eColorAttachmentOutput,
-					vk::PipelineStageFlagBits::eBottomOfPipe,
-					vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
-					vk::AccessFlagBits::eMemoryRead,
+					vk::PipelineStageFlagBits::eFragmentShader,
+					vk::AccessFlagBits::eColorAttachmentWrite,
+					vk::AccessFlagBits::eShaderRead,
 					vk::DependencyFlagBits::eByRegion
 				)
 			};
@@ -1058,6 +1577,10 @@ namespace dk
 	void OffScreenForwardRenderer::resize(int width, int height)
 	{
 		Renderer::resize(width, height);
+
+		// Frames in flight might still be using the images
+		get_graphics().get_logical_device().waitIdle();
+
 		destroy_depth_data();
 		destroy_color_data();
 		create_depth_data();
@@ -1066,9 +1589,18 @@ namespace dk
 
 	void OffScreenForwardRenderer::render()
 	{
+		// Wait until the GPU is done with this frame's resources
+		begin_frame();
+		auto& frame = m_frames[m_frame];
+
 		// Update lights
 		upate_lighting_data();
 
+		// Cull and batch objects
+		compute_visibility();
+		compute_occlusion();
+		build_render_batches();
+
 		// Window extent
 		vk::Extent2D extent = {};
 		extent.width = static_cast<uint32_t>(get_width());
@@ -1081,9 +1613,9 @@ namespace dk
 
 			vk::SubmitInfo submit_info = {};
 			submit_info.commandBufferCount = 1;
-			submit_info.pCommandBuffers = &m_vk_depth_prepass_command_buffer;
+			submit_info.pCommandBuffers = &frame.depth_prepass_command_buffer;
 			submit_info.signalSemaphoreCount = 1;
-			submit_info.pSignalSemaphores = &m_semaphores.depth_prepass_finished;
+			submit_info.pSignalSemaphores = &frame.depth_prepass_finished;
 			submit_info.pWaitDstStageMask = &wait_stage;
 			submit_info.pWaitSemaphores = nullptr;
 			submit_info.waitSemaphoreCount = 0;
@@ -1099,20 +1631,17 @@ namespace dk
 
 			vk::SubmitInfo submit_info = {};
 			submit_info.waitSemaphoreCount = 1;
-			submit_info.pWaitSemaphores = &m_semaphores.depth_prepass_finished;
+			submit_info.pWaitSemaphores = &frame.depth_prepass_finished;
 			submit_info.pWaitDstStageMask = &wait_stage;
 			submit_info.commandBufferCount = 1;
-			submit_info.pCommandBuffers = &m_vk_rendering_command_buffer;
+			submit_info.pCommandBuffers = &frame.rendering_command_buffer;
 			submit_info.signalSemaphoreCount = 0;
 			submit_info.pSignalSemaphores = nullptr;
 
-			// Submit to queue
-			get_graphics().get_device_manager().get_graphics_queue().submit(submit_info, vk::Fence());
+			// Submit to queue. The fence tells us when the frame's resources are free again.
+			get_graphics().get_device_manager().get_graphics_queue().submit(submit_info, frame.fence);
 		}
 
-		// Wait for graphics queue to finish rendering
-		get_graphics().get_device_manager().get_graphics_queue().waitIdle();
-
 		// Clear rendering queues
 		flush_queues();
 	}
@@ -7,54 +7,38 @@
  */
 
 /** Includes. */
+#include <chrono>
+#include <mutex>
 #include <utilities\threading.hpp>
+#include <utilities\culling.hpp>
+#include <utilities\occlusion.hpp>
 #include "swapchain_manager.hpp"
 #include "lighting.hpp"
 #include "texture.hpp"
+#include "texture_table.hpp"
+#include "frame_statistics.hpp"
+#include "uniform_ring.hpp"
 #include "renderer.hpp"
 
 namespace dk
 {
 	/**
-	 * @brief Camera data structure.
+	 * @brief A group of objects sharing a shader, material, and mesh
+	 *        that are drawn using a single instanced draw call.
 	 */
-	struct CameraData
+	struct RenderBatch
 	{
-		/** View-projection matrix. */
-		glm::mat4 vp_mat = {};
+		/** Sort key of the first instance in the batch. */
+		uint64_t sort_key = 0;
 
-		/** Position in space. */
-		glm::vec3 position = {};
+		/** Index of the renderable object whose resources are used to draw the batch. */
+		size_t object = 0;
 
-		/** View frustum. */
-		Frustum frustum = {};
+		/** Index of the first instance in the instance buffer. */
+		uint32_t first_instance = 0;
 
-		/** Command buffers to use for rendering the skybox. */
-		std::vector<VkManagedCommandBuffer> command_buffers = {};
-
-		/** Sky box. */
-		HSkyBox sky_box = HSkyBox();
-	};
-
-	/**
-	 * @brief An object that can be rendered onto the screen.
-	 */
-	struct RenderableObject
-	{
-		/** Command buffer to record to. */
-		std::vector<VkManagedCommandBuffer> command_buffers = {};
-
-		/** Shader. */
-		HMaterialShader shader = {};
-
-		/** Mesh. */
-		HMesh mesh = {};
-
-		/** Descriptor sets. */
-		std::vector<vk::DescriptorSet> descriptor_sets = {};
-
-		/** Model matrix. */
-		glm::mat4 model = {};
+		/** Number of instances to draw. */
+		uint32_t instance_count = 0;
 	};
 
 
@@ -78,6 +62,7 @@ namespace dk
 		 * @param Height.
 		 * @param Texture allocator.
 		 * @param Mesh allocator.
+		 * @param Maximum number of frames the CPU can record ahead of the GPU.
 		 */
 		ForwardRendererBase
 		(
@@ -85,7 +70,8 @@ namespace dk
 			int width, 
 			int height,
 			ResourceAllocator<Texture>* texture_allocator, 
-			ResourceAllocator<Mesh>* mesh_allocator
+			ResourceAllocator<Mesh>* mesh_allocator,
+			size_t frames_in_flight = 2
 		);
 
 		/**
@@ -117,21 +103,51 @@ namespace dk
 		}
 
 		/**
-		 * @brief Get primary graphics command buffer.
-		 * @return Graphics command buffer.
+		 * @brief Get descriptor set used by the renderer.
+		 * @return Descriptor set.
+		 * @note Each frame in flight has its own set. This is the set of the frame being recorded.
 		 */
-		vk::CommandBuffer& get_primary_command_buffer()
+		vk::DescriptorSet& get_descriptor_set()
 		{
-			return m_vk_primary_command_buffer;
+			return m_frames[m_frame].descriptor_set;
 		}
 
 		/**
-		 * @brief Get descriptor set used by the renderer.
+		 * @brief Get the maximum number of frames the CPU can record ahead of the GPU.
+		 * @return Number of frames in flight.
+		 */
+		size_t get_frames_in_flight() const
+		{
+			return m_frames.size();
+		}
+
+		/**
+		 * @brief Get the ring buffer per instance uniform data is written to.
+		 * @return Uniform ring buffer.
+		 * @note Allocations are valid until the GPU finishes the next frame.
+		 */
+		UniformRingBuffer& get_uniform_ring()
+		{
+			return m_uniform_ring;
+		}
+
+		/**
+		 * @brief Get the table of textures materials sample from.
+		 * @return Texture table.
+		 */
+		TextureTable& get_texture_table()
+		{
+			return *m_texture_table;
+		}
+
+		/**
+		 * @brief Get the texture table descriptor set.
 		 * @return Descriptor set.
+		 * @note This is the set of the frame being recorded.
 		 */
-		vk::DescriptorSet& get_descriptor_set()
+		const vk::DescriptorSet& get_texture_descriptor_set() const
 		{
-			return m_descriptor.set;
+			return m_texture_table->get_descriptor_set(m_frame);
 		}
 
 		/**
@@ -152,13 +168,13 @@ namespace dk
 		 * @brief Draw a renderable object.
 		 * @param Renderable object.
 		 */
-		void draw(const RenderableObject& obj);
+		void draw(const RenderableObject& obj) override;
 
 		/**
 		 * @brief Draw a point light.
 		 * @param Point light.
 		 */
-		void draw(const PointLightData& point_light)
+		void draw(const PointLightData& point_light) override
 		{
 			m_lighting_manager->draw(point_light);
 		}
@@ -167,32 +183,73 @@ namespace dk
 		 * @brief Draw a directional light.
 		 * @param Directional light.
 		 */
-		void draw(const DirectionalLightData& dir_light)
+		void draw(const DirectionalLightData& dir_light) override
 		{
 			m_lighting_manager->draw(dir_light);
 		}
 
+		/**
+		 * @brief Free a resource once the GPU is done with every frame that may use it.
+		 * @param Function that frees the resource.
+		 * @note The function runs when the most recently submitted frame's fence is next waited
+		 *       on, or right away once the renderer is shut down.
+		 */
+		void defer_deletion(std::function<void()> deletion) override;
+
 		/**
 		 * @brief Set main camera.
 		 * @param Camera data.
 		 */
-		void set_main_camera(const CameraData& data)
+		void set_main_camera(const CameraData& data) override
 		{
-			m_main_camera = data;
+			Renderer::set_main_camera(data);
 			m_lighting_manager->set_camera_position(data.position);
+			m_lighting_manager->set_camera(data.view_mat, data.proj_mat, data.near_plane, data.far_plane);
+		}
+
+		/**
+		 * @brief Set the maximum number of point lights shaded each frame.
+		 * @param Light budget. Zero means unlimited.
+		 * @note Visible lights with the smallest screen contribution are dropped first.
+		 */
+		void set_point_light_budget(size_t budget)
+		{
+			m_lighting_manager->set_point_light_budget(budget);
 		}
 
 		/**
-		 * @brief Get main camera.
-		 * @return Main camera
+		 * @brief Get the statistics of recently rendered frames.
+		 * @return Statistics history.
+		 * @note Must not be used while the renderer is rendering.
 		 */
-		const CameraData& get_main_camera() const
+		FrameStatisticsHistory& get_statistics_history()
 		{
-			return m_main_camera;
+			return m_statistics_history;
 		}
 
 	protected:
 
+		/**
+		 * @brief What a secondary command buffer recorded.
+		 */
+		struct RecordStatistics
+		{
+			/** Number of draw calls. */
+			size_t draw_calls = 0;
+
+			/** Number of triangles. */
+			uint64_t triangles = 0;
+
+			/** Number of pipeline binds. */
+			size_t pipeline_binds = 0;
+
+			/** Number of descriptor set bind calls. */
+			size_t descriptor_binds = 0;
+
+			/** Recording time in milliseconds. */
+			float record_time = 0.0f;
+		};
+
 		/**
 		 * @brief Copy constructor.
 		 * @param Other rendering engine.
@@ -206,11 +263,62 @@ namespace dk
 		 */
 		ForwardRendererBase& operator=(const ForwardRendererBase& other) { return *this; };
 
+		/**
+		 * @brief Wait until the GPU has finished with the current frame's resources.
+		 * @note Only blocks when the CPU is more than the number of frames in flight ahead.
+		 */
+		void begin_frame();
+
 		/**
 		 * @brief Update lighting data.
 		 */
 		void upate_lighting_data();
 
+		/**
+		 * @brief Find every renderable object visible to the main camera.
+		 * @note The test is split across the worker threads. Both passes
+		 *       consume the resulting list.
+		 */
+		void compute_visibility();
+
+		/**
+		 * @brief Remove visible objects hidden behind occluders.
+		 * @note Occluders are rasterized into a low resolution depth buffer on
+		 *       the CPU. Nothing happens when no occluders are visible.
+		 */
+		void compute_occlusion();
+
+		/**
+		 * @brief Group visible objects into batches and write their 
+		 *        per instance data to the instance buffer.
+		 */
+		void build_render_batches();
+
+		/**
+		 * @brief Make sure the current frame's instance buffer can hold a number of instances.
+		 * @param Number of instances.
+		 */
+		void reserve_instances(size_t count);
+
+		/**
+		 * @brief Record every render batch across the worker threads.
+		 * @param Secondary command buffers to record to. One per worker thread.
+		 * @param Inheritence info.
+		 * @param Size of window to draw on.
+		 * @param Shader pipeline index.
+		 * @param List of command buffers to execute. Recorded command buffers are appended.
+		 * @note Batches are split into contiguous ranges so each command buffer
+		 *       sees sorted state and can skip redundant binds.
+		 */
+		void record_render_batches
+		(
+			std::vector<VkManagedCommandBuffer>& managed_command_buffers,
+			vk::CommandBufferInheritanceInfo inheritance_info,
+			vk::Extent2D extent,
+			size_t pipeline,
+			std::vector<vk::CommandBuffer>& command_buffers
+		);
+
 		/**
 		 * @brief Perform the depth prepass.
 		 * @param Size of window to draw on.
@@ -253,6 +361,9 @@ namespace dk
 		/** Lighting manager. */
 		std::unique_ptr<LightingManager> m_lighting_manager;
 
+		/** Texture table. Outlives shutdown() so materials freed afterwards can release their slots. */
+		std::unique_ptr<TextureTable> m_texture_table;
+
 		/** Texture allocator. */
 		ResourceAllocator<Texture>* m_texture_allocator;
 
@@ -265,20 +376,116 @@ namespace dk
 		/** Command pool. */
 		vk::CommandPool m_vk_command_pool;
 
-		/** Primary graphics command buffer. */
-		vk::CommandBuffer m_vk_primary_command_buffer;
+		/** List of renderable objects. */
+		std::vector<RenderableObject> m_renderable_objects;
 
-		/** Depth prepass command buffer. */
-		vk::CommandBuffer m_vk_depth_prepass_command_buffer;
+		/** World space bounds of each renderable object. */
+		AABBList m_object_bounds;
 
-		/** Rendering command buffer. */
-		vk::CommandBuffer m_vk_rendering_command_buffer;
+		/** Indices of renderable objects visible to the main camera. */
+		std::vector<uint32_t> m_visible_objects;
 
-		/** Main camera data. */
-		CameraData m_main_camera;
+		/** Indices of visible objects found by each worker thread. */
+		std::vector<std::vector<uint32_t>> m_worker_visible_objects;
 
-		/** List of renderable objects. */
-		std::vector<RenderableObject> m_renderable_objects;
+		/** Software depth buffer occluders are rasterized into. */
+		OcclusionBuffer m_occlusion_buffer;
+
+		/** Batches of visible objects to draw this frame. */
+		std::vector<RenderBatch> m_render_batches;
+
+		/** Dense indices of the draw state used this frame. */
+		DrawStateIndices m_draw_state;
+
+		/** Sort keys of visible objects. */
+		std::vector<uint64_t> m_draw_keys;
+
+		/** Indices of visible objects. Sorted alongside the keys. */
+		std::vector<uint32_t> m_draw_indices;
+
+		/** Statistics of the frame being rendered. */
+		FrameStatistics m_frame_statistics;
+
+		/** Statistics of recently rendered frames. */
+		FrameStatisticsHistory m_statistics_history;
+
+		/** What each batch command buffer recorded. Filled by record_render_batches(). */
+		std::vector<RecordStatistics> m_record_statistics;
+
+		/** Time the frame being rendered began. */
+		std::chrono::high_resolution_clock::time_point m_frame_start_time;
+
+		/** Bytes the upload manager had staged when the last frame began. */
+		uint64_t m_staged_bytes = 0;
+
+		/**
+		 * @brief Resources owned by a single frame in flight.
+		 * @note None of these may be touched until the frame's fence is signaled.
+		 */
+		struct FrameData
+		{
+			/** Signaled when the GPU finishes the frame. */
+			vk::Fence fence = {};
+
+			/** Depth prepass command buffer. */
+			vk::CommandBuffer depth_prepass_command_buffer = {};
+
+			/** Rendering command buffer. */
+			vk::CommandBuffer rendering_command_buffer = {};
+
+			/** Depth prepass batch command buffers. One per worker thread. */
+			std::vector<VkManagedCommandBuffer> depth_prepass_batches = {};
+
+			/** Color pass batch command buffers. One per worker thread. */
+			std::vector<VkManagedCommandBuffer> color_batches = {};
+
+			/** Sky box depth prepass command buffer. */
+			VkManagedCommandBuffer sky_box_depth_prepass = {};
+
+			/** Sky box color pass command buffer. */
+			VkManagedCommandBuffer sky_box_color = {};
+
+			/** Semaphore to indicate depth prepass has finished. */
+			vk::Semaphore depth_prepass_finished = {};
+
+			/** Semaphore to indicate color rendering has finished. */
+			vk::Semaphore color_rendering_finished = {};
+
+			/** Renderer descriptor set. Points at this frame's lighting and instance buffers. */
+			vk::DescriptorSet descriptor_set = {};
+
+			/** Resources to free once the frame's fence is signaled. */
+			std::vector<std::function<void()>> deletions = {};
+
+			/**
+			 * @brief Per instance data buffer.
+			 * @note The first instance is reserved for the sky box.
+			 */
+			struct
+			{
+				/** Storage buffer. */
+				VkMemBuffer buffer = {};
+
+				/** Buffer mapping. */
+				VertexShaderData* map = nullptr;
+
+				/** Number of instances the buffer can hold. */
+				size_t capacity = 0;
+
+			} instances;
+		};
+
+		/** Resources for each frame in flight. */
+		std::vector<FrameData> m_frames;
+
+		/** Index of the frame being recorded. */
+		size_t m_frame = 0;
+
+		/** Lock for deferred deletions, since resources are destroyed outside the rendering thread. */
+		std::mutex m_deletion_mutex;
+
+		/** Per frame ring buffer for per instance uniform data. */
+		UniformRingBuffer m_uniform_ring;
 
 		/**
 		 * @brief Depth prepass image.
@@ -306,19 +513,6 @@ namespace dk
 
 		} m_render_passes;
 
-		/**
-		 * @brief Semaphores.
-		 */
-		struct
-		{
-			/** Semaphore to indicate depth prepass has finished. */
-			vk::Semaphore depth_prepass_finished;
-
-			/** Semaphore to indicate color rendering has finished. */
-			vk::Semaphore color_rendering_finished;
-			
-		} m_semaphores;
-
 		/**
 		 * @brief ForwardRenderer descriptor.
 		 */
@@ -330,18 +524,11 @@ namespace dk
 			/** Descriptor pool. */
 			vk::DescriptorPool pool = {};
 
-			/** Descriptor set. */
-			vk::DescriptorSet set = {};
-
 		} m_descriptor;
 	};
 
 	/**
 	 * Forward+ renderer.
-	 * @note When drawing objects with this renderer, 
-	 *       the first command buffer will be used for
-	 *       renering, and the second will be used for
-	 *       a depth prepass.
 	 */
 	class ForwardRenderer : public ForwardRendererBase
 	{
@@ -357,8 +544,15 @@ namespace dk
 		 * @param Graphics context.
 		 * @param Texture allocator.
 		 * @param Mesh allocator.
+		 * @param Maximum number of frames the CPU can record ahead of the GPU.
 		 */
-		ForwardRenderer(Graphics* graphics, ResourceAllocator<Texture>* texture_allocator, ResourceAllocator<Mesh>* mesh_allocator);
+		ForwardRenderer
+		(
+			Graphics* graphics, 
+			ResourceAllocator<Texture>* texture_allocator, 
+			ResourceAllocator<Mesh>* mesh_allocator,
+			size_t frames_in_flight = 2
+		);
 
 		/**
 		 * @brief Destructor.
@@ -424,18 +618,14 @@ namespace dk
 		/** Framebuffers. */
 		std::vector<vk::Framebuffer> m_vk_framebuffers;
 
-		/** Semaphore to indicate an image is available for rendering too. */
-		vk::Semaphore m_vk_image_available;
+		/** Semaphores to indicate an image is available for rendering too. One per frame in flight. */
+		std::vector<vk::Semaphore> m_vk_image_available;
 	};
 
 
 
 	/**
 	 * Off screen Forward+ renderer.
-	 * @note When drawing objects with this renderer, 
-	 *       the first command buffer will be used for
-	 *       renering, and the second will be used for
-	 *       a depth prepass.
 	 */
 	class OffScreenForwardRenderer : public ForwardRendererBase
 	{
@@ -453,6 +643,7 @@ namespace dk
 		 * @param Height.
 		 * @param Texture allocator.
 		 * @param Mesh allocator.
+		 * @param Maximum number of frames the CPU can record ahead of the GPU.
 		 */
 		OffScreenForwardRenderer
 		(
@@ -460,7 +651,8 @@ namespace dk
 			int width, 
 			int height, 
 			ResourceAllocator<Texture>* texture_allocator, 
-			ResourceAllocator<Mesh>* mesh_allocator
+			ResourceAllocator<Mesh>* mesh_allocator,
+			size_t frames_in_flight = 2
 		);
 
 		/**
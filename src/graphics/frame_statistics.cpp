@@ -0,0 +1,107 @@
+/**
+ * @file frame_statistics.cpp
+ * @brief Per frame renderer statistics source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <sstream>
+#include <algorithm>
+#include <utilities\debugging.hpp>
+#include <utilities\file_io.hpp>
+#include "frame_statistics.hpp"
+
+namespace dk
+{
+	const size_t FrameStatisticsHistory::default_capacity;
+
+	FrameStatisticsHistory::FrameStatisticsHistory(size_t capacity) : m_frames(std::max<size_t>(capacity, 1)) {}
+
+	void FrameStatisticsHistory::push(const FrameStatistics& frame)
+	{
+		m_frames[m_next] = frame;
+		m_next = (m_next + 1) % m_frames.size();
+		m_count = std::min(m_count + 1, m_frames.size());
+	}
+
+	void FrameStatisticsHistory::clear()
+	{
+		m_next = 0;
+		m_count = 0;
+	}
+
+	void FrameStatisticsHistory::set_capacity(size_t capacity)
+	{
+		capacity = std::max<size_t>(capacity, 1);
+
+		// Copy out the newest frames, oldest first
+		const size_t count = std::min(m_count, capacity);
+		std::vector<FrameStatistics> frames(capacity);
+		for (size_t i = 0; i < count; ++i)
+			frames[i] = (*this)[m_count - count + i];
+
+		m_frames = std::move(frames);
+		m_next = count % capacity;
+		m_count = count;
+	}
+
+	const FrameStatistics& FrameStatisticsHistory::operator[](size_t index) const
+	{
+		dk_assert(index < m_count);
+		return m_frames[(m_next + m_frames.size() - m_count + index) % m_frames.size()];
+	}
+
+	std::string FrameStatisticsHistory::to_csv() const
+	{
+		size_t worker_count = 0;
+		for (size_t i = 0; i < m_count; ++i)
+			worker_count = std::max(worker_count, (*this)[i].worker_record_times.size());
+
+		std::ostringstream csv;
+		csv << "frame,cpu_time_ms,submitted_objects,frustum_culled_objects,occlusion_culled_objects,"
+			<< "drawn_objects,batches,draw_calls,triangles,pipeline_binds,descriptor_binds,"
+			<< "secondary_command_buffers,upload_bytes";
+
+		for (size_t i = 0; i < worker_count; ++i)
+			csv << ",worker_" << i << "_record_ms";
+
+		csv << '\n';
+
+		for (size_t i = 0; i < m_count; ++i)
+		{
+			const auto& frame = (*this)[i];
+
+			csv << frame.frame << ','
+				<< frame.cpu_time << ','
+				<< frame.submitted_objects << ','
+				<< frame.frustum_culled_objects << ','
+				<< frame.occlusion_culled_objects << ','
+				<< frame.drawn_objects << ','
+				<< frame.batches << ','
+				<< frame.draw_calls << ','
+				<< frame.triangles << ','
+				<< frame.pipeline_binds << ','
+				<< frame.descriptor_binds << ','
+				<< frame.secondary_command_buffers << ','
+				<< frame.upload_bytes;
+
+			// Workers the frame didn't have are left empty
+			for (size_t j = 0; j < worker_count; ++j)
+			{
+				csv << ',';
+				if (j < frame.worker_record_times.size())
+					csv << frame.worker_record_times[j];
+			}
+
+			csv << '\n';
+		}
+
+		return csv.str();
+	}
+
+	bool FrameStatisticsHistory::write_csv(const std::string& path) const
+	{
+		const std::string csv = to_csv();
+		return write_binary_file(path, csv.data(), csv.size());
+	}
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+/**
+ * @file frame_statistics.hpp
+ * @brief Per frame renderer statistics header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace dk
+{
+	/**
+	 * @brief What a renderer did during a single frame.
+	 * @note Draw, bind, and triangle counts cover both the depth prepass and the color pass.
+	 */
+	struct FrameStatistics
+	{
+		/** Frame number. */
+		uint64_t frame = 0;
+
+		/** CPU time spent rendering the frame in milliseconds. Includes waiting on the GPU. */
+		float cpu_time = 0.0f;
+
+		/** Number of renderable objects submitted. */
+		size_t submitted_objects = 0;
+
+		/** Number of renderable objects outside the main cameras frustum. */
+		size_t frustum_culled_objects = 0;
+
+		/** Number of renderable objects hidden behind occluders. */
+		size_t occlusion_culled_objects = 0;
+
+		/** Number of renderable objects drawn. */
+		size_t drawn_objects = 0;
+
+		/** Number of render batches. */
+		size_t batches = 0;
+
+		/** Number of draw calls. */
+		size_t draw_calls = 0;
+
+		/** Number of triangles drawn. */
+		uint64_t triangles = 0;
+
+		/** Number of pipeline binds. */
+		size_t pipeline_binds = 0;
+
+		/** Number of descriptor set bind calls. */
+		size_t descriptor_binds = 0;
+
+		/** Number of secondary command buffers recorded. */
+		size_t secondary_command_buffers = 0;
+
+		/** Bytes staged by the upload manager since the last frame. */
+		uint64_t upload_bytes = 0;
+
+		/** Time each worker thread spent recording command buffers in milliseconds. */
+		std::vector<float> worker_record_times = {};
+	};
+
+
+
+	/**
+	 * @brief The most recent frames statistics.
+	 * @note Once full, every new frame replaces the oldest one.
+	 */
+	class FrameStatisticsHistory
+	{
+	public:
+
+		/** Default number of frames kept. */
+		static const size_t default_capacity = 600;
+
+		/**
+		 * @brief Constructor.
+		 * @param Number of frames kept.
+		 */
+		FrameStatisticsHistory(size_t capacity = default_capacity);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~FrameStatisticsHistory() = default;
+
+		/**
+		 * @brief Add a frame.
+		 * @param Frame statistics.
+		 */
+		void push(const FrameStatistics& frame);
+
+		/**
+		 * @brief Remove every frame.
+		 */
+		void clear();
+
+		/**
+		 * @brief Change the number of frames kept.
+		 * @param Number of frames kept.
+		 * @note The newest frames are kept if the history shrinks.
+		 */
+		void set_capacity(size_t capacity);
+
+		/**
+		 * @brief Get the number of frames kept.
+		 * @return Number of frames kept.
+		 */
+		size_t get_capacity() const
+		{
+			return m_frames.size();
+		}
+
+		/**
+		 * @brief Get the number of frames in the history.
+		 * @return Number of frames.
+		 */
+		size_t size() const
+		{
+			return m_count;
+		}
+
+		/**
+		 * @brief Get a frame.
+		 * @param Index. Zero is the oldest frame.
+		 * @return Frame statistics.
+		 */
+		const FrameStatistics& operator[](size_t index) const;
+
+		/**
+		 * @brief Get the newest frame.
+		 * @return Frame statistics.
+		 * @note The history must not be empty.
+		 */
+		const FrameStatistics& get_latest() const
+		{
+			return (*this)[m_count - 1];
+		}
+
+		/**
+		 * @brief Format the history as CSV, oldest frame first.
+		 * @return CSV text. The first line names the columns.
+		 * @note There is a worker time column for every worker seen in the history.
+		 */
+		std::string to_csv() const;
+
+		/**
+		 * @brief Write the history to a CSV file, replacing it if it exists.
+		 * @param Path to the file.
+		 * @return If the file could be written.
+		 */
+		bool write_csv(const std::string& path) const;
+
+	private:
+
+		/** Ring of frames. */
+		std::vector<FrameStatistics> m_frames = {};
+
+		/** Index the next frame is written to. */
+		size_t m_next = 0;
+
+		/** Number of frames in the history. */
+		size_t m_count = 0;
+	};
+}
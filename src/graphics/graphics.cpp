@@ -5,6 +5,7 @@
  */
 
 /** Includes. */
+#include <limits>
 #include <engine/config.hpp>
 #include "graphics.hpp"
 
@@ -118,16 +119,50 @@ namespace dk
 
 		// Create command manager
 		m_command_manager = std::make_unique<VkCommandManager>(get_logical_device(), m_device_manager->get_queue_family_indices(), thread_count);
+
+		// Create memory manager
+		m_memory_manager = std::make_unique<VkMemoryManager>(get_physical_device(), get_logical_device());
+
+		// Create upload manager
+		m_upload_manager = std::make_unique<VkUploadManager>(*this);
+
+		// Load shader cache
+		m_shader_cache = std::make_unique<VkShaderCache>(get_physical_device(), get_logical_device(), DK_SHADER_CACHE_PREFIX);
+	}
+
+	Graphics::Graphics(int width, int height) :
+		m_headless(true),
+		m_width(width),
+		m_height(height),
+		m_name("headless")
+	{
+		// Bounds checking
+		dk_assert(width > 0);
+		dk_assert(height > 0);
 	}
 
 	void Graphics::shutdown()
 	{
+		// Nothing was created
+		if (m_headless)
+			return;
+
 		// Wait for logical device to finish whatever it was doing
 		m_device_manager->get_logical_deivce().waitIdle();
 
+		// Save and destroy shader cache
+		m_shader_cache->save();
+		m_shader_cache.reset();
+
+		// Destroy upload manager
+		m_upload_manager.reset();
+
 		// Destroy command manager
 		m_command_manager.reset();
 
+		// Destroy memory manager
+		m_memory_manager.reset();
+
 		// Destroy device manager
 		m_device_manager.reset();
 
@@ -146,7 +181,13 @@ namespace dk
 		SDL_DestroyWindow(m_window);
 	}
 
-	VkMemBuffer Graphics::create_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties)
+	VkMemBuffer Graphics::create_buffer
+	(
+		vk::DeviceSize size, 
+		vk::BufferUsageFlags usage, 
+		vk::MemoryPropertyFlags properties,
+		AllocationStrategy strategy
+	)
 	{
 		VkMemBuffer buffer = {};
 		
@@ -170,16 +211,11 @@ namespace dk
 
 		// Allocate memory
 		vk::MemoryRequirements mem_requirements = get_logical_device().getBufferMemoryRequirements(buffer.buffer);
-
-		vk::MemoryAllocateInfo alloc_info = {};
-		alloc_info.allocationSize = mem_requirements.size;
-		alloc_info.memoryTypeIndex = find_memory_type(get_physical_device(), mem_requirements.memoryTypeBits, properties);
-
-		buffer.memory = get_logical_device().allocateMemory(alloc_info);
-		dk_assert(buffer.memory);
+		buffer.memory = m_memory_manager->allocate(mem_requirements, properties, true, strategy);
+		dk_assert(buffer.memory.memory);
 		
 		// Bind buffer to memory
-		get_logical_device().bindBufferMemory(buffer.buffer, buffer.memory, 0);
+		get_logical_device().bindBufferMemory(buffer.buffer, buffer.memory.memory, buffer.memory.offset);
 		return buffer;
 	}
 
@@ -213,8 +249,11 @@ namespace dk
 		submit_info.commandBufferCount = 1;
 		submit_info.pCommandBuffers = &command_buffer;
 
-		m_device_manager->get_transfer_queue().submit(submit_info, vk::Fence());
-		m_device_manager->get_transfer_queue().waitIdle();
+		// Wait on a fence so unrelated work on the queue isn't waited on too
+		vk::Fence fence = get_logical_device().createFence({});
+		m_device_manager->get_transfer_queue().submit(submit_info, fence);
+		get_logical_device().waitForFences(1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		get_logical_device().destroyFence(fence);
 
 		// Free command buffer
 		get_logical_device().freeCommandBuffers(m_command_manager->get_transfer_pool(), command_buffer);
@@ -229,7 +268,7 @@ namespace dk
 		vk::ImageUsageFlags usage,
 		vk::MemoryPropertyFlags properties,
 		vk::Image& image,
-		vk::DeviceMemory& image_memory,
+		VkMemAllocation& image_memory,
 		vk::ImageCreateFlags flags,
 		uint32_t array_layers,
 		uint32_t mip_levels
@@ -254,19 +293,12 @@ namespace dk
 			dk_assert(check == vk::Result::eSuccess);
 		}
 
-		vk::MemoryRequirements mem_requirements = get_logical_device().getImageMemoryRequirements(image);
-
-		vk::MemoryAllocateInfo alloc_info = {};
-		alloc_info.setAllocationSize(mem_requirements.size);
-		alloc_info.setMemoryTypeIndex(find_memory_type(get_physical_device(), mem_requirements.memoryTypeBits, properties));
-
 		// Allocate memory
-		{
-			auto check = get_logical_device().allocateMemory(&alloc_info, nullptr, &image_memory);
-			dk_assert(check == vk::Result::eSuccess);
-		}
+		vk::MemoryRequirements mem_requirements = get_logical_device().getImageMemoryRequirements(image);
+		image_memory = m_memory_manager->allocate(mem_requirements, properties, tiling == vk::ImageTiling::eLinear);
+		dk_assert(image_memory.memory);
 
-		get_logical_device().bindImageMemory(image, image_memory, 0);
+		get_logical_device().bindImageMemory(image, image_memory.memory, image_memory.offset);
 	}
 
 	void Graphics::transition_image_layout
@@ -436,8 +468,11 @@ namespace dk
 		submitInfo.setCommandBufferCount(1);
 		submitInfo.setPCommandBuffers(&command_buffer);
 
-		m_device_manager->get_graphics_queue().submit(1, &submitInfo, { nullptr });
-		m_device_manager->get_graphics_queue().waitIdle();
+		// Wait on a fence so in flight frames aren't waited on too
+		vk::Fence fence = get_logical_device().createFence({});
+		m_device_manager->get_graphics_queue().submit(1, &submitInfo, fence);
+		get_logical_device().waitForFences(1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		get_logical_device().destroyFence(fence);
 
 		get_logical_device().freeCommandBuffers(m_command_manager->get_single_use_pool(), 1, &command_buffer);
 	}
@@ -478,15 +513,10 @@ namespace dk
 		// Create image
 		new_attachment.image = get_logical_device().createImage(image);
 
-		vk::MemoryAllocateInfo mem_alloc = {};
-		vk::MemoryRequirements mem_reqs = get_logical_device().getImageMemoryRequirements(new_attachment.image);
-
-		mem_alloc.allocationSize = mem_reqs.size;
-		mem_alloc.memoryTypeIndex = find_memory_type(get_physical_device(), mem_reqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
-
 		// Allocate and bind image memory
-		new_attachment.memory = get_logical_device().allocateMemory(mem_alloc);
-		get_logical_device().bindImageMemory(new_attachment.image, new_attachment.memory, 0);
+		vk::MemoryRequirements mem_reqs = get_logical_device().getImageMemoryRequirements(new_attachment.image);
+		new_attachment.memory = m_memory_manager->allocate(mem_reqs, vk::MemoryPropertyFlagBits::eDeviceLocal, false);
+		get_logical_device().bindImageMemory(new_attachment.image, new_attachment.memory.memory, new_attachment.memory.offset);
 
 		new_attachment.view = create_image_view(new_attachment.image, format, aspect_mask);
 
@@ -497,92 +527,7 @@ namespace dk
 	{
 		vk::CommandBuffer command_buffer = begin_single_time_commands();
 
-		vk::ImageMemoryBarrier barrier = {};
-		barrier.image = image;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-		barrier.subresourceRange.levelCount = 1;
-
-		int32_t mip_width = tex_width;
-		int32_t mip_height = tex_height;
-
-		for (uint32_t i = 1; i < mip_levels; ++i) 
-		{
-			barrier.subresourceRange.baseMipLevel = i - 1;
-			barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-			barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
-			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-			barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
-
-			command_buffer.pipelineBarrier
-			(
-				vk::PipelineStageFlagBits::eTransfer,
-				vk::PipelineStageFlagBits::eTransfer, 
-				static_cast<vk::DependencyFlagBits>(0),
-				0, nullptr,
-				0, nullptr,
-				1, &barrier
-			);
-
-			vk::ImageBlit blit = {};
-			blit.srcOffsets[0] = { 0, 0, 0 };
-			blit.srcOffsets[1] = { mip_width, mip_height, 1 };
-			blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-			blit.srcSubresource.mipLevel = i - 1;
-			blit.srcSubresource.baseArrayLayer = 0;
-			blit.srcSubresource.layerCount = 1;
-			blit.dstOffsets[0] = { 0, 0, 0 };
-			blit.dstOffsets[1] = { mip_width / 2, mip_height / 2, 1 };
-			blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-			blit.dstSubresource.mipLevel = i;
-			blit.dstSubresource.baseArrayLayer = 0;
-			blit.dstSubresource.layerCount = 1;
-
-			command_buffer.blitImage
-			(
-				image, vk::ImageLayout::eTransferSrcOptimal,
-				image, vk::ImageLayout::eTransferDstOptimal,
-				1, &blit,
-				vk::Filter::eLinear
-			);
-
-			barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
-			barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-			barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
-			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-			command_buffer.pipelineBarrier
-			(
-				vk::PipelineStageFlagBits::eTransfer,
-				vk::PipelineStageFlagBits::eFragmentShader,
-				static_cast<vk::DependencyFlagBits>(0),
-				0, nullptr,
-				0, nullptr,
-				1, &barrier
-			);
-
-			if (mip_width > 1) mip_width /= 2;
-			if (mip_height > 1) mip_height /= 2;
-		}
-
-		barrier.subresourceRange.baseMipLevel = mip_levels - 1;
-		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-		barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-		command_buffer.pipelineBarrier
-		(
-			vk::PipelineStageFlagBits::eTransfer,
-			vk::PipelineStageFlagBits::eFragmentShader,
-			static_cast<vk::DependencyFlagBits>(0),
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-		);
+		record_mipmaps(command_buffer, image, tex_width, tex_height, mip_levels);
 
 		end_single_time_commands(command_buffer);
 	}
@@ -13,6 +13,9 @@
 #include "vulkan_utilities.hpp"
 #include "device_manager.hpp"
 #include "command_manager.hpp"
+#include "memory_manager.hpp"
+#include "upload_manager.hpp"
+#include "shader_cache.hpp"
 #include "debugging.hpp"
 
 namespace dk
@@ -39,6 +42,14 @@ namespace dk
 		 */
 		Graphics(size_t thread_count, const std::string& name, int width, int height, uint32_t flags = 0);
 
+		/**
+		 * @brief Headless constructor.
+		 * @param Width of the imaginary window.
+		 * @param Height of the imaginary window.
+		 * @note No window or Vulkan objects are created. Only usable with the null renderer.
+		 */
+		Graphics(int width, int height);
+
 		/**
 		 * @brief Destructor.
 		 */
@@ -49,6 +60,15 @@ namespace dk
 		 */
 		void shutdown();
 
+		/**
+		 * @brief Check if the graphics context was created without a window or GPU.
+		 * @return If the context is headless.
+		 */
+		bool is_headless() const
+		{
+			return m_headless;
+		}
+
 		/**
 		 * @brief Get the SDL window.
 		 * @return The SDL window.
@@ -85,6 +105,33 @@ namespace dk
 			return *m_command_manager.get();
 		}
 
+		/**
+		 * @brief Get the memory manager.
+		 * @return The memory manager.
+		 */
+		VkMemoryManager& get_memory_manager()
+		{
+			return *m_memory_manager.get();
+		}
+
+		/**
+		 * @brief Get the upload manager.
+		 * @return The upload manager.
+		 */
+		VkUploadManager& get_upload_manager()
+		{
+			return *m_upload_manager.get();
+		}
+
+		/**
+		 * @brief Get the shader cache.
+		 * @return The shader cache.
+		 */
+		VkShaderCache& get_shader_cache()
+		{
+			return *m_shader_cache.get();
+		}
+
 		/**
 		 * @brief Get physical device.
 		 * @return Physical device.
@@ -127,6 +174,9 @@ namespace dk
 		 */
 		int get_width() const
 		{
+			if (m_headless)
+				return m_width;
+
 			int w, h;
 			SDL_GetWindowSize(m_window, &w, &h);
 			return w;
@@ -138,6 +188,9 @@ namespace dk
 		 */
 		int get_height() const
 		{
+			if (m_headless)
+				return m_height;
+
 			int w, h;
 			SDL_GetWindowSize(m_window, &w, &h);
 			return h;
@@ -148,11 +201,20 @@ namespace dk
 		 * @param Size of data.
 		 * @param Usage.
 		 * @param Memory properties
+		 * @param Allocation strategy. Use linear for short lived buffers like staging buffers.
+		 * @note Host visible buffers are persistently mapped. Use the memory's mapped pointer.
 		 */
-		VkMemBuffer create_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+		VkMemBuffer create_buffer
+		(
+			vk::DeviceSize size, 
+			vk::BufferUsageFlags usage, 
+			vk::MemoryPropertyFlags properties,
+			AllocationStrategy strategy = AllocationStrategy::Buddy
+		);
 
 		/**
 		 * @brief Copy memory contained in one buffer into another.
+		 * @note Blocks until the copy finishes. Prefer the upload manager for uploads.
 		 * @param Source buffer.
 		 * @param Destination buffer.
 		 * @param Size of data.
@@ -181,7 +243,7 @@ namespace dk
 			vk::ImageUsageFlags usage,
 			vk::MemoryPropertyFlags properties,
 			vk::Image& image,
-			vk::DeviceMemory& image_memory,
+			VkMemAllocation& image_memory,
 			vk::ImageCreateFlags flags = static_cast<vk::ImageCreateFlagBits>(0),
 			uint32_t array_layers = 1,
 			uint32_t mip_levels = 1
@@ -288,7 +350,16 @@ namespace dk
 
 
 		/** SDL window. */
-		SDL_Window* m_window;
+		SDL_Window* m_window = nullptr;
+
+		/** Was the context created without a window or GPU? */
+		bool m_headless = false;
+
+		/** Width of the imaginary window when headless. */
+		int m_width = 0;
+
+		/** Height of the imaginary window when headless. */
+		int m_height = 0;
 
 		/** Window name. */
 		std::string m_name;
@@ -307,5 +378,14 @@ namespace dk
 
 		/** Command manager. */
 		std::unique_ptr<VkCommandManager> m_command_manager;
+
+		/** Device memory manager. */
+		std::unique_ptr<VkMemoryManager> m_memory_manager;
+
+		/** Upload manager. */
+		std::unique_ptr<VkUploadManager> m_upload_manager;
+
+		/** Pipeline and shader reflection cache. */
+		std::unique_ptr<VkShaderCache> m_shader_cache;
 	};
 }
\ No newline at end of file
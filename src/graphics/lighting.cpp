@@ -5,119 +5,273 @@
  */
 
 /** Includes. */
+#include <cstring>
+#include <algorithm>
 #include "lighting.hpp"
 
 namespace dk
 {
-	LightingManager::LightingManager(Graphics* graphics, size_t point_light_count, size_t dir_light_count) :
+	/**
+	 * @brief Find the capacity a buffer should grow to.
+	 * @param Current capacity.
+	 * @param Number of elements it must hold.
+	 * @return New capacity.
+	 */
+	static size_t grow_capacity(size_t capacity, size_t count)
+	{
+		capacity = capacity > 0 ? capacity : 1;
+		while (capacity < count)
+			capacity *= 2;
+
+		return capacity;
+	}
+
+	/**
+	 * @brief Write a light count and the live range of a light list to a mapped buffer.
+	 * @param Buffer mapping.
+	 * @param Lights.
+	 */
+	template<typename T>
+	static void write_lights(void* map, const std::vector<T>& lights)
+	{
+		// The count is padded to 16 bytes to match std430 array alignment
+		const uint32_t count = static_cast<uint32_t>(lights.size());
+		std::memcpy(map, &count, sizeof(uint32_t));
+
+		if (count > 0)
+			std::memcpy(static_cast<char*>(map) + 16, lights.data(), sizeof(T) * lights.size());
+	}
+
+
+	LightingManager::LightingManager(Graphics* graphics, size_t point_light_count, size_t dir_light_count, size_t frame_count) :
 		m_graphics(graphics)
 	{
-		// Resize light vectors
-		m_point_lights.resize(point_light_count);
+		// Reserve light vectors
+		m_point_lights.reserve(point_light_count);
+		m_visible_point_lights.reserve(point_light_count);
 		m_directional_lights.reserve(dir_light_count);
+		m_camera.frustum = Frustum(m_camera.projection * m_camera.view);
 
-		// Create lighting buffer
-		m_lighting_ubo = m_graphics->create_buffer
-		(
-			sizeof(m_lighting_data),
-			vk::BufferUsageFlagBits::eUniformBuffer,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-		);
-		m_lighting_map = m_graphics->get_logical_device().mapMemory(m_lighting_ubo.memory, 0, sizeof(m_lighting_data));
+		// Every frame in flight gets its own buffers
+		m_frames.resize(frame_count > 0 ? frame_count : 1);
 
-		// Create SSBOs
-		create_point_light_ssbo();
-		create_directional_ssbo();
+		for (auto& frame : m_frames)
+		{
+			// Create lighting buffer
+			frame.lighting_ubo = m_graphics->create_buffer
+			(
+				sizeof(m_lighting_data),
+				vk::BufferUsageFlagBits::eUniformBuffer,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+			);
+			frame.lighting_map = frame.lighting_ubo.memory.mapped;
+
+			// Create SSBOs
+			create_point_light_ssbo(frame, point_light_count);
+			create_directional_ssbo(frame, dir_light_count);
+			create_cluster_ssbo(frame, LightClusterGrid::cluster_count);
+		}
 	}
 
 	LightingManager::~LightingManager()
 	{
 		// Cleanup
-		destroy_point_light_ssbo();
-		destroy_directional_light_ssbo();
-		m_graphics->get_logical_device().unmapMemory(m_lighting_ubo.memory);
-		m_lighting_ubo.free(m_graphics->get_logical_device());
+		for (auto& frame : m_frames)
+		{
+			destroy_point_light_ssbo(frame);
+			destroy_directional_light_ssbo(frame);
+			frame.cluster_ssbo.free(m_graphics->get_logical_device());
+			frame.lighting_ubo.free(m_graphics->get_logical_device());
+		}
 	}
 
-	void LightingManager::upload()
+	void LightingManager::upload(size_t frame_index, ThreadPool* thread_pool)
 	{
+		auto& frame = m_frames[frame_index];
+
+		// Only lights that can be seen are sent to the GPU
+		cull_point_lights();
+
+		// Assign point lights to clusters
+		m_cluster_grid.build
+		(
+			m_camera.view,
+			m_camera.projection,
+			m_camera.near_plane,
+			m_camera.far_plane,
+			m_visible_point_lights.size() > 0 ? &m_visible_point_lights[0].position.x : nullptr,
+			sizeof(PointLightData),
+			m_visible_point_lights.size(),
+			thread_pool
+		);
+
+		m_lighting_data.cluster_params.z = m_cluster_grid.get_slice_scale();
+		m_lighting_data.cluster_params.w = m_cluster_grid.get_slice_bias();
+
+		// Grow the frame's buffers geometrically if they can't hold this frame's lights
+		if (frame.point_light_capacity < m_visible_point_lights.size())
+		{
+			const size_t capacity = grow_capacity(frame.point_light_capacity, m_visible_point_lights.size());
+			destroy_point_light_ssbo(frame);
+			create_point_light_ssbo(frame, capacity);
+		}
+
+		if (frame.directional_light_capacity < m_directional_lights.size())
+		{
+			const size_t capacity = grow_capacity(frame.directional_light_capacity, m_directional_lights.size());
+			destroy_directional_light_ssbo(frame);
+			create_directional_ssbo(frame, capacity);
+		}
+
+		const auto& light_indices = m_cluster_grid.get_light_indices();
+		if (frame.cluster_index_capacity < light_indices.size())
+		{
+			const size_t capacity = grow_capacity(frame.cluster_index_capacity, light_indices.size());
+			frame.cluster_ssbo.free(m_graphics->get_logical_device());
+			create_cluster_ssbo(frame, capacity);
+		}
+
 		// Upload lighting data
-		std::memcpy(m_lighting_map, &m_lighting_data, sizeof(m_lighting_data));
+		std::memcpy(frame.lighting_map, &m_lighting_data, sizeof(m_lighting_data));
 
-		// Upload point light data
-		std::memcpy(m_point_light_map, &m_point_light_count, sizeof(uint32_t));
-		std::memcpy((void*)((int*)m_point_light_map + sizeof(uint32_t)), m_point_lights.data(), sizeof(PointLightData) * m_point_lights.size());
+		// Upload light clusters
+		const size_t clusters_size = sizeof(LightClusterGrid::Cluster) * LightClusterGrid::cluster_count;
+		char* cluster_map = static_cast<char*>(frame.cluster_ssbo.memory.mapped);
+		std::memcpy(cluster_map, m_cluster_grid.get_clusters().data(), clusters_size);
+		std::memcpy(cluster_map + clusters_size, light_indices.data(), sizeof(uint32_t) * light_indices.size());
 
-		// Upload directional light data
-		std::memcpy(m_directional_light_map, &m_directional_light_count, sizeof(uint32_t));
-		std::memcpy((void*)((int*)m_directional_light_map + sizeof(uint32_t)), m_directional_lights.data(), sizeof(DirectionalLightData) * m_directional_lights.size());
+		// Upload point and directional light data
+		write_lights(frame.point_light_map, m_visible_point_lights);
+		write_lights(frame.directional_light_map, m_directional_lights);
 	}
 
 	void LightingManager::flush_queues()
 	{
-		m_point_light_count = 0;
-		m_directional_light_count = 0;
+		m_point_lights.clear();
+		m_directional_lights.clear();
 	}
 
-	void LightingManager::draw(PointLightData data)
+	void LightingManager::cull_point_lights()
 	{
-		if (m_point_light_count + 1 > m_point_lights.size())
+		m_visible_point_lights.clear();
+		m_point_light_order.clear();
+
+		// Frustum culling
+		for (size_t i = 0; i < m_point_lights.size(); ++i)
 		{
-			destroy_point_light_ssbo();
-			m_point_lights.resize(m_point_lights.size() + 32);
-			create_point_light_ssbo();
+			const glm::vec4& position = m_point_lights[i].position;
+			if (m_camera.frustum.check_inside(glm::vec3(position), position.w))
+				m_point_light_order.push_back(static_cast<uint32_t>(i));
 		}
 
-		m_point_lights[m_point_light_count++] = data;
+		// Keep the lights with the largest screen contribution if there are too many
+		if (m_point_light_budget > 0 && m_point_light_order.size() > m_point_light_budget)
+		{
+			const glm::vec3 camera_position = glm::vec3(m_lighting_data.camera_position);
+			m_point_light_scores.resize(m_point_lights.size());
+
+			for (const uint32_t i : m_point_light_order)
+			{
+				// Squared projected radius times brightness. Lights around the camera cover the whole screen.
+				const auto& light = m_point_lights[i];
+				const float distance = std::max(glm::length(glm::vec3(light.position) - camera_position), light.position.w);
+				const float coverage = distance > 0.0f ? light.position.w / distance : 1.0f;
+				const float brightness = std::max(std::max(light.color.r, light.color.g), light.color.b) * light.color.a;
+				m_point_light_scores[i] = coverage * coverage * brightness;
+			}
+
+			std::nth_element
+			(
+				m_point_light_order.begin(),
+				m_point_light_order.begin() + m_point_light_budget,
+				m_point_light_order.end(),
+				[this](uint32_t a, uint32_t b) { return m_point_light_scores[a] > m_point_light_scores[b]; }
+			);
+
+			// Restore submission order so light indices don't shuffle between frames
+			m_point_light_order.resize(m_point_light_budget);
+			std::sort(m_point_light_order.begin(), m_point_light_order.end());
+		}
+
+		for (const uint32_t i : m_point_light_order)
+			m_visible_point_lights.push_back(m_point_lights[i]);
 	}
 
-	void LightingManager::draw(DirectionalLightData data)
+	void LightingManager::set_camera(const glm::mat4& view, const glm::mat4& projection, float near_plane, float far_plane)
 	{
-		if (m_directional_light_count + 1 > m_directional_lights.size())
-		{
-			destroy_directional_light_ssbo();
-			m_directional_lights.resize(m_directional_lights.size() + 8);
-			create_directional_ssbo();
-		}
+		m_camera.view = view;
+		m_camera.projection = projection;
+		m_camera.near_plane = near_plane;
+		m_camera.far_plane = far_plane;
 
-		m_directional_lights[m_directional_light_count++] = data;
+		// View depth is the negated view space Z
+		m_lighting_data.view_depth = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+		m_camera.frustum = Frustum(projection * view);
 	}
 
-	void LightingManager::create_point_light_ssbo()
+	void LightingManager::draw(PointLightData data)
 	{
-		size_t data_size = 16 + (sizeof(PointLightData) * m_point_lights.size());
+		// Lights that can't light anything are dropped. Buffers are resized when each frame is uploaded.
+		if (data.position.w > 0.0f && data.color.a > 0.0f)
+			m_point_lights.push_back(data);
+	}
 
-		m_point_light_ssbo = m_graphics->create_buffer
+	void LightingManager::draw(DirectionalLightData data)
+	{
+		// Directional lights reach everything, so only dark ones are dropped
+		if (data.color.a > 0.0f)
+			m_directional_lights.push_back(data);
+	}
+
+	void LightingManager::create_point_light_ssbo(FrameBuffers& frame, size_t capacity)
+	{
+		capacity = capacity > 0 ? capacity : 1;
+		size_t data_size = 16 + (sizeof(PointLightData) * capacity);
+
+		frame.point_light_ssbo = m_graphics->create_buffer
 		(
 			data_size,
 			vk::BufferUsageFlagBits::eStorageBuffer,
 			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
 		);
-		m_point_light_map = m_graphics->get_logical_device().mapMemory(m_point_light_ssbo.memory, 0, data_size);
+		frame.point_light_map = frame.point_light_ssbo.memory.mapped;
+		frame.point_light_capacity = capacity;
 	}
 
-	void LightingManager::create_directional_ssbo()
+	void LightingManager::create_directional_ssbo(FrameBuffers& frame, size_t capacity)
 	{
-		size_t data_size = 16 + (sizeof(DirectionalLightData) * m_directional_lights.size());
+		capacity = capacity > 0 ? capacity : 1;
+		size_t data_size = 16 + (sizeof(DirectionalLightData) * capacity);
 
-		m_directional_light_ssbo = m_graphics->create_buffer
+		frame.directional_light_ssbo = m_graphics->create_buffer
 		(
 			data_size,
 			vk::BufferUsageFlagBits::eStorageBuffer,
 			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
 		);
-		m_directional_light_map = m_graphics->get_logical_device().mapMemory(m_directional_light_ssbo.memory, 0, data_size);
+		frame.directional_light_map = frame.directional_light_ssbo.memory.mapped;
+		frame.directional_light_capacity = capacity;
+	}
+
+	void LightingManager::create_cluster_ssbo(FrameBuffers& frame, size_t index_count)
+	{
+		frame.cluster_index_capacity = index_count;
+
+		frame.cluster_ssbo = m_graphics->create_buffer
+		(
+			(sizeof(LightClusterGrid::Cluster) * LightClusterGrid::cluster_count) + (sizeof(uint32_t) * index_count),
+			vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		);
 	}
 
-	void LightingManager::destroy_point_light_ssbo()
+	void LightingManager::destroy_point_light_ssbo(FrameBuffers& frame)
 	{
-		m_graphics->get_logical_device().unmapMemory(m_point_light_ssbo.memory);
-		m_point_light_ssbo.free(m_graphics->get_logical_device());
+		frame.point_light_ssbo.free(m_graphics->get_logical_device());
 	}
 
-	void LightingManager::destroy_directional_light_ssbo()
+	void LightingManager::destroy_directional_light_ssbo(FrameBuffers& frame)
 	{
-		m_graphics->get_logical_device().unmapMemory(m_directional_light_ssbo.memory);
-		m_directional_light_ssbo.free(m_graphics->get_logical_device());
+		frame.directional_light_ssbo.free(m_graphics->get_logical_device());
 	}
 }
\ No newline at end of file
@@ -8,6 +8,9 @@
 
 /** Includes. */
 #include <glm\glm.hpp>
+#include <utilities\frustum.hpp>
+#include <utilities\clustering.hpp>
+#include <utilities\threading.hpp>
 #include "graphics.hpp"
 
 namespace dk
@@ -40,6 +43,8 @@ namespace dk
 
 	/**
 	 * @brief Manages lights and their buffers.
+	 * @note Point lights are assigned to a clustered grid over the view frustum
+	 *       on the CPU, so shaders only loop over the lights near each fragment.
 	 */
 	class LightingManager
 	{
@@ -50,8 +55,9 @@ namespace dk
 		 * @param Graphics context.
 		 * @param Starting number of point lights.
 		 * @param Starting number of directional lights.
+		 * @param Number of frames that can be in flight at once.
 		 */
-		LightingManager(Graphics* graphics, size_t point_light_count, size_t dir_light_count);
+		LightingManager(Graphics* graphics, size_t point_light_count, size_t dir_light_count, size_t frame_count = 1);
 
 		/**
 		 * @brief Destructor.
@@ -59,40 +65,66 @@ namespace dk
 		~LightingManager();
 
 		/**
-		 * @brief Upload lighting data.
+		 * @brief Assign point lights to clusters and upload lighting data.
+		 * @param Frame to upload to.
+		 * @param Thread pool to assign lights with. Runs on the calling thread if null.
+		 * @note The frame's buffers must not be in use by the GPU. They are
+		 *       recreated if there are more lights than they can hold.
 		 */
-		void upload();
+		void upload(size_t frame, ThreadPool* thread_pool = nullptr);
 
 		/**
 		 * @brief Flush light queues.
 		 */
 		void flush_queues();
 
+		/**
+		 * @brief Get number of frames buffers exist for.
+		 * @return Number of frames.
+		 */
+		size_t get_frame_count() const
+		{
+			return m_frames.size();
+		}
+
 		/**
 		 * @brief Get lighting data UBO.
+		 * @param Frame.
 		 * @return Lighting data UBO.
 		 */
-		VkMemBuffer& get_lighting_data_ubo()
+		VkMemBuffer& get_lighting_data_ubo(size_t frame)
 		{
-			return m_lighting_ubo;
+			return m_frames[frame].lighting_ubo;
 		}
 
 		/**
 		 * @brief Get point light SSBO.
+		 * @param Frame.
 		 * @return Point light SSBO.
 		 */
-		VkMemBuffer& get_point_light_ssbo()
+		VkMemBuffer& get_point_light_ssbo(size_t frame)
 		{
-			return m_point_light_ssbo;
+			return m_frames[frame].point_light_ssbo;
 		}
 
 		/**
 		 * @brief Get directional light SSBO.
+		 * @param Frame.
 		 * @return Directional light SSBO.
 		 */
-		VkMemBuffer& get_directional_light_ssbo()
+		VkMemBuffer& get_directional_light_ssbo(size_t frame)
+		{
+			return m_frames[frame].directional_light_ssbo;
+		}
+
+		/**
+		 * @brief Get light cluster SSBO.
+		 * @param Frame.
+		 * @return Light cluster SSBO.
+		 */
+		VkMemBuffer& get_cluster_ssbo(size_t frame)
 		{
-			return m_directional_light_ssbo;
+			return m_frames[frame].cluster_ssbo;
 		}
 
 		/**
@@ -106,20 +138,41 @@ namespace dk
 
 		/**
 		 * @brief Get point light data size.
+		 * @param Frame.
 		 * @return Point light data size.
 		 */
-		size_t get_point_light_data_size() const
+		size_t get_point_light_data_size(size_t frame) const
 		{
-			return sizeof(uint32_t) + (sizeof(PointLightData) * m_point_lights.size());
+			return 16 + (sizeof(PointLightData) * m_frames[frame].point_light_capacity);
 		}
 
 		/**
 		 * @brief Get directional light data size.
+		 * @param Frame.
 		 * @return Directional light data size.
 		 */
-		size_t get_directional_light_data_size() const
+		size_t get_directional_light_data_size(size_t frame) const
+		{
+			return 16 + (sizeof(DirectionalLightData) * m_frames[frame].directional_light_capacity);
+		}
+
+		/**
+		 * @brief Get light cluster data size.
+		 * @param Frame.
+		 * @return Light cluster data size.
+		 */
+		size_t get_cluster_data_size(size_t frame) const
+		{
+			return (sizeof(LightClusterGrid::Cluster) * LightClusterGrid::cluster_count) + (sizeof(uint32_t) * m_frames[frame].cluster_index_capacity);
+		}
+
+		/**
+		 * @brief Get the light cluster grid.
+		 * @return Light cluster grid.
+		 */
+		const LightClusterGrid& get_cluster_grid() const
 		{
-			return sizeof(uint32_t) + (sizeof(DirectionalLightData) * m_directional_lights.size());
+			return m_cluster_grid;
 		}
 
 		/**
@@ -149,6 +202,46 @@ namespace dk
 			m_lighting_data.camera_position = glm::vec4(cam_pos, 1.0f);
 		}
 
+		/**
+		 * @brief Set the camera lights are clustered for.
+		 * @param View matrix.
+		 * @param Projection matrix.
+		 * @param Near clipping plane.
+		 * @param Far clipping plane.
+		 */
+		void set_camera(const glm::mat4& view, const glm::mat4& projection, float near_plane, float far_plane);
+
+		/**
+		 * @brief Set the maximum number of point lights sent to the GPU.
+		 * @param Light budget. Zero means unlimited.
+		 * @note When more lights are visible, the ones with the largest
+		 *       screen contribution are kept.
+		 */
+		void set_point_light_budget(size_t budget)
+		{
+			m_point_light_budget = budget;
+		}
+
+		/**
+		 * @brief Get the number of point lights sent to the GPU last upload.
+		 * @return Visible point light count.
+		 */
+		size_t get_visible_point_light_count() const
+		{
+			return m_visible_point_lights.size();
+		}
+
+		/**
+		 * @brief Set the size of the viewport being rendered to.
+		 * @param Width.
+		 * @param Height.
+		 */
+		void set_viewport_size(int width, int height)
+		{
+			m_lighting_data.cluster_params.x = static_cast<float>(width);
+			m_lighting_data.cluster_params.y = static_cast<float>(height);
+		}
+
 		/**
 		 * @brief Draw point light.
 		 * @param Point light data.
@@ -163,42 +256,128 @@ namespace dk
 
 	private:
 
+		/**
+		 * @brief GPU buffers owned by a single frame.
+		 */
+		struct FrameBuffers
+		{
+			/** Lighting uniform buffer. */
+			VkMemBuffer lighting_ubo = {};
+
+			/** Lighting data UBO mapping pointer. */
+			void* lighting_map = nullptr;
+
+			/** Point light SSBO. */
+			VkMemBuffer point_light_ssbo = {};
+
+			/** Point light data SSBO mapping pointer. */
+			void* point_light_map = nullptr;
+
+			/** Number of point lights the SSBO can hold. */
+			size_t point_light_capacity = 0;
+
+			/** Directional light SSBO. */
+			VkMemBuffer directional_light_ssbo = {};
+
+			/** Directional data SSBO mapping pointer. */
+			void* directional_light_map = nullptr;
+
+			/** Number of directional lights the SSBO can hold. */
+			size_t directional_light_capacity = 0;
+
+			/** Light cluster SSBO. Clusters followed by the light indices they point into. */
+			VkMemBuffer cluster_ssbo = {};
+
+			/** Number of light indices the cluster SSBO can hold. */
+			size_t cluster_index_capacity = 0;
+		};
+
+		/**
+		 * @brief Cull point lights outside the camera frustum and apply the light budget.
+		 * @note Surviving lights are written to the visible light list in submission order.
+		 */
+		void cull_point_lights();
+
 		/**
 		 * @brief Create point light SSBO.
+		 * @param Frame buffers.
+		 * @param Number of point lights it must hold.
 		 */
-		void create_point_light_ssbo();
+		void create_point_light_ssbo(FrameBuffers& frame, size_t capacity);
 
 		/**
 		 * @brief Create directional light SSBO.
+		 * @param Frame buffers.
+		 * @param Number of directional lights it must hold.
+		 */
+		void create_directional_ssbo(FrameBuffers& frame, size_t capacity);
+
+		/**
+		 * @brief Create light cluster SSBO.
+		 * @param Frame buffers.
+		 * @param Number of light indices it must hold.
 		 */
-		void create_directional_ssbo();
+		void create_cluster_ssbo(FrameBuffers& frame, size_t index_count);
 
 		/**
 		 * @brief Destroy point light SSBO.
+		 * @param Frame buffers.
 		 */
-		void destroy_point_light_ssbo();
+		void destroy_point_light_ssbo(FrameBuffers& frame);
 
 		/**
 		 * @brief Destroy directional light SSBO.
+		 * @param Frame buffers.
 		 */
-		void destroy_directional_light_ssbo();
+		void destroy_directional_light_ssbo(FrameBuffers& frame);
 
 
 
 		/** Graphics context. */
 		Graphics* m_graphics;
 
-		/** Point lights. */
+		/** Point lights submitted this frame. */
 		std::vector<PointLightData> m_point_lights = {};
-		
-		/** Point lights allocated. */
-		size_t m_point_light_count = 0;
 
-		/** Directional lights. */
+		/** Point lights that survived culling. */
+		std::vector<PointLightData> m_visible_point_lights = {};
+
+		/** Indices of point lights that survived frustum culling. */
+		std::vector<uint32_t> m_point_light_order = {};
+
+		/** Screen contribution of each point light. Only used when over budget. */
+		std::vector<float> m_point_light_scores = {};
+
+		/** Maximum number of visible point lights. Zero means unlimited. */
+		size_t m_point_light_budget = 0;
+
+		/** Directional lights submitted this frame. */
 		std::vector<DirectionalLightData> m_directional_lights = {};
 
-		/** Directional lights allocated. */
-		size_t m_directional_light_count = 0;
+		/** Point light cluster grid. */
+		LightClusterGrid m_cluster_grid = {};
+
+		/**
+		 * @brief Camera lights are clustered for.
+		 */
+		struct
+		{
+			/** View matrix. */
+			glm::mat4 view = {};
+
+			/** Projection matrix. */
+			glm::mat4 projection = {};
+
+			/** Near clipping plane. */
+			float near_plane = 0.1f;
+
+			/** Far clipping plane. */
+			float far_plane = 1000.0f;
+
+			/** View frustum. */
+			Frustum frustum = {};
+
+		} m_camera;
 
 		/**
 		 * @brief Lighting data
@@ -211,24 +390,15 @@ namespace dk
 			/** Camera position. */
 			glm::vec4 camera_position = {};
 
-		} m_lighting_data;
+			/** Dot with a world space position to get its view depth. */
+			glm::vec4 view_depth = {};
 
-		/** Point light SSBO. */
-		VkMemBuffer m_point_light_ssbo = {};
+			/** Viewport width, viewport height, depth slice scale, and depth slice bias. */
+			glm::vec4 cluster_params = {};
 
-		/** Directional light SSBO. */
-		VkMemBuffer m_directional_light_ssbo = {};
-
-		/** Lighting uniform buffer. */
-		VkMemBuffer m_lighting_ubo = {};
-
-		/** Lighting data UBO mapping pointer. */
-		void* m_lighting_map = nullptr;
-
-		/** Point light data SSBO mapping pointer. */
-		void* m_point_light_map = nullptr;
+		} m_lighting_data;
 
-		/** Directional data SSBO mapping pointer. */
-		void* m_directional_light_map = nullptr;
+		/** Buffers for each frame in flight. */
+		std::vector<FrameBuffers> m_frames = {};
 	};
 }
\ No newline at end of file
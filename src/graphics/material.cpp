@@ -5,15 +5,18 @@
  */
 
 /** Includes. */
+#include <array>
 #include "material.hpp"
 
 namespace dk
 {
 	Material::Material() {}
 
-	Material::Material(Graphics* graphics, HMaterialShader shader) :
+	Material::Material(Graphics* graphics, HMaterialShader shader, const UniformRingBuffer& uniform_ring, TextureTable& texture_table) :
 		m_graphics(graphics),
 		m_shader(shader),
+		m_texture_table(&texture_table),
+		m_table_slot(texture_table.allocate_material()),
 		m_textures({}),
 		m_cube_maps({})
 	{
@@ -32,30 +35,67 @@ namespace dk
 			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
 		);
 
-		// Create descriptor pool and descriptor set
-		if (m_shader->get_texture_count() > 0)
+		// Create descriptor pool
 		{
-			vk::DescriptorPoolSize pool_size = {};
-			pool_size.type = vk::DescriptorType::eCombinedImageSampler;
-			pool_size.descriptorCount = static_cast<uint32_t>(m_shader->get_texture_count());
+			std::vector<vk::DescriptorPoolSize> pool_sizes(2);
+			pool_sizes[0].type = vk::DescriptorType::eUniformBuffer;
+			pool_sizes[0].descriptorCount = 2;
+			pool_sizes[1].type = vk::DescriptorType::eUniformBufferDynamic;
+			pool_sizes[1].descriptorCount = 2;
 
 			vk::DescriptorPoolCreateInfo pool_info = {};
-			pool_info.poolSizeCount = 1;
-			pool_info.pPoolSizes = &pool_size;
+			pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+			pool_info.pPoolSizes = pool_sizes.data();
 			pool_info.maxSets = 1;
 
 			m_vk_descriptor_pool = m_graphics->get_logical_device().createDescriptorPool(pool_info);
+			dk_assert(m_vk_descriptor_pool);
+		}
 
+		// Create the descriptor set shared by everything using the material
+		{
 			vk::DescriptorSetAllocateInfo alloc_info = {};
 			alloc_info.descriptorPool = m_vk_descriptor_pool;
 			alloc_info.descriptorSetCount = 1;
-			alloc_info.pSetLayouts = &m_shader->get_texture_descriptor_set_layout();
-			m_vk_texture_descriptor_set = m_graphics->get_logical_device().allocateDescriptorSets(alloc_info)[0];
+			alloc_info.pSetLayouts = &m_shader->get_descriptor_set_layout();
+			m_vk_descriptor_set = m_graphics->get_logical_device().allocateDescriptorSets(alloc_info)[0];
+			dk_assert(m_vk_descriptor_set);
+
+			std::array<vk::DescriptorBufferInfo, 4> buffer_infos = {};
+			buffer_infos[0].buffer = m_vertex_uniform_buffer.buffer;
+			buffer_infos[0].offset = 0;
+			buffer_infos[0].range = m_shader->get_vertex_buffer_size();
+
+			buffer_infos[1].buffer = uniform_ring.get_buffer();
+			buffer_infos[1].offset = 0;
+			buffer_infos[1].range = m_shader->get_inst_vertex_buffer_size();
+
+			buffer_infos[2].buffer = m_fragment_uniform_buffer.buffer;
+			buffer_infos[2].offset = 0;
+			buffer_infos[2].range = m_shader->get_fragment_buffer_size();
+
+			buffer_infos[3].buffer = uniform_ring.get_buffer();
+			buffer_infos[3].offset = 0;
+			buffer_infos[3].range = m_shader->get_inst_fragment_buffer_size();
+
+			std::array<vk::WriteDescriptorSet, 4> writes = {};
+
+			for (size_t i = 0; i < 4; ++i)
+			{
+				writes[i].dstSet = m_vk_descriptor_set;
+				writes[i].dstBinding = static_cast<uint32_t>(i);
+				writes[i].dstArrayElement = 0;
+				writes[i].descriptorType = (i % 2 == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eUniformBufferDynamic;
+				writes[i].descriptorCount = 1;
+				writes[i].pBufferInfo = &buffer_infos[i];
+			}
+
+			m_graphics->get_logical_device().updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 		}
 
 		// Create maps
-		m_vertex_map = m_graphics->get_logical_device().mapMemory(m_vertex_uniform_buffer.memory, 0, m_shader->get_vertex_buffer_size());
-		m_fragment_map = m_graphics->get_logical_device().mapMemory(m_fragment_uniform_buffer.memory, 0, m_shader->get_fragment_buffer_size());
+		m_vertex_map = m_vertex_uniform_buffer.memory.mapped;
+		m_fragment_map = m_fragment_uniform_buffer.memory.mapped;
 	}
 
 	Material::~Material() {}
@@ -65,7 +105,7 @@ namespace dk
 		dk_assert(index < m_shader->get_texture_count());
 		m_cube_maps.erase(index);
 		m_textures[index] = texture;
-		update_texture_descriptor_set();
+		m_texture_table->set_material_texture(m_table_slot, index, texture);
 	}
 
 	void Material::set_cube_map(size_t index, HCubeMap cube_map)
@@ -73,63 +113,16 @@ namespace dk
 		dk_assert(index < m_shader->get_texture_count());
 		m_textures.erase(index);
 		m_cube_maps[index] = cube_map;
-		update_texture_descriptor_set();
+		m_texture_table->set_material_cube_map(m_table_slot, index, cube_map);
 	}
 
 	void Material::free()
 	{
 		m_textures.clear();
 		m_cube_maps.clear();
-		m_graphics->get_logical_device().unmapMemory(m_vertex_uniform_buffer.memory);
-		m_graphics->get_logical_device().unmapMemory(m_fragment_uniform_buffer.memory);
+		m_texture_table->free_material(m_table_slot);
 		m_graphics->get_logical_device().destroyDescriptorPool(m_vk_descriptor_pool);
 		m_vertex_uniform_buffer.free(m_graphics->get_logical_device());
 		m_fragment_uniform_buffer.free(m_graphics->get_logical_device());
 	}
-
-	void Material::update_texture_descriptor_set()
-	{
-		if (m_textures.size() + m_cube_maps.size() < m_shader->get_texture_count())
-			return;
-
-		std::vector<vk::WriteDescriptorSet> write_sets(m_shader->get_texture_count());
-		std::vector<vk::DescriptorImageInfo> descriptor_image_info(m_shader->get_texture_count());
-
-		// Textures
-		for (auto texture : m_textures)
-		{
-			size_t i = texture.first;
-
-			descriptor_image_info[i].imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-			descriptor_image_info[i].imageView = texture.second->get_image_view();
-			descriptor_image_info[i].sampler = texture.second->get_sampler();
-
-			write_sets[i].dstSet = m_vk_texture_descriptor_set;
-			write_sets[i].dstBinding = static_cast<uint32_t>(i);
-			write_sets[i].dstArrayElement = 0;
-			write_sets[i].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-			write_sets[i].descriptorCount = 1;
-			write_sets[i].pImageInfo = &descriptor_image_info[i];
-		}
-
-		// Cube maps
-		for (auto cube_map : m_cube_maps)
-		{
-			size_t i = cube_map.first;
-
-			descriptor_image_info[i].imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-			descriptor_image_info[i].imageView = cube_map.second->get_image_view();
-			descriptor_image_info[i].sampler = cube_map.second->get_sampler();
-
-			write_sets[i].dstSet = m_vk_texture_descriptor_set;
-			write_sets[i].dstBinding = static_cast<uint32_t>(i);
-			write_sets[i].dstArrayElement = 0;
-			write_sets[i].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-			write_sets[i].descriptorCount = 1;
-			write_sets[i].pImageInfo = &descriptor_image_info[i];
-		}
-
-		// Update descriptor sets
-		m_graphics->get_logical_device().updateDescriptorSets(static_cast<uint32_t>(write_sets.size()), write_sets.data(), 0, nullptr);
-	}
 }
\ No newline at end of file
@@ -10,7 +10,9 @@
 #include <utilities\resource_allocator.hpp>
 #include <map>
 #include "material_shader.hpp"
+#include "uniform_ring.hpp"
 #include "texture.hpp"
+#include "texture_table.hpp"
 
 namespace dk
 {
@@ -30,8 +32,10 @@ namespace dk
 		 * @brief Constructor.
 		 * @param Graphics context.
 		 * @param Shader.
+		 * @param Ring buffer holding per instance data.
+		 * @param Texture table the materials textures are sampled from.
 		 */
-		Material(Graphics* graphics, HMaterialShader shader);
+		Material(Graphics* graphics, HMaterialShader shader, const UniformRingBuffer& uniform_ring, TextureTable& texture_table);
 
 		/**
 		 * @brief Destructor.
@@ -117,12 +121,24 @@ namespace dk
 		}
 
 		/**
-		 * @brief Get texture descriptor set.
-		 * @return Texture descriptor set.
+		 * @brief Get descriptor set.
+		 * @return Descriptor set.
+		 * @note Shared by everything drawn with the material. Per instance data
+		 *       is selected with dynamic offsets into the uniform ring buffer.
 		 */
-		const vk::DescriptorSet& get_texture_descriptor_set() const
+		const vk::DescriptorSet& get_descriptor_set() const
 		{
-			return m_vk_texture_descriptor_set;
+			return m_vk_descriptor_set;
+		}
+
+		/**
+		 * @brief Get the materials slot in the texture table.
+		 * @return Material slot.
+		 * @note Fragment shaders read it from a push constant to find the materials textures.
+		 */
+		uint32_t get_table_slot() const
+		{
+			return m_table_slot;
 		}
 
 		/**
@@ -151,11 +167,6 @@ namespace dk
 
 	private:
 
-		/**
-		 * Update texture descriptor set.
-		 */
-		void update_texture_descriptor_set();
-
 
 
 		/** Graphics context. */
@@ -167,8 +178,14 @@ namespace dk
 		/** Descriptor pool. */
 		vk::DescriptorPool m_vk_descriptor_pool = {};
 
-		/** Texture descriptor set. */
-		vk::DescriptorSet m_vk_texture_descriptor_set = {};
+		/** Descriptor set. */
+		vk::DescriptorSet m_vk_descriptor_set = {};
+
+		/** Texture table. */
+		TextureTable* m_texture_table = nullptr;
+
+		/** Slot in the texture table. */
+		uint32_t m_table_slot = 0;
 
 		/** Vertex uniform buffer. */
 		VkMemBuffer m_vertex_uniform_buffer;
@@ -5,7 +5,6 @@
  */
 
 /** Includes. */
-#include "spirv_cross\spirv_glsl.hpp"
 #include "material_shader.hpp"
 #include "mesh.hpp"
 
@@ -18,52 +17,21 @@ namespace dk
 		Graphics* graphics,
 		std::vector<MaterialShaderCreateInfo>& create_info,
 		const std::vector<char>& vert_byte_code,
-		const std::vector<char>& frag_byte_code
+		const std::vector<char>& frag_byte_code,
+		VertexFormat vertex_format
 	)
 	{
 		m_graphics = graphics;
+		m_vertex_format = vertex_format;
 
+		// Reflect on byte code. Results are cached between runs.
 		{
-			// Analyze vertex shader byte code
-			size_t word_count = vert_byte_code.size() / 4;
-			dk_assert((word_count * 4) == vert_byte_code.size());
-			spirv_cross::CompilerGLSL glsl(reinterpret_cast<const uint32_t*>(vert_byte_code.data()), word_count);
-
-			// Find sizes for uniform buffers
-			spirv_cross::ShaderResources resources = glsl.get_shader_resources();
-			for (const auto& buffer : resources.uniform_buffers)
-			{
-				const spirv_cross::SPIRType& type = glsl.get_type(buffer.base_type_id);
-				size_t size = glsl.get_declared_struct_size(type);
-
-				if (buffer.name == "MaterialData")
-					m_vertex_buffer_size = size;
-				else
-					m_inst_vertex_buffer_size = size;
-			}
-		}
-
-		{
-			// Analyze fragment shader byte code
-			size_t word_count = frag_byte_code.size() / 4;
-			dk_assert((word_count * 4) == frag_byte_code.size());
-			spirv_cross::CompilerGLSL glsl(reinterpret_cast<const uint32_t*>(frag_byte_code.data()), word_count);
-			
-			// Find sizes for uniform buffers
-			spirv_cross::ShaderResources resources = glsl.get_shader_resources();
-			for (const auto& buffer : resources.uniform_buffers)
-			{
-				const spirv_cross::SPIRType& type = glsl.get_type(buffer.base_type_id);
-				size_t size = glsl.get_declared_struct_size(type);
-
-				if (buffer.name == "MaterialData")
-					m_fragment_buffer_size = size;
-				else
-					m_inst_fragment_buffer_size = size;
-			}
-
-			// Get texture count
-			m_texture_count = resources.sampled_images.size();
+			const ShaderReflection reflection = m_graphics->get_shader_cache().reflect(vert_byte_code, frag_byte_code);
+			m_vertex_buffer_size = static_cast<size_t>(reflection.vertex_buffer_size);
+			m_inst_vertex_buffer_size = static_cast<size_t>(reflection.inst_vertex_buffer_size);
+			m_fragment_buffer_size = static_cast<size_t>(reflection.fragment_buffer_size);
+			m_inst_fragment_buffer_size = static_cast<size_t>(reflection.inst_fragment_buffer_size);
+			m_texture_count = static_cast<size_t>(reflection.texture_count);
 		}
 
 		dk_assert
@@ -83,8 +51,9 @@ namespace dk
 			bindings[0].descriptorCount = 1;
 			bindings[0].stageFlags = vk::ShaderStageFlagBits::eVertex;
 
+			// Per instance data lives in the renderers uniform ring buffer
 			bindings[1].binding = 1;
-			bindings[1].descriptorType = vk::DescriptorType::eUniformBuffer;
+			bindings[1].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
 			bindings[1].descriptorCount = 1;
 			bindings[1].stageFlags = vk::ShaderStageFlagBits::eVertex;
 
@@ -94,7 +63,7 @@ namespace dk
 			bindings[2].stageFlags = vk::ShaderStageFlagBits::eFragment;
 
 			bindings[3].binding = 3;
-			bindings[3].descriptorType = vk::DescriptorType::eUniformBuffer;
+			bindings[3].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
 			bindings[3].descriptorCount = 1;
 			bindings[3].stageFlags = vk::ShaderStageFlagBits::eFragment;
 
@@ -106,27 +75,6 @@ namespace dk
 			dk_assert(m_vk_descriptor_set_layout);
 		}
 
-		// Create texture descriptor set layout
-		if(m_texture_count > 0)
-		{
-			std::vector<vk::DescriptorSetLayoutBinding> bindings(m_texture_count);
-
-			for (size_t i = 0; i < m_texture_count; ++i)
-			{
-				bindings[i].binding = static_cast<uint32_t>(i);
-				bindings[i].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-				bindings[i].descriptorCount = 1;
-				bindings[i].stageFlags = vk::ShaderStageFlagBits::eFragment;
-			}
-
-			vk::DescriptorSetLayoutCreateInfo layout_info = {};
-			layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
-			layout_info.pBindings = bindings.data();
-
-			m_vk_texture_descriptor_set_layout = m_graphics->get_logical_device().createDescriptorSetLayout(layout_info);
-			dk_assert(m_vk_texture_descriptor_set_layout);
-		}
-
 		// Create shader modules
 		m_vk_vertex_shader_module = create_shader_module(m_graphics->get_logical_device(), vert_byte_code);
 		m_vk_fragment_shader_module = create_shader_module(m_graphics->get_logical_device(), frag_byte_code);
@@ -163,18 +111,35 @@ namespace dk
 			}
 
 			// Set up descriptor set layouts
-			pipeline_create_info.descriptor_set_layouts.resize(1 + create_info[i].descriptor_set_layouts.size() + (m_texture_count > 0 ? 1 : 0));
+			pipeline_create_info.descriptor_set_layouts.resize(1 + create_info[i].descriptor_set_layouts.size());
 			pipeline_create_info.descriptor_set_layouts[0] = m_vk_descriptor_set_layout;
 
 			for (size_t j = 1; j < 1 + create_info[i].descriptor_set_layouts.size(); ++j)
 				pipeline_create_info.descriptor_set_layouts[j] = create_info[i].descriptor_set_layouts[j - 1];
 
-			if (m_texture_count > 0)
-				pipeline_create_info.descriptor_set_layouts[pipeline_create_info.descriptor_set_layouts.size() - 1] = m_vk_texture_descriptor_set_layout;
+			// Fragment shaders find their materials texture slots using a push constant and
+			// vertex shaders reading packed vertices find their meshes bounds using another. Every
+			// material pipeline has the same ranges so their layouts stay compatible.
+			vk::PushConstantRange material_range = {};
+			material_range.stageFlags = vk::ShaderStageFlagBits::eFragment;
+			material_range.offset = 0;
+			material_range.size = sizeof(uint32_t);
+
+			vk::PushConstantRange bounds_range = {};
+			bounds_range.stageFlags = vk::ShaderStageFlagBits::eVertex;
+			bounds_range.offset = PackedVertexBounds::push_constant_offset;
+			bounds_range.size = sizeof(PackedVertexBounds);
+
+			pipeline_create_info.push_constant_ranges = { material_range, bounds_range };
 
 			// Pipeline layout creation
-			auto binding_description = Vertex::get_binding_description();
-			auto attribute_descriptions = Vertex::get_attribute_descriptions();
+			auto binding_description = m_vertex_format == VertexFormat::Packed ? 
+				PackedVertex::get_binding_description() : 
+				Vertex::get_binding_description();
+
+			auto attribute_descriptions = m_vertex_format == VertexFormat::Packed ? 
+				PackedVertex::get_attribute_descriptions() : 
+				Vertex::get_attribute_descriptions();
 
 			vk::PipelineVertexInputStateCreateInfo& vertex_input_info = pipeline_create_info.vertex_input_info;
 			vertex_input_info.vertexBindingDescriptionCount = 1;
@@ -266,7 +231,12 @@ namespace dk
 			depth_stencil.front = {};
 			depth_stencil.back = {};
 
-			m_pipelines[i] = create_shader_pipeline(m_graphics->get_logical_device(), pipeline_create_info);
+			m_pipelines[i] = create_shader_pipeline
+			(
+				m_graphics->get_logical_device(), 
+				pipeline_create_info, 
+				m_graphics->get_shader_cache().get_pipeline_cache()
+			);
 		}
 	}
 
@@ -274,6 +244,5 @@ namespace dk
 	{
 		Shader::free();
 		m_graphics->get_logical_device().destroyDescriptorSetLayout(m_vk_descriptor_set_layout);
-		m_graphics->get_logical_device().destroyDescriptorSetLayout(m_vk_texture_descriptor_set_layout);
 	}
 }
\ No newline at end of file
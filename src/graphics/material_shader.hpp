@@ -8,11 +8,13 @@
 
 /** Includes. */
 #include "shader.hpp"
+#include "mesh.hpp"
 
 namespace dk
 {
 	/**
-	 * Standard data sent to a MaterialShader's vertex shader.
+	 * Standard per instance data sent to a MaterialShader's vertex shader.
+	 * @note Read from the renderers instance buffer using gl_InstanceIndex.
 	 */
 	struct VertexShaderData
 	{
@@ -70,13 +72,15 @@ namespace dk
 		 * @param Material shader create infos.
 		 * @param Vertex shader byte code.
 		 * @param Fragment shader byte code.
+		 * @param Layout of the vertices the vertex shader reads.
 		 */
 		MaterialShader
 		(
 			Graphics* graphics, 
 			std::vector<MaterialShaderCreateInfo>& create_info,
 			const std::vector<char>& vert_byte_code, 
-			const std::vector<char>& frag_byte_code
+			const std::vector<char>& frag_byte_code,
+			VertexFormat vertex_format = VertexFormat::Standard
 		);
 
 		/**
@@ -127,21 +131,21 @@ namespace dk
 		}
 
 		/**
-		 * @brief Get descriptor set layout.
-		 * @return Descriptor set layout.
+		 * @brief Get the layout of the vertices the vertex shader reads.
+		 * @return Vertex format. Meshes drawn with the shader must use it.
 		 */
-		vk::DescriptorSetLayout& get_descriptor_set_layout()
+		VertexFormat get_vertex_format() const
 		{
-			return m_vk_descriptor_set_layout;
+			return m_vertex_format;
 		}
 
 		/**
-		 * @brief Get texture descriptor set layout.
-		 * @return Texture descriptor set layout.
+		 * @brief Get descriptor set layout.
+		 * @return Descriptor set layout.
 		 */
-		vk::DescriptorSetLayout& get_texture_descriptor_set_layout()
+		vk::DescriptorSetLayout& get_descriptor_set_layout()
 		{
-			return m_vk_texture_descriptor_set_layout;
+			return m_vk_descriptor_set_layout;
 		}
 
 	private:
@@ -149,9 +153,6 @@ namespace dk
 		/** Descriptor set layout. */
 		vk::DescriptorSetLayout m_vk_descriptor_set_layout;
 
-		/** Texture descriptor set layout. */
-		vk::DescriptorSetLayout m_vk_texture_descriptor_set_layout;
-
 		/** Size in bytes of the vertex uniform buffer. */
 		size_t m_vertex_buffer_size;
 
@@ -163,6 +164,9 @@ namespace dk
 
 		/** Size in bytes of the per instance fragment uniform buffer. */
 		size_t m_inst_fragment_buffer_size;
+
+		/** Layout of the vertices the vertex shader reads. */
+		VertexFormat m_vertex_format = VertexFormat::Standard;
 	};
 
 	/** Handle to a material shader. */
@@ -0,0 +1,142 @@
+/**
+ * @file memory_manager.cpp
+ * @brief Device memory manager source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include "memory_manager.hpp"
+
+namespace dk
+{
+	void VkMemAllocation::free()
+	{
+		if (manager)
+			manager->free(*this);
+	}
+
+
+
+	VkMemoryManager::VkMemoryManager(vk::PhysicalDevice& physical_device, vk::Device& logical_device, vk::DeviceSize block_size) :
+		m_vk_physical_device(physical_device),
+		m_vk_logical_device(logical_device)
+	{
+		m_vk_memory_properties = m_vk_physical_device.getMemoryProperties();
+		m_non_coherent_atom_size = m_vk_physical_device.getProperties().limits.nonCoherentAtomSize;
+		m_allocator = std::make_unique<MemoryAllocator>(this, static_cast<uint64_t>(block_size));
+	}
+
+	VkMemoryManager::~VkMemoryManager()
+	{
+		// Return every block before the device memory list goes away
+		m_allocator.reset();
+	}
+
+	VkMemAllocation VkMemoryManager::allocate
+	(
+		const vk::MemoryRequirements& requirements,
+		vk::MemoryPropertyFlags properties,
+		bool linear_resource,
+		AllocationStrategy strategy
+	)
+	{
+		MemoryRequest request = {};
+		request.size = static_cast<uint64_t>(requirements.size);
+		request.alignment = static_cast<uint64_t>(requirements.alignment);
+		request.memory_type = find_memory_type(m_vk_physical_device, requirements.memoryTypeBits, properties);
+		request.linear_resource = linear_resource;
+		request.strategy = strategy;
+
+		// Flushed ranges of non coherent memory must cover whole atoms
+		if (is_non_coherent(request.memory_type))
+		{
+			const uint64_t atom = static_cast<uint64_t>(m_non_coherent_atom_size);
+			request.alignment = std::max(request.alignment, atom);
+			request.size = ((request.size + atom - 1) / atom) * atom;
+		}
+
+		VkMemAllocation allocation = {};
+		if (!m_allocator->allocate(request, allocation.allocation))
+		{
+			dk_err("Vulkan: Out of device memory.");
+			return allocation;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			allocation.memory = m_vk_blocks[allocation.allocation.block - 1];
+		}
+
+		allocation.offset = static_cast<vk::DeviceSize>(allocation.allocation.offset);
+		allocation.size = static_cast<vk::DeviceSize>(allocation.allocation.size);
+		allocation.mapped = allocation.allocation.mapped;
+		allocation.manager = this;
+		return allocation;
+	}
+
+	void VkMemoryManager::free(VkMemAllocation& allocation)
+	{
+		m_allocator->free(allocation.allocation);
+		allocation = {};
+	}
+
+	void VkMemoryManager::flush(const VkMemAllocation& allocation)
+	{
+		if (!allocation.memory || !is_non_coherent(allocation.allocation.memory_type))
+			return;
+
+		vk::MappedMemoryRange range = {};
+		range.memory = allocation.memory;
+		range.offset = allocation.offset;
+		range.size = allocation.size;
+		m_vk_logical_device.flushMappedMemoryRanges(1, &range);
+	}
+
+	uint64_t VkMemoryManager::allocate_block(uint32_t memory_type, uint64_t size, void** mapped)
+	{
+		vk::MemoryAllocateInfo alloc_info = {};
+		alloc_info.allocationSize = static_cast<vk::DeviceSize>(size);
+		alloc_info.memoryTypeIndex = memory_type;
+
+		vk::DeviceMemory memory = {};
+		if (m_vk_logical_device.allocateMemory(&alloc_info, nullptr, &memory) != vk::Result::eSuccess)
+			return 0;
+
+		// Keep host visible blocks mapped for their whole lifetime
+		if (m_vk_memory_properties.memoryTypes[memory_type].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+			*mapped = m_vk_logical_device.mapMemory(memory, 0, VK_WHOLE_SIZE);
+
+		// Find a handle for the block
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_free_handles.size() > 0)
+		{
+			const uint64_t handle = m_free_handles.back();
+			m_free_handles.pop_back();
+			m_vk_blocks[handle - 1] = memory;
+			return handle;
+		}
+
+		m_vk_blocks.push_back(memory);
+		return static_cast<uint64_t>(m_vk_blocks.size());
+	}
+
+	void VkMemoryManager::free_block(uint32_t memory_type, uint64_t block)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		vk::DeviceMemory& memory = m_vk_blocks[block - 1];
+
+		if (m_vk_memory_properties.memoryTypes[memory_type].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+			m_vk_logical_device.unmapMemory(memory);
+
+		m_vk_logical_device.freeMemory(memory);
+		memory = vk::DeviceMemory();
+		m_free_handles.push_back(block);
+	}
+
+	bool VkMemoryManager::is_non_coherent(uint32_t memory_type) const
+	{
+		const auto flags = m_vk_memory_properties.memoryTypes[memory_type].propertyFlags;
+		return (flags & vk::MemoryPropertyFlagBits::eHostVisible) && !(flags & vk::MemoryPropertyFlagBits::eHostCoherent);
+	}
+}
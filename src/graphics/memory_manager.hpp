@@ -0,0 +1,133 @@
+#pragma once
+
+/**
+ * @file memory_manager.hpp
+ * @brief Device memory manager.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <utilities\memory_allocator.hpp>
+#include "vulkan_utilities.hpp"
+
+namespace dk
+{
+	/**
+	 * @brief Sub-allocates buffer and image memory out of large device memory blocks.
+	 * @note Host visible blocks are mapped once when they are created and stay
+	 *       mapped, so allocations expose a pointer instead of being mapped.
+	 */
+	class VkMemoryManager : public MemoryBackend
+	{
+	public:
+
+		/**
+		 * @brief Constructor.
+		 * @param Physical device.
+		 * @param Logical device.
+		 * @param Size of a memory block.
+		 */
+		VkMemoryManager
+		(
+			vk::PhysicalDevice& physical_device,
+			vk::Device& logical_device,
+			vk::DeviceSize block_size = MemoryAllocator::default_block_size
+		);
+
+		/**
+		 * @brief Destructor.
+		 * @note Every block is freed, including ones with live allocations.
+		 */
+		~VkMemoryManager();
+
+		/**
+		 * @brief Allocate memory.
+		 * @param Memory requirements of the resource.
+		 * @param Memory properties.
+		 * @param Is the resource a buffer or linearly tiled image?
+		 * @param Allocation strategy.
+		 * @return Allocation. Bind the resource to its memory at its offset.
+		 */
+		VkMemAllocation allocate
+		(
+			const vk::MemoryRequirements& requirements,
+			vk::MemoryPropertyFlags properties,
+			bool linear_resource,
+			AllocationStrategy strategy = AllocationStrategy::Buddy
+		);
+
+		/**
+		 * @brief Free memory.
+		 * @param Allocation.
+		 */
+		void free(VkMemAllocation& allocation);
+
+		/**
+		 * @brief Make host writes to an allocation visible to the device.
+		 * @param Allocation.
+		 * @note Does nothing for host coherent memory.
+		 */
+		void flush(const VkMemAllocation& allocation);
+
+		/**
+		 * @brief Get the sub-allocator.
+		 * @return Sub-allocator.
+		 * @note Used for statistics and defragmentation.
+		 */
+		MemoryAllocator& get_allocator()
+		{
+			return *m_allocator.get();
+		}
+
+		/**
+		 * @brief Allocate a block of device memory.
+		 * @param Memory type index.
+		 * @param Size in bytes.
+		 * @param Set to the mapping of the block if it is host visible.
+		 * @return Block handle. Zero if the device is out of memory.
+		 */
+		uint64_t allocate_block(uint32_t memory_type, uint64_t size, void** mapped) override;
+
+		/**
+		 * @brief Free a block of device memory.
+		 * @param Memory type index.
+		 * @param Block handle.
+		 */
+		void free_block(uint32_t memory_type, uint64_t block) override;
+
+	private:
+
+		/**
+		 * @brief Check if a memory type needs explicit flushes.
+		 * @param Memory type index.
+		 * @return If the memory type is host visible but not coherent.
+		 */
+		bool is_non_coherent(uint32_t memory_type) const;
+
+
+
+		/** Physical device. */
+		vk::PhysicalDevice& m_vk_physical_device;
+
+		/** Logical device. */
+		vk::Device& m_vk_logical_device;
+
+		/** Memory properties of the physical device. */
+		vk::PhysicalDeviceMemoryProperties m_vk_memory_properties = {};
+
+		/** Alignment of flushed ranges of non coherent memory. */
+		vk::DeviceSize m_non_coherent_atom_size = 1;
+
+		/** Device memory of each block. Block handles are indices plus one. */
+		std::vector<vk::DeviceMemory> m_vk_blocks = {};
+
+		/** Unused block handles. */
+		std::vector<uint64_t> m_free_handles = {};
+
+		/** Lock for the block list. */
+		std::mutex m_mutex;
+
+		/** Sub-allocator. */
+		std::unique_ptr<MemoryAllocator> m_allocator;
+	};
+}
@@ -5,6 +5,11 @@
  */
 
 /** Includes. */
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <utilities\mesh_split.hpp>
+#include <utilities\vertex_quantization.hpp>
 #include "mesh.hpp"
 
 namespace dk
@@ -45,148 +50,178 @@ namespace dk
 
 
 
-	Mesh::Mesh() {}
+	const uint32_t PackedVertexBounds::push_constant_offset;
 
-	Mesh::Mesh(Graphics* graphics, const std::vector<uint16_t>& indices, const std::vector<Vertex>& vertices) :
-		m_graphics(graphics),
-		m_vertex_buffer({}),
-		m_indices(indices),
-		m_vertices(vertices)
+	vk::VertexInputBindingDescription PackedVertex::get_binding_description()
 	{
-		calculate_aabb();
-		calculate_tangents();
+		vk::VertexInputBindingDescription binding_description = {};
+		binding_description.binding = 0;
+		binding_description.stride = sizeof(PackedVertex);
+		binding_description.inputRate = vk::VertexInputRate::eVertex;
+		return binding_description;
 	}
 
-	void Mesh::free()
+	std::array<vk::VertexInputAttributeDescription, 4> PackedVertex::get_attribute_descriptions()
 	{
-		m_vertex_buffer.free(m_graphics->get_logical_device());
-		m_index_buffer.free(m_graphics->get_logical_device());
+		std::array<vk::VertexInputAttributeDescription, 4> attribute_descriptions = {};
+		attribute_descriptions[0].binding = 0;
+		attribute_descriptions[0].location = 0;
+		attribute_descriptions[0].format = vk::Format::eR16G16B16A16Unorm;
+		attribute_descriptions[0].offset = offsetof(PackedVertex, position);
+
+		attribute_descriptions[1].binding = 0;
+		attribute_descriptions[1].location = 1;
+		attribute_descriptions[1].format = vk::Format::eR16G16Sfloat;
+		attribute_descriptions[1].offset = offsetof(PackedVertex, uv);
+
+		attribute_descriptions[2].binding = 0;
+		attribute_descriptions[2].location = 2;
+		attribute_descriptions[2].format = vk::Format::eR16G16Snorm;
+		attribute_descriptions[2].offset = offsetof(PackedVertex, normal);
+
+		attribute_descriptions[3].binding = 0;
+		attribute_descriptions[3].location = 3;
+		attribute_descriptions[3].format = vk::Format::eR16G16Snorm;
+		attribute_descriptions[3].offset = offsetof(PackedVertex, tangent);
+		return attribute_descriptions;
 	}
 
-	void Mesh::compute_normals()
+	PackedVertex PackedVertex::pack(const Vertex& vertex, const AABB& aabb)
 	{
-		// Zero out normals
-		for (size_t i = 0; i < m_vertices.size(); ++i)
-			m_vertices[i].normal = glm::vec3(0);
-
-		// Compute normals
-		for (size_t i = 0; i < m_indices.size(); i += 3)
-		{
-			auto v1 = m_vertices[m_indices[i]].position;
-			auto v2 = m_vertices[m_indices[i + 1]].position;
-			auto v3 = m_vertices[m_indices[i + 2]].position;
+		const glm::vec3 min = aabb.center - aabb.extent;
+		const glm::vec3 size = aabb.extent * 2.0f;
 
-			glm::vec3 n = glm::normalize(glm::cross((v1 - v2), (v1 - v3)));
+		PackedVertex packed = {};
+		for (size_t i = 0; i < 3; ++i)
+			packed.position[i] = quantize_unorm16(size[i] > 0.0f ? (vertex.position[i] - min[i]) / size[i] : 0.0f);
 
-			m_vertices[m_indices[i]].normal += n;
-			m_vertices[m_indices[i + 1]].normal += n;
-			m_vertices[m_indices[i + 2]].normal += n;
-		}
+		packed.uv[0] = float_to_half(vertex.uv.x);
+		packed.uv[1] = float_to_half(vertex.uv.y);
 
-		// Normalize
-		for (size_t i = 0; i < m_vertices.size(); ++i)
-			m_vertices[i].normal = glm::normalize(m_vertices[i].normal);
+		const glm::vec2 normal = encode_octahedral(vertex.normal);
+		packed.normal[0] = quantize_snorm16(normal.x);
+		packed.normal[1] = quantize_snorm16(normal.y);
 
-		vk::DeviceSize buffer_size = sizeof(m_vertices[0]) * m_vertices.size();
+		const glm::vec2 tangent = encode_octahedral(vertex.tangent);
+		packed.tangent[0] = quantize_snorm16(tangent.x);
+		packed.tangent[1] = quantize_snorm16(tangent.y);
 
-		// Create staging buffer
-		VkMemBuffer staging_buffer = m_graphics->create_buffer
-		(
-			buffer_size,
-			vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-		);
+		return packed;
+	}
 
-		// Put vertices into the buffer
-		void* data = m_graphics->get_logical_device().mapMemory(staging_buffer.memory, 0, buffer_size);
-		memcpy(data, m_vertices.data(), static_cast<size_t>(buffer_size));
-		m_graphics->get_logical_device().unmapMemory(staging_buffer.memory);
+	Vertex PackedVertex::unpack(const AABB& aabb) const
+	{
+		const glm::vec3 min = aabb.center - aabb.extent;
+		const glm::vec3 size = aabb.extent * 2.0f;
 
-		// Copy data from staging buffer into the vertex buffer
-		m_graphics->copy_buffer(staging_buffer.buffer, m_vertex_buffer.buffer, buffer_size);
+		Vertex vertex = {};
+		for (size_t i = 0; i < 3; ++i)
+			vertex.position[i] = min[i] + (dequantize_unorm16(position[i]) * size[i]);
 
-		// Free the staging buffer
-		staging_buffer.free(m_graphics->get_logical_device());
+		vertex.uv = glm::vec2(half_to_float(uv[0]), half_to_float(uv[1]));
+		vertex.normal = decode_octahedral(glm::vec2(dequantize_snorm16(normal[0]), dequantize_snorm16(normal[1])));
+		vertex.tangent = decode_octahedral(glm::vec2(dequantize_snorm16(tangent[0]), dequantize_snorm16(tangent[1])));
+		return vertex;
 	}
 
-	void Mesh::init_index_buffer()
+	/**
+	 * @brief Find the angle between two directions.
+	 * @param First direction.
+	 * @param Second direction. Must be unit length.
+	 * @return Angle in degrees. Zero if the first direction has no length.
+	 */
+	static float angle_between(const glm::vec3& a, const glm::vec3& b)
 	{
-		vk::DeviceSize buffer_size = sizeof(m_indices[0]) * m_indices.size();
+		const float length = glm::length(a);
+		if (length == 0.0f)
+			return 0.0f;
 
-		// Create staging buffer
-		VkMemBuffer staging_buffer = m_graphics->create_buffer
-		(
-			buffer_size,
-			vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-		);
+		return glm::degrees(std::acos(std::min(std::max(glm::dot(a / length, b), -1.0f), 1.0f)));
+	}
 
-		// Put indices into the bfufer
-		void* data = m_graphics->get_logical_device().mapMemory(staging_buffer.memory, 0, buffer_size);
-		memcpy(data, m_indices.data(), static_cast<size_t>(buffer_size));
-		m_graphics->get_logical_device().unmapMemory(staging_buffer.memory);
+	VertexPackingError measure_packing_error(const std::vector<Vertex>& vertices, const AABB& aabb)
+	{
+		VertexPackingError error = {};
+		for (const auto& vertex : vertices)
+		{
+			const Vertex unpacked = PackedVertex::pack(vertex, aabb).unpack(aabb);
+			error.position = std::max(error.position, glm::length(unpacked.position - vertex.position));
+			error.uv = std::max(error.uv, glm::length(unpacked.uv - vertex.uv));
+			error.normal = std::max(error.normal, angle_between(vertex.normal, unpacked.normal));
+			error.tangent = std::max(error.tangent, angle_between(vertex.tangent, unpacked.tangent));
+		}
 
-		// Create index buffer
-		m_index_buffer = m_graphics->create_buffer
-		(
-			buffer_size,
-			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-			vk::MemoryPropertyFlagBits::eDeviceLocal
-		);
+		return error;
+	}
 
-		// Copy data from staging buffer into the index buffer
-		m_graphics->copy_buffer(staging_buffer.buffer, m_index_buffer.buffer, buffer_size);
 
-		// Free the staging buffer
-		staging_buffer.free(m_graphics->get_logical_device());
+
+	size_t get_vertex_size(VertexFormat vertex_format)
+	{
+		return vertex_format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
 	}
 
-	void Mesh::init_vertex_buffer()
+	size_t get_index_size(vk::IndexType index_type)
 	{
-		vk::DeviceSize buffer_size = sizeof(m_vertices[0]) * m_vertices.size();
+		return index_type == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
 
-		// Create staging buffer
-		VkMemBuffer staging_buffer = m_graphics->create_buffer
-		(
-			buffer_size,
-			vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-		);
+	vk::IndexType choose_index_type(size_t vertex_count)
+	{
+		// Small meshes use half as much memory
+		return vertex_count <= static_cast<size_t>(std::numeric_limits<uint16_t>::max()) + 1 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+	}
 
-		// Put vertices into the buffer
-		void* data = m_graphics->get_logical_device().mapMemory(staging_buffer.memory, 0, buffer_size);
-		memcpy(data, m_vertices.data(), static_cast<size_t>(buffer_size));
-		m_graphics->get_logical_device().unmapMemory(staging_buffer.memory);
+	void encode_vertices(const std::vector<Vertex>& vertices, const AABB& aabb, VertexFormat vertex_format, std::vector<char>& data)
+	{
+		data.resize(get_vertex_size(vertex_format) * vertices.size());
 
-		// Create vertex buffer
-		m_vertex_buffer = m_graphics->create_buffer
-		(
-			buffer_size,
-			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-			vk::MemoryPropertyFlagBits::eDeviceLocal
-		);
+		// Full precision vertices are used as is
+		if (vertex_format == VertexFormat::Standard)
+		{
+			if (vertices.size() > 0)
+				std::memcpy(data.data(), vertices.data(), data.size());
 
-		// Copy data from staging buffer into the vertex buffer
-		m_graphics->copy_buffer(staging_buffer.buffer, m_vertex_buffer.buffer, buffer_size);
+			return;
+		}
 
-		// Free the staging buffer
-		staging_buffer.free(m_graphics->get_logical_device());
+		// Packed vertices are quantized relative to the AABB
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			const PackedVertex packed = PackedVertex::pack(vertices[i], aabb);
+			std::memcpy(data.data() + (sizeof(PackedVertex) * i), &packed, sizeof(PackedVertex));
+		}
 	}
 
-	void Mesh::calculate_tangents()
+	void encode_indices(const std::vector<uint32_t>& indices, vk::IndexType index_type, std::vector<char>& data)
 	{
-		// Free buffers if needed
-		if (m_index_buffer.buffer && m_index_buffer.memory)
-			m_index_buffer.free(m_graphics->get_logical_device());
+		data.resize(get_index_size(index_type) * indices.size());
 
-		if (m_vertex_buffer.buffer && m_vertex_buffer.memory)
-			m_vertex_buffer.free(m_graphics->get_logical_device());
+		if (index_type == vk::IndexType::eUint32)
+		{
+			if (indices.size() > 0)
+				std::memcpy(data.data(), indices.data(), data.size());
+
+			return;
+		}
+
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			dk_assert(indices[i] <= std::numeric_limits<uint16_t>::max());
+			const uint16_t index = static_cast<uint16_t>(indices[i]);
+			std::memcpy(data.data() + (sizeof(uint16_t) * i), &index, sizeof(uint16_t));
+		}
+	}
 
-		for (size_t i = 0; i < m_indices.size(); i += 3)
+
+
+	void calculate_tangents(const std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+	{
+		for (size_t i = 0; i < indices.size(); i += 3)
 		{
-			Vertex& v0 = m_vertices[m_indices[i]];
-			Vertex& v1 = m_vertices[m_indices[i + 1]];
-			Vertex& v2 = m_vertices[m_indices[i + 2]];
+			Vertex& v0 = vertices[indices[i]];
+			Vertex& v1 = vertices[indices[i + 1]];
+			Vertex& v2 = vertices[indices[i + 2]];
 
 			const auto edge1 = v1.position - v0.position;
 			const auto edge2 = v2.position - v0.position;
@@ -209,20 +244,44 @@ namespace dk
 			v2.tangent += tangent;
 		}
 
-		for (size_t i = 0; i < m_vertices.size(); ++i)
-			m_vertices[i].tangent = glm::normalize(m_vertices[i].tangent);
+		for (size_t i = 0; i < vertices.size(); ++i)
+			vertices[i].tangent = glm::normalize(vertices[i].tangent);
+	}
+
+	void calculate_normals(const std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+	{
+		// Zero out normals
+		for (size_t i = 0; i < vertices.size(); ++i)
+			vertices[i].normal = glm::vec3(0);
+
+		// Compute normals
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			auto v1 = vertices[indices[i]].position;
+			auto v2 = vertices[indices[i + 1]].position;
+			auto v3 = vertices[indices[i + 2]].position;
+
+			glm::vec3 n = glm::normalize(glm::cross((v1 - v2), (v1 - v3)));
+
+			vertices[indices[i]].normal += n;
+			vertices[indices[i + 1]].normal += n;
+			vertices[indices[i + 2]].normal += n;
+		}
 
-		init_vertex_buffer();
-		init_index_buffer();
+		// Normalize
+		for (size_t i = 0; i < vertices.size(); ++i)
+			vertices[i].normal = glm::normalize(vertices[i].normal);
 	}
 
-	void Mesh::calculate_aabb()
+	AABB calculate_aabb(const std::vector<Vertex>& vertices)
 	{
 		// Reset bounding box
 		glm::vec3 min = {}, max = {};
+		if (vertices.size() > 0)
+			min = max = vertices[0].position;
 
 		// Loop over every vertex finding the min and max values.
-		for (auto& vertex : m_vertices)
+		for (auto& vertex : vertices)
 		{
 			if (vertex.position.x < min.x) min.x = vertex.position.x;
 			if (vertex.position.x > max.x) max.x = vertex.position.x;
@@ -234,7 +293,228 @@ namespace dk
 			if (vertex.position.z > max.z) max.z = vertex.position.z;
 		}
 
-		m_aabb.center = (min + max) / 2.0f;
-		m_aabb.extent = (max - min) / 2.0f;
+		AABB aabb = {};
+		aabb.center = (min + max) / 2.0f;
+		aabb.extent = (max - min) / 2.0f;
+		return aabb;
+	}
+
+	AABB calculate_aabb(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t first_index, size_t index_count)
+	{
+		AABB aabb = {};
+		if (index_count == 0)
+			return aabb;
+
+		glm::vec3 min = vertices[indices[first_index]].position;
+		glm::vec3 max = min;
+
+		for (size_t i = first_index; i < first_index + index_count; ++i)
+		{
+			min = glm::min(min, vertices[indices[i]].position);
+			max = glm::max(max, vertices[indices[i]].position);
+		}
+
+		aabb.center = (min + max) / 2.0f;
+		aabb.extent = (max - min) / 2.0f;
+		return aabb;
+	}
+
+	std::vector<SubMesh> split_sub_meshes(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t max_triangles)
+	{
+		const auto parts = split_mesh(indices, vertices.size() > 0 ? &vertices[0].position.x : nullptr, sizeof(Vertex), max_triangles);
+
+		std::vector<SubMesh> sub_meshes = {};
+		for (const auto& part : parts)
+		{
+			SubMesh sub_mesh = {};
+			sub_mesh.first_index = static_cast<uint32_t>(part.first_index);
+			sub_mesh.index_count = static_cast<uint32_t>(part.index_count);
+			sub_mesh.aabb = calculate_aabb(indices, vertices, part.first_index, part.index_count);
+			sub_meshes.push_back(sub_mesh);
+		}
+
+		// Meshes without triangles still have something to draw
+		if (sub_meshes.empty())
+			sub_meshes.push_back(SubMesh());
+
+		return sub_meshes;
+	}
+
+
+
+	Mesh::Mesh() {}
+
+	Mesh::Mesh
+	(
+		Graphics* graphics,
+		const std::vector<uint32_t>& indices,
+		const std::vector<Vertex>& vertices,
+		VertexFormat vertex_format
+	) :
+		m_graphics(graphics),
+		m_vertex_buffer({}),
+		m_vertex_format(vertex_format),
+		m_index_type(choose_index_type(vertices.size())),
+		m_index_count(indices.size()),
+		m_cpu_data(true),
+		m_indices(indices),
+		m_vertices(vertices)
+	{
+		m_aabb = calculate_aabb(m_vertices);
+		calculate_tangents(m_indices, m_vertices);
+
+		if (!m_graphics->is_headless())
+		{
+			std::vector<char> vertex_data = {};
+			encode_vertices(m_vertices, m_aabb, m_vertex_format, vertex_data);
+			init_vertex_buffer(vertex_data.data(), vertex_data.size());
+
+			std::vector<char> index_data = {};
+			encode_indices(m_indices, m_index_type, index_data);
+			init_index_buffer(index_data.data(), index_data.size());
+		}
+
+		// Everything is drawn at once until the mesh is split
+		SubMesh sub_mesh = {};
+		sub_mesh.index_count = static_cast<uint32_t>(m_indices.size());
+		sub_mesh.aabb = m_aabb;
+		m_sub_meshes.push_back(sub_mesh);
+	}
+
+	Mesh::Mesh(Graphics* graphics, const MeshView& data) :
+		m_graphics(graphics),
+		m_vertex_buffer({}),
+		m_vertex_format(data.vertex_format),
+		m_index_type(data.index_type),
+		m_index_count(data.index_count),
+		m_cpu_data(false),
+		m_sub_meshes(data.sub_meshes, data.sub_meshes + data.sub_mesh_count),
+		m_aabb(data.aabb)
+	{
+		dk_assert(m_sub_meshes.size() > 0);
+
+		// Occluders are rasterized on the CPU, so they keep their positions and indices
+		if (data.occluder_positions && data.occluder_indices)
+		{
+			m_occluder_positions.assign(data.occluder_positions, data.occluder_positions + data.vertex_count);
+			m_occluder_indices.assign(data.occluder_indices, data.occluder_indices + data.index_count);
+		}
+
+		// Copied straight into the staging buffer
+		if (!m_graphics->is_headless())
+		{
+			init_vertex_buffer(data.vertices, get_vertex_size(data.vertex_format) * data.vertex_count);
+			init_index_buffer(data.indices, get_index_size(data.index_type) * data.index_count);
+		}
+	}
+
+	void Mesh::free()
+	{
+		if (m_graphics && !m_graphics->is_headless())
+		{
+			m_graphics->get_upload_manager().wait(m_upload_ticket);
+			m_vertex_buffer.free(m_graphics->get_logical_device());
+			m_index_buffer.free(m_graphics->get_logical_device());
+		}
+	}
+
+	bool Mesh::get_occluder(const float*& positions, size_t& stride, const uint32_t*& indices) const
+	{
+		if (m_cpu_data && m_vertices.size() > 0)
+		{
+			positions = &m_vertices[0].position.x;
+			stride = sizeof(Vertex);
+			indices = m_indices.data();
+			return true;
+		}
+
+		if (m_occluder_positions.size() > 0)
+		{
+			positions = &m_occluder_positions[0].x;
+			stride = sizeof(glm::vec3);
+			indices = m_occluder_indices.data();
+			return true;
+		}
+
+		return false;
+	}
+
+	PackedVertexBounds Mesh::get_packed_vertex_bounds() const
+	{
+		PackedVertexBounds bounds = {};
+		bounds.offset = glm::vec4(m_aabb.center - m_aabb.extent, 0.0f);
+		bounds.scale = glm::vec4(m_aabb.extent * 2.0f, 0.0f);
+		return bounds;
+	}
+
+	void Mesh::add_lod(HMesh mesh, float screen_size)
+	{
+		dk_assert(mesh.allocator);
+		dk_assert(screen_size > 0.0f);
+		dk_assert(m_lod_screen_sizes.empty() || screen_size < m_lod_screen_sizes.back());
+
+		m_lods.push_back(mesh);
+		m_lod_screen_sizes.push_back(screen_size);
+	}
+
+	void Mesh::split(size_t max_triangles)
+	{
+		dk_assert(m_cpu_data);
+		m_sub_meshes = split_sub_meshes(m_indices, m_vertices, max_triangles);
+
+		if (m_graphics->is_headless())
+			return;
+
+		// Upload the reordered indices
+		std::vector<char> index_data = {};
+		encode_indices(m_indices, m_index_type, index_data);
+
+		m_graphics->get_upload_manager().wait(m_upload_ticket);
+		m_index_buffer.free(m_graphics->get_logical_device());
+		init_index_buffer(index_data.data(), index_data.size());
+	}
+
+	void Mesh::compute_normals()
+	{
+		dk_assert(m_cpu_data);
+		calculate_normals(m_indices, m_vertices);
+
+		if (!m_graphics->is_headless())
+			upload_vertices();
+	}
+
+	void Mesh::init_index_buffer(const void* data, vk::DeviceSize size)
+	{
+		// Create index buffer
+		m_index_buffer = m_graphics->create_buffer
+		(
+			size,
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal
+		);
+
+		// Upload indices into the index buffer
+		m_upload_ticket = m_graphics->get_upload_manager().upload_buffer(data, size, m_index_buffer.buffer);
+	}
+
+	void Mesh::init_vertex_buffer(const void* data, vk::DeviceSize size)
+	{
+		// Create vertex buffer
+		m_vertex_buffer = m_graphics->create_buffer
+		(
+			size,
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal
+		);
+
+		// Upload vertices into the vertex buffer
+		m_upload_ticket = m_graphics->get_upload_manager().upload_buffer(data, size, m_vertex_buffer.buffer);
+	}
+
+	void Mesh::upload_vertices()
+	{
+		std::vector<char> vertex_data = {};
+		encode_vertices(m_vertices, m_aabb, m_vertex_format, vertex_data);
+		m_upload_ticket = m_graphics->get_upload_manager().upload_buffer(vertex_data.data(), vertex_data.size(), m_vertex_buffer.buffer);
 	}
 }
\ No newline at end of file
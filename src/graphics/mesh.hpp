@@ -66,8 +66,259 @@ namespace dk
 
 
 
+	/**
+	 * @brief Layout of the vertices in a vertex buffer.
+	 */
+	enum class VertexFormat
+	{
+		/** Vertex. Full precision floats. */
+		Standard = 0,
+
+		/** PackedVertex. Quantized to less than half the size. */
+		Packed = 1
+	};
+
+
+
+	/**
+	 * @brief Packed vertex information.
+	 * @note Positions are 16 bit unsigned normalized integers relative to the meshes AABB,
+	 *       UVs are half floats, and normals and tangents are octahedral encoded 16 bit
+	 *       signed normalized integers. 20 bytes instead of 44.
+	 */
+	struct PackedVertex
+	{
+		/** Position relative to the AABB. The last component is padding. */
+		uint16_t position[4] = {};
+
+		/** UV coordinate as half floats. */
+		uint16_t uv[2] = {};
+
+		/** Octahedral encoded normal. */
+		int16_t normal[2] = {};
+
+		/** Octahedral encoded tangent. */
+		int16_t tangent[2] = {};
+
+		/**
+		 * @brief Description of vertex bindings used by Vulkan.
+		 * @note Binding description.
+		 */
+		static vk::VertexInputBindingDescription get_binding_description();
+
+		/**
+		 * @brief Array of descriptions for each vertex input.
+		 * @note Vertex input descriptions. Locations match Vertex.
+		 */
+		static std::array<vk::VertexInputAttributeDescription, 4> get_attribute_descriptions();
+
+		/**
+		 * @brief Pack a vertex.
+		 * @param Vertex.
+		 * @param AABB containing the vertex.
+		 * @return Packed vertex.
+		 */
+		static PackedVertex pack(const Vertex& vertex, const AABB& aabb);
+
+		/**
+		 * @brief Unpack the vertex.
+		 * @param AABB the vertex was packed with.
+		 * @return Vertex as the vertex shader sees it.
+		 */
+		Vertex unpack(const AABB& aabb) const;
+	};
+
+	/**
+	 * @brief Data vertex shaders need to unpack positions.
+	 * @note Pushed to the vertex stage at PackedVertexBounds::push_constant_offset.
+	 *       Position = offset + (packed position * scale).
+	 */
+	struct PackedVertexBounds
+	{
+		/** Push constant offset. Fragment shaders own everything before it. */
+		static const uint32_t push_constant_offset = 16;
+
+		/** Position of the AABB corner packed positions start from. */
+		glm::vec4 offset = {};
+
+		/** Size of the AABB. */
+		glm::vec4 scale = {};
+	};
+
+	/**
+	 * @brief Largest error packing caused in a set of vertices.
+	 */
+	struct VertexPackingError
+	{
+		/** Distance between positions. */
+		float position = 0.0f;
+
+		/** Distance between UVs. */
+		float uv = 0.0f;
+
+		/** Angle between normals in degrees. */
+		float normal = 0.0f;
+
+		/** Angle between tangents in degrees. */
+		float tangent = 0.0f;
+	};
+
+	/**
+	 * @brief Measure the error of packing vertices.
+	 * @param Vertices.
+	 * @param AABB containing every vertex.
+	 * @return Largest error of each attribute.
+	 */
+	extern VertexPackingError measure_packing_error(const std::vector<Vertex>& vertices, const AABB& aabb);
+
+
+
+	/**
+	 * @brief A range of a meshes triangles that is drawn and culled on its own.
+	 */
+	struct SubMesh
+	{
+		/** Index of the first index. */
+		uint32_t first_index = 0;
+
+		/** Number of indices. */
+		uint32_t index_count = 0;
+
+		/** AABB of the triangles. */
+		AABB aabb = {};
+	};
+
+	/**
+	 * @brief Mesh data laid out the way the GPU reads it.
+	 * @note Points at memory owned by someone else, like a cooked mesh file.
+	 */
+	struct MeshView
+	{
+		/** Vertex buffer contents. Tangents must already be calculated. */
+		const void* vertices = nullptr;
+
+		/** Number of vertices. */
+		size_t vertex_count = 0;
+
+		/** Layout of the vertices. */
+		VertexFormat vertex_format = VertexFormat::Standard;
+
+		/** Index buffer contents. */
+		const void* indices = nullptr;
+
+		/** Number of indices. */
+		size_t index_count = 0;
+
+		/** Type of the indices. */
+		vk::IndexType index_type = vk::IndexType::eUint32;
+
+		/** Sub meshes. */
+		const SubMesh* sub_meshes = nullptr;
+
+		/** Number of sub meshes. Must be at least one. */
+		size_t sub_mesh_count = 0;
+
+		/** AABB of every vertex. */
+		AABB aabb = {};
+
+		/** Position of each vertex, for rasterizing the mesh as an occluder. Null if the mesh wasn't cooked as one. */
+		const glm::vec3* occluder_positions = nullptr;
+
+		/** Indices into the occluder positions. Ordered like the index buffer so sub meshes cover the same triangles. */
+		const uint32_t* occluder_indices = nullptr;
+	};
+
+	/**
+	 * @brief Get the size of a vertex.
+	 * @param Vertex format.
+	 * @return Size in bytes.
+	 */
+	extern size_t get_vertex_size(VertexFormat vertex_format);
+
+	/**
+	 * @brief Get the size of an index.
+	 * @param Index type.
+	 * @return Size in bytes.
+	 */
+	extern size_t get_index_size(vk::IndexType index_type);
+
+	/**
+	 * @brief Choose the smallest index type that can address every vertex.
+	 * @param Number of vertices.
+	 * @return Index type.
+	 */
+	extern vk::IndexType choose_index_type(size_t vertex_count);
+
+	/**
+	 * @brief Lay vertices out the way a vertex buffer reads them.
+	 * @param Vertices with tangents.
+	 * @param AABB of the vertices. Packed positions are relative to it.
+	 * @param Vertex format.
+	 * @param Vertex buffer contents to fill.
+	 */
+	extern void encode_vertices(const std::vector<Vertex>& vertices, const AABB& aabb, VertexFormat vertex_format, std::vector<char>& data);
+
+	/**
+	 * @brief Lay indices out the way an index buffer reads them.
+	 * @param Indices.
+	 * @param Index type. Every index must fit in it.
+	 * @param Index buffer contents to fill.
+	 */
+	extern void encode_indices(const std::vector<uint32_t>& indices, vk::IndexType index_type, std::vector<char>& data);
+
+	/**
+	 * @brief Calculate vertex tangents from UVs.
+	 * @param Indices.
+	 * @param Vertices. Tangents are added to the existing ones and normalized.
+	 */
+	extern void calculate_tangents(const std::vector<uint32_t>& indices, std::vector<Vertex>& vertices);
+
+	/**
+	 * @brief Calculate smooth vertex normals.
+	 * @param Indices.
+	 * @param Vertices. Normals are replaced.
+	 */
+	extern void calculate_normals(const std::vector<uint32_t>& indices, std::vector<Vertex>& vertices);
+
+	/**
+	 * @brief Calculate the AABB of a set of vertices.
+	 * @param Vertices.
+	 * @return AABB.
+	 */
+	extern AABB calculate_aabb(const std::vector<Vertex>& vertices);
+
+	/**
+	 * @brief Calculate the AABB of a range of indices.
+	 * @param Indices.
+	 * @param Vertices.
+	 * @param First index.
+	 * @param Number of indices.
+	 * @return AABB.
+	 */
+	extern AABB calculate_aabb(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t first_index, size_t index_count);
+
+	/**
+	 * @brief Split triangles into spatially compact sub meshes.
+	 * @param Indices. Triangles are reordered so each sub mesh is a contiguous range.
+	 * @param Vertices.
+	 * @param Most triangles a sub mesh may have.
+	 * @return Sub meshes. At least one even if there are no triangles.
+	 */
+	extern std::vector<SubMesh> split_sub_meshes(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t max_triangles);
+
+
+
+	class Mesh;
+
+	/** Handle to a mesh. */
+	using HMesh = Handle<Mesh>;
+
 	/**
 	 * @brief Container of mesh data.
+	 * @note Meshes made from vertices and indices keep a copy of them on the CPU. Meshes made
+	 *       from a MeshView upload it as is and only keep their bounds and sub meshes.
+	 * @note Meshes made with a headless graphics context have no buffers, so they can be
+	 *       culled and sorted but not drawn.
 	 */
 	class Mesh
 	{
@@ -83,9 +334,25 @@ namespace dk
 		 * @param Graphics context.
 		 * @param Indices.
 		 * @param Vertices.
+		 * @param Layout of the vertex buffer. Must match the shaders the mesh is drawn with.
 		 * @note Tangents will be calculated, so don't worry about doing that yourself.
+		 * @note 16 bit indices are uploaded when every vertex can be addressed by them.
+		 */
+		Mesh
+		(
+			Graphics* graphics,
+			const std::vector<uint32_t>& indices,
+			const std::vector<Vertex>& vertices,
+			VertexFormat vertex_format = VertexFormat::Standard
+		);
+
+		/**
+		 * @brief Constructor for prepared mesh data.
+		 * @param Graphics context.
+		 * @param Mesh data. Uploaded as it is, and not kept on the CPU apart from bounds, sub meshes, and occluder data.
+		 * @note The vertex format must match the shaders the mesh is drawn with.
 		 */
-		Mesh(Graphics* graphics, const std::vector<uint16_t>& indices, const std::vector<Vertex>& vertices);
+		Mesh(Graphics* graphics, const MeshView& data);
 
 		/**
 		 * @brief Destructor.
@@ -98,6 +365,15 @@ namespace dk
 		 */
 		void free();
 
+		/**
+		 * @brief Check if the mesh has been uploaded.
+		 * @return If the mesh is resident. False for placeholders of streamed meshes.
+		 */
+		bool is_resident() const
+		{
+			return m_graphics != nullptr;
+		}
+
 		/**
 		 * @brief Get vertex memory buffer.
 		 * @return Vertex memory buffer.
@@ -107,6 +383,21 @@ namespace dk
 			return m_vertex_buffer;
 		}
 
+		/**
+		 * @brief Get the layout of the vertex buffer.
+		 * @return Vertex format.
+		 */
+		VertexFormat get_vertex_format() const
+		{
+			return m_vertex_format;
+		}
+
+		/**
+		 * @brief Get the data vertex shaders need to unpack positions.
+		 * @return Packed vertex bounds.
+		 */
+		PackedVertexBounds get_packed_vertex_bounds() const;
+
 		/**
 		 * @brief Get index memory buffer.
 		 * @return Index memory buffer.
@@ -116,15 +407,60 @@ namespace dk
 			return m_index_buffer;
 		}
 
+		/**
+		 * @brief Get the type of the indices in the index buffer.
+		 * @return Index type.
+		 */
+		vk::IndexType get_index_type() const
+		{
+			return m_index_type;
+		}
+
 		/**
 		 * @brief Get index count.
 		 * @return Index count.
 		 */
 		size_t get_index_count() const
 		{
-			return m_indices.size();
+			return m_index_count;
+		}
+
+		/**
+		 * @brief Check if the vertices and indices are kept on the CPU.
+		 * @return If they are. False for meshes made from a MeshView.
+		 */
+		bool has_cpu_data() const
+		{
+			return m_cpu_data;
+		}
+
+		/**
+		 * @brief Get indices.
+		 * @return Indices. Empty unless has_cpu_data().
+		 */
+		const std::vector<uint32_t>& get_indices() const
+		{
+			return m_indices;
+		}
+
+		/**
+		 * @brief Get vertices.
+		 * @return Vertices. Empty unless has_cpu_data().
+		 */
+		const std::vector<Vertex>& get_vertices() const
+		{
+			return m_vertices;
 		}
 
+		/**
+		 * @brief Get the triangles to rasterize when the mesh hides objects behind it.
+		 * @param Pointer to the first vertex position to fill.
+		 * @param Distance in bytes between vertex positions to fill.
+		 * @param Indices to fill. Sub meshes cover the same ranges of them as of the index buffer.
+		 * @return If the mesh has anything to rasterize. Meshes made from a MeshView only do if it was cooked as an occluder.
+		 */
+		bool get_occluder(const float*& positions, size_t& stride, const uint32_t*& indices) const;
+
 		/**
 		 * @brief Get AABB bounding box.
 		 * @return AABB.
@@ -134,37 +470,91 @@ namespace dk
 			return m_aabb;
 		}
 
+		/**
+		 * @brief Get sub meshes.
+		 * @return Sub meshes. Unsplit meshes have one covering every triangle.
+		 */
+		const std::vector<SubMesh>& get_sub_meshes() const
+		{
+			return m_sub_meshes;
+		}
+
 		/**
 		 * @brief Compute normals.
+		 * @note The mesh must have CPU data.
 		 */
 		void compute_normals();
 
-	private:
+		/**
+		 * @brief Split the mesh into spatially compact sub meshes.
+		 * @param Most triangles a sub mesh may have.
+		 * @note Triangles are reordered so each sub mesh is a contiguous range of indices.
+		 * @note The mesh must have CPU data.
+		 */
+		void split(size_t max_triangles);
 
 		/**
-		 * @brief Initialize the index buffer.
+		 * @brief Add a less detailed level.
+		 * @param Mesh to draw at the new level.
+		 * @param Screen size the level is used below. Must be smaller than the previous levels.
+		 * @note Screen sizes are measured by get_screen_size().
 		 */
-		void init_index_buffer();
+		void add_lod(HMesh mesh, float screen_size);
 
 		/**
-		 * @brief Initialize the vertex buffer.
+		 * @brief Get the number of detail levels.
+		 * @return Number of detail levels, including this mesh.
 		 */
-		void init_vertex_buffer();
+		size_t get_lod_count() const
+		{
+			return m_lods.size() + 1;
+		}
 
 		/**
-		 * @brief Calculate tangents and reinitialize buffers.
+		 * @brief Get the mesh drawn at a detail level.
+		 * @param Detail level. Must be greater than zero since level zero is this mesh.
+		 * @return Mesh.
 		 */
-		void calculate_tangents();
+		HMesh get_lod(size_t level) const
+		{
+			dk_assert(level > 0 && level <= m_lods.size());
+			return m_lods[level - 1];
+		}
 
 		/**
-		 * @brief Calculate AABB bounding box.
+		 * @brief Get the screen size each level past the first is used below.
+		 * @return Screen sizes.
 		 */
-		void calculate_aabb();
+		const std::vector<float>& get_lod_screen_sizes() const
+		{
+			return m_lod_screen_sizes;
+		}
 
+	private:
+
+		/**
+		 * @brief Create the index buffer and upload indices into it.
+		 * @param Index buffer contents.
+		 * @param Size of the contents in bytes.
+		 */
+		void init_index_buffer(const void* data, vk::DeviceSize size);
+
+		/**
+		 * @brief Create the vertex buffer and upload vertices into it.
+		 * @param Vertex buffer contents.
+		 * @param Size of the contents in bytes.
+		 */
+		void init_vertex_buffer(const void* data, vk::DeviceSize size);
+
+		/**
+		 * @brief Upload the CPU vertices into the vertex buffer in the meshes vertex format.
+		 */
+		void upload_vertices();
 
 
-		/** Graphics context. */
-		Graphics* m_graphics;
+
+		/** Graphics context. Null until the mesh is resident. */
+		Graphics* m_graphics = nullptr;
 
 		/** Vertex buffer. */
 		VkMemBuffer m_vertex_buffer;
@@ -172,16 +562,43 @@ namespace dk
 		/** Index buffer. */
 		VkMemBuffer m_index_buffer;
 
+		/** Ticket of the last upload to the buffers. */
+		uint64_t m_upload_ticket = 0;
+
+		/** Layout of the vertex buffer. */
+		VertexFormat m_vertex_format = VertexFormat::Standard;
+
+		/** Type of the indices in the index buffer. */
+		vk::IndexType m_index_type = vk::IndexType::eUint16;
+
+		/** Number of indices. */
+		size_t m_index_count = 0;
+
+		/** Are the vertices and indices kept on the CPU? */
+		bool m_cpu_data = false;
+
 		/** Indices. */
-		std::vector<uint16_t> m_indices = {};
+		std::vector<uint32_t> m_indices = {};
+
+		/** Sub meshes. */
+		std::vector<SubMesh> m_sub_meshes = {};
 
 		/** Vertices. */
 		std::vector<Vertex> m_vertices = {};
 
 		/** AABB box. */
 		AABB m_aabb = {};
-	};
 
-	/** Handle to a mesh. */
-	using HMesh = Handle<Mesh>;
+		/** Vertex positions rasterized as an occluder. Only kept for meshes made from a MeshView with occluder data. */
+		std::vector<glm::vec3> m_occluder_positions = {};
+
+		/** Indices rasterized as an occluder. Only kept for meshes made from a MeshView with occluder data. */
+		std::vector<uint32_t> m_occluder_indices = {};
+
+		/** Less detailed levels, from most to least detailed. */
+		std::vector<HMesh> m_lods = {};
+
+		/** Screen size each less detailed level is used below. */
+		std::vector<float> m_lod_screen_sizes = {};
+	};
 }
\ No newline at end of file
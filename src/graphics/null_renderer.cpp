@@ -0,0 +1,62 @@
+/**
+ * @file null_renderer.cpp
+ * @brief Duck null renderer source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <chrono>
+#include "null_renderer.hpp"
+
+namespace dk
+{
+	NullRenderer::NullRenderer(Graphics* graphics) :
+		Renderer(graphics, graphics->get_width(), graphics->get_height())
+	{
+
+	}
+
+	void NullRenderer::shutdown()
+	{
+		m_renderable_objects.clear();
+		m_object_bounds.clear();
+	}
+
+	void NullRenderer::render()
+	{
+		const auto start_time = std::chrono::high_resolution_clock::now();
+
+		// Frustum culling
+		m_visible_objects.clear();
+		cull_aabbs(m_main_camera.frustum, m_object_bounds, 0, m_object_bounds.size(), m_visible_objects);
+
+		// Sort by state and then front-to-back
+		sort_draws(m_renderable_objects, m_visible_objects, m_main_camera.position, m_draw_state, m_draw_keys, m_draw_indices);
+
+		// Count the batches the forward renderer would make
+		size_t batch_count = 0;
+		for (size_t i = 0; i < m_draw_indices.size(); ++i)
+			if (i == 0 || !can_batch(m_renderable_objects[m_draw_indices[i - 1]], m_renderable_objects[m_draw_indices[i]]))
+				++batch_count;
+
+		// Record statistics in the same form as the forward renderer
+		FrameStatistics statistics = {};
+		statistics.frame = ++m_frame_count;
+		statistics.submitted_objects = m_renderable_objects.size();
+		statistics.frustum_culled_objects = m_renderable_objects.size() - m_visible_objects.size();
+		statistics.drawn_objects = m_visible_objects.size();
+		statistics.batches = batch_count;
+		statistics.cpu_time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+		m_statistics_history.push(statistics);
+
+		// Clear queues
+		m_renderable_objects.clear();
+		m_object_bounds.clear();
+	}
+
+	void NullRenderer::draw(const RenderableObject& obj)
+	{
+		m_renderable_objects.push_back(obj);
+		m_object_bounds.push_back(obj.bounds);
+	}
+}
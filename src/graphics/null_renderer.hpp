@@ -0,0 +1,111 @@
+#pragma once
+
+/**
+ * @file null_renderer.hpp
+ * @brief Duck renderer that draws nothing.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include "renderer.hpp"
+#include "frame_statistics.hpp"
+
+namespace dk
+{
+	/**
+	 * @brief Renderer for simulation servers and benchmarks.
+	 * @note Submissions are culled, sorted, and batched the same way the forward
+	 *       renderer does it, but nothing touches Vulkan. Meshes only exist on the
+	 *       CPU, and draws carry no material or shader. Occlusion culling is skipped.
+	 *       Statistics only cover culling and batching, since nothing is drawn.
+	 */
+	class NullRenderer : public Renderer
+	{
+	public:
+
+		/**
+		 * @brief Default constructor.
+		 */
+		NullRenderer() = default;
+
+		/**
+		 * @brief Constructor.
+		 * @param Graphics context. May be headless.
+		 */
+		NullRenderer(Graphics* graphics);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~NullRenderer() = default;
+
+		/**
+		 * @brief Shutdown the renderer.
+		 */
+		void shutdown() override;
+
+		/**
+		 * @brief Cull, sort, and batch everything submitted this frame.
+		 */
+		void render() override;
+
+		/**
+		 * @brief Draw a renderable object.
+		 * @param Renderable object.
+		 */
+		void draw(const RenderableObject& obj) override;
+
+		/**
+		 * @brief Draw a point light.
+		 * @param Point light.
+		 */
+		void draw(const PointLightData& point_light) override
+		{
+
+		}
+
+		/**
+		 * @brief Draw a directional light.
+		 * @param Directional light.
+		 */
+		void draw(const DirectionalLightData& dir_light) override
+		{
+
+		}
+
+		/**
+		 * @brief Get the statistics of recently rendered frames.
+		 * @return Statistics history.
+		 */
+		FrameStatisticsHistory& get_statistics_history()
+		{
+			return m_statistics_history;
+		}
+
+	private:
+
+		/** List of renderable objects. */
+		std::vector<RenderableObject> m_renderable_objects = {};
+
+		/** World space bounds of each renderable object. */
+		AABBList m_object_bounds = {};
+
+		/** Indices of renderable objects visible to the main camera. */
+		std::vector<uint32_t> m_visible_objects = {};
+
+		/** Dense indices of the draw state used this frame. */
+		DrawStateIndices m_draw_state = {};
+
+		/** Sort keys of visible objects. */
+		std::vector<uint64_t> m_draw_keys = {};
+
+		/** Indices of visible objects. Sorted alongside the keys. */
+		std::vector<uint32_t> m_draw_indices = {};
+
+		/** Number of frames rendered. */
+		uint64_t m_frame_count = 0;
+
+		/** Statistics of recently rendered frames. */
+		FrameStatisticsHistory m_statistics_history = {};
+	};
+}
@@ -5,10 +5,148 @@
  */
 
 /** Includes. */
+#include <cstring>
+#include <tuple>
+#include <algorithm>
+#include <utilities\sorting.hpp>
 #include "renderer.hpp"
 
 namespace dk
 {
+	uint64_t make_draw_sort_key(uint64_t pass, uint32_t shader, uint32_t material, uint32_t sub_mesh, float depth)
+	{
+		dk_assert(shader < DrawStateIndices::max_shaders);
+		dk_assert(material < DrawStateIndices::max_materials);
+		dk_assert(sub_mesh < DrawStateIndices::max_sub_meshes);
+
+		// The bits of a positive float increase with its value, so the
+		// top half of them make a monotonic quantized depth.
+		uint32_t depth_bits = 0;
+		depth = depth > 0.0f ? depth : 0.0f;
+		memcpy(&depth_bits, &depth, sizeof(float));
+
+		return
+			((pass & 0x3) << 62) |
+			(static_cast<uint64_t>(shader) << 48) |
+			(static_cast<uint64_t>(material) << 32) |
+			(static_cast<uint64_t>(sub_mesh) << 16) |
+			static_cast<uint64_t>(depth_bits >> 16);
+	}
+
+	bool can_batch(const RenderableObject& a, const RenderableObject& b)
+	{
+		return
+			a.shader.id == b.shader.id &&
+			a.material.id == b.material.id &&
+			a.mesh.id == b.mesh.id &&
+			a.sub_mesh == b.sub_mesh &&
+			a.dynamic_offsets == b.dynamic_offsets;
+	}
+
+	void sort_draws
+	(
+		const std::vector<RenderableObject>& objects,
+		const std::vector<uint32_t>& visible,
+		const glm::vec3& camera_position,
+		DrawStateIndices& state,
+		std::vector<uint64_t>& keys,
+		std::vector<uint32_t>& indices
+	)
+	{
+		state.clear();
+		keys.clear();
+		indices.clear();
+
+		// Sort key generation
+		for (const uint32_t i : visible)
+		{
+			const auto& obj = objects[i];
+			const float depth = glm::length(obj.bounds.center - camera_position);
+			keys.push_back(state.make_key(DRAW_PASS_OPAQUE, obj, depth));
+			indices.push_back(i);
+		}
+
+		// Sort by state and then front-to-back
+		if (state.is_exact())
+		{
+			radix_sort(keys, indices);
+			return;
+		}
+
+		// States that share an index could interleave, so compare the states themselves
+		std::vector<uint32_t> order(keys.size());
+		for (uint32_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+		{
+			const auto& obj_a = objects[indices[a]];
+			const auto& obj_b = objects[indices[b]];
+			return 
+				std::make_tuple(keys[a] >> 62, obj_a.shader.id, obj_a.material.id, obj_a.mesh.id, obj_a.sub_mesh, keys[a] & 0xFFFF, a) <
+				std::make_tuple(keys[b] >> 62, obj_b.shader.id, obj_b.material.id, obj_b.mesh.id, obj_b.sub_mesh, keys[b] & 0xFFFF, b);
+		});
+
+		std::vector<uint64_t> sorted_keys(keys.size());
+		std::vector<uint32_t> sorted_indices(indices.size());
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			sorted_keys[i] = keys[order[i]];
+			sorted_indices[i] = indices[order[i]];
+		}
+
+		keys.swap(sorted_keys);
+		indices.swap(sorted_indices);
+	}
+
+
+
+	const uint32_t DrawStateIndices::max_shaders;
+	const uint32_t DrawStateIndices::max_materials;
+	const uint32_t DrawStateIndices::max_sub_meshes;
+
+	void DrawStateIndices::clear()
+	{
+		m_shaders.clear();
+		m_materials.clear();
+		m_sub_meshes.clear();
+		m_exact = true;
+	}
+
+	uint64_t DrawStateIndices::make_key(uint64_t pass, const RenderableObject& obj, float depth)
+	{
+		const uint64_t sub_mesh = (static_cast<uint64_t>(obj.mesh.id) << 32) | obj.sub_mesh;
+
+		return make_draw_sort_key
+		(
+			pass,
+			get_index(m_shaders, obj.shader.id, max_shaders),
+			get_index(m_materials, obj.material.id, max_materials),
+			get_index(m_sub_meshes, sub_mesh, max_sub_meshes),
+			depth
+		);
+	}
+
+	uint32_t DrawStateIndices::get_index(std::unordered_map<uint64_t, uint32_t>& indices, uint64_t id, uint32_t max_indices)
+	{
+		auto it = indices.find(id);
+		if (it != indices.end())
+			return it->second;
+
+		// Out of room, so the rest share the last index
+		if (indices.size() >= max_indices - 1)
+		{
+			m_exact = false;
+			return max_indices - 1;
+		}
+
+		const uint32_t index = static_cast<uint32_t>(indices.size());
+		indices.insert({ id, index });
+		return index;
+	}
+
+
+
 	Renderer::Renderer(Graphics* graphics, int width, int height) : 
 		m_graphics(graphics),
 		m_width(width),
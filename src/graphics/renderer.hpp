@@ -7,14 +7,202 @@
  */
 
 /** Includes. */
+#include <array>
+#include <functional>
+#include <unordered_map>
 #include <utilities\resource_allocator.hpp>
+#include <utilities\culling.hpp>
 #include "graphics.hpp"
 #include "material.hpp"
 #include "mesh.hpp"
 #include "sky_box.hpp"
+#include "lighting.hpp"
 
 namespace dk
 {
+	/** Draw pass an opaque object belongs to. Stored in the top bits of a sort key. */
+	const uint64_t DRAW_PASS_OPAQUE = 0;
+
+	/**
+	 * @brief Camera data structure.
+	 */
+	struct CameraData
+	{
+		/** View-projection matrix. */
+		glm::mat4 vp_mat = {};
+
+		/** View matrix. */
+		glm::mat4 view_mat = {};
+
+		/** Projection matrix. */
+		glm::mat4 proj_mat = {};
+
+		/** Near clipping plane. */
+		float near_plane = 0.1f;
+
+		/** Far clipping plane. */
+		float far_plane = 1000.0f;
+
+		/** Position in space. */
+		glm::vec3 position = {};
+
+		/** View frustum. */
+		Frustum frustum = {};
+
+		/** Sky box. */
+		HSkyBox sky_box = HSkyBox();
+	};
+
+	/**
+	 * @brief An object that can be rendered onto the screen.
+	 */
+	struct RenderableObject
+	{
+		/** Shader. */
+		HMaterialShader shader = {};
+
+		/** Material. */
+		HMaterial material = {};
+
+		/** Mesh. */
+		HMesh mesh = {};
+
+		/** Index of the sub mesh to draw. */
+		uint32_t sub_mesh = 0;
+
+		/** Descriptor sets. */
+		std::vector<vk::DescriptorSet> descriptor_sets = {};
+
+		/** Offsets of the per instance vertex and fragment data in the uniform ring buffer. */
+		std::array<uint32_t, 2> dynamic_offsets = {};
+
+		/** Model matrix. */
+		glm::mat4 model = {};
+
+		/** World space bounding box of the sub mesh. */
+		AABB bounds = {};
+
+		/** Does the mesh hide objects behind it? */
+		bool occluder = false;
+	};
+
+	/**
+	 * @brief Create a sort key for a draw.
+	 * @param Draw pass.
+	 * @param Shader index. Must be less than 2^14.
+	 * @param Material index. Must be less than 2^16.
+	 * @param Sub mesh index. Must be less than 2^16.
+	 * @param Distance from the camera.
+	 * @return Sort key.
+	 * @note Layout from most to least significant bits is
+	 *       pass (2), shader (14), material (16), sub mesh (16), depth (16).
+	 *       Draws sharing state are adjacent and ordered front-to-back.
+	 * @note Indices come from DrawStateIndices so distinct states never share bits.
+	 */
+	extern uint64_t make_draw_sort_key(uint64_t pass, uint32_t shader, uint32_t material, uint32_t sub_mesh, float depth);
+
+	/**
+	 * @brief Check if two renderable objects can be drawn in the same instanced draw call.
+	 * @param First object.
+	 * @param Second object.
+	 * @return If the objects share a shader, material, sub mesh, and per instance data.
+	 */
+	extern bool can_batch(const RenderableObject& a, const RenderableObject& b);
+
+	/**
+	 * @brief Numbers the draw state used in a frame densely so it fits in sort keys.
+	 * @note Indices are handed out in the order states are first seen.
+	 */
+	class DrawStateIndices
+	{
+	public:
+
+		/** Number of shaders a sort key can tell apart. */
+		static const uint32_t max_shaders = 1 << 14;
+
+		/** Number of materials a sort key can tell apart. */
+		static const uint32_t max_materials = 1 << 16;
+
+		/** Number of sub meshes a sort key can tell apart. */
+		static const uint32_t max_sub_meshes = 1 << 16;
+
+		/**
+		 * @brief Default constructor.
+		 */
+		DrawStateIndices() = default;
+
+		/**
+		 * @brief Forget every index. Call at the start of each frame.
+		 */
+		void clear();
+
+		/**
+		 * @brief Create a sort key for a draw.
+		 * @param Draw pass.
+		 * @param Object.
+		 * @param Distance from the camera.
+		 * @return Sort key.
+		 * @note If the frame has more states than the key can tell apart, the extra states
+		 *       share the last index and is_exact() returns false.
+		 */
+		uint64_t make_key(uint64_t pass, const RenderableObject& obj, float depth);
+
+		/**
+		 * @brief Check if every state made so far got its own index.
+		 * @return If sorting by key alone keeps draws sharing state adjacent.
+		 */
+		bool is_exact() const
+		{
+			return m_exact;
+		}
+
+	private:
+
+		/**
+		 * @brief Get the index of an ID, handing out the next one if it's new.
+		 * @param Indices of the IDs seen so far.
+		 * @param ID.
+		 * @param Number of indices that fit in the key.
+		 * @return Index.
+		 */
+		uint32_t get_index(std::unordered_map<uint64_t, uint32_t>& indices, uint64_t id, uint32_t max_indices);
+
+		/** Shader indices. */
+		std::unordered_map<uint64_t, uint32_t> m_shaders = {};
+
+		/** Material indices. */
+		std::unordered_map<uint64_t, uint32_t> m_materials = {};
+
+		/** Sub mesh indices, by mesh ID in the top half and sub mesh in the bottom half. */
+		std::unordered_map<uint64_t, uint32_t> m_sub_meshes = {};
+
+		/** Did every state get its own index? */
+		bool m_exact = true;
+	};
+
+	/**
+	 * @brief Sort visible objects into draw order.
+	 * @param Objects.
+	 * @param Indices of the visible objects.
+	 * @param Camera position.
+	 * @param State indices. Cleared first.
+	 * @param Sort keys to fill in draw order.
+	 * @param Object indices to fill in draw order.
+	 * @note Keys are radix sorted. If the frame has too many states for the keys, objects are
+	 *       compared by their full state instead so draws sharing state still end up adjacent.
+	 */
+	extern void sort_draws
+	(
+		const std::vector<RenderableObject>& objects,
+		const std::vector<uint32_t>& visible,
+		const glm::vec3& camera_position,
+		DrawStateIndices& state,
+		std::vector<uint64_t>& keys,
+		std::vector<uint32_t>& indices
+	);
+
+
+
 	/**
 	 * @brief Renderer base class.
 	 */
@@ -66,6 +254,53 @@ namespace dk
 		 */
 		virtual void resize(int width, int height);
 
+		/**
+		 * @brief Draw a renderable object.
+		 * @param Renderable object.
+		 * @note Renderers that don't draw the scene ignore submissions.
+		 */
+		virtual void draw(const RenderableObject& obj) {}
+
+		/**
+		 * @brief Draw a point light.
+		 * @param Point light.
+		 */
+		virtual void draw(const PointLightData& point_light) {}
+
+		/**
+		 * @brief Draw a directional light.
+		 * @param Directional light.
+		 */
+		virtual void draw(const DirectionalLightData& dir_light) {}
+
+		/**
+		 * @brief Free a resource once the GPU is done with every frame that may use it.
+		 * @param Function that frees the resource.
+		 * @note Renderers without frames in flight free it right away.
+		 */
+		virtual void defer_deletion(std::function<void()> deletion)
+		{
+			deletion();
+		}
+
+		/**
+		 * @brief Set main camera.
+		 * @param Camera data.
+		 */
+		virtual void set_main_camera(const CameraData& data)
+		{
+			m_main_camera = data;
+		}
+
+		/**
+		 * @brief Get main camera.
+		 * @return Main camera
+		 */
+		const CameraData& get_main_camera() const
+		{
+			return m_main_camera;
+		}
+
 		/**
 		 * Get window width.
 		 * @return Window width.
@@ -84,6 +319,11 @@ namespace dk
 			return m_height;
 		}
 
+	protected:
+
+		/** Main camera data. */
+		CameraData m_main_camera = {};
+
 	private:
 
 		/**
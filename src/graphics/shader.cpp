@@ -5,7 +5,6 @@
  */
 
 /** Includes. */
-#include "spirv_cross\spirv_glsl.hpp"
 #include "shader.hpp"
 
 namespace dk
@@ -20,18 +19,8 @@ namespace dk
 		const std::vector<char>& frag_byte_code
 	) : m_graphics(graphics)
 	{
-		{
-			// Analyze fragment shader byte code
-			size_t word_count = frag_byte_code.size() / 4;
-			dk_assert((word_count * 4) == frag_byte_code.size());
-			spirv_cross::CompilerGLSL glsl(reinterpret_cast<const uint32_t*>(frag_byte_code.data()), word_count);
-			
-			// Find sizes for uniform buffers
-			spirv_cross::ShaderResources resources = glsl.get_shader_resources();
-
-			// Get texture count
-			m_texture_count = resources.sampled_images.size();
-		}
+		// Get texture count
+		m_texture_count = static_cast<size_t>(m_graphics->get_shader_cache().reflect({}, frag_byte_code).texture_count);
 
 		// Create shader modules
 		if (vert_byte_code.size() > 0)
@@ -76,7 +65,12 @@ namespace dk
 		// Create pipelines
 		for (size_t i = 0; i < create_info.size(); ++i)
 		{
-			m_pipelines[i] = create_shader_pipeline(m_graphics->get_logical_device(), create_info[i].pipeline_create_info);
+			m_pipelines[i] = create_shader_pipeline
+			(
+				m_graphics->get_logical_device(), 
+				create_info[i].pipeline_create_info, 
+				m_graphics->get_shader_cache().get_pipeline_cache()
+			);
 		}
 	}
 
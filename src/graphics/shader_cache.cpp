@@ -0,0 +1,224 @@
+/**
+ * @file shader_cache.cpp
+ * @brief On disk pipeline and shader reflection cache source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cstring>
+#include <utilities\file_io.hpp>
+#include <utilities\hex.hpp>
+#include "spirv_cross\spirv_glsl.hpp"
+#include "shader_cache.hpp"
+
+namespace dk
+{
+	/** Identifies a reflection cache file. */
+	static const uint32_t reflection_magic = 0x52534B44;
+
+	/** Reflection cache format version. Bump when ShaderReflection changes. */
+	static const uint32_t reflection_version = 2;
+
+	/** Size of a pipeline cache header as of header version one. */
+	static const size_t pipeline_header_size = 16 + VK_UUID_SIZE;
+
+	VkShaderCache::VkShaderCache(vk::PhysicalDevice& physical_device, vk::Device& logical_device, const std::string& prefix) :
+		m_vk_physical_device(physical_device),
+		m_vk_logical_device(logical_device)
+	{
+		const vk::PhysicalDeviceProperties properties = m_vk_physical_device.getProperties();
+
+		// Pipeline caches are only valid for the device that made them
+		m_pipeline_path = prefix + "-pipelines-" + binary_to_hex(reinterpret_cast<const char*>(properties.pipelineCacheUUID), VK_UUID_SIZE) + ".bin";
+		m_reflection_path = prefix + "-reflection.bin";
+
+		std::vector<char> data = {};
+		if (try_read_binary_file(m_pipeline_path, data) && data.size() >= pipeline_header_size)
+		{
+			uint32_t header[4] = {};
+			memcpy(header, data.data(), sizeof(header));
+
+			const bool valid =
+				header[0] >= pipeline_header_size &&
+				header[1] == static_cast<uint32_t>(VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+				header[2] == properties.vendorID &&
+				header[3] == properties.deviceID &&
+				memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+			if (!valid)
+				data.clear();
+		}
+		else
+			data.clear();
+
+		vk::PipelineCacheCreateInfo cache_info = {};
+		cache_info.initialDataSize = data.size();
+		cache_info.pInitialData = data.size() > 0 ? data.data() : nullptr;
+
+		m_vk_pipeline_cache = m_vk_logical_device.createPipelineCache(cache_info);
+		dk_assert(m_vk_pipeline_cache);
+
+		load_reflections();
+	}
+
+	VkShaderCache::~VkShaderCache()
+	{
+		if (m_vk_pipeline_cache)
+			m_vk_logical_device.destroyPipelineCache(m_vk_pipeline_cache);
+	}
+
+	void VkShaderCache::save()
+	{
+		const std::vector<uint8_t> data = m_vk_logical_device.getPipelineCacheData(m_vk_pipeline_cache);
+		if (data.size() > 0)
+			write_binary_file(m_pipeline_path, reinterpret_cast<const char*>(data.data()), data.size());
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_dirty)
+		{
+			save_reflections();
+			m_dirty = false;
+		}
+	}
+
+	ShaderReflection VkShaderCache::reflect(const std::vector<char>& vert_byte_code, const std::vector<char>& frag_byte_code)
+	{
+		const uint64_t hash = hash_binary
+		(
+			frag_byte_code.data(),
+			frag_byte_code.size(),
+			hash_binary(vert_byte_code.data(), vert_byte_code.size())
+		);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_reflections.find(hash);
+
+			if (it != m_reflections.end() && it->second.vert_size == vert_byte_code.size() && it->second.frag_size == frag_byte_code.size())
+				return it->second.reflection;
+		}
+
+		// Missing or stale
+		Entry entry = {};
+		entry.vert_size = static_cast<uint64_t>(vert_byte_code.size());
+		entry.frag_size = static_cast<uint64_t>(frag_byte_code.size());
+		entry.reflection = reflect_byte_code(vert_byte_code, frag_byte_code);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_reflections[hash] = entry;
+		m_dirty = true;
+
+		return entry.reflection;
+	}
+
+	ShaderReflection VkShaderCache::reflect_byte_code(const std::vector<char>& vert_byte_code, const std::vector<char>& frag_byte_code)
+	{
+		ShaderReflection reflection = {};
+
+		if (vert_byte_code.size() > 0)
+		{
+			// Analyze vertex shader byte code
+			size_t word_count = vert_byte_code.size() / 4;
+			dk_assert((word_count * 4) == vert_byte_code.size());
+			spirv_cross::CompilerGLSL glsl(reinterpret_cast<const uint32_t*>(vert_byte_code.data()), word_count);
+
+			// Find sizes for uniform buffers
+			spirv_cross::ShaderResources resources = glsl.get_shader_resources();
+			for (const auto& buffer : resources.uniform_buffers)
+			{
+				const spirv_cross::SPIRType& type = glsl.get_type(buffer.base_type_id);
+				size_t size = glsl.get_declared_struct_size(type);
+
+				if (buffer.name == "MaterialData")
+					reflection.vertex_buffer_size = size;
+				else
+					reflection.inst_vertex_buffer_size = size;
+			}
+		}
+
+		if (frag_byte_code.size() > 0)
+		{
+			// Analyze fragment shader byte code
+			size_t word_count = frag_byte_code.size() / 4;
+			dk_assert((word_count * 4) == frag_byte_code.size());
+			spirv_cross::CompilerGLSL glsl(reinterpret_cast<const uint32_t*>(frag_byte_code.data()), word_count);
+
+			// Find sizes for uniform buffers
+			spirv_cross::ShaderResources resources = glsl.get_shader_resources();
+			for (const auto& buffer : resources.uniform_buffers)
+			{
+				const spirv_cross::SPIRType& type = glsl.get_type(buffer.base_type_id);
+				size_t size = glsl.get_declared_struct_size(type);
+
+				if (buffer.name == "MaterialData")
+					reflection.fragment_buffer_size = size;
+				else
+					reflection.inst_fragment_buffer_size = size;
+			}
+
+			// Get texture count. Material shaders sample the texture table, so they declare how many
+			// textures they use with a specialization constant instead of one sampler per texture.
+			reflection.texture_count = resources.sampled_images.size();
+			for (const auto& constant : glsl.get_specialization_constants())
+				if (glsl.get_name(constant.id) == "DK_TEXTURE_COUNT")
+					reflection.texture_count = glsl.get_constant(constant.id).scalar();
+		}
+
+		return reflection;
+	}
+
+	void VkShaderCache::load_reflections()
+	{
+		std::vector<char> data = {};
+		if (!try_read_binary_file(m_reflection_path, data))
+			return;
+
+		const size_t header_size = sizeof(uint32_t) * 2 + sizeof(uint64_t);
+		const size_t entry_size = sizeof(uint64_t) + sizeof(Entry);
+		if (data.size() < header_size)
+			return;
+
+		uint32_t magic = 0, version = 0;
+		uint64_t count = 0;
+		memcpy(&magic, data.data(), sizeof(uint32_t));
+		memcpy(&version, data.data() + sizeof(uint32_t), sizeof(uint32_t));
+		memcpy(&count, data.data() + sizeof(uint32_t) * 2, sizeof(uint64_t));
+
+		// Throw away caches from other versions or that were cut short
+		if (magic != reflection_magic || version != reflection_version || data.size() != header_size + (count * entry_size))
+			return;
+
+		const char* read = data.data() + header_size;
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			uint64_t hash = 0;
+			Entry entry = {};
+			memcpy(&hash, read, sizeof(uint64_t));
+			memcpy(&entry, read + sizeof(uint64_t), sizeof(Entry));
+			m_reflections[hash] = entry;
+			read += entry_size;
+		}
+	}
+
+	void VkShaderCache::save_reflections()
+	{
+		const size_t header_size = sizeof(uint32_t) * 2 + sizeof(uint64_t);
+		const size_t entry_size = sizeof(uint64_t) + sizeof(Entry);
+		const uint64_t count = static_cast<uint64_t>(m_reflections.size());
+
+		std::vector<char> data(header_size + (m_reflections.size() * entry_size));
+		memcpy(data.data(), &reflection_magic, sizeof(uint32_t));
+		memcpy(data.data() + sizeof(uint32_t), &reflection_version, sizeof(uint32_t));
+		memcpy(data.data() + sizeof(uint32_t) * 2, &count, sizeof(uint64_t));
+
+		char* write = data.data() + header_size;
+		for (const auto& reflection : m_reflections)
+		{
+			memcpy(write, &reflection.first, sizeof(uint64_t));
+			memcpy(write + sizeof(uint64_t), &reflection.second, sizeof(Entry));
+			write += entry_size;
+		}
+
+		write_binary_file(m_reflection_path, data.data(), data.size());
+	}
+}
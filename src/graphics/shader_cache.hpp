@@ -0,0 +1,144 @@
+#pragma once
+
+/**
+ * @file shader_cache.hpp
+ * @brief On disk pipeline and shader reflection cache.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <unordered_map>
+#include <mutex>
+#include "vulkan_utilities.hpp"
+
+namespace dk
+{
+	/**
+	 * @brief Information found by reflecting on shader byte code.
+	 */
+	struct ShaderReflection
+	{
+		/** Size of the vertex shaders material uniform buffer. */
+		uint64_t vertex_buffer_size = 0;
+
+		/** Size of the vertex shaders per instance uniform buffer. */
+		uint64_t inst_vertex_buffer_size = 0;
+
+		/** Size of the fragment shaders material uniform buffer. */
+		uint64_t fragment_buffer_size = 0;
+
+		/** Size of the fragment shaders per instance uniform buffer. */
+		uint64_t inst_fragment_buffer_size = 0;
+
+		/** Number of textures sampled by the fragment shader. */
+		uint64_t texture_count = 0;
+	};
+
+	/**
+	 * @brief Keeps pipeline creation and shader reflection results between runs.
+	 * @note The pipeline cache file is named after the devices pipeline cache UUID,
+	 *       and is thrown away if its header doesn't match the device. Reflection
+	 *       results are keyed by a hash of the byte code and recomputed when the
+	 *       byte code changes.
+	 */
+	class VkShaderCache
+	{
+	public:
+
+		/**
+		 * @brief Constructor.
+		 * @param Physical device.
+		 * @param Logical device.
+		 * @param Path prefix of the cache files.
+		 */
+		VkShaderCache(vk::PhysicalDevice& physical_device, vk::Device& logical_device, const std::string& prefix);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~VkShaderCache();
+
+		/**
+		 * @brief Write the caches to disk.
+		 */
+		void save();
+
+		/**
+		 * @brief Get the pipeline cache.
+		 * @return Pipeline cache.
+		 */
+		vk::PipelineCache& get_pipeline_cache()
+		{
+			return m_vk_pipeline_cache;
+		}
+
+		/**
+		 * @brief Reflect on shader byte code, using cached results if possible.
+		 * @param Vertex shader byte code. May be empty.
+		 * @param Fragment shader byte code. May be empty.
+		 * @return Reflection results.
+		 */
+		ShaderReflection reflect(const std::vector<char>& vert_byte_code, const std::vector<char>& frag_byte_code);
+
+	private:
+
+		/**
+		 * @brief A cached reflection result.
+		 */
+		struct Entry
+		{
+			/** Vertex shader byte code size. Guards against hash collisions. */
+			uint64_t vert_size = 0;
+
+			/** Fragment shader byte code size. Guards against hash collisions. */
+			uint64_t frag_size = 0;
+
+			/** Reflection results. */
+			ShaderReflection reflection = {};
+		};
+
+		/**
+		 * @brief Reflect on shader byte code.
+		 * @param Vertex shader byte code. May be empty.
+		 * @param Fragment shader byte code. May be empty.
+		 * @return Reflection results.
+		 */
+		static ShaderReflection reflect_byte_code(const std::vector<char>& vert_byte_code, const std::vector<char>& frag_byte_code);
+
+		/**
+		 * @brief Load the reflection cache file.
+		 */
+		void load_reflections();
+
+		/**
+		 * @brief Save the reflection cache file.
+		 */
+		void save_reflections();
+
+
+
+		/** Physical device. */
+		vk::PhysicalDevice& m_vk_physical_device;
+
+		/** Logical device. */
+		vk::Device& m_vk_logical_device;
+
+		/** Pipeline cache. */
+		vk::PipelineCache m_vk_pipeline_cache = {};
+
+		/** Pipeline cache file path. */
+		std::string m_pipeline_path = "";
+
+		/** Reflection cache file path. */
+		std::string m_reflection_path = "";
+
+		/** Reflection results keyed by byte code hash. */
+		std::unordered_map<uint64_t, Entry> m_reflections = {};
+
+		/** Have reflection results changed since the last save? */
+		bool m_dirty = false;
+
+		/** Lock for the reflection results. */
+		std::mutex m_mutex;
+	};
+}
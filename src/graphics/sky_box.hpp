@@ -60,15 +60,6 @@ namespace dk
 			return m_material;
 		}
 
-		/**
-		 * Get descriptor set.
-		 * @return Descriptor set.
-		 */
-		const vk::DescriptorSet& get_descriptor_set() const
-		{
-			return m_vk_descriptor_set;
-		}
-
 		/**
 		 * Set mesh.
 		 * @param New mesh.
@@ -83,21 +74,8 @@ namespace dk
 		 */
 		HMaterial set_material(HMaterial material);
 
-		/**
-		 * Set vertex data.
-		 * @param Vertex data.
-		 */
-		void set_vertex_data(const VertexShaderData& data);
-
 	private:
 
-		/**
-		 * @brief Generate resources.
-		 */
-		void generate_resources();
-
-
-		
 		/** Graphics context. */
 		Graphics* m_graphics;
 
@@ -106,24 +84,6 @@ namespace dk
 
 		/** Material. */
 		HMaterial m_material = HMaterial();
-
-		/** Descriptor pool. */
-		vk::DescriptorPool m_vk_descriptor_pool = {};
-
-		/** Descriptor set. */
-		vk::DescriptorSet m_vk_descriptor_set = {};
-
-		/** Per instance vertex uniform buffer. */
-		VkMemBuffer m_vertex_uniform_buffer = {};
-
-		/** Per instance fragment uniform buffer. */
-		VkMemBuffer m_fragment_uniform_buffer = {};
-
-		/** Vertex buffer mapping. */
-		void* m_vertex_map = nullptr;
-
-		/** Fragment buffer mapping. */
-		void* m_fragment_map = nullptr;
 	};
 
 	/** Handle to a sky box. */
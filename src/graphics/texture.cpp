@@ -11,13 +11,80 @@
 
 namespace dk
 {
+	/**
+	 * @brief Add a decoded layer to an image.
+	 * @param Image.
+	 * @param Pixels from stb_image. Freed.
+	 * @param Width.
+	 * @param Height.
+	 * @return If the layer could be added. Every layer must be the same size.
+	 */
+	static bool add_layer(ImageData& image, unsigned char* pixels, int width, int height)
+	{
+		if (!pixels)
+			return false;
+
+		if (image.layer_count > 0 && (static_cast<uint32_t>(width) != image.width || static_cast<uint32_t>(height) != image.height))
+		{
+			stbi_image_free(pixels);
+			return false;
+		}
+
+		image.width = static_cast<uint32_t>(width);
+		image.height = static_cast<uint32_t>(height);
+		++image.layer_count;
+
+		const size_t layer_size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+		image.pixels.insert(image.pixels.end(), pixels, pixels + layer_size);
+		stbi_image_free(pixels);
+		return true;
+	}
+
+	ImageData decode_image(const std::vector<std::string>& paths)
+	{
+		ImageData image = {};
+
+		for (const auto& path : paths)
+		{
+			int width = 0, height = 0, channels = 0;
+			if (!add_layer(image, stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha), width, height))
+				return {};
+		}
+
+		return image;
+	}
+
+	ImageData decode_image(const std::vector<FileSpan>& files)
+	{
+		ImageData image = {};
+
+		for (const auto& file : files)
+		{
+			int width = 0, height = 0, channels = 0;
+			unsigned char* pixels = stbi_load_from_memory
+			(
+				reinterpret_cast<const stbi_uc*>(file.data),
+				static_cast<int>(file.size),
+				&width, 
+				&height, 
+				&channels, 
+				STBI_rgb_alpha
+			);
+
+			if (!add_layer(image, pixels, width, height))
+				return {};
+		}
+
+		return image;
+	}
+
 	Texture::Texture
 	(
 		Graphics* graphics,
 		vk::Image image,
 		vk::ImageView image_view,
 		vk::Sampler sampler,
-		vk::DeviceMemory memory,
+		VkMemAllocation memory,
 		vk::Filter filter,
 		uint32_t width,
 		uint32_t height,
@@ -36,45 +103,24 @@ namespace dk
 
 	}
 
-	Texture::Texture(Graphics* graphics, const std::string& path, vk::Filter filtering, uint32_t mip_map_levels) :
+	Texture::Texture(Graphics* graphics, const ImageData& image, vk::Filter filtering, uint32_t mip_map_levels) :
 		m_graphics(graphics),
 		m_vk_filtering(filtering),
 		m_mip_map_levels(mip_map_levels)
 	{
 		auto logical_device = m_graphics->get_logical_device();
 
-		// Load image from file
-		int tex_width = 0, tex_height = 0, tex_channels = 0;
-		auto pixels = stbi_load(path.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-
-		m_width = static_cast<uint32_t>(tex_width);
-		m_height = static_cast<uint32_t>(tex_height);
+		m_width = image.width;
+		m_height = image.height;
 
-		dk_assert(pixels);
+		dk_assert(image.layer_count == 1);
 
 		// Calculate max mip map count
-		uint32_t max_mip = static_cast<uint32_t>(std::floor(std::log2(std::max(tex_width, tex_height)))) + 1;
+		uint32_t max_mip = static_cast<uint32_t>(std::floor(std::log2(std::max(m_width, m_height)))) + 1;
 		dk_assert(m_mip_map_levels <= max_mip);
 
 		auto image_size = static_cast<vk::DeviceSize>(m_width * m_height * 4);
 
-		// Create staging buffer
-		VkMemBuffer staging_buffer = m_graphics->create_buffer
-		(
-			image_size,
-			vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-		);
-
-		// Map image to memory
-		void* data;
-		logical_device.mapMemory(staging_buffer.memory, 0, image_size, (vk::MemoryMapFlagBits)0, &data);
-		memcpy(data, pixels, static_cast<size_t>(image_size));
-		logical_device.unmapMemory(staging_buffer.memory);
-
-		// Free pixel data
-		stbi_image_free(pixels);
-
 		// Create image
 		m_graphics->create_image
 		(
@@ -91,18 +137,8 @@ namespace dk
 			m_mip_map_levels
 		);
 
-		// Prepare texture for shader access
-		m_graphics->transition_image_layout(m_vk_image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 1, m_mip_map_levels);
-		m_graphics->copy_buffer_to_image(staging_buffer.buffer, m_vk_image, static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height));
-		
-		if (m_mip_map_levels == 1)
-			m_graphics->transition_image_layout(m_vk_image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
-		else
-			m_graphics->generate_mipmaps(m_vk_image, m_width, m_height, m_mip_map_levels);
-
-		// Cleanup staging buffer
-		logical_device.destroyBuffer(staging_buffer.buffer);
-		logical_device.freeMemory(staging_buffer.memory);
+		// Upload image data and prepare texture for shader access
+		m_upload_ticket = m_graphics->get_upload_manager().upload_image(image.pixels.data(), image_size, m_vk_image, m_width, m_height, 1, m_mip_map_levels);
 
 		// Create texture image view
 		m_vk_image_view = m_graphics->create_image_view
@@ -137,15 +173,20 @@ namespace dk
 		m_vk_sampler = logical_device.createSampler(samplerInfo);
 	}
 
+	Texture::Texture(Graphics* graphics, const std::string& path, vk::Filter filtering, uint32_t mip_map_levels) :
+		Texture(graphics, decode_image({ path }), filtering, mip_map_levels) {}
+
 	void Texture::free()
 	{
 		if (m_graphics)
 		{
+			m_graphics->get_upload_manager().wait(m_upload_ticket);
+
 			auto logical_device = m_graphics->get_logical_device();
 			if (m_vk_sampler) logical_device.destroySampler(m_vk_sampler);
 			if (m_vk_image_view) logical_device.destroyImageView(m_vk_image_view);
-			if (m_vk_memory) logical_device.freeMemory(m_vk_memory);
 			if (m_vk_image) logical_device.destroyImage(m_vk_image);
+			m_vk_memory.free();
 		}
 	}
 
@@ -155,77 +196,25 @@ namespace dk
 		vk::Image image,
 		vk::ImageView& image_view,
 		vk::Sampler sampler,
-		vk::DeviceMemory memory,
+		VkMemAllocation memory,
 		vk::Filter filter,
 		uint32_t width,
 		uint32_t height
 	) : Texture(graphics, image, image_view, sampler, memory, filter, width, height) {}
 
-	CubeMap::CubeMap
-	(
-		Graphics* graphics,
-		const std::string& top,
-		const std::string& bottom,
-		const std::string& north,
-		const std::string& east,
-		const std::string& south,
-		const std::string& west,
-		vk::Filter filter
-	)
+	CubeMap::CubeMap(Graphics* graphics, const ImageData& image, vk::Filter filter)
 	{
 		m_graphics = graphics;
 		m_vk_filtering = filter;
 
 		auto& logical_device = m_graphics->get_logical_device();
 
-		// Load image from file
-		int tex_width = 0, tex_height = 0, tex_channels = 0;
-		unsigned char* top_pixels		= stbi_load(top.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-		unsigned char* bottom_pixels	= stbi_load(bottom.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-		unsigned char* north_pixels		= stbi_load(north.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-		unsigned char* east_pixels		= stbi_load(east.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-		unsigned char* south_pixels		= stbi_load(south.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-		unsigned char* west_pixels		= stbi_load(west.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-
-		m_width = static_cast<uint32_t>(tex_width);
-		m_height = static_cast<uint32_t>(tex_height);
+		m_width = image.width;
+		m_height = image.height;
 	
-		dk_assert(top_pixels && bottom_pixels && north_pixels && east_pixels && south_pixels && west_pixels);
+		dk_assert(image.layer_count == 6);
 	
 		auto image_size = static_cast<vk::DeviceSize>((m_width * m_height * 4) * 6);
-		auto single_image_size = static_cast<vk::DeviceSize>(m_width * m_height * 4);
-
-		// Combined images
-		unsigned char* total = new unsigned char[static_cast<size_t>(image_size)];
-		memcpy(total,							west_pixels, single_image_size);
-		memcpy(total + single_image_size,		east_pixels, single_image_size);
-		memcpy(total + (2 * single_image_size), top_pixels, single_image_size);
-		memcpy(total + (3 * single_image_size), bottom_pixels, single_image_size);
-		memcpy(total + (4 * single_image_size), north_pixels, single_image_size);
-		memcpy(total + (5 * single_image_size), south_pixels, single_image_size);
-
-		// Create staging buffer
-		VkMemBuffer staging_buffer = m_graphics->create_buffer
-		(
-			image_size,
-			vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-		);
-	
-		// Map image to memory
-		void* data;
-		logical_device.mapMemory(staging_buffer.memory, 0, image_size, (vk::MemoryMapFlagBits)0, &data);
-		memcpy(data, total, static_cast<size_t>(image_size));
-		logical_device.unmapMemory(staging_buffer.memory);
-	
-		// Free pixel data
-		stbi_image_free(top_pixels);
-		stbi_image_free(bottom_pixels);
-		stbi_image_free(north_pixels);
-		stbi_image_free(east_pixels);
-		stbi_image_free(south_pixels);
-		stbi_image_free(west_pixels);
-		delete total;
 	
 		// Create image
 		m_graphics->create_image
@@ -242,14 +231,8 @@ namespace dk
 			6
 		);
 	
-		// Prepare texture for shader access
-		m_graphics->transition_image_layout(m_vk_image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 6);
-		m_graphics->copy_buffer_to_image(staging_buffer.buffer, m_vk_image, static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height), 6, static_cast<uint32_t>(single_image_size));
-		m_graphics->transition_image_layout(m_vk_image, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 6);
-	
-		// Cleanup staging buffer
-		logical_device.destroyBuffer(staging_buffer.buffer);
-		logical_device.freeMemory(staging_buffer.memory);
+		// Upload every face and prepare texture for shader access
+		m_upload_ticket = m_graphics->get_upload_manager().upload_image(image.pixels.data(), image_size, m_vk_image, m_width, m_height, 6);
 	
 		// Create texture image view
 		m_vk_image_view = m_graphics->create_image_view(m_vk_image, vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor, vk::ImageViewType::eCube, 6);
@@ -275,4 +258,16 @@ namespace dk
 		// Create sampler
 		m_vk_sampler = logical_device.createSampler(samplerInfo);
 	}
+
+	CubeMap::CubeMap
+	(
+		Graphics* graphics,
+		const std::string& top,
+		const std::string& bottom,
+		const std::string& north,
+		const std::string& east,
+		const std::string& south,
+		const std::string& west,
+		vk::Filter filter
+	) : CubeMap(graphics, decode_image({ west, east, top, bottom, north, south }), filter) {}
 }
\ No newline at end of file
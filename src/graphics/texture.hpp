@@ -9,10 +9,45 @@
 /** Includes. */
 #include <utilities\debugging.hpp>
 #include <utilities\resource_allocator.hpp>
+#include <utilities\file_io.hpp>
 #include "graphics.hpp"
 
 namespace dk
 {
+	/**
+	 * @brief Decoded image with every layer stored as RGBA8.
+	 */
+	struct ImageData
+	{
+		/** Width of each layer. */
+		uint32_t width = 0;
+
+		/** Height of each layer. */
+		uint32_t height = 0;
+
+		/** Number of layers. */
+		uint32_t layer_count = 0;
+
+		/** Pixels. Layers are tightly packed one after another. */
+		std::vector<unsigned char> pixels = {};
+	};
+
+	/**
+	 * @brief Decode image files into the layers of an image.
+	 * @param Path to the file containing each layer.
+	 * @return Image data. Empty if a file couldn't be decoded or the layers differ in size.
+	 * @note Doesn't touch the GPU, so it's safe to call from any thread.
+	 */
+	extern ImageData decode_image(const std::vector<std::string>& paths);
+
+	/**
+	 * @brief Decode encoded image files held in memory into the layers of an image.
+	 * @param Contents of the file of each layer.
+	 * @return Image data. Empty if a file couldn't be decoded or the layers differ in size.
+	 * @note Doesn't touch the GPU, so it's safe to call from any thread.
+	 */
+	extern ImageData decode_image(const std::vector<FileSpan>& files);
+
 	/**
 	 * @brief Base class for every texture
 	 */
@@ -43,13 +78,22 @@ namespace dk
 			vk::Image image,
 			vk::ImageView image_view,
 			vk::Sampler sampler,
-			vk::DeviceMemory memory,
+			VkMemAllocation memory,
 			vk::Filter filter,
 			uint32_t width,
 			uint32_t height,
 			uint32_t mip_map_levels = 1
 		);
 
+		/**
+		 * @brief Constructor.
+		 * @param Graphics context.
+		 * @param Decoded image. Must have one layer.
+		 * @param Filtering.
+		 * @param Mip map levels.
+		 */
+		Texture(Graphics* graphics, const ImageData& image, vk::Filter filtering, uint32_t mip_map_levels = 1);
+
 		/**
 		 * @brief Graphics context.
 		 * @param Path to file containing image.
@@ -68,6 +112,15 @@ namespace dk
 		 */
 		void free();
 
+		/**
+		 * @brief Check if the texture has been uploaded.
+		 * @return If the texture is resident. False for placeholders of streamed textures.
+		 */
+		bool is_resident() const
+		{
+			return m_graphics != nullptr;
+		}
+
 		/**
 		 * @brief Get image width.
 		 * @return Width.
@@ -133,14 +186,17 @@ namespace dk
 
 	protected:
 
-		/** Graphics context */
-		Graphics* m_graphics;
+		/** Graphics context. Null until the texture is resident. */
+		Graphics* m_graphics = nullptr;
 
 		/** Vulkan image. */
 		vk::Image m_vk_image;
 
 		/** Vulkan image memory. */
-		vk::DeviceMemory m_vk_memory;
+		VkMemAllocation m_vk_memory = {};
+
+		/** Ticket of the upload of the image data. */
+		uint64_t m_upload_ticket = 0;
 
 		/** Texture image view. */
 		vk::ImageView m_vk_image_view = {};
@@ -192,12 +248,20 @@ namespace dk
 			vk::Image image, 
 			vk::ImageView& imageView, 
 			vk::Sampler sampler, 
-			vk::DeviceMemory memory, 
+			VkMemAllocation memory, 
 			vk::Filter filter,
 			uint32_t width, 
 			uint32_t height
 		);
 
+		/**
+		 * @brief Constructor.
+		 * @param Graphics context.
+		 * @param Decoded image. Must have six layers, ordered west, east, top, bottom, north, south.
+		 * @param Texture filtering.
+		 */
+		CubeMap(Graphics* graphics, const ImageData& image, vk::Filter filter);
+
 		/**
 		 * @brief Constructor.
 		 * @param Graphics context.
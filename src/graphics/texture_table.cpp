@@ -0,0 +1,330 @@
+/**
+ * @file texture_table.cpp
+ * @brief Global texture table source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <array>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include "texture_table.hpp"
+
+namespace dk
+{
+	/** Number of materials a frame's material buffer starts out holding. */
+	static const size_t MIN_MATERIAL_CAPACITY = 16;
+
+	const uint32_t TextureTable::texture_capacity;
+	const uint32_t TextureTable::cube_map_capacity;
+	const uint32_t TextureTable::max_material_textures;
+	const uint32_t TextureTable::fallback_slot;
+
+	TextureTable::TextureTable(Graphics* graphics, size_t frame_count) :
+		m_graphics(graphics),
+		m_frames(frame_count),
+		m_textures(texture_capacity),
+		m_cube_maps(cube_map_capacity)
+	{
+		// Hand out low slots first. The fallback slot is never handed out.
+		for (uint32_t i = texture_capacity; i > fallback_slot + 1; --i)
+			m_free_textures.push_back(i - 1);
+
+		for (uint32_t i = cube_map_capacity; i > fallback_slot + 1; --i)
+			m_free_cube_maps.push_back(i - 1);
+
+		// Every slot is a combined image sampler, so both limits apply
+		const vk::PhysicalDeviceLimits limits = m_graphics->get_physical_device().getProperties().limits;
+		dk_assert(limits.maxPerStageDescriptorSamplers >= texture_capacity + cube_map_capacity);
+		dk_assert(limits.maxPerStageDescriptorSampledImages >= texture_capacity + cube_map_capacity);
+
+		// Create descriptor set layout
+		{
+			std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {};
+			bindings[0].binding = 0;
+			bindings[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+			bindings[0].descriptorCount = texture_capacity;
+			bindings[0].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+			bindings[1].binding = 1;
+			bindings[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+			bindings[1].descriptorCount = cube_map_capacity;
+			bindings[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+			bindings[2].binding = 2;
+			bindings[2].descriptorType = vk::DescriptorType::eStorageBuffer;
+			bindings[2].descriptorCount = 1;
+			bindings[2].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+			vk::DescriptorSetLayoutCreateInfo layout_info = {};
+			layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+			layout_info.pBindings = bindings.data();
+
+			m_vk_descriptor_set_layout = m_graphics->get_logical_device().createDescriptorSetLayout(layout_info);
+			dk_assert(m_vk_descriptor_set_layout);
+		}
+
+		// Create descriptor pool
+		{
+			const uint32_t frame_count_u32 = static_cast<uint32_t>(m_frames.size());
+
+			std::array<vk::DescriptorPoolSize, 2> pool_sizes = {};
+			pool_sizes[0].type = vk::DescriptorType::eCombinedImageSampler;
+			pool_sizes[0].descriptorCount = (texture_capacity + cube_map_capacity) * frame_count_u32;
+			pool_sizes[1].type = vk::DescriptorType::eStorageBuffer;
+			pool_sizes[1].descriptorCount = frame_count_u32;
+
+			vk::DescriptorPoolCreateInfo pool_info = {};
+			pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+			pool_info.pPoolSizes = pool_sizes.data();
+			pool_info.maxSets = frame_count_u32;
+
+			m_vk_descriptor_pool = m_graphics->get_logical_device().createDescriptorPool(pool_info);
+			dk_assert(m_vk_descriptor_pool);
+		}
+
+		// Create each frame's set. Material buffers are created on the first update.
+		for (auto& frame : m_frames)
+		{
+			vk::DescriptorSetAllocateInfo alloc_info = {};
+			alloc_info.descriptorPool = m_vk_descriptor_pool;
+			alloc_info.descriptorSetCount = 1;
+			alloc_info.pSetLayouts = &m_vk_descriptor_set_layout;
+
+			frame.descriptor_set = m_graphics->get_logical_device().allocateDescriptorSets(alloc_info)[0];
+			dk_assert(frame.descriptor_set);
+		}
+	}
+
+	void TextureTable::free()
+	{
+		for (auto& frame : m_frames)
+		{
+			if (frame.material_capacity > 0)
+				frame.material_buffer.free(m_graphics->get_logical_device());
+
+			frame = {};
+		}
+
+		m_frames.clear();
+		m_graphics->get_logical_device().destroyDescriptorPool(m_vk_descriptor_pool);
+		m_graphics->get_logical_device().destroyDescriptorSetLayout(m_vk_descriptor_set_layout);
+	}
+
+	void TextureTable::set_texture(HTexture texture)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto& slot = m_textures[get_slot(texture.id, m_texture_slots, m_free_textures)];
+		slot.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		slot.imageView = texture->get_image_view();
+		slot.sampler = texture->get_sampler();
+		++m_version;
+	}
+
+	void TextureTable::set_cube_map(HCubeMap cube_map)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto& slot = m_cube_maps[get_slot(cube_map.id, m_cube_map_slots, m_free_cube_maps)];
+		slot.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		slot.imageView = cube_map->get_image_view();
+		slot.sampler = cube_map->get_sampler();
+		++m_version;
+	}
+
+	void TextureTable::remove_texture(resource_id texture)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto slot = m_texture_slots.find(texture);
+
+		if (slot != m_texture_slots.end())
+		{
+			remove_material_references(slot->second, false);
+			m_textures[slot->second] = vk::DescriptorImageInfo();
+			m_free_textures.push_back(slot->second);
+			m_texture_slots.erase(slot);
+			++m_version;
+		}
+	}
+
+	void TextureTable::remove_cube_map(resource_id cube_map)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto slot = m_cube_map_slots.find(cube_map);
+
+		if (slot != m_cube_map_slots.end())
+		{
+			remove_material_references(slot->second, true);
+			m_cube_maps[slot->second] = vk::DescriptorImageInfo();
+			m_free_cube_maps.push_back(slot->second);
+			m_cube_map_slots.erase(slot);
+			++m_version;
+		}
+	}
+
+	uint32_t TextureTable::allocate_material()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint32_t material = 0;
+
+		if (m_free_materials.size() > 0)
+		{
+			material = m_free_materials.back();
+			m_free_materials.pop_back();
+		}
+		else
+		{
+			material = static_cast<uint32_t>(m_material_textures.size() / max_material_textures);
+			m_material_textures.resize(m_material_textures.size() + max_material_textures);
+			m_material_cube_maps.resize(m_material_cube_maps.size() + max_material_textures);
+		}
+
+		std::fill_n(m_material_textures.begin() + (material * max_material_textures), max_material_textures, fallback_slot);
+		std::fill_n(m_material_cube_maps.begin() + (material * max_material_textures), max_material_textures, false);
+		++m_version;
+
+		return material;
+	}
+
+	void TextureTable::free_material(uint32_t material)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		dk_assert(material < m_material_textures.size() / max_material_textures);
+		m_free_materials.push_back(material);
+	}
+
+	void TextureTable::set_material_texture(uint32_t material, size_t index, HTexture texture)
+	{
+		dk_assert(index < max_material_textures);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		dk_assert(material < m_material_textures.size() / max_material_textures);
+
+		// Streamed textures are sampled before they're put in the table, so the slot may be handed out here
+		m_material_textures[(material * max_material_textures) + index] = get_slot(texture.id, m_texture_slots, m_free_textures);
+		m_material_cube_maps[(material * max_material_textures) + index] = false;
+		++m_version;
+	}
+
+	void TextureTable::set_material_cube_map(uint32_t material, size_t index, HCubeMap cube_map)
+	{
+		dk_assert(index < max_material_textures);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		dk_assert(material < m_material_textures.size() / max_material_textures);
+
+		m_material_textures[(material * max_material_textures) + index] = get_slot(cube_map.id, m_cube_map_slots, m_free_cube_maps);
+		m_material_cube_maps[(material * max_material_textures) + index] = true;
+		++m_version;
+	}
+
+	void TextureTable::update(size_t frame_index)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto& frame = m_frames[frame_index];
+
+		if (frame.version == m_version)
+			return;
+
+		// Grow the material buffer geometrically
+		const size_t material_count = std::max<size_t>(m_material_textures.size() / max_material_textures, 1);
+		if (frame.material_capacity < material_count)
+		{
+			size_t capacity = std::max(frame.material_capacity, MIN_MATERIAL_CAPACITY);
+			while (capacity < material_count)
+				capacity *= 2;
+
+			// The frame's fence has been waited on so the GPU is done with the old buffer
+			if (frame.material_capacity > 0)
+				frame.material_buffer.free(m_graphics->get_logical_device());
+
+			const vk::DeviceSize size = static_cast<vk::DeviceSize>(sizeof(uint32_t) * max_material_textures * capacity);
+			frame.material_buffer = m_graphics->create_buffer
+			(
+				size,
+				vk::BufferUsageFlagBits::eStorageBuffer,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+			);
+			frame.material_capacity = capacity;
+
+			vk::DescriptorBufferInfo buffer_info = {};
+			buffer_info.buffer = frame.material_buffer.buffer;
+			buffer_info.offset = 0;
+			buffer_info.range = size;
+
+			vk::WriteDescriptorSet write = {};
+			write.dstSet = frame.descriptor_set;
+			write.dstBinding = 2;
+			write.dstArrayElement = 0;
+			write.descriptorType = vk::DescriptorType::eStorageBuffer;
+			write.descriptorCount = 1;
+			write.pBufferInfo = &buffer_info;
+
+			m_graphics->get_logical_device().updateDescriptorSets(1, &write, 0, nullptr);
+		}
+
+		// Upload material texture slots
+		if (m_material_textures.size() > 0)
+			std::memcpy(frame.material_buffer.memory.mapped, m_material_textures.data(), sizeof(uint32_t) * m_material_textures.size());
+
+		// Update texture and cube map arrays
+		write_images(frame.descriptor_set, 0, m_textures);
+		write_images(frame.descriptor_set, 1, m_cube_maps);
+
+		frame.version = m_version;
+	}
+
+	uint32_t TextureTable::get_slot(resource_id id, std::unordered_map<resource_id, uint32_t>& slots, std::vector<uint32_t>& free_slots)
+	{
+		auto slot = slots.find(id);
+		if (slot != slots.end())
+			return slot->second;
+
+		// The shaders declare fixed size arrays, so there's nowhere to grow into
+		if (free_slots.empty())
+		{
+			dk_log("Texture table out of slots. " << slots.size() << " are in use.");
+			std::terminate();
+		}
+
+		const uint32_t free_slot = free_slots.back();
+		free_slots.pop_back();
+		slots[id] = free_slot;
+
+		return free_slot;
+	}
+
+	void TextureTable::remove_material_references(uint32_t slot, bool cube_map)
+	{
+		// Freed slots are reused right away, so materials must stop sampling them first
+		for (size_t i = 0; i < m_material_textures.size(); ++i)
+			if (m_material_textures[i] == slot && m_material_cube_maps[i] == cube_map)
+				m_material_textures[i] = fallback_slot;
+	}
+
+	void TextureTable::write_images(vk::DescriptorSet set, uint32_t binding, const std::vector<vk::DescriptorImageInfo>& slots)
+	{
+		auto fallback = std::find_if(slots.begin(), slots.end(), [](const vk::DescriptorImageInfo& slot)
+		{
+			return static_cast<bool>(slot.imageView);
+		});
+
+		if (fallback == slots.end())
+			return;
+
+		std::vector<vk::DescriptorImageInfo> image_infos = slots;
+		for (auto& image_info : image_infos)
+			if (!image_info.imageView)
+				image_info = *fallback;
+
+		vk::WriteDescriptorSet write = {};
+		write.dstSet = set;
+		write.dstBinding = binding;
+		write.dstArrayElement = 0;
+		write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+		write.descriptorCount = static_cast<uint32_t>(image_infos.size());
+		write.pImageInfo = image_infos.data();
+
+		m_graphics->get_logical_device().updateDescriptorSets(1, &write, 0, nullptr);
+	}
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+/**
+ * @file texture_table.hpp
+ * @brief Global texture table header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include "texture.hpp"
+
+namespace dk
+{
+	/**
+	 * @brief Every texture and cube map in one descriptor set, along with the slots each material samples.
+	 * @note Slots are handed out from a free list the first time a texture or cube map is put in the
+	 *       table or sampled by a material, and kept until it is removed, so they never move. Materials
+	 *       sampling a removed texture or cube map are pointed at the fallback slot. Each frame in flight
+	 *       has its own copy of the set and material buffer. Changes are copied into a frame's copy once
+	 *       the GPU is done with it.
+	 */
+	class TextureTable
+	{
+	public:
+
+		/** Number of texture slots. Must match the shaders. */
+		static const uint32_t texture_capacity = 256;
+
+		/** Number of cube map slots. Must match the shaders. */
+		static const uint32_t cube_map_capacity = 16;
+
+		/** Most textures a material can sample. Must match the shaders. */
+		static const uint32_t max_material_textures = 8;
+
+		/** Slot that is never handed out. It's empty, so it samples the first full slot. */
+		static const uint32_t fallback_slot = 0;
+
+		/**
+		 * @brief Default constructor.
+		 */
+		TextureTable() = default;
+
+		/**
+		 * @brief Constructor.
+		 * @param Graphics context.
+		 * @param Number of frames in flight.
+		 */
+		TextureTable(Graphics* graphics, size_t frame_count);
+
+		/**
+		 * @brief Destructor.
+		 */
+		~TextureTable() = default;
+
+		/**
+		 * @brief Free Vulkan resources.
+		 * @note Slots may still be changed afterwards, but nothing will be uploaded.
+		 */
+		void free();
+
+		/**
+		 * @brief Put a texture in its slot.
+		 * @param Texture.
+		 */
+		void set_texture(HTexture texture);
+
+		/**
+		 * @brief Put a cube map in its slot.
+		 * @param Cube map.
+		 */
+		void set_cube_map(HCubeMap cube_map);
+
+		/**
+		 * @brief Empty a texture's slot so it can be reused.
+		 * @param Texture resource ID.
+		 * @note Materials sampling the texture sample the fallback slot instead.
+		 */
+		void remove_texture(resource_id texture);
+
+		/**
+		 * @brief Empty a cube map's slot so it can be reused.
+		 * @param Cube map resource ID.
+		 * @note Materials sampling the cube map sample the fallback slot instead.
+		 */
+		void remove_cube_map(resource_id cube_map);
+
+		/**
+		 * @brief Allocate a material slot.
+		 * @return Material slot.
+		 */
+		uint32_t allocate_material();
+
+		/**
+		 * @brief Free a material slot.
+		 * @param Material slot.
+		 */
+		void free_material(uint32_t material);
+
+		/**
+		 * @brief Set a texture a material samples.
+		 * @param Material slot.
+		 * @param Texture index within the material.
+		 * @param Texture.
+		 */
+		void set_material_texture(uint32_t material, size_t index, HTexture texture);
+
+		/**
+		 * @brief Set a cube map a material samples.
+		 * @param Material slot.
+		 * @param Texture index within the material.
+		 * @param Cube map.
+		 */
+		void set_material_cube_map(uint32_t material, size_t index, HCubeMap cube_map);
+
+		/**
+		 * @brief Copy changes into a frame's descriptor set and material buffer.
+		 * @param Frame index.
+		 * @note The GPU must be done with the frame.
+		 */
+		void update(size_t frame);
+
+		/**
+		 * @brief Get descriptor set layout.
+		 * @return Descriptor set layout.
+		 */
+		const vk::DescriptorSetLayout& get_descriptor_set_layout() const
+		{
+			return m_vk_descriptor_set_layout;
+		}
+
+		/**
+		 * @brief Get a frame's descriptor set.
+		 * @param Frame index.
+		 * @return Descriptor set.
+		 */
+		const vk::DescriptorSet& get_descriptor_set(size_t frame) const
+		{
+			return m_frames[frame].descriptor_set;
+		}
+
+	private:
+
+		/**
+		 * @brief A frame in flight's copy of the table.
+		 */
+		struct FrameData
+		{
+			/** Descriptor set. */
+			vk::DescriptorSet descriptor_set = {};
+
+			/** Material texture slots. */
+			VkMemBuffer material_buffer = {};
+
+			/** Number of materials the buffer can hold. */
+			size_t material_capacity = 0;
+
+			/** Table version the frame was last updated to. */
+			uint64_t version = 0;
+		};
+
+		/**
+		 * @brief Get the slot of a resource, handing out a free one if it has none.
+		 * @param Resource ID.
+		 * @param Slots of every resource of its type.
+		 * @param Free slots of its type.
+		 * @return Slot.
+		 * @note The table mutex must be held.
+		 */
+		static uint32_t get_slot(resource_id id, std::unordered_map<resource_id, uint32_t>& slots, std::vector<uint32_t>& free_slots);
+
+		/**
+		 * @brief Point every material entry using a slot at the fallback slot.
+		 * @param Slot.
+		 * @param If the slot is a cube map slot instead of a texture slot.
+		 * @note The table mutex must be held.
+		 */
+		void remove_material_references(uint32_t slot, bool cube_map);
+
+		/**
+		 * @brief Write an array of image descriptors.
+		 * @param Descriptor set.
+		 * @param Binding.
+		 * @param Slot contents. Empty slots have a null image view.
+		 * @note Shaders that index an array count every element as used, so empty slots
+		 *       point at the first full one. Nothing is written if every slot is empty.
+		 */
+		void write_images(vk::DescriptorSet set, uint32_t binding, const std::vector<vk::DescriptorImageInfo>& slots);
+
+
+
+		/** Graphics context. */
+		Graphics* m_graphics = nullptr;
+
+		/** Descriptor set layout. */
+		vk::DescriptorSetLayout m_vk_descriptor_set_layout = {};
+
+		/** Descriptor pool. */
+		vk::DescriptorPool m_vk_descriptor_pool = {};
+
+		/** Frames in flight. */
+		std::vector<FrameData> m_frames = {};
+
+		/** Texture slots. */
+		std::vector<vk::DescriptorImageInfo> m_textures = {};
+
+		/** Cube map slots. */
+		std::vector<vk::DescriptorImageInfo> m_cube_maps = {};
+
+		/** Slot of every texture with one, by resource ID. */
+		std::unordered_map<resource_id, uint32_t> m_texture_slots = {};
+
+		/** Slot of every cube map with one, by resource ID. */
+		std::unordered_map<resource_id, uint32_t> m_cube_map_slots = {};
+
+		/** Texture slots that can be handed out. */
+		std::vector<uint32_t> m_free_textures = {};
+
+		/** Cube map slots that can be handed out. */
+		std::vector<uint32_t> m_free_cube_maps = {};
+
+		/** Texture slots of every material. Each material has max_material_textures entries. */
+		std::vector<uint32_t> m_material_textures = {};
+
+		/** Which entries of m_material_textures are cube map slots. */
+		std::vector<bool> m_material_cube_maps = {};
+
+		/** Material slots that can be reused. */
+		std::vector<uint32_t> m_free_materials = {};
+
+		/** Incremented every time the table changes. */
+		uint64_t m_version = 1;
+
+		/** Guards everything above since resources change outside the rendering thread. */
+		std::mutex m_mutex = {};
+	};
+}
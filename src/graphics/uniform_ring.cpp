@@ -0,0 +1,74 @@
+/**
+ * @file uniform_ring.cpp
+ * @brief Uniform ring buffer source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <exception>
+#include "uniform_ring.hpp"
+
+namespace dk
+{
+	UniformRingBuffer::UniformRingBuffer(Graphics* graphics, size_t frame_size, size_t frame_count) :
+		m_graphics(graphics),
+		m_frame_count(frame_count)
+	{
+		dk_assert(frame_count > 0);
+
+		// Every frame's region must start on an aligned offset
+		const vk::PhysicalDeviceProperties properties = m_graphics->get_physical_device().getProperties();
+		m_alignment = std::max<size_t>(static_cast<size_t>(properties.limits.minUniformBufferOffsetAlignment), 1);
+		m_frame_size = ((frame_size + m_alignment - 1) / m_alignment) * m_alignment;
+
+		const vk::DeviceSize size = static_cast<vk::DeviceSize>(m_frame_size * m_frame_count);
+
+		m_buffer = m_graphics->create_buffer
+		(
+			size,
+			vk::BufferUsageFlagBits::eUniformBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		);
+
+		m_map = static_cast<char*>(m_buffer.memory.mapped);
+		dk_assert(m_map);
+	}
+
+	void UniformRingBuffer::free()
+	{
+		m_map = nullptr;
+
+		if (m_buffer.buffer)
+		{
+			m_buffer.free(m_graphics->get_logical_device());
+			m_buffer.buffer = vk::Buffer();
+		}
+	}
+
+	void* UniformRingBuffer::allocate(size_t size, uint32_t& offset)
+	{
+		const size_t aligned_size = ((size + m_alignment - 1) / m_alignment) * m_alignment;
+
+		// Everything allocated this frame is still referenced by recorded draws, and descriptor
+		// sets point at this buffer so it can't be swapped for a bigger one mid frame. Stop in
+		// release builds too instead of overwriting data the GPU is about to read.
+		if (m_head + aligned_size > m_frame_size)
+		{
+			dk_log("Uniform ring buffer out of memory. Allocating " << aligned_size << " bytes with " << (m_frame_size - m_head) << " of " << m_frame_size << " left this frame.");
+			std::terminate();
+		}
+
+		const size_t frame_offset = m_frame * m_frame_size + m_head;
+		m_head += aligned_size;
+
+		offset = static_cast<uint32_t>(frame_offset);
+		return m_map + frame_offset;
+	}
+
+	void UniformRingBuffer::next_frame()
+	{
+		m_frame = (m_frame + 1) % m_frame_count;
+		m_head = 0;
+	}
+}
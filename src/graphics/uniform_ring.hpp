@@ -0,0 +1,105 @@
+#pragma once
+
+/**
+ * @file uniform_ring.hpp
+ * @brief Per frame ring buffer for dynamic uniform data.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include "graphics.hpp"
+
+namespace dk
+{
+	/**
+	 * @brief A persistently mapped uniform buffer split into one region per frame.
+	 * @note Data is written to the current frame's region and read using dynamic 
+	 *       uniform buffer offsets, so descriptor sets never need to be rewritten.
+	 */
+	class UniformRingBuffer
+	{
+	public:
+
+		/**
+		 * @brief Default constructor.
+		 */
+		UniformRingBuffer() = default;
+
+		/**
+		 * @brief Constructor.
+		 * @param Graphics context.
+		 * @param Size in bytes of each frame's region.
+		 * @param Number of frames.
+		 */
+		UniformRingBuffer(Graphics* graphics, size_t frame_size, size_t frame_count);
+
+		/**
+		 * @brief Default destructor.
+		 */
+		~UniformRingBuffer() = default;
+
+		/**
+		 * @brief Free the buffer.
+		 */
+		void free();
+
+		/**
+		 * @brief Allocate memory from the current frame's region.
+		 * @param Size in bytes.
+		 * @param Dynamic offset of the allocation.
+		 * @return Pointer to the mapped memory.
+		 * @note The memory is only valid until the region is reused.
+		 * @note Running out of space in a frame terminates the program, so size regions for the worst frame.
+		 */
+		void* allocate(size_t size, uint32_t& offset);
+
+		/**
+		 * @brief Move on to the next frame's region.
+		 */
+		void next_frame();
+
+		/**
+		 * @brief Get the buffer.
+		 * @return Buffer.
+		 */
+		const vk::Buffer& get_buffer() const
+		{
+			return m_buffer.buffer;
+		}
+
+		/**
+		 * @brief Get the number of frames.
+		 * @return Number of frames.
+		 */
+		size_t get_frame_count() const
+		{
+			return m_frame_count;
+		}
+
+	private:
+
+		/** Graphics context. */
+		Graphics* m_graphics = nullptr;
+
+		/** Uniform buffer. */
+		VkMemBuffer m_buffer = {};
+
+		/** Buffer mapping. */
+		char* m_map = nullptr;
+
+		/** Size in bytes of each frame's region. */
+		size_t m_frame_size = 0;
+
+		/** Number of frames. */
+		size_t m_frame_count = 0;
+
+		/** Current frame. */
+		size_t m_frame = 0;
+
+		/** Offset of the next allocation within the current frame's region. */
+		size_t m_head = 0;
+
+		/** Required alignment of dynamic offsets. */
+		size_t m_alignment = 1;
+	};
+}
@@ -0,0 +1,491 @@
+/**
+ * @file upload_manager.cpp
+ * @brief Batched uploads source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include "graphics.hpp"
+#include "upload_manager.hpp"
+
+namespace dk
+{
+	const vk::DeviceSize VkUploadManager::default_ring_size;
+
+	/** Stages that read uploaded buffers. */
+	static const vk::PipelineStageFlags buffer_read_stages =
+		vk::PipelineStageFlagBits::eVertexInput |
+		vk::PipelineStageFlagBits::eVertexShader |
+		vk::PipelineStageFlagBits::eFragmentShader;
+
+	/** Accesses that read uploaded buffers. */
+	static const vk::AccessFlags buffer_read_access =
+		vk::AccessFlagBits::eVertexAttributeRead |
+		vk::AccessFlagBits::eIndexRead |
+		vk::AccessFlagBits::eUniformRead |
+		vk::AccessFlagBits::eShaderRead;
+
+	VkUploadManager::VkUploadManager(Graphics& graphics, vk::DeviceSize ring_size) :
+		m_graphics(graphics),
+		m_ring_size(ring_size)
+	{
+		const QueueFamilyIndices qfi = m_graphics.get_device_manager().get_queue_family_indices();
+		m_separate_transfer_family = qfi.transfer_family != qfi.graphics_family;
+
+		// Create command pools
+		vk::CommandPoolCreateInfo pool_info = {};
+		pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient;
+
+		pool_info.queueFamilyIndex = static_cast<uint32_t>(qfi.transfer_family);
+		m_vk_transfer_pool = m_graphics.get_logical_device().createCommandPool(pool_info);
+		dk_assert(m_vk_transfer_pool);
+
+		pool_info.queueFamilyIndex = static_cast<uint32_t>(qfi.graphics_family);
+		m_vk_graphics_pool = m_graphics.get_logical_device().createCommandPool(pool_info);
+		dk_assert(m_vk_graphics_pool);
+
+		// Staged data must satisfy image copy offset rules
+		const vk::PhysicalDeviceLimits limits = m_graphics.get_physical_device().getProperties().limits;
+		m_alignment = std::max<vk::DeviceSize>(m_alignment, limits.optimalBufferCopyOffsetAlignment);
+
+		// Create staging ring. It is persistently mapped.
+		m_ring = m_graphics.create_buffer
+		(
+			m_ring_size,
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		);
+		dk_assert(m_ring.memory.mapped);
+	}
+
+	VkUploadManager::~VkUploadManager()
+	{
+		wait_all();
+
+		auto& logical_device = m_graphics.get_logical_device();
+
+		for (auto& batch : m_free_batches)
+		{
+			logical_device.freeCommandBuffers(m_vk_transfer_pool, 1, &batch.transfer_command_buffer);
+			logical_device.freeCommandBuffers(m_vk_graphics_pool, 1, &batch.graphics_command_buffer);
+			logical_device.destroySemaphore(batch.transfer_finished);
+			logical_device.destroyFence(batch.fence);
+		}
+
+		m_free_batches.clear();
+		logical_device.destroyCommandPool(m_vk_transfer_pool);
+		logical_device.destroyCommandPool(m_vk_graphics_pool);
+		m_ring.free(logical_device);
+	}
+
+	uint64_t VkUploadManager::upload_buffer(const void* data, vk::DeviceSize size, const vk::Buffer& dst, vk::DeviceSize dst_offset)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		vk::Buffer src = {};
+		vk::DeviceSize src_offset = 0;
+		stage(data, size, src, src_offset);
+
+		Batch& batch = get_pending_batch();
+
+		vk::BufferCopy region = {};
+		region.srcOffset = src_offset;
+		region.dstOffset = dst_offset;
+		region.size = size;
+
+		vk::BufferMemoryBarrier barrier = {};
+		barrier.buffer = dst;
+		barrier.offset = dst_offset;
+		barrier.size = size;
+
+		if (m_separate_transfer_family)
+		{
+			const QueueFamilyIndices qfi = m_graphics.get_device_manager().get_queue_family_indices();
+			barrier.srcQueueFamilyIndex = static_cast<uint32_t>(qfi.transfer_family);
+			barrier.dstQueueFamilyIndex = static_cast<uint32_t>(qfi.graphics_family);
+
+			// Copy on the transfer queue and release the buffer
+			batch.transfer_command_buffer.copyBuffer(src, dst, region);
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = static_cast<vk::AccessFlagBits>(0);
+
+			batch.transfer_command_buffer.pipelineBarrier
+			(
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eBottomOfPipe,
+				static_cast<vk::DependencyFlagBits>(0),
+				0, nullptr,
+				1, &barrier,
+				0, nullptr
+			);
+
+			// Acquire the buffer on the graphics queue. The transfer semaphore is waited on at
+			// the read stages, so the barrier starts at the same stages to chain onto the wait.
+			// Nothing on this queue wrote the buffer, so there is nothing to make available.
+			barrier.srcAccessMask = vk::AccessFlags();
+			barrier.dstAccessMask = buffer_read_access;
+
+			batch.graphics_command_buffer.pipelineBarrier
+			(
+				buffer_read_stages,
+				buffer_read_stages,
+				static_cast<vk::DependencyFlagBits>(0),
+				0, nullptr,
+				1, &barrier,
+				0, nullptr
+			);
+
+			batch.has_transfer_work = true;
+		}
+		else
+		{
+			batch.graphics_command_buffer.copyBuffer(src, dst, region);
+
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = buffer_read_access;
+
+			batch.graphics_command_buffer.pipelineBarrier
+			(
+				vk::PipelineStageFlagBits::eTransfer,
+				buffer_read_stages,
+				static_cast<vk::DependencyFlagBits>(0),
+				0, nullptr,
+				1, &barrier,
+				0, nullptr
+			);
+		}
+
+		return batch.ticket;
+	}
+
+	uint64_t VkUploadManager::upload_image
+	(
+		const void* data,
+		vk::DeviceSize size,
+		const vk::Image& image,
+		uint32_t width,
+		uint32_t height,
+		uint32_t layer_count,
+		uint32_t mip_levels
+	)
+	{
+		dk_assert(layer_count > 0 && mip_levels > 0);
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		vk::Buffer src = {};
+		vk::DeviceSize src_offset = 0;
+		stage(data, size, src, src_offset);
+
+		Batch& batch = get_pending_batch();
+		vk::CommandBuffer& command_buffer = batch.graphics_command_buffer;
+
+		// Prepare every level for the copy
+		vk::ImageMemoryBarrier barrier = {};
+		barrier.oldLayout = vk::ImageLayout::eUndefined;
+		barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mip_levels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = layer_count;
+		barrier.srcAccessMask = static_cast<vk::AccessFlagBits>(0);
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+		command_buffer.pipelineBarrier
+		(
+			vk::PipelineStageFlagBits::eTopOfPipe,
+			vk::PipelineStageFlagBits::eTransfer,
+			static_cast<vk::DependencyFlagBits>(0),
+			0, nullptr,
+			0, nullptr,
+			1, &barrier
+		);
+
+		// Copy each layer into the first level
+		const vk::DeviceSize layer_size = size / layer_count;
+		std::vector<vk::BufferImageCopy> regions(layer_count);
+
+		for (uint32_t i = 0; i < layer_count; ++i)
+		{
+			regions[i].setBufferOffset(src_offset + (i * layer_size));
+			regions[i].setBufferRowLength(0);
+			regions[i].setBufferImageHeight(0);
+			regions[i].imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			regions[i].imageSubresource.mipLevel = 0;
+			regions[i].imageSubresource.baseArrayLayer = i;
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].setImageOffset({ 0, 0, 0 });
+			regions[i].setImageExtent({ width, height, 1 });
+		}
+
+		command_buffer.copyBufferToImage
+		(
+			src,
+			image,
+			vk::ImageLayout::eTransferDstOptimal,
+			static_cast<uint32_t>(regions.size()),
+			regions.data()
+		);
+
+		// Fill the rest of the levels and prepare for sampling
+		if (mip_levels > 1)
+			record_mipmaps(command_buffer, image, static_cast<int32_t>(width), static_cast<int32_t>(height), mip_levels, layer_count);
+		else
+		{
+			barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+			barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+			command_buffer.pipelineBarrier
+			(
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader,
+				static_cast<vk::DependencyFlagBits>(0),
+				0, nullptr,
+				0, nullptr,
+				1, &barrier
+			);
+		}
+
+		return batch.ticket;
+	}
+
+	uint64_t VkUploadManager::flush()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_recording)
+		{
+			retire(false);
+			return 0;
+		}
+
+		const uint64_t ticket = m_pending.ticket;
+		submit_pending();
+		retire(false);
+		return ticket;
+	}
+
+	bool VkUploadManager::is_complete(uint64_t ticket)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		retire(false);
+		return ticket <= m_completed_ticket;
+	}
+
+	void VkUploadManager::wait(uint64_t ticket)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_recording && ticket >= m_pending.ticket)
+			submit_pending();
+
+		while (m_completed_ticket < ticket && m_in_flight.size() > 0)
+			retire(true);
+	}
+
+	void VkUploadManager::wait_all()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		submit_pending();
+
+		while (m_in_flight.size() > 0)
+			retire(true);
+	}
+
+	uint64_t VkUploadManager::get_staged_bytes()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_staged_bytes;
+	}
+
+	VkUploadManager::Batch& VkUploadManager::get_pending_batch()
+	{
+		if (m_recording)
+			return m_pending;
+
+		auto& logical_device = m_graphics.get_logical_device();
+
+		// Reuse a finished batch or create a new one
+		if (m_free_batches.size() > 0)
+		{
+			m_pending = std::move(m_free_batches.back());
+			m_free_batches.pop_back();
+		}
+		else
+		{
+			m_pending = {};
+
+			vk::CommandBufferAllocateInfo alloc_info = {};
+			alloc_info.level = vk::CommandBufferLevel::ePrimary;
+			alloc_info.commandBufferCount = 1;
+
+			alloc_info.commandPool = m_vk_transfer_pool;
+			m_pending.transfer_command_buffer = logical_device.allocateCommandBuffers(alloc_info)[0];
+			dk_assert(m_pending.transfer_command_buffer);
+
+			alloc_info.commandPool = m_vk_graphics_pool;
+			m_pending.graphics_command_buffer = logical_device.allocateCommandBuffers(alloc_info)[0];
+			dk_assert(m_pending.graphics_command_buffer);
+
+			m_pending.transfer_finished = logical_device.createSemaphore({});
+			dk_assert(m_pending.transfer_finished);
+
+			m_pending.fence = logical_device.createFence({});
+			dk_assert(m_pending.fence);
+		}
+
+		m_pending.ticket = m_next_ticket++;
+
+		vk::CommandBufferBeginInfo begin_info = {};
+		begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+		m_pending.transfer_command_buffer.begin(begin_info);
+		m_pending.graphics_command_buffer.begin(begin_info);
+
+		m_recording = true;
+		return m_pending;
+	}
+
+	void VkUploadManager::stage(const void* data, vk::DeviceSize size, vk::Buffer& buffer, vk::DeviceSize& offset)
+	{
+		m_staged_bytes += size;
+
+		// Too big for the ring. Use a staging buffer that lives as long as the batch.
+		if (size > m_ring_size)
+		{
+			VkMemBuffer temporary = m_graphics.create_buffer
+			(
+				size,
+				vk::BufferUsageFlagBits::eTransferSrc,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+				AllocationStrategy::Linear
+			);
+
+			memcpy(temporary.memory.mapped, data, static_cast<size_t>(size));
+			buffer = temporary.buffer;
+			offset = 0;
+			get_pending_batch().temporary_buffers.push_back(temporary);
+			return;
+		}
+
+		while (true)
+		{
+			// Nothing is in use so start over at the beginning
+			if (m_ring_used == 0)
+				m_ring_head = 0;
+
+			vk::DeviceSize start = ((m_ring_head + m_alignment - 1) / m_alignment) * m_alignment;
+
+			// Wrap around, wasting the end of the ring
+			if (start + size > m_ring_size)
+				start = 0;
+
+			const vk::DeviceSize bytes = start >= m_ring_head ?
+				(start - m_ring_head) + size :
+				(m_ring_size - m_ring_head) + size;
+
+			if (m_ring_used + bytes <= m_ring_size)
+			{
+				memcpy(static_cast<char*>(m_ring.memory.mapped) + start, data, static_cast<size_t>(size));
+				m_ring_head = start + size;
+				m_ring_used += bytes;
+				get_pending_batch().ring_bytes += bytes;
+
+				buffer = m_ring.buffer;
+				offset = start;
+				return;
+			}
+
+			// Out of room. Submit what we have and wait for the oldest batch to free its space.
+			submit_pending();
+			retire(true);
+		}
+	}
+
+	void VkUploadManager::submit_pending()
+	{
+		if (!m_recording)
+			return;
+
+		m_recording = false;
+		Batch batch = std::move(m_pending);
+		m_pending = {};
+
+		batch.transfer_command_buffer.end();
+		batch.graphics_command_buffer.end();
+
+		// Copy buffers on the transfer queue
+		if (batch.has_transfer_work)
+		{
+			vk::SubmitInfo submit_info = {};
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &batch.transfer_command_buffer;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores = &batch.transfer_finished;
+
+			m_graphics.get_device_manager().get_transfer_queue().submit(submit_info, vk::Fence());
+		}
+
+		// Acquire buffers and upload images on the graphics queue
+		{
+			// Wait where the acquire barriers start, so uploads of images in the same batch
+			// don't wait on the transfer queue
+			vk::PipelineStageFlags wait_stage = buffer_read_stages;
+
+			vk::SubmitInfo submit_info = {};
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &batch.graphics_command_buffer;
+
+			if (batch.has_transfer_work)
+			{
+				submit_info.waitSemaphoreCount = 1;
+				submit_info.pWaitSemaphores = &batch.transfer_finished;
+				submit_info.pWaitDstStageMask = &wait_stage;
+			}
+
+			m_graphics.get_device_manager().get_graphics_queue().submit(submit_info, batch.fence);
+		}
+
+		m_in_flight.push_back(std::move(batch));
+	}
+
+	void VkUploadManager::retire(bool wait_for_oldest)
+	{
+		auto& logical_device = m_graphics.get_logical_device();
+
+		if (wait_for_oldest && m_in_flight.size() > 0)
+			logical_device.waitForFences(1, &m_in_flight.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+		// Batches finish in submission order
+		while (m_in_flight.size() > 0)
+		{
+			Batch& batch = m_in_flight.front();
+			if (logical_device.getFenceStatus(batch.fence) != vk::Result::eSuccess)
+				break;
+
+			logical_device.resetFences(1, &batch.fence);
+
+			for (auto& temporary : batch.temporary_buffers)
+				temporary.free(logical_device);
+
+			m_ring_used -= batch.ring_bytes;
+			m_completed_ticket = batch.ticket;
+
+			batch.temporary_buffers.clear();
+			batch.ring_bytes = 0;
+			batch.has_transfer_work = false;
+
+			m_free_batches.push_back(std::move(batch));
+			m_in_flight.pop_front();
+		}
+	}
+}
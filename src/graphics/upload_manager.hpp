@@ -0,0 +1,225 @@
+#pragma once
+
+/**
+ * @file upload_manager.hpp
+ * @brief Batched uploads to device local memory.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <deque>
+#include <mutex>
+#include "vulkan_utilities.hpp"
+
+namespace dk
+{
+	class Graphics;
+
+	/**
+	 * @brief Copies data into device local buffers and images through a persistent staging ring.
+	 * @note Uploads are recorded into a pending batch and submitted together by flush().
+	 *       Buffer copies run on the transfer queue and are handed over to the graphics
+	 *       queue. Image copies, layout transitions, and mip maps run on the graphics queue.
+	 *       Work submitted to the graphics queue after a flush sees the uploaded data,
+	 *       so renderers only need to flush before they submit.
+	 */
+	class VkUploadManager
+	{
+	public:
+
+		/** Default staging ring size. */
+		static const vk::DeviceSize default_ring_size = 32 * 1024 * 1024;
+
+		/**
+		 * @brief Constructor.
+		 * @param Graphics context.
+		 * @param Size of the staging ring in bytes.
+		 */
+		VkUploadManager(Graphics& graphics, vk::DeviceSize ring_size = default_ring_size);
+
+		/**
+		 * @brief Destructor.
+		 * @note Waits for every batch to finish.
+		 */
+		~VkUploadManager();
+
+		/**
+		 * @brief Copy data into a buffer.
+		 * @param Data.
+		 * @param Size of the data in bytes.
+		 * @param Destination buffer. Must have been created with transfer destination usage.
+		 * @param Offset in the destination buffer.
+		 * @return Ticket of the batch the copy was recorded into.
+		 */
+		uint64_t upload_buffer(const void* data, vk::DeviceSize size, const vk::Buffer& dst, vk::DeviceSize dst_offset = 0);
+
+		/**
+		 * @brief Copy data into every layer of an image and generate its mip maps.
+		 * @param Data. Layers are tightly packed one after another.
+		 * @param Size of the data in bytes.
+		 * @param Destination image. Must be in undefined layout.
+		 * @param Width.
+		 * @param Height.
+		 * @param Array layer count.
+		 * @param Mip map levels.
+		 * @return Ticket of the batch the copy was recorded into.
+		 * @note The image is left in shader read only layout.
+		 */
+		uint64_t upload_image
+		(
+			const void* data,
+			vk::DeviceSize size,
+			const vk::Image& image,
+			uint32_t width,
+			uint32_t height,
+			uint32_t layer_count = 1,
+			uint32_t mip_levels = 1
+		);
+
+		/**
+		 * @brief Submit the pending batch.
+		 * @return Ticket of the submitted batch. Zero if nothing was pending.
+		 */
+		uint64_t flush();
+
+		/**
+		 * @brief Check if a batch has finished.
+		 * @param Ticket.
+		 * @return If the batch has finished.
+		 */
+		bool is_complete(uint64_t ticket);
+
+		/**
+		 * @brief Wait for a batch to finish. Flushes the pending batch if needed.
+		 * @param Ticket.
+		 */
+		void wait(uint64_t ticket);
+
+		/**
+		 * @brief Flush and wait for every batch to finish.
+		 */
+		void wait_all();
+
+		/**
+		 * @brief Get the number of bytes staged since the upload manager was created.
+		 * @return Staged bytes.
+		 */
+		uint64_t get_staged_bytes();
+
+	private:
+
+		/**
+		 * @brief A group of uploads submitted together.
+		 */
+		struct Batch
+		{
+			/** Command buffer for the transfer queue. */
+			vk::CommandBuffer transfer_command_buffer = {};
+
+			/** Command buffer for the graphics queue. */
+			vk::CommandBuffer graphics_command_buffer = {};
+
+			/** Signaled when the transfer queue work finishes. */
+			vk::Semaphore transfer_finished = {};
+
+			/** Signaled when the whole batch finishes. */
+			vk::Fence fence = {};
+
+			/** Ticket. */
+			uint64_t ticket = 0;
+
+			/** Bytes of the staging ring used, including wasted space at the end of the ring. */
+			vk::DeviceSize ring_bytes = 0;
+
+			/** Staging buffers for uploads too large for the ring. */
+			std::vector<VkMemBuffer> temporary_buffers = {};
+
+			/** Buffers handed from the transfer queue to the graphics queue. */
+			std::vector<vk::Buffer> acquired_buffers = {};
+
+			/** Has any transfer queue work been recorded? */
+			bool has_transfer_work = false;
+		};
+
+		/**
+		 * @brief Get the pending batch, beginning a new one if needed.
+		 * @return Pending batch.
+		 */
+		Batch& get_pending_batch();
+
+		/**
+		 * @brief Copy data into staging memory.
+		 * @param Data.
+		 * @param Size in bytes.
+		 * @param Set to the buffer the data was copied into.
+		 * @param Set to the offset of the data in the buffer.
+		 */
+		void stage(const void* data, vk::DeviceSize size, vk::Buffer& buffer, vk::DeviceSize& offset);
+
+		/**
+		 * @brief Submit the pending batch.
+		 * @note Must be called with the lock held.
+		 */
+		void submit_pending();
+
+		/**
+		 * @brief Recycle batches that have finished.
+		 * @param Wait for the oldest batch to finish first?
+		 * @note Must be called with the lock held.
+		 */
+		void retire(bool wait_for_oldest);
+
+
+
+		/** Graphics context. */
+		Graphics& m_graphics;
+
+		/** Command pool for the transfer queue. */
+		vk::CommandPool m_vk_transfer_pool = {};
+
+		/** Command pool for the graphics queue. */
+		vk::CommandPool m_vk_graphics_pool = {};
+
+		/** Do buffer copies need to be handed over to the graphics queue family? */
+		bool m_separate_transfer_family = false;
+
+		/** Staging ring. */
+		VkMemBuffer m_ring = {};
+
+		/** Size of the staging ring. */
+		vk::DeviceSize m_ring_size = 0;
+
+		/** Next free offset in the staging ring. */
+		vk::DeviceSize m_ring_head = 0;
+
+		/** Bytes of the staging ring used by unfinished batches. */
+		vk::DeviceSize m_ring_used = 0;
+
+		/** Alignment of staged data. */
+		vk::DeviceSize m_alignment = 16;
+
+		/** Batch being recorded. */
+		Batch m_pending = {};
+
+		/** Is a batch being recorded? */
+		bool m_recording = false;
+
+		/** Submitted batches, oldest first. */
+		std::deque<Batch> m_in_flight = {};
+
+		/** Finished batches ready to be reused. */
+		std::vector<Batch> m_free_batches = {};
+
+		/** Ticket of the next batch. */
+		uint64_t m_next_ticket = 1;
+
+		/** Highest ticket known to be finished. */
+		uint64_t m_completed_ticket = 0;
+
+		/** Bytes staged since creation. */
+		uint64_t m_staged_bytes = 0;
+
+		/** Lock. */
+		std::mutex m_mutex;
+	};
+}
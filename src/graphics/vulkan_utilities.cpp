@@ -270,7 +270,7 @@ namespace dk
 		return vk::Format::eD16Unorm;
 	}
 
-	ShaderPipeline create_shader_pipeline(const vk::Device& logical_device, const ShaderPipelineCreateInfo& info)
+	ShaderPipeline create_shader_pipeline(const vk::Device& logical_device, const ShaderPipelineCreateInfo& info, const vk::PipelineCache& pipeline_cache)
 	{
 		ShaderPipeline pipeline = {};
 
@@ -300,9 +300,107 @@ namespace dk
 		pipeline_info.renderPass = info.render_pass;
 		pipeline_info.subpass = 0;
 
-		pipeline.pipeline = logical_device.createGraphicsPipeline(vk::PipelineCache(), pipeline_info);
+		pipeline.pipeline = logical_device.createGraphicsPipeline(pipeline_cache, pipeline_info);
 		dk_assert(pipeline.pipeline);
 
 		return pipeline;
 	}
+
+	void record_mipmaps
+	(
+		vk::CommandBuffer& command_buffer, 
+		const vk::Image& image, 
+		int32_t width, 
+		int32_t height, 
+		uint32_t mip_levels, 
+		uint32_t layer_count
+	)
+	{
+		vk::ImageMemoryBarrier barrier = {};
+		barrier.image = image;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = layer_count;
+		barrier.subresourceRange.levelCount = 1;
+
+		int32_t mip_width = width;
+		int32_t mip_height = height;
+
+		for (uint32_t i = 1; i < mip_levels; ++i) 
+		{
+			barrier.subresourceRange.baseMipLevel = i - 1;
+			barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+			barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+			command_buffer.pipelineBarrier
+			(
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eTransfer, 
+				static_cast<vk::DependencyFlagBits>(0),
+				0, nullptr,
+				0, nullptr,
+				1, &barrier
+			);
+
+			vk::ImageBlit blit = {};
+			blit.srcOffsets[0] = { 0, 0, 0 };
+			blit.srcOffsets[1] = { mip_width, mip_height, 1 };
+			blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			blit.srcSubresource.mipLevel = i - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = layer_count;
+			blit.dstOffsets[0] = { 0, 0, 0 };
+			blit.dstOffsets[1] = { mip_width > 1 ? mip_width / 2 : 1, mip_height > 1 ? mip_height / 2 : 1, 1 };
+			blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			blit.dstSubresource.mipLevel = i;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = layer_count;
+
+			command_buffer.blitImage
+			(
+				image, vk::ImageLayout::eTransferSrcOptimal,
+				image, vk::ImageLayout::eTransferDstOptimal,
+				1, &blit,
+				vk::Filter::eLinear
+			);
+
+			barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+			barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+			command_buffer.pipelineBarrier
+			(
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eFragmentShader,
+				static_cast<vk::DependencyFlagBits>(0),
+				0, nullptr,
+				0, nullptr,
+				1, &barrier
+			);
+
+			if (mip_width > 1) mip_width /= 2;
+			if (mip_height > 1) mip_height /= 2;
+		}
+
+		barrier.subresourceRange.baseMipLevel = mip_levels - 1;
+		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		command_buffer.pipelineBarrier
+		(
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eFragmentShader,
+			static_cast<vk::DependencyFlagBits>(0),
+			0, nullptr,
+			0, nullptr,
+			1, &barrier
+		);
+	}
 }
\ No newline at end of file
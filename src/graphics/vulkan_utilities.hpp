@@ -14,12 +14,44 @@
 #include <SDL_vulkan.h>
 #include <vulkan\vulkan.hpp>
 #include <vector>
+#include <utilities\memory_allocator.hpp>
 
 #undef max
 #undef min
 
 namespace dk
 {
+	class VkMemoryManager;
+
+	/**
+	 * @brief Region of device memory owned by a buffer or image.
+	 */
+	struct VkMemAllocation
+	{
+		/** Device memory block the region is in. */
+		vk::DeviceMemory memory = {};
+
+		/** Offset of the region within the block. */
+		vk::DeviceSize offset = 0;
+
+		/** Size of the region. */
+		vk::DeviceSize size = 0;
+
+		/** Persistent mapping of the region. Null if the memory isn't host visible. */
+		void* mapped = nullptr;
+
+		/** Sub-allocator book keeping. */
+		MemoryAllocation allocation = {};
+
+		/** Memory manager the region came from. */
+		VkMemoryManager* manager = nullptr;
+
+		/**
+		 * @brief Give the region back to its memory manager.
+		 */
+		void free();
+	};
+
 	/**
 	 * Shader pipeline and pipeline layout.
 	 */
@@ -83,7 +115,7 @@ namespace dk
 		vk::Image image = {};
 
 		/** Image memory. */
-		vk::DeviceMemory memory = {};
+		VkMemAllocation memory = {};
 		
 		/** Image view. */
 		vk::ImageView view = {};
@@ -137,7 +169,7 @@ namespace dk
 		vk::Buffer buffer;
 
 		/** Memory. */
-		vk::DeviceMemory memory;
+		VkMemAllocation memory;
 
 		/**
 		 * @brief Free both the buffer and the memory.
@@ -146,7 +178,7 @@ namespace dk
 		void free(const vk::Device& logical_device)
 		{
 			logical_device.destroyBuffer(buffer);
-			logical_device.freeMemory(memory);
+			memory.free();
 		}
 	};
 
@@ -250,7 +282,28 @@ namespace dk
 	 * Create a shader pipeline.
 	 * @param Logical device.
 	 * @param Shader create info.
+	 * @param Pipeline cache.
 	 * @return Shader pipeline.
 	 */
-	ShaderPipeline create_shader_pipeline(const vk::Device& logical_device, const ShaderPipelineCreateInfo& info);
+	ShaderPipeline create_shader_pipeline(const vk::Device& logical_device, const ShaderPipelineCreateInfo& info, const vk::PipelineCache& pipeline_cache = {});
+
+	/**
+	 * @brief Record commands that generate mip maps for an image.
+	 * @param Command buffer to record into.
+	 * @param Image. Every level must be in transfer destination layout.
+	 * @param Width.
+	 * @param Height.
+	 * @param Mip map levels.
+	 * @param Array layer count.
+	 * @note Every level is left in shader read only layout.
+	 */
+	void record_mipmaps
+	(
+		vk::CommandBuffer& command_buffer, 
+		const vk::Image& image, 
+		int32_t width, 
+		int32_t height, 
+		uint32_t mip_levels, 
+		uint32_t layer_count = 1
+	);
 }
\ No newline at end of file
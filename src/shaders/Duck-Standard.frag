@@ -15,16 +15,45 @@ layout(set = 0, binding = 3) uniform FragmentData
 };
 
 // Material data macro
-#define MATERIAL_DATA layout(set = 0, binding = 3) uniform MaterialData
+#define MATERIAL_DATA layout(set = 0, binding = 2) uniform MaterialData
+
+// Texture table. Must match TextureTable.
+#define TEXTURE_TABLE_SIZE 256
+#define CUBE_MAP_TABLE_SIZE 16
+#define MAX_MATERIAL_TEXTURES 8
+
+layout(set = 2, binding = 0) uniform sampler2D TEXTURE_TABLE[TEXTURE_TABLE_SIZE];
+layout(set = 2, binding = 1) uniform samplerCube CUBE_MAP_TABLE[CUBE_MAP_TABLE_SIZE];
+
+// Table slots of every materials textures
+layout(std430, set = 2, binding = 2) readonly buffer MaterialTextures
+{
+	uint MATERIAL_TEXTURES[];
+};
+
+// Material being drawn
+layout(push_constant) uniform MaterialIndex
+{
+	uint MATERIAL_INDEX;
+};
+
+// Number of textures the material uses
+#define TEXTURE_COUNT(N) layout(constant_id = 0) const uint DK_TEXTURE_COUNT = N
 
 // Texture macro
-#define TEXTURE_IN(N) layout(set = 2, binding = N) uniform sampler2D
+#define TEXTURE(N) TEXTURE_TABLE[MATERIAL_TEXTURES[(MATERIAL_INDEX * MAX_MATERIAL_TEXTURES) + N]]
 
 // Cube map macro
-#define CUBE_MAP_IN(N) layout(set = 2, binding = N) uniform samplerCube
+#define CUBE_MAP(N) CUBE_MAP_TABLE[MATERIAL_TEXTURES[(MATERIAL_INDEX * MAX_MATERIAL_TEXTURES) + N]]
 
 const float PI = 3.14159265359;
 
+// Light cluster grid. Must match LightClusterGrid.
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+
 
 
 struct PointLighData
@@ -83,8 +112,38 @@ layout(set = 1, binding = 2) uniform LightingData
 	
 	layout(offset = 16)
 	vec4 camera_position;
+	
+	layout(offset = 32)
+	vec4 view_depth;
+	
+	layout(offset = 48)
+	vec4 cluster_params;
 } lighting_data;
 
+// Point lights touching each cluster
+layout(std430, set = 1, binding = 4) buffer LightClusters
+{
+	/** Offset and count of each clusters light indices. */
+	uvec2 clusters[CLUSTER_COUNT];
+	
+	/** Indices into the point light list. */
+	uint light_indices[];
+} light_clusters;
+
+uint get_cluster(vec3 position)
+{
+	// Tile from screen position
+	uvec2 tile = uvec2(gl_FragCoord.xy / lighting_data.cluster_params.xy * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y));
+	tile = min(tile, uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+	
+	// Slice from view depth
+	float depth = max(dot(lighting_data.view_depth, vec4(position, 1.0)), 0.0001);
+	float slice = floor(log(depth) * lighting_data.cluster_params.z + lighting_data.cluster_params.w);
+	uint z = uint(clamp(slice, 0.0, float(CLUSTER_GRID_Z - 1)));
+	
+	return tile.x + (tile.y * CLUSTER_GRID_X) + (z * CLUSTER_GRID_X * CLUSTER_GRID_Y);
+}
+
 float distribution_GGX(vec3 N, vec3 H, float roughness)
 {
 	float a = roughness*roughness;
@@ -178,9 +237,11 @@ vec3 total_lighting(vec3 position, vec3 normal, float metallic, float roughness,
 		total += lighting(data);
 	}
 	
-	// Point lights
-	for(uint i = 0; i < point_lights.light_count; ++i)
+	// Point lights in this fragments cluster
+	uvec2 cluster = light_clusters.clusters[get_cluster(position)];
+	for(uint n = 0; n < cluster.y; ++n)
 	{
+		uint i = light_clusters.light_indices[cluster.x + n];
 		vec3 pos_diff = point_lights.data[i].position.xyz - position;
 		float dist = length(pos_diff);
 		
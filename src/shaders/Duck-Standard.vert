@@ -1,10 +1,37 @@
 #extension GL_ARB_separate_shader_objects : enable
 
-// Vertex inputs
+// Vertex inputs. Shaders reading packed vertices define DK_PACKED_VERTEX before including this file.
+#ifdef DK_PACKED_VERTEX
+layout(location = 0) in vec4 IN_PACKED_POSITION;
+layout(location = 1) in vec2 IN_UV;
+layout(location = 2) in vec2 IN_PACKED_NORMAL;
+layout(location = 3) in vec2 IN_PACKED_TANGENT;
+
+// Bounds packed positions are relative to. The fragment shader owns the first 16 bytes.
+layout(push_constant) uniform PackedVertexBounds
+{
+	layout(offset = 16) vec4 PACKED_POSITION_OFFSET;
+	vec4 PACKED_POSITION_SCALE;
+};
+
+// Decode an octahedral encoded unit vector
+vec3 decode_octahedral(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(v.yx)) * mix(vec2(-1.0), vec2(1.0), greaterThanEqual(v.xy, vec2(0.0)));
+	return normalize(v);
+}
+
+#define IN_POSITION (PACKED_POSITION_OFFSET.xyz + (IN_PACKED_POSITION.xyz * PACKED_POSITION_SCALE.xyz))
+#define IN_NORMAL decode_octahedral(IN_PACKED_NORMAL)
+#define IN_TANGENT decode_octahedral(IN_PACKED_TANGENT)
+#else
 layout(location = 0) in vec3 IN_POSITION;
 layout(location = 1) in vec2 IN_UV;
 layout(location = 2) in vec3 IN_NORMAL;
 layout(location = 3) in vec3 IN_TANGENT;
+#endif
 
 // Vertex ouput
 out gl_PerVertex { vec4 gl_Position; };
@@ -13,15 +40,30 @@ out gl_PerVertex { vec4 gl_Position; };
 // Material data macro
 #define MATERIAL_DATA layout(set = 0, binding = 0) uniform MaterialData
 
-// Per instance data
+// Per renderer data
 layout(set = 0, binding = 1) uniform VertexData
 {
-	layout(offset = 0)
-	mat4 MODEL;
+	int UNUSED_VERTEX_VARIABLE;
+};
+
+// Per instance data
+struct InstanceData
+{
+	/** Model matrix. */
+	mat4 model;
 	
-	layout(offset = 64)
-	mat4 MVP;
+	/** Model-view-projection matrix. */
+	mat4 mvp;
 };
 
+layout(std430, set = 1, binding = 3) readonly buffer Instances
+{
+	InstanceData data[];
+} instances;
+
+// Instance data macros
+#define MODEL instances.data[gl_InstanceIndex].model
+#define MVP instances.data[gl_InstanceIndex].mvp
+
 // Output to fragment shader macro
 #define FRAGMENT_IN(N) layout(location = N) out
\ No newline at end of file
@@ -5,7 +5,9 @@ FRAGMENT_IN(0) vec3 F_UVW;
 
 MATERIAL_DATA { layout(offset = 0) int unused; };
 
-CUBE_MAP_IN(0) cube_map_tex;
+TEXTURE_COUNT(1);
+
+#define cube_map_tex CUBE_MAP(0)
 
 void main() 
 {
@@ -12,11 +12,13 @@ MATERIAL_DATA
 	layout(offset = 16) float roughness;
 };
 
-TEXTURE_IN(0) albedo_tex;
-TEXTURE_IN(1) normal_tex;
-TEXTURE_IN(2) metallic_tex;
-TEXTURE_IN(3) roughness_tex;
-TEXTURE_IN(4) ao_tex;
+TEXTURE_COUNT(5);
+
+#define albedo_tex TEXTURE(0)
+#define normal_tex TEXTURE(1)
+#define metallic_tex TEXTURE(2)
+#define roughness_tex TEXTURE(3)
+#define ao_tex TEXTURE(4)
 
 void main() 
 {
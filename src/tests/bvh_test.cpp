@@ -0,0 +1,281 @@
+/**
+ * @file bvh_test.cpp
+ * @brief Dynamic bounding volume hierarchy tests.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <glm\gtc\matrix_transform.hpp>
+#include <utilities\bvh.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+/**
+ * A proxy in the tree and the box it was last given.
+ */
+struct TestProxy
+{
+	/** Proxy ID. */
+	int32_t proxy = DynamicBVH::null_node;
+
+	/** User data. */
+	uint32_t data = 0;
+
+	/** Tight bounding box. */
+	AABB aabb = {};
+};
+
+/**
+ * Create an AABB.
+ * @param Center.
+ * @param Extent.
+ * @return AABB.
+ */
+static AABB make_aabb(const glm::vec3& center, const glm::vec3& extent)
+{
+	AABB aabb = {};
+	aabb.center = center;
+	aabb.extent = extent;
+	return aabb;
+}
+
+/**
+ * Check if two boxes overlap, touching counts.
+ * @param First box.
+ * @param Second box.
+ * @return If they overlap.
+ */
+static bool overlaps(const AABB& a, const AABB& b)
+{
+	const glm::vec3 a_min = a.center - a.extent;
+	const glm::vec3 a_max = a.center + a.extent;
+	const glm::vec3 b_min = b.center - b.extent;
+	const glm::vec3 b_max = b.center + b.extent;
+
+	return
+		a_max.x >= b_min.x && a_max.y >= b_min.y && a_max.z >= b_min.z &&
+		a_min.x <= b_max.x && a_min.y <= b_max.y && a_min.z <= b_max.z;
+}
+
+/**
+ * Intersect a ray with a box using the slab test.
+ * @param Ray origin.
+ * @param Ray direction.
+ * @param Box.
+ * @param Maximum distance along the ray.
+ * @param Distance to the hit.
+ * @return If the ray hit the box.
+ */
+static bool ray_hits(const glm::vec3& origin, const glm::vec3& direction, const AABB& aabb, float max_distance, float& distance)
+{
+	const glm::vec3 min = aabb.center - aabb.extent;
+	const glm::vec3 max = aabb.center + aabb.extent;
+	const glm::vec3 inv_dir = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float t_min = 0.0f;
+	float t_max = max_distance;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float t0 = (min[i] - origin[i]) * inv_dir[i];
+		float t1 = (max[i] - origin[i]) * inv_dir[i];
+
+		if (t0 > t1)
+			std::swap(t0, t1);
+
+		t_min = std::max(t_min, t0);
+		t_max = std::min(t_max, t1);
+
+		if (t_min > t_max)
+			return false;
+	}
+
+	distance = t_min;
+	return true;
+}
+
+/**
+ * Small moves stay inside the fattened box and big ones reinsert.
+ */
+static void test_move_margin()
+{
+	DynamicBVH bvh(0.1f);
+	const int32_t proxy = bvh.insert(make_aabb(glm::vec3(0.0f), glm::vec3(1.0f)), 3);
+
+	dk_check(bvh.size() == 1);
+	dk_check(bvh.get_data(proxy) == 3);
+	dk_check(!bvh.move(proxy, make_aabb(glm::vec3(0.05f, 0.0f, 0.0f), glm::vec3(1.0f))));
+	dk_check(bvh.move(proxy, make_aabb(glm::vec3(5.0f, 0.0f, 0.0f), glm::vec3(1.0f))));
+
+	// The query sees the tight box, not the fattened one
+	std::vector<uint32_t> data = {};
+	bvh.query(make_aabb(glm::vec3(3.95f, 0.0f, 0.0f), glm::vec3(0.0f)), data);
+	dk_check(data.empty());
+
+	bvh.query(make_aabb(glm::vec3(4.05f, 0.0f, 0.0f), glm::vec3(0.0f)), data);
+	dk_check(data == std::vector<uint32_t>{ 3 });
+
+	bvh.remove(proxy);
+	dk_check(bvh.size() == 0);
+	dk_check(bvh.get_height() == 0);
+}
+
+/**
+ * After random inserts, moves, and removes, every query must match a brute force search.
+ */
+static void test_matches_brute_force()
+{
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.0f, 5.0f);
+	std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_int_distribution<int> operation(0, 9);
+
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 80.0f);
+
+	DynamicBVH bvh = {};
+	std::vector<TestProxy> proxies = {};
+	uint32_t next_data = 0;
+
+	const auto random_aabb = [&]()
+	{
+		return make_aabb(glm::vec3(position(rng), position(rng), position(rng)), glm::vec3(size(rng), size(rng), size(rng)));
+	};
+
+	for (size_t step = 0; step < 5000; ++step)
+	{
+		const int op = operation(rng);
+
+		if (proxies.size() < 50 || op < 4)
+		{
+			TestProxy proxy = {};
+			proxy.aabb = random_aabb();
+			proxy.data = next_data++;
+			proxy.proxy = bvh.insert(proxy.aabb, proxy.data);
+			proxies.push_back(proxy);
+		}
+		else if (op < 8)
+		{
+			// Mix moves that stay in the fattened box with moves that leave it
+			TestProxy& proxy = proxies[std::uniform_int_distribution<size_t>(0, proxies.size() - 1)(rng)];
+			if (op < 6)
+				proxy.aabb.center += glm::vec3(jitter(rng), jitter(rng), jitter(rng));
+			else
+				proxy.aabb = random_aabb();
+
+			bvh.move(proxy.proxy, proxy.aabb);
+		}
+		else
+		{
+			const size_t i = std::uniform_int_distribution<size_t>(0, proxies.size() - 1)(rng);
+			bvh.remove(proxies[i].proxy);
+			proxies[i] = proxies.back();
+			proxies.pop_back();
+		}
+
+		if (step % 100 != 99)
+			continue;
+
+		dk_check(bvh.size() == proxies.size());
+
+		for (const auto& proxy : proxies)
+			dk_check(bvh.get_data(proxy.proxy) == proxy.data);
+
+		// Box queries
+		for (size_t i = 0; i < 10; ++i)
+		{
+			const AABB aabb = make_aabb(glm::vec3(position(rng), position(rng), position(rng)), glm::vec3(size(rng) * 4.0f));
+
+			std::vector<uint32_t> expected = {};
+			for (const auto& proxy : proxies)
+				if (overlaps(proxy.aabb, aabb))
+					expected.push_back(proxy.data);
+
+			std::vector<uint32_t> found = {};
+			bvh.query(aabb, found);
+
+			std::sort(expected.begin(), expected.end());
+			std::sort(found.begin(), found.end());
+			dk_check(found == expected);
+		}
+
+		// Frustum queries
+		for (size_t i = 0; i < 4; ++i)
+		{
+			const glm::vec3 eye = glm::vec3(position(rng), position(rng), position(rng));
+			const glm::vec3 forward = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 0.0f, 0.01f));
+			Frustum frustum(proj * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+			std::vector<uint32_t> expected = {};
+			for (const auto& proxy : proxies)
+				if (frustum.check_inside(proxy.aabb))
+					expected.push_back(proxy.data);
+
+			std::vector<uint32_t> found = {};
+			bvh.query(frustum, found);
+
+			std::sort(expected.begin(), expected.end());
+			std::sort(found.begin(), found.end());
+			dk_check(found == expected);
+		}
+
+		// Raycasts. Ties may hit either proxy, so compare distances
+		for (size_t i = 0; i < 20; ++i)
+		{
+			const glm::vec3 origin = glm::vec3(position(rng), position(rng), position(rng));
+			const glm::vec3 direction = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.01f));
+			const float max_distance = 150.0f;
+
+			bool expected_hit = false;
+			float expected_distance = max_distance;
+			for (const auto& proxy : proxies)
+			{
+				float t = 0.0f;
+				if (ray_hits(origin, direction, proxy.aabb, expected_distance, t))
+				{
+					expected_hit = true;
+					expected_distance = t;
+				}
+			}
+
+			uint32_t data = 0;
+			float distance = 0.0f;
+			const bool hit = bvh.raycast(origin, direction, max_distance, data, distance);
+			dk_check(hit == expected_hit);
+
+			if (hit && expected_hit)
+			{
+				const auto owner = std::find_if(proxies.begin(), proxies.end(), [&](const TestProxy& proxy) { return proxy.data == data; });
+				dk_check(owner != proxies.end());
+				dk_check(std::abs(distance - expected_distance) < 0.001f);
+
+				float t = 0.0f;
+				dk_check(owner != proxies.end() && ray_hits(origin, direction, owner->aabb, max_distance, t) && std::abs(t - distance) < 0.001f);
+			}
+		}
+	}
+
+	// Emptying the tree leaves nothing to find
+	for (const auto& proxy : proxies)
+		bvh.remove(proxy.proxy);
+
+	std::vector<uint32_t> found = {};
+	bvh.query(make_aabb(glm::vec3(0.0f), glm::vec3(1000.0f)), found);
+
+	uint32_t data = 0;
+	float distance = 0.0f;
+	dk_check(bvh.size() == 0);
+	dk_check(found.empty());
+	dk_check(!bvh.raycast(glm::vec3(-200.0f), glm::vec3(1.0f), 1000.0f, data, distance));
+}
+
+int main()
+{
+	test_move_margin();
+	test_matches_brute_force();
+	return finish_test("bvh");
+}
@@ -0,0 +1,75 @@
+/**
+ * @file clustering_bench.cpp
+ * @brief Clustered light assignment benchmark.
+ * @author Connor J. Bramham (ReeCocho)
+ * @note Assigns 1k, 2.5k, 5k, and 10k random point lights to the cluster grid on
+ *       the calling thread and split across a thread pool like the renderer does.
+ */
+
+/** Includes. */
+#include <random>
+#include <glm\gtc\matrix_transform.hpp>
+#include <utilities\clustering.hpp>
+#include <utilities\threading.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+int main()
+{
+	const float near_plane = 0.1f;
+	const float far_plane = 500.0f;
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, near_plane, far_plane);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	const size_t worker_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	ThreadPool thread_pool(worker_count);
+	LightClusterGrid grid = {};
+
+	// Lights fill a box around the frustum, so some are culled and the rest spread across the slices
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position_xy(-300.0f, 300.0f);
+	std::uniform_real_distribution<float> position_z(-far_plane, 50.0f);
+	std::uniform_real_distribution<float> radius(1.0f, 10.0f);
+
+	std::cout << "lights, light indices, serial ms, parallel ms (" << worker_count << " threads)\n";
+
+	for (const size_t count : { 1000, 2500, 5000, 10000 })
+	{
+		std::vector<glm::vec4> lights = {};
+		for (size_t i = 0; i < count; ++i)
+			lights.push_back(glm::vec4(position_xy(rng), position_xy(rng), position_z(rng), radius(rng)));
+
+		const double serial = time_fastest([&]()
+		{
+			grid.build(view, proj, near_plane, far_plane, &lights[0].x, sizeof(glm::vec4), lights.size());
+		});
+
+		const std::vector<uint32_t> serial_indices = grid.get_light_indices();
+		const std::vector<LightClusterGrid::Cluster> serial_clusters = grid.get_clusters();
+
+		const double parallel = time_fastest([&]()
+		{
+			grid.build(view, proj, near_plane, far_plane, &lights[0].x, sizeof(glm::vec4), lights.size(), &thread_pool);
+		});
+
+		// Results don't depend on the number of threads
+		bool same = grid.get_light_indices() == serial_indices;
+		for (size_t i = 0; i < serial_clusters.size(); ++i)
+			same &=
+				grid.get_clusters()[i].offset == serial_clusters[i].offset &&
+				grid.get_clusters()[i].count == serial_clusters[i].count;
+
+		if (!same)
+		{
+			std::cerr << "Serial and parallel assignment disagree for " << count << " lights\n";
+			return 1;
+		}
+
+		std::cout <<
+			count << ", " << serial_indices.size() << ", " <<
+			serial * 1000.0 << ", " << parallel * 1000.0 << '\n';
+	}
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file culling_bench.cpp
+ * @brief Frustum culling benchmark.
+ * @author Connor J. Bramham (ReeCocho)
+ * @note Culls 10k, 100k, and 1M random boxes with the scalar test, the SIMD
+ *       test, and the SIMD test split across a thread pool like the renderer does.
+ */
+
+/** Includes. */
+#include <random>
+#include <glm\gtc\matrix_transform.hpp>
+#include <utilities\culling.hpp>
+#include <utilities\threading.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+int main()
+{
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(proj * view);
+
+	const size_t worker_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	ThreadPool thread_pool(worker_count);
+	std::vector<std::vector<uint32_t>> worker_visible(worker_count);
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> size(0.5f, 4.0f);
+
+	std::cout << "boxes, visible, scalar ms, simd ms, parallel ms (" << worker_count << " threads)\n";
+
+	for (const size_t count : { 10000, 100000, 1000000 })
+	{
+		AABBList bounds = {};
+		for (size_t i = 0; i < count; ++i)
+		{
+			AABB aabb = {};
+			aabb.center = glm::vec3(position(rng), position(rng), position(rng));
+			aabb.extent = glm::vec3(size(rng), size(rng), size(rng));
+			bounds.push_back(aabb);
+		}
+
+		std::vector<uint32_t> visible = {};
+		visible.reserve(count);
+
+		const double scalar = time_fastest([&]()
+		{
+			visible.clear();
+			for (size_t i = 0; i < count; ++i)
+				if (frustum.check_inside(bounds.get(i)))
+					visible.push_back(static_cast<uint32_t>(i));
+		});
+
+		const double simd = time_fastest([&]()
+		{
+			visible.clear();
+			cull_aabbs(frustum, bounds, 0, count, visible);
+		});
+
+		const double parallel = time_fastest([&]()
+		{
+			const size_t job_size = (count + worker_count - 1) / worker_count;
+
+			for (size_t i = 0; i < worker_count; ++i)
+			{
+				const size_t begin = std::min(i * job_size, count);
+				const size_t end = std::min(begin + job_size, count);
+				auto& worker = worker_visible[i];
+
+				thread_pool.workers[i]->add_job([&frustum, &bounds, &worker, begin, end]()
+				{
+					worker.clear();
+					cull_aabbs(frustum, bounds, begin, end, worker);
+				});
+			}
+
+			thread_pool.wait();
+
+			visible.clear();
+			for (const auto& worker : worker_visible)
+				visible.insert(visible.end(), worker.begin(), worker.end());
+		});
+
+		std::cout <<
+			count << ", " << visible.size() << ", " <<
+			scalar * 1000.0 << ", " << simd * 1000.0 << ", " << parallel * 1000.0 << '\n';
+	}
+
+	return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file culling_test.cpp
+ * @brief Frustum culling tests.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <random>
+#include <glm\gtc\matrix_transform.hpp>
+#include <utilities\culling.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+/**
+ * Create a frustum looking down -Z from the origin.
+ * @return Frustum.
+ */
+static Frustum make_frustum()
+{
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return Frustum(proj * view);
+}
+
+/**
+ * Create an AABB.
+ * @param Center.
+ * @param Extent.
+ * @return AABB.
+ */
+static AABB make_aabb(const glm::vec3& center, const glm::vec3& extent)
+{
+	AABB aabb = {};
+	aabb.center = center;
+	aabb.extent = extent;
+	return aabb;
+}
+
+/**
+ * Boxes with a known answer.
+ */
+static void test_known_boxes()
+{
+	Frustum frustum = make_frustum();
+
+	AABBList bounds = {};
+	bounds.push_back(make_aabb(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(1.0f)));		// In front
+	bounds.push_back(make_aabb(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(1.0f)));			// Behind
+	bounds.push_back(make_aabb(glm::vec3(0.0f, 0.0f, -200.0f), glm::vec3(1.0f)));		// Past the far plane
+	bounds.push_back(make_aabb(glm::vec3(50.0f, 0.0f, -10.0f), glm::vec3(1.0f)));		// Far to the right
+	bounds.push_back(make_aabb(glm::vec3(0.0f, 0.0f, -100.0f), glm::vec3(1.0f)));		// Straddles the far plane
+	bounds.push_back(make_aabb(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f)));			// Around the camera
+
+	std::vector<uint32_t> visible = {};
+	cull_aabbs(frustum, bounds, 0, bounds.size(), visible);
+
+	const std::vector<uint32_t> expected = { 0, 4, 5 };
+	dk_check(visible == expected);
+}
+
+/**
+ * The SIMD path must agree with the scalar frustum test, in order, for any range.
+ */
+static void test_matches_scalar()
+{
+	Frustum frustum = make_frustum();
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+	std::uniform_real_distribution<float> size(0.0f, 8.0f);
+
+	AABBList bounds = {};
+	for (size_t i = 0; i < 10007; ++i)
+		bounds.push_back(make_aabb(glm::vec3(position(rng), position(rng), position(rng)), glm::vec3(size(rng), size(rng), size(rng))));
+
+	std::vector<uint32_t> expected = {};
+	for (size_t i = 0; i < bounds.size(); ++i)
+		if (frustum.check_inside(bounds.get(i)))
+			expected.push_back(static_cast<uint32_t>(i));
+
+	dk_check(expected.size() > 0 && expected.size() < bounds.size());
+
+	std::vector<uint32_t> visible = {};
+	cull_aabbs(frustum, bounds, 0, bounds.size(), visible);
+	dk_check(visible == expected);
+
+	// Ranges that don't start on a multiple of 4 exercise the scalar tail
+	std::vector<uint32_t> ranges = {};
+	const size_t splits[] = { 0, 3, 1001, 1002, 5555, 9999, bounds.size() };
+	for (size_t i = 0; i + 1 < sizeof(splits) / sizeof(splits[0]); ++i)
+		cull_aabbs(frustum, bounds, splits[i], splits[i + 1], ranges);
+
+	dk_check(ranges == expected);
+}
+
+int main()
+{
+	test_known_boxes();
+	test_matches_scalar();
+	return finish_test("culling");
+}
@@ -0,0 +1,179 @@
+/**
+ * @file deduplication_bench.cpp
+ * @brief Vertex deduplication test and benchmark.
+ * @author Connor J. Bramham (ReeCocho)
+ * @note Checks deduplicate_vertices() against a quadratic search on small grids, then
+ *       times it on grids of 8k to 512k triangles. Timings are only printed, since
+ *       wall clock time is too noisy to fail a test on.
+ */
+
+/** Includes. */
+#include <vector>
+#include <cstring>
+#include <limits>
+#include <utilities\mesh_optimize.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+/** Floats in each vertex. Position, UV, and normal like the OBJ importer reads. */
+static const size_t VERTEX_FLOATS = 8;
+
+/**
+ * Create a grid of quads with every triangle's vertices written out separately, like an OBJ face list.
+ * @param Quads along each side.
+ * @return Vertices.
+ * @note Vertices on the first column alternate between zero and negative zero, which must be merged.
+ */
+static std::vector<float> make_grid(size_t size)
+{
+	std::vector<float> vertices = {};
+	vertices.reserve(size * size * 6 * VERTEX_FLOATS);
+
+	const size_t corners[] = { 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1 };
+
+	for (size_t z = 0; z < size; ++z)
+		for (size_t x = 0; x < size; ++x)
+			for (size_t i = 0; i < 6; ++i)
+			{
+				const size_t vx = x + corners[i * 2];
+				const size_t vz = z + corners[i * 2 + 1];
+				const float px = vx == 0 ? (i % 2 == 0 ? 0.0f : -0.0f) : static_cast<float>(vx);
+
+				const float vertex[VERTEX_FLOATS] =
+				{
+					px, 0.0f, static_cast<float>(vz),
+					static_cast<float>(vx) / size, static_cast<float>(vz) / size,
+					0.0f, 1.0f, 0.0f
+				};
+
+				vertices.insert(vertices.end(), vertex, vertex + VERTEX_FLOATS);
+			}
+
+	return vertices;
+}
+
+/**
+ * Deduplicate by comparing every vertex against every unique vertex before it.
+ * @param Vertices.
+ * @param Index of the unique vertex each vertex is equal to.
+ * @return Number of unique vertices.
+ */
+static size_t deduplicate_quadratic(const std::vector<float>& vertices, std::vector<uint32_t>& remap)
+{
+	const size_t vertex_count = vertices.size() / VERTEX_FLOATS;
+	std::vector<size_t> unique = {};
+	remap.resize(vertex_count);
+
+	for (size_t i = 0; i < vertex_count; ++i)
+	{
+		remap[i] = static_cast<uint32_t>(unique.size());
+
+		for (size_t j = 0; j < unique.size(); ++j)
+		{
+			bool equal = true;
+			for (size_t k = 0; k < VERTEX_FLOATS; ++k)
+				equal = equal && vertices[i * VERTEX_FLOATS + k] == vertices[unique[j] * VERTEX_FLOATS + k];
+
+			if (equal)
+			{
+				remap[i] = static_cast<uint32_t>(j);
+				break;
+			}
+		}
+
+		if (remap[i] == unique.size())
+			unique.push_back(i);
+	}
+
+	return unique.size();
+}
+
+/**
+ * Gather the first copy of every unique vertex.
+ * @param Vertices.
+ * @param Index of the unique vertex each vertex is equal to.
+ * @return Unique vertices.
+ */
+static std::vector<float> gather_unique(const std::vector<float>& vertices, const std::vector<uint32_t>& remap)
+{
+	std::vector<float> unique = {};
+
+	for (size_t i = 0; i < remap.size(); ++i)
+		if (remap[i] == unique.size() / VERTEX_FLOATS)
+			unique.insert(unique.end(), vertices.begin() + (i * VERTEX_FLOATS), vertices.begin() + ((i + 1) * VERTEX_FLOATS));
+
+	return unique;
+}
+
+/**
+ * The hash map must give the same output, bit for bit, as the quadratic search.
+ */
+static void test_matches_quadratic()
+{
+	for (const size_t size : { 1, 2, 7, 32, 64 })
+	{
+		std::vector<float> vertices = make_grid(size);
+
+		// NaN never equals anything, so each copy stays separate
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		for (size_t i = 0; i < 2; ++i)
+		{
+			vertices.insert(vertices.end(), vertices.begin(), vertices.begin() + VERTEX_FLOATS);
+			vertices[vertices.size() - 1] = nan;
+		}
+
+		std::vector<uint32_t> expected = {};
+		const size_t expected_count = deduplicate_quadratic(vertices, expected);
+
+		std::vector<uint32_t> remap = {};
+		const size_t count = deduplicate_vertices(vertices.data(), vertices.size() / VERTEX_FLOATS, sizeof(float) * VERTEX_FLOATS, remap);
+
+		// A grid of N quads has (N + 1)^2 corners, plus the two NaN vertices
+		dk_check(expected_count == (size + 1) * (size + 1) + 2);
+		dk_check(count == expected_count);
+		dk_check(remap == expected);
+
+		const std::vector<float> expected_unique = gather_unique(vertices, expected);
+		const std::vector<float> unique = gather_unique(vertices, remap);
+		dk_check(unique.size() == expected_unique.size());
+		dk_check(std::memcmp(unique.data(), expected_unique.data(), sizeof(float) * unique.size()) == 0);
+	}
+
+	// Nothing in, nothing out
+	std::vector<uint32_t> remap = { 1, 2, 3 };
+	dk_check(deduplicate_vertices(nullptr, 0, sizeof(float) * VERTEX_FLOATS, remap) == 0);
+	dk_check(remap.empty());
+}
+
+/**
+ * Print the time per vertex as meshes grow. It should stay roughly flat.
+ */
+static void bench_scaling()
+{
+	std::cout << "triangles, vertices, unique, ms, ns per vertex\n";
+
+	for (const size_t size : { 64, 128, 256, 512 })
+	{
+		const std::vector<float> vertices = make_grid(size);
+		const size_t vertex_count = vertices.size() / VERTEX_FLOATS;
+		std::vector<uint32_t> remap = {};
+		size_t count = 0;
+
+		const double seconds = time_fastest([&]()
+		{
+			count = deduplicate_vertices(vertices.data(), vertex_count, sizeof(float) * VERTEX_FLOATS, remap);
+		}, 3);
+
+		dk_check(count == (size + 1) * (size + 1));
+
+		std::cout << size * size * 2 << ", " << vertex_count << ", " << count << ", " << seconds * 1000.0 << ", " << (seconds * 1e9) / vertex_count << '\n';
+	}
+}
+
+int main()
+{
+	test_matches_quadratic();
+	bench_scaling();
+	return finish_test("deduplication");
+}
@@ -0,0 +1,494 @@
+/**
+ * @file memory_allocator_test.cpp
+ * @brief Memory sub-allocator tests.
+ * @author Connor J. Bramham (ReeCocho)
+ * @note Blocks come from a fake backend backed by host memory, so no GPU is needed.
+ */
+
+/** Includes. */
+#include <map>
+#include <random>
+#include <cstring>
+#include <utilities\memory_allocator.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+/** Block size used by the tests. */
+static const uint64_t BLOCK_SIZE = 64 * 1024;
+
+/**
+ * @brief Backend that hands out host memory and records every call.
+ */
+class FakeBackend : public MemoryBackend
+{
+public:
+
+	uint64_t allocate_block(uint32_t memory_type, uint64_t size, void** mapped) override
+	{
+		if (blocks.size() >= max_blocks)
+			return 0;
+
+		const uint64_t handle = next_handle++;
+		auto& block = blocks[handle];
+		block.memory_type = memory_type;
+		block.data.resize(static_cast<size_t>(size));
+
+		*mapped = block.data.data();
+		++allocated;
+		return handle;
+	}
+
+	void free_block(uint32_t memory_type, uint64_t block) override
+	{
+		auto it = blocks.find(block);
+		dk_check(it != blocks.end());
+		if (it == blocks.end())
+			return;
+
+		dk_check(it->second.memory_type == memory_type);
+		blocks.erase(it);
+		++freed;
+	}
+
+	/**
+	 * @brief A live block.
+	 */
+	struct Block
+	{
+		/** Memory type index. */
+		uint32_t memory_type = 0;
+
+		/** Memory. */
+		std::vector<char> data = {};
+	};
+
+	/** Live blocks by handle. */
+	std::map<uint64_t, Block> blocks = {};
+
+	/** Number of blocks allowed to be live at once. */
+	size_t max_blocks = SIZE_MAX;
+
+	/** Next block handle. Zero means failure, so it starts at one. */
+	uint64_t next_handle = 1;
+
+	/** Number of blocks allocated. */
+	size_t allocated = 0;
+
+	/** Number of blocks freed. */
+	size_t freed = 0;
+};
+
+/**
+ * Create a request.
+ * @param Size in bytes.
+ * @param Alignment in bytes.
+ * @param Allocation strategy.
+ * @return Request.
+ */
+static MemoryRequest make_request(uint64_t size, uint64_t alignment = 1, AllocationStrategy strategy = AllocationStrategy::Buddy)
+{
+	MemoryRequest request = {};
+	request.size = size;
+	request.alignment = alignment;
+	request.strategy = strategy;
+	return request;
+}
+
+/**
+ * Check if two allocations overlap.
+ * @param First allocation.
+ * @param Second allocation.
+ * @return If they share a byte of the same block.
+ */
+static bool overlaps(const MemoryAllocation& a, const MemoryAllocation& b)
+{
+	return a.block == b.block && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+/**
+ * Buddy allocations are aligned to their size class, never overlap, and merge back when freed.
+ */
+static void test_buddy()
+{
+	FakeBackend backend = {};
+	MemoryAllocator allocator(&backend, BLOCK_SIZE);
+
+	std::vector<MemoryAllocation> allocations = {};
+	for (const uint64_t size : { 1, 255, 256, 257, 1000, 4096, 5000, 300 })
+	{
+		MemoryAllocation allocation = {};
+		dk_check(allocator.allocate(make_request(size), allocation));
+		dk_check(allocation.id != 0 && allocation.size == size);
+		dk_check(allocation.offset + allocation.size <= BLOCK_SIZE);
+
+		// Buddy regions are aligned to their power of two size
+		uint64_t size_class = MemoryAllocator::min_buddy_size;
+		while (size_class < size)
+			size_class <<= 1;
+		dk_check(allocation.offset % size_class == 0);
+
+		// The mapping points into the backends memory
+		dk_check(allocation.mapped == backend.blocks[allocation.block].data.data() + allocation.offset);
+
+		for (const auto& other : allocations)
+			dk_check(!overlaps(allocation, other));
+
+		allocations.push_back(allocation);
+	}
+
+	dk_check(backend.blocks.size() == 1);
+
+	for (const auto& allocation : allocations)
+		allocator.free(allocation);
+
+	// Everything merged back, so two halves fit in the one block again
+	MemoryAllocation a = {};
+	MemoryAllocation b = {};
+	dk_check(allocator.allocate(make_request(BLOCK_SIZE / 2), a));
+	dk_check(allocator.allocate(make_request(BLOCK_SIZE / 2), b));
+	dk_check(a.block == b.block && a.offset != b.offset);
+	dk_check(backend.allocated == 1);
+
+	// A third doesn't fit, so it needs a new block
+	MemoryAllocation c = {};
+	dk_check(allocator.allocate(make_request(BLOCK_SIZE / 2), c));
+	dk_check(c.block != a.block && backend.allocated == 2);
+}
+
+/**
+ * Linear allocations are packed one after another and rewind once the block is empty.
+ */
+static void test_linear()
+{
+	FakeBackend backend = {};
+	MemoryAllocator allocator(&backend, BLOCK_SIZE);
+
+	MemoryAllocation a = {};
+	MemoryAllocation b = {};
+	MemoryAllocation c = {};
+	dk_check(allocator.allocate(make_request(100, 1, AllocationStrategy::Linear), a));
+	dk_check(allocator.allocate(make_request(100, 64, AllocationStrategy::Linear), b));
+	dk_check(allocator.allocate(make_request(10, 1, AllocationStrategy::Linear), c));
+
+	dk_check(a.offset == 0);
+	dk_check(b.offset == 128);
+	dk_check(c.offset == 228);
+	dk_check(a.block == b.block && b.block == c.block);
+
+	// Padding counts as used
+	dk_check(allocator.get_statistics().used_bytes == 238);
+
+	// Space isn't reused until every allocation is freed
+	allocator.free(b);
+	MemoryAllocation d = {};
+	dk_check(allocator.allocate(make_request(10, 1, AllocationStrategy::Linear), d));
+	dk_check(d.offset == 238);
+
+	allocator.free(a);
+	allocator.free(c);
+	allocator.free(d);
+	dk_check(allocator.get_statistics().used_bytes == 0);
+
+	MemoryAllocation e = {};
+	dk_check(allocator.allocate(make_request(10, 1, AllocationStrategy::Linear), e));
+	dk_check(e.offset == 0 && e.block == a.block);
+
+	// Linear and buddy allocations never share a block
+	MemoryAllocation f = {};
+	dk_check(allocator.allocate(make_request(10), f));
+	dk_check(f.block != e.block);
+}
+
+/**
+ * Alignment is respected by both strategies.
+ */
+static void test_alignment()
+{
+	FakeBackend backend = {};
+	MemoryAllocator allocator(&backend, BLOCK_SIZE);
+
+	for (const AllocationStrategy strategy : { AllocationStrategy::Buddy, AllocationStrategy::Linear })
+		for (const uint64_t alignment : { 1, 16, 256, 4096, 16384 })
+		{
+			MemoryAllocation padding = {};
+			MemoryAllocation allocation = {};
+			dk_check(allocator.allocate(make_request(3, 1, strategy), padding));
+			dk_check(allocator.allocate(make_request(100, alignment, strategy), allocation));
+			dk_check(allocation.offset % alignment == 0);
+			dk_check(!overlaps(padding, allocation));
+		}
+}
+
+/**
+ * Allocations larger than half a block get their own block, which is freed straight away.
+ */
+static void test_dedicated()
+{
+	FakeBackend backend = {};
+	MemoryAllocator allocator(&backend, BLOCK_SIZE);
+
+	MemoryAllocation allocation = {};
+	dk_check(allocator.allocate(make_request(BLOCK_SIZE / 2 + 1), allocation));
+	dk_check(allocation.offset == 0);
+	dk_check(backend.blocks[allocation.block].data.size() == BLOCK_SIZE / 2 + 1);
+
+	// Alignments larger than half a block are dedicated too
+	MemoryAllocation aligned = {};
+	dk_check(allocator.allocate(make_request(16, BLOCK_SIZE), aligned));
+	dk_check(aligned.offset == 0);
+
+	MemoryStatistics stats = allocator.get_statistics();
+	dk_check(stats.dedicated_count == 2 && stats.block_count == 2);
+
+	allocator.free(allocation);
+	allocator.free(aligned);
+	dk_check(backend.blocks.empty());
+	dk_check(allocator.get_statistics().block_count == 0);
+}
+
+/**
+ * Memory types and resource kinds get separate blocks, and the statistics follow them.
+ */
+static void test_pools_and_statistics()
+{
+	FakeBackend backend = {};
+	MemoryAllocator allocator(&backend, BLOCK_SIZE);
+
+	MemoryRequest buffer = make_request(1000);
+	MemoryRequest image = make_request(1000);
+	image.linear_resource = false;
+	MemoryRequest other_type = make_request(1000);
+	other_type.memory_type = 3;
+
+	MemoryAllocation a = {};
+	MemoryAllocation b = {};
+	MemoryAllocation c = {};
+	dk_check(allocator.allocate(buffer, a));
+	dk_check(allocator.allocate(image, b));
+	dk_check(allocator.allocate(other_type, c));
+
+	dk_check(a.block != b.block && b.block != c.block && a.block != c.block);
+	dk_check(c.memory_type == 3 && backend.blocks[c.block].memory_type == 3);
+
+	const MemoryStatistics stats = allocator.get_statistics();
+	dk_check(stats.block_count == 3);
+	dk_check(stats.allocation_count == 3);
+	dk_check(stats.reserved_bytes == 3 * BLOCK_SIZE);
+	dk_check(stats.used_bytes == 3 * 1024);
+
+	const MemoryStatistics type_stats = allocator.get_statistics(3);
+	dk_check(type_stats.block_count == 1 && type_stats.allocation_count == 1 && type_stats.used_bytes == 1024);
+	dk_check(allocator.get_statistics(7).block_count == 0);
+}
+
+/**
+ * Running out of backend memory fails the allocation instead of crashing.
+ */
+static void test_out_of_memory()
+{
+	FakeBackend backend = {};
+	backend.max_blocks = 1;
+	MemoryAllocator allocator(&backend, BLOCK_SIZE);
+
+	MemoryAllocation a = {};
+	MemoryAllocation b = {};
+	dk_check(allocator.allocate(make_request(BLOCK_SIZE / 2), a));
+	dk_check(allocator.allocate(make_request(BLOCK_SIZE / 2), b));
+
+	MemoryAllocation c = {};
+	dk_check(!allocator.allocate(make_request(16), c));
+	dk_check(c.id == 0);
+
+	MemoryAllocation d = {};
+	dk_check(!allocator.allocate(make_request(BLOCK_SIZE), d));
+	dk_check(d.id == 0);
+
+	// Freeing an invalid allocation does nothing
+	allocator.free(c);
+	dk_check(allocator.get_statistics().allocation_count == 2);
+}
+
+/**
+ * Emptied blocks are kept one per pool until trimmed, and everything is returned on destruction.
+ */
+static void test_trim_and_destruction()
+{
+	FakeBackend backend = {};
+
+	{
+		MemoryAllocator allocator(&backend, BLOCK_SIZE);
+
+		std::vector<MemoryAllocation> allocations(4);
+		for (auto& allocation : allocations)
+			dk_check(allocator.allocate(make_request(BLOCK_SIZE / 2), allocation));
+
+		dk_check(backend.blocks.size() == 2);
+
+		// The first empty block is kept for reuse and the second is given back
+		for (auto& allocation : allocations)
+			allocator.free(allocation);
+
+		dk_check(backend.blocks.size() == 1);
+		dk_check(allocator.get_statistics().block_count == 1);
+
+		allocator.trim();
+		dk_check(backend.blocks.empty());
+		dk_check(allocator.get_statistics().block_count == 0);
+
+		// Leave some live allocations for the destructor
+		MemoryAllocation a = {};
+		MemoryAllocation b = {};
+		dk_check(allocator.allocate(make_request(100), a));
+		dk_check(allocator.allocate(make_request(BLOCK_SIZE), b));
+		dk_check(backend.blocks.size() == 2);
+	}
+
+	dk_check(backend.blocks.empty());
+	dk_check(backend.allocated == backend.freed);
+}
+
+/**
+ * Defragmentation moves allocations out of sparse blocks and gives the emptied blocks back.
+ */
+static void test_defragment()
+{
+	FakeBackend backend = {};
+	MemoryAllocator allocator(&backend, BLOCK_SIZE);
+
+	// Fill two blocks with 4KiB allocations tagged with their index
+	const uint64_t size = 4096;
+	const size_t per_block = static_cast<size_t>(BLOCK_SIZE / size);
+	std::vector<MemoryAllocation> allocations(per_block * 2);
+
+	for (size_t i = 0; i < allocations.size(); ++i)
+	{
+		MemoryRequest request = make_request(size);
+		request.user_data = reinterpret_cast<void*>(i);
+		dk_check(allocator.allocate(request, allocations[i]));
+		std::memset(allocations[i].mapped, static_cast<int>(i), static_cast<size_t>(size));
+	}
+
+	dk_check(backend.blocks.size() == 2);
+
+	// Leave three allocations in the first block and free a few in the second to make room
+	std::vector<bool> live(allocations.size(), true);
+	for (size_t i = 0; i < per_block; ++i)
+		if (i % 5 != 0 || i > 10)
+		{
+			allocator.free(allocations[i]);
+			live[i] = false;
+		}
+
+	for (size_t i = per_block; i < per_block + 4; ++i)
+	{
+		allocator.free(allocations[i]);
+		live[i] = false;
+	}
+
+	// Refusing every move keeps everything where it is
+	size_t refused = 0;
+	dk_check(allocator.defragment([&refused](const MemoryAllocation&, const MemoryAllocation&, void*)
+	{
+		++refused;
+		return false;
+	}) == 0);
+	dk_check(refused == 3);
+	dk_check(backend.blocks.size() == 2);
+	dk_check(allocator.get_statistics().allocation_count == per_block - 1);
+
+	// Accepted moves copy the data, and the first block is given back
+	const size_t moves = allocator.defragment([&](const MemoryAllocation& from, const MemoryAllocation& to, void* user_data)
+	{
+		const size_t index = reinterpret_cast<size_t>(user_data);
+		dk_check(from.id == allocations[index].id);
+		dk_check(from.block != to.block && to.size == from.size);
+
+		std::memcpy(to.mapped, from.mapped, static_cast<size_t>(from.size));
+		allocations[index] = to;
+		return true;
+	});
+
+	dk_check(moves == 3);
+	dk_check(backend.blocks.size() == 1);
+	dk_check(allocator.get_statistics().allocation_count == per_block - 1);
+
+	for (size_t i = 0; i < allocations.size(); ++i)
+		if (live[i])
+		{
+			const char* data = static_cast<const char*>(allocations[i].mapped);
+			dk_check(data[0] == static_cast<char>(i) && data[size - 1] == static_cast<char>(i));
+		}
+
+	// Move limits are respected
+	MemoryAllocation sparse = {};
+	dk_check(allocator.allocate(make_request(BLOCK_SIZE / 2), sparse));
+	dk_check(allocator.allocate(make_request(size), sparse));
+	dk_check(allocator.defragment([](const MemoryAllocation&, const MemoryAllocation&, void*) { return true; }, 0) == 0);
+}
+
+/**
+ * Random allocations and frees never overlap and keep the statistics consistent.
+ */
+static void test_random()
+{
+	FakeBackend backend = {};
+	MemoryAllocator allocator(&backend, BLOCK_SIZE);
+	std::mt19937 rng(3);
+
+	std::vector<MemoryAllocation> allocations = {};
+	uint64_t requested = 0;
+
+	for (size_t step = 0; step < 4000; ++step)
+	{
+		if (allocations.empty() || rng() % 3 != 0)
+		{
+			const AllocationStrategy strategy = rng() % 4 == 0 ? AllocationStrategy::Linear : AllocationStrategy::Buddy;
+			MemoryRequest request = make_request(1 + rng() % 8192, 1ull << (rng() % 9), strategy);
+			request.memory_type = rng() % 2;
+
+			MemoryAllocation allocation = {};
+			dk_check(allocator.allocate(request, allocation));
+			dk_check(allocation.offset % request.alignment == 0);
+
+			for (const auto& other : allocations)
+				dk_check(!overlaps(allocation, other));
+
+			requested += request.size;
+			allocations.push_back(allocation);
+		}
+		else
+		{
+			const size_t i = rng() % allocations.size();
+			requested -= allocations[i].size;
+			allocator.free(allocations[i]);
+			allocations[i] = allocations.back();
+			allocations.pop_back();
+		}
+	}
+
+	const MemoryStatistics stats = allocator.get_statistics();
+	dk_check(stats.allocation_count == allocations.size());
+	dk_check(stats.used_bytes >= requested);
+	dk_check(stats.used_bytes <= stats.reserved_bytes);
+	dk_check(stats.block_count == backend.blocks.size());
+
+	for (const auto& allocation : allocations)
+		allocator.free(allocation);
+
+	dk_check(allocator.get_statistics().used_bytes == 0);
+}
+
+int main()
+{
+	test_buddy();
+	test_linear();
+	test_alignment();
+	test_dedicated();
+	test_pools_and_statistics();
+	test_out_of_memory();
+	test_trim_and_destruction();
+	test_defragment();
+	test_random();
+	return finish_test("memory allocator");
+}
@@ -0,0 +1,278 @@
+/**
+ * @file mesh_lod_test.cpp
+ * @brief Mesh simplification and level of detail selection tests.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cmath>
+#include <algorithm>
+#include <glm\gtc\matrix_transform.hpp>
+#include <utilities\mesh_lod.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+/**
+ * Vertex with an attribute after the position, so the stride isn't just the position.
+ */
+struct TestVertex
+{
+	/** Position. */
+	glm::vec3 position = {};
+
+	/** Texture coordinate. */
+	glm::vec2 uv = {};
+};
+
+/** Number of quads along each side of the test grid. */
+static const uint32_t GRID_SIZE = 8;
+
+/** Column of the grid that is split into a seam. */
+static const uint32_t SEAM_COLUMN = GRID_SIZE / 2;
+
+/**
+ * Get the index of a grid vertex.
+ * @param Column.
+ * @param Row.
+ * @return Index.
+ */
+static uint32_t grid_index(uint32_t x, uint32_t y)
+{
+	return (y * (GRID_SIZE + 1)) + x;
+}
+
+/**
+ * Get the index of the copy of a seam vertex used by the right half of the grid.
+ * @param Row.
+ * @return Index.
+ */
+static uint32_t seam_index(uint32_t y)
+{
+	return ((GRID_SIZE + 1) * (GRID_SIZE + 1)) + y;
+}
+
+/**
+ * Find the signed area of every triangle facing +Z, summed.
+ * @param Indices.
+ * @param Vertices.
+ * @param Set to false if any triangle faces away from +Z.
+ * @return Summed area.
+ */
+static float get_area(const std::vector<uint32_t>& indices, const std::vector<TestVertex>& vertices, bool& facing)
+{
+	float area = 0.0f;
+	facing = true;
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const glm::vec3 p0 = vertices[indices[i]].position;
+		const glm::vec3 p1 = vertices[indices[i + 1]].position;
+		const glm::vec3 p2 = vertices[indices[i + 2]].position;
+		const float z = glm::cross(p1 - p0, p2 - p0).z;
+
+		facing = facing && z > 0.0f;
+		area += z * 0.5f;
+	}
+
+	return area;
+}
+
+/**
+ * Flat grids collapse their interior but keep their outline and seams.
+ */
+static void test_simplify_grid()
+{
+	// The seam column is duplicated with different texture coordinates for the right half
+	std::vector<TestVertex> vertices = {};
+	for (uint32_t y = 0; y <= GRID_SIZE; ++y)
+		for (uint32_t x = 0; x <= GRID_SIZE; ++x)
+		{
+			TestVertex vertex = {};
+			vertex.position = glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+			vertex.uv = glm::vec2(static_cast<float>(x), static_cast<float>(y)) / static_cast<float>(GRID_SIZE);
+			vertices.push_back(vertex);
+		}
+
+	for (uint32_t y = 0; y <= GRID_SIZE; ++y)
+	{
+		TestVertex vertex = vertices[grid_index(SEAM_COLUMN, y)];
+		vertex.uv.x += 1.0f;
+		vertices.push_back(vertex);
+	}
+
+	std::vector<uint32_t> indices = {};
+	for (uint32_t y = 0; y < GRID_SIZE; ++y)
+		for (uint32_t x = 0; x < GRID_SIZE; ++x)
+		{
+			const auto get = [&](uint32_t vx, uint32_t vy)
+			{
+				return x >= SEAM_COLUMN && vx == SEAM_COLUMN ? seam_index(vy) : grid_index(vx, vy);
+			};
+
+			const uint32_t quad[] = { get(x, y), get(x + 1, y), get(x + 1, y + 1), get(x, y + 1) };
+			indices.insert(indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+		}
+
+	const std::vector<uint32_t> simplified = simplify_mesh(indices, &vertices[0].position.x, sizeof(TestVertex), vertices.size(), 0, 0.01f);
+
+	dk_check(simplified.size() % 3 == 0);
+	dk_check(simplified.size() < indices.size());
+
+	bool valid = true;
+	for (size_t i = 0; i < simplified.size(); i += 3)
+	{
+		const uint32_t a = simplified[i];
+		const uint32_t b = simplified[i + 1];
+		const uint32_t c = simplified[i + 2];
+		valid = valid && a < vertices.size() && b < vertices.size() && c < vertices.size() && a != b && b != c && a != c;
+	}
+
+	dk_check(valid);
+
+	if (!valid)
+		return;
+
+	// Nothing flipped and the surface still covers the whole grid
+	bool facing = false;
+	const float area = get_area(simplified, vertices, facing);
+	dk_check(facing);
+	dk_check(std::abs(area - static_cast<float>(GRID_SIZE * GRID_SIZE)) < 0.001f);
+
+	const auto used = [&](uint32_t v)
+	{
+		return std::find(simplified.begin(), simplified.end(), v) != simplified.end();
+	};
+
+	// Outline vertices can't move
+	for (uint32_t i = 0; i <= GRID_SIZE; ++i)
+	{
+		dk_check(used(grid_index(i, 0)));
+		dk_check(used(grid_index(i, GRID_SIZE)));
+		dk_check(used(grid_index(0, i)));
+		dk_check(used(grid_index(GRID_SIZE, i)));
+	}
+
+	// Both sides of the seam must stay, or texture coordinates would tear
+	for (uint32_t y = 0; y <= GRID_SIZE; ++y)
+	{
+		dk_check(used(grid_index(SEAM_COLUMN, y)));
+		dk_check(used(seam_index(y)));
+	}
+}
+
+/**
+ * Closed shapes with no flat areas stop at the error limit instead of the target.
+ */
+static void test_simplify_error_limit()
+{
+	// Octahedron
+	std::vector<TestVertex> vertices(6);
+	vertices[0].position = glm::vec3( 1.0f,  0.0f,  0.0f);
+	vertices[1].position = glm::vec3(-1.0f,  0.0f,  0.0f);
+	vertices[2].position = glm::vec3( 0.0f,  1.0f,  0.0f);
+	vertices[3].position = glm::vec3( 0.0f, -1.0f,  0.0f);
+	vertices[4].position = glm::vec3( 0.0f,  0.0f,  1.0f);
+	vertices[5].position = glm::vec3( 0.0f,  0.0f, -1.0f);
+
+	const std::vector<uint32_t> indices =
+	{
+		0, 2, 4,	2, 1, 4,	1, 3, 4,	3, 0, 4,
+		2, 0, 5,	1, 2, 5,	3, 1, 5,	0, 3, 5
+	};
+
+	const std::vector<uint32_t> limited = simplify_mesh(indices, &vertices[0].position.x, sizeof(TestVertex), vertices.size(), 0, 0.01f);
+	dk_check(limited == indices);
+
+	// Meshes already under the target are returned as is
+	const std::vector<uint32_t> untouched = simplify_mesh(indices, &vertices[0].position.x, sizeof(TestVertex), vertices.size(), indices.size(), 1.0f);
+	dk_check(untouched == indices);
+}
+
+/**
+ * Screen sizes match the projected radius and ignore a flipped Y axis.
+ */
+static void test_screen_size()
+{
+	// A 90 degree field of view puts 1 in [1][1]
+	glm::mat4 proj = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	dk_check(std::abs(get_screen_size(5.0f, 3.0f, proj) - 0.75f) < 0.0001f);
+
+	const float near_size = get_screen_size(10.0f, 1.0f, proj);
+	const float far_size = get_screen_size(20.0f, 1.0f, proj);
+	dk_check(near_size > far_size);
+
+	proj[1][1] *= -1.0f;
+	dk_check(get_screen_size(10.0f, 1.0f, proj) == near_size);
+
+	// Spheres around the camera cover the whole screen
+	dk_check(get_screen_size(1.0f, 1.0f, proj) == std::numeric_limits<float>::max());
+	dk_check(get_screen_size(0.0f, 1.0f, proj) == std::numeric_limits<float>::max());
+}
+
+/**
+ * Levels change once a threshold is passed by the hysteresis, and not before.
+ */
+static void test_select_lod()
+{
+	// 0.5 and 0.25 scaled by 1 +/- 0.25 are exact, so the band edges can be hit exactly
+	const float screen_sizes[] = { 0.5f, 0.25f };
+	const uint32_t count = 2;
+	const float hysteresis = 0.25f;
+
+	// Without hysteresis a size on a threshold uses the finer level
+	dk_check(select_lod(1.0f, screen_sizes, count, 0, 0.0f) == 0);
+	dk_check(select_lod(0.5f, screen_sizes, count, 0, 0.0f) == 0);
+	dk_check(select_lod(0.5f, screen_sizes, count, 2, 0.0f) == 0);
+	dk_check(select_lod(0.4f, screen_sizes, count, 0, 0.0f) == 1);
+	dk_check(select_lod(0.1f, screen_sizes, count, 0, 0.0f) == 2);
+
+	// Coarsening happens below the lower edge of the band
+	dk_check(select_lod(0.375f, screen_sizes, count, 0, hysteresis) == 0);
+	dk_check(select_lod(0.374f, screen_sizes, count, 0, hysteresis) == 1);
+	dk_check(select_lod(0.1875f, screen_sizes, count, 1, hysteresis) == 1);
+	dk_check(select_lod(0.187f, screen_sizes, count, 1, hysteresis) == 2);
+
+	// Refining happens at the upper edge of the band
+	dk_check(select_lod(0.624f, screen_sizes, count, 1, hysteresis) == 1);
+	dk_check(select_lod(0.625f, screen_sizes, count, 1, hysteresis) == 0);
+	dk_check(select_lod(0.312f, screen_sizes, count, 2, hysteresis) == 2);
+	dk_check(select_lod(0.3125f, screen_sizes, count, 2, hysteresis) == 1);
+
+	// Inside the band the current level sticks, whichever it is
+	dk_check(select_lod(0.5f, screen_sizes, count, 0, hysteresis) == 0);
+	dk_check(select_lod(0.5f, screen_sizes, count, 1, hysteresis) == 1);
+
+	// Big changes skip levels
+	dk_check(select_lod(0.01f, screen_sizes, count, 0, hysteresis) == 2);
+	dk_check(select_lod(10.0f, screen_sizes, count, 2, hysteresis) == 0);
+
+	// Levels past the end are clamped
+	dk_check(select_lod(0.01f, screen_sizes, count, 7, hysteresis) == 2);
+}
+
+/**
+ * Meshes with a single level have no screen sizes and always use it.
+ */
+static void test_select_single_lod()
+{
+	dk_check(select_lod(1.0f, nullptr, 0, 0, 0.25f) == 0);
+	dk_check(select_lod(0.0f, nullptr, 0, 0, 0.25f) == 0);
+	dk_check(select_lod(0.0f, nullptr, 0, 3, 0.25f) == 0);
+
+	// One screen size means two levels
+	const float screen_size = 0.5f;
+	dk_check(select_lod(0.1f, &screen_size, 1, 0, 0.25f) == 1);
+	dk_check(select_lod(0.1f, &screen_size, 1, 5, 0.25f) == 1);
+	dk_check(select_lod(0.9f, &screen_size, 1, 1, 0.25f) == 0);
+}
+
+int main()
+{
+	test_simplify_grid();
+	test_simplify_error_limit();
+	test_screen_size();
+	test_select_lod();
+	test_select_single_lod();
+	return finish_test("mesh_lod");
+}
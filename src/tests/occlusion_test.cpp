@@ -0,0 +1,226 @@
+/**
+ * @file occlusion_test.cpp
+ * @brief Software occlusion culling tests.
+ * @author Connor J. Bramham (ReeCocho)
+ * @note The first argument is the golden depth image. Pass "--update" as the
+ *       second argument to rewrite it after an intended change to the rasterizer.
+ */
+
+/** Includes. */
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glm\gtc\matrix_transform.hpp>
+#include <utilities\occlusion.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+/** Golden image resolution. One block wide and two blocks tall per side. */
+static const uint32_t IMAGE_WIDTH = 64;
+static const uint32_t IMAGE_HEIGHT = 32;
+
+/**
+ * Create a view-projection matrix looking down -Z from the origin.
+ * @return View-projection matrix.
+ */
+static glm::mat4 make_view_proj()
+{
+	const glm::mat4 proj = glm::perspective(glm::radians(90.0f), 2.0f, 0.1f, 100.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return proj * view;
+}
+
+/**
+ * Create an AABB.
+ * @param Center.
+ * @param Extent.
+ * @return AABB.
+ */
+static AABB make_aabb(const glm::vec3& center, const glm::vec3& extent)
+{
+	AABB aabb = {};
+	aabb.center = center;
+	aabb.extent = extent;
+	return aabb;
+}
+
+/**
+ * Add a quad facing the camera as an occluder.
+ * @param Occlusion buffer.
+ * @param View-projection matrix.
+ * @param Minimum corner.
+ * @param Maximum corner.
+ * @param Distance in front of the camera.
+ */
+static void add_quad(OcclusionBuffer& buffer, const glm::mat4& vp, const glm::vec2& min, const glm::vec2& max, float distance)
+{
+	const float positions[] =
+	{
+		min.x, min.y, -distance,
+		max.x, min.y, -distance,
+		max.x, max.y, -distance,
+		min.x, max.y, -distance
+	};
+
+	const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+	buffer.add_occluder(vp, positions, sizeof(float) * 3, indices, 6);
+}
+
+/**
+ * Convert a depth image to text, one character per pixel.
+ * @param Depth values.
+ * @return Text image. Uncovered pixels are '.', and covered pixels are 'a' plus their depth.
+ */
+static std::string to_text(const std::vector<float>& depth)
+{
+	std::string text = {};
+
+	for (uint32_t y = 0; y < IMAGE_HEIGHT; ++y)
+	{
+		for (uint32_t x = 0; x < IMAGE_WIDTH; ++x)
+		{
+			const float d = depth[y * IMAGE_WIDTH + x];
+			text += d >= 26.0f ? '.' : static_cast<char>('a' + static_cast<int>(d));
+		}
+
+		text += '\n';
+	}
+
+	return text;
+}
+
+/**
+ * A wall covering the whole screen hides everything behind it.
+ */
+static void test_full_wall()
+{
+	const glm::mat4 vp = make_view_proj();
+	OcclusionBuffer buffer(IMAGE_WIDTH, IMAGE_HEIGHT);
+
+	// Nothing is hidden by an empty buffer
+	buffer.rasterize();
+	dk_check(buffer.test(vp, make_aabb(glm::vec3(0.0f, 0.0f, -50.0f), glm::vec3(1.0f))));
+
+	add_quad(buffer, vp, glm::vec2(-100.0f), glm::vec2(100.0f), 10.0f);
+	dk_check(buffer.get_triangle_count() == 2);
+	buffer.rasterize();
+
+	// Depth is clip space W, which is the distance along the view direction
+	std::vector<float> depth = {};
+	buffer.resolve(depth);
+	dk_check(depth.size() == IMAGE_WIDTH * IMAGE_HEIGHT);
+
+	for (const float d : depth)
+		dk_check(std::abs(d - 10.0f) < 1e-3f);
+
+	dk_check(!buffer.test(vp, make_aabb(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f))));		// Behind
+	dk_check(!buffer.test(vp, make_aabb(glm::vec3(8.0f, 3.0f, -30.0f), glm::vec3(2.0f))));		// Behind, off center
+	dk_check(buffer.test(vp, make_aabb(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(1.0f))));		// In front
+	dk_check(buffer.test(vp, make_aabb(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(2.0f))));		// Through the wall
+	dk_check(buffer.test(vp, make_aabb(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f))));			// Crossing the near plane
+	dk_check(buffer.test(vp, make_aabb(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(1.0f))));		// Behind the camera
+}
+
+/**
+ * A small occluder only hides what is directly behind it.
+ */
+static void test_partial_occluder()
+{
+	const glm::mat4 vp = make_view_proj();
+	OcclusionBuffer buffer(IMAGE_WIDTH, IMAGE_HEIGHT);
+
+	// Covers the middle of the screen from -5 to 5 on X at a distance of 10
+	add_quad(buffer, vp, glm::vec2(-5.0f), glm::vec2(5.0f), 10.0f);
+	buffer.rasterize();
+
+	dk_check(!buffer.test(vp, make_aabb(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f))));		// Behind the middle
+	dk_check(buffer.test(vp, make_aabb(glm::vec3(15.0f, 0.0f, -20.0f), glm::vec3(1.0f))));		// Beside it
+	dk_check(buffer.test(vp, make_aabb(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(12.0f, 1.0f, 1.0f))));	// Wider than it
+}
+
+/**
+ * Rasterizing bands of block rows separately must give the same image as rasterizing the whole buffer.
+ */
+static void test_banded_rasterize()
+{
+	const glm::mat4 vp = make_view_proj();
+	OcclusionBuffer whole(IMAGE_WIDTH, IMAGE_HEIGHT * 2);
+	OcclusionBuffer banded(IMAGE_WIDTH, IMAGE_HEIGHT * 2);
+	dk_check(banded.get_block_rows() == 4);
+
+	for (OcclusionBuffer* buffer : { &whole, &banded })
+	{
+		add_quad(*buffer, vp, glm::vec2(-6.0f, -3.0f), glm::vec2(2.0f, 7.0f), 9.0f);
+		add_quad(*buffer, vp, glm::vec2(-1.0f, -8.0f), glm::vec2(9.0f, 1.0f), 14.0f);
+	}
+
+	whole.rasterize();
+	banded.rasterize(0, 1);
+	banded.rasterize(1, 3);
+	banded.rasterize(3, 4);
+
+	std::vector<float> whole_depth = {};
+	std::vector<float> banded_depth = {};
+	whole.resolve(whole_depth);
+	banded.resolve(banded_depth);
+	dk_check(whole_depth == banded_depth);
+}
+
+/**
+ * Overlapping occluders at different depths must match the golden image.
+ * @param Path to the golden image.
+ * @param Rewrite the golden image instead of comparing against it?
+ */
+static void test_golden_image(const std::string& path, bool update)
+{
+	const glm::mat4 vp = make_view_proj();
+	OcclusionBuffer buffer(IMAGE_WIDTH, IMAGE_HEIGHT);
+
+	add_quad(buffer, vp, glm::vec2(-12.0f, -4.0f), glm::vec2(4.0f, 6.0f), 12.0f);
+	add_quad(buffer, vp, glm::vec2(-2.0f, -3.0f), glm::vec2(3.0f, 1.0f), 4.0f);
+	add_quad(buffer, vp, glm::vec2(5.0f, -20.0f), glm::vec2(18.0f, 20.0f), 20.0f);
+
+	// A triangle to check edges that aren't axis aligned
+	const float positions[] = { 2.0f, -6.0f, -7.0f, 9.0f, -2.0f, -7.0f, 4.0f, 5.0f, -7.0f };
+	const uint32_t indices[] = { 0, 1, 2 };
+	buffer.add_occluder(vp, positions, sizeof(float) * 3, indices, 3);
+	buffer.rasterize();
+
+	std::vector<float> depth = {};
+	buffer.resolve(depth);
+	const std::string image = to_text(depth);
+
+	if (update)
+	{
+		std::ofstream stream(path);
+		stream << image;
+		dk_check(stream.good());
+		std::cout << "Wrote " << path << '\n';
+		return;
+	}
+
+	std::ifstream stream(path);
+	dk_check(stream.is_open());
+	const std::string golden = std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+	if (golden != image)
+	{
+		std::cerr << "Expected :\n" << golden << "Got :\n" << image;
+		dk_check(golden == image);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	test_full_wall();
+	test_partial_occluder();
+	test_banded_rasterize();
+
+	if (argc > 1)
+		test_golden_image(argv[1], argc > 2 && std::string(argv[2]) == "--update");
+	else
+		std::cout << "No golden image given, skipping it\n";
+
+	return finish_test("occlusion");
+}
@@ -0,0 +1,59 @@
+/**
+ * @file sorting_bench.cpp
+ * @brief Draw key sorting benchmark.
+ * @author Connor J. Bramham (ReeCocho)
+ * @note Sorts 10k, 100k, and 1M draw keys with radix_sort() and std::sort,
+ *       and checks both give the same order.
+ */
+
+/** Includes. */
+#include <random>
+#include <numeric>
+#include <utilities\sorting.hpp>
+#include "test.hpp"
+
+using namespace dk;
+
+int main()
+{
+	std::mt19937_64 rng(1);
+
+	std::cout << "keys, radix ms, std::sort ms\n";
+
+	for (const size_t count : { 10000, 100000, 1000000 })
+	{
+		// Few distinct states and random depths, like a frame of draws
+		std::vector<uint64_t> keys(count);
+		for (auto& key : keys)
+			key = ((rng() % 64) << 48) | ((rng() % 512) << 32) | ((rng() % 2048) << 16) | (rng() & 0xFFFF);
+
+		std::vector<uint64_t> radix_keys = {};
+		std::vector<uint32_t> radix_values = {};
+
+		const double radix = time_fastest([&]()
+		{
+			radix_keys = keys;
+			radix_values.resize(count);
+			std::iota(radix_values.begin(), radix_values.end(), 0);
+			radix_sort(radix_keys, radix_values);
+		});
+
+		std::vector<std::pair<uint64_t, uint32_t>> pairs(count);
+
+		const double standard = time_fastest([&]()
+		{
+			for (size_t i = 0; i < count; ++i)
+				pairs[i] = { keys[i], static_cast<uint32_t>(i) };
+
+			std::sort(pairs.begin(), pairs.end());
+		});
+
+		// Radix sort is stable, so ties keep their original order like the pairs do
+		for (size_t i = 0; i < count; ++i)
+			dk_check(radix_keys[i] == pairs[i].first && radix_values[i] == pairs[i].second);
+
+		std::cout << count << ", " << radix * 1000.0 << ", " << standard * 1000.0 << '\n';
+	}
+
+	return finish_test("sorting");
+}
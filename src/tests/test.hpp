@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * @file test.hpp
+ * @brief Test and benchmark helpers header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+
+/** Check a condition and count it as a failure if it's false. Unlike dk_assert, it stays in release builds. */
+#define dk_check(COND) {if(!(COND)) { std::cerr << "Check failed in file " << __FILE__ << " on line " << __LINE__ << " : " << #COND << '\n'; ++dk::get_test_failures(); }}((void)0)
+
+namespace dk
+{
+	/**
+	 * Get the number of failed checks.
+	 * @return Number of failed checks.
+	 */
+	inline size_t& get_test_failures()
+	{
+		static size_t failures = 0;
+		return failures;
+	}
+
+	/**
+	 * Report the result of a test program.
+	 * @param Name of the test.
+	 * @return Exit code. Zero if every check passed.
+	 */
+	inline int finish_test(const char* name)
+	{
+		if (get_test_failures() > 0)
+		{
+			std::cerr << name << " : " << get_test_failures() << " checks failed\n";
+			return 1;
+		}
+
+		std::cout << name << " : passed\n";
+		return 0;
+	}
+
+	/**
+	 * Time a function.
+	 * @param Function.
+	 * @param Number of runs.
+	 * @return Seconds the fastest run took.
+	 */
+	template<typename F>
+	inline double time_fastest(F&& function, size_t runs = 5)
+	{
+		double fastest = std::numeric_limits<double>::max();
+
+		for (size_t i = 0; i < runs; ++i)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			function();
+			const auto end = std::chrono::high_resolution_clock::now();
+			fastest = std::min(fastest, std::chrono::duration<double>(end - start).count());
+		}
+
+		return fastest;
+	}
+}
@@ -0,0 +1,46 @@
+/**
+ * @file cook.cpp
+ * @brief Offline mesh cooker.
+ * @author Connor J. Bramham (ReeCocho)
+ * @note Usage: Duck-Cook <mesh directory> [--force]
+ *       Cooks every mesh the directories resources.json lists into a .dkmesh file next
+ *       to it. Meshes whose sources haven't changed since they were last cooked are skipped.
+ */
+
+/** Includes. */
+#include <string>
+#include <utilities\debugging.hpp>
+#include <engine\mesh_cooker.hpp>
+
+int main(int argc, char* argv[])
+{
+	std::string meshes = "";
+	bool force = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--force")
+			force = true;
+		else
+			meshes = arg;
+	}
+
+	if (meshes == "")
+	{
+		dk_log("Usage: Duck-Cook <mesh directory> [--force]");
+		return 1;
+	}
+
+	if (meshes.back() != '/' && meshes.back() != '\\')
+		meshes += '/';
+
+	const size_t failed = dk::cook_meshes(meshes, force);
+	if (failed > 0)
+	{
+		dk_log(failed << " meshes failed to cook");
+		return 1;
+	}
+
+	return 0;
+}
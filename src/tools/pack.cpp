@@ -0,0 +1,73 @@
+/**
+ * @file pack.cpp
+ * @brief Offline asset packer.
+ * @author Connor J. Bramham (ReeCocho)
+ * @note Usage: Duck-Pack <config file> <pack> [--compress]
+ *       Packs every resource the resource directories in the config file list into one
+ *       file. Run from the directory the game runs from so paths match. Meshes are cooked
+ *       first if their sources changed.
+ */
+
+/** Includes. */
+#include <json.hpp>
+#include <string>
+#include <fstream>
+#include <utilities\debugging.hpp>
+#include <engine\resource_pack.hpp>
+
+/** For convenience */
+using json = nlohmann::json;
+
+int main(int argc, char* argv[])
+{
+	std::string config = "";
+	std::string pack = "";
+	bool compress = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--compress")
+			compress = true;
+		else if (config == "")
+			config = arg;
+		else
+			pack = arg;
+	}
+
+	if (config == "" || pack == "")
+	{
+		dk_log("Usage: Duck-Pack <config file> <pack> [--compress]");
+		return 1;
+	}
+
+	std::ifstream stream(config);
+	if (!stream.is_open())
+	{
+		dk_log("Failed to open " << config);
+		return 1;
+	}
+
+	json j;
+	stream >> j;
+
+	const size_t failed = dk::write_resource_pack
+	(
+		j["meshes"],
+		j["textures"],
+		j["shaders"],
+		j["materials"],
+		j["cubemaps"],
+		j["skys"],
+		pack,
+		compress
+	);
+
+	if (failed > 0)
+	{
+		dk_log(failed << " files failed to pack");
+		return 1;
+	}
+
+	return 0;
+}
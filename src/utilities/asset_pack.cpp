@@ -0,0 +1,285 @@
+/**
+ * @file asset_pack.cpp
+ * @brief Single file asset archive source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <cstring>
+#include "compression.hpp"
+#include "asset_pack.hpp"
+
+namespace dk
+{
+	/**
+	 * Start of an asset pack.
+	 */
+	struct AssetPackHeader
+	{
+		/** Identifies the file as an asset pack. */
+		uint32_t magic = 0;
+
+		/** Format version. */
+		uint32_t version = 0;
+
+		/** Number of entries in the table of contents. */
+		uint64_t entry_count = 0;
+
+		/** Length of the path table. */
+		uint64_t paths_size = 0;
+	};
+
+	/** Most a compressed file can grow by when decompressed. Bounds memory used by damaged packs. */
+	static const uint64_t MAX_COMPRESSION_RATIO = 256;
+
+	const uint32_t AssetPack::magic;
+	const uint32_t AssetPack::version;
+	const uint64_t AssetPack::alignment;
+
+	std::string normalize_pack_path(const std::string& path)
+	{
+		std::string normalized = "";
+		normalized.reserve(path.size());
+
+		size_t begin = 0;
+		while (begin <= path.size())
+		{
+			size_t end = path.find_first_of("/\\", begin);
+			if (end == std::string::npos)
+				end = path.size();
+
+			// Skip "." and the gaps between repeated slashes
+			const std::string part = path.substr(begin, end - begin);
+			if (part != "" && part != ".")
+			{
+				if (normalized != "")
+					normalized += '/';
+
+				normalized += part;
+			}
+
+			begin = end + 1;
+		}
+
+		return normalized;
+	}
+
+	uint64_t hash_pack_path(const std::string& path)
+	{
+		return hash_binary(path.data(), path.size());
+	}
+
+
+
+	bool AssetPack::open(const std::string& path)
+	{
+		close();
+
+		if (!m_file.open(path) || m_file.get_size() < sizeof(AssetPackHeader))
+			return false;
+
+		const char* data = m_file.get_data();
+		const uint64_t size = m_file.get_size();
+
+		AssetPackHeader header = {};
+		std::memcpy(&header, data, sizeof(header));
+
+		// The table of contents and path table must fit
+		const uint64_t toc_end = sizeof(AssetPackHeader) + (header.entry_count * sizeof(AssetPackEntry));
+		if 
+		(
+			header.magic != magic || 
+			header.version != version ||
+			header.entry_count > (size - sizeof(AssetPackHeader)) / sizeof(AssetPackEntry) ||
+			header.paths_size > size - toc_end
+		)
+		{
+			m_file.close();
+			return false;
+		}
+
+		const AssetPackEntry* entries = reinterpret_cast<const AssetPackEntry*>(data + sizeof(AssetPackHeader));
+
+		// Every entry must be inside the file, and sorted so they can be searched
+		for (uint64_t i = 0; i < header.entry_count; ++i)
+		{
+			const AssetPackEntry& entry = entries[i];
+
+			if 
+			(
+				entry.offset % alignment != 0 ||
+				entry.offset > size ||
+				entry.stored_size > size - entry.offset ||
+				entry.path_offset > header.paths_size ||
+				entry.path_length > header.paths_size - entry.path_offset ||
+				(entry.compressed == 0 && entry.stored_size != entry.size) ||
+				(entry.compressed != 0 && entry.size / MAX_COMPRESSION_RATIO > entry.stored_size) ||
+				(i > 0 && entries[i - 1].hash > entry.hash)
+			)
+			{
+				m_file.close();
+				return false;
+			}
+		}
+
+		m_entries = entries;
+		m_entry_count = static_cast<size_t>(header.entry_count);
+		m_paths = data + toc_end;
+		return true;
+	}
+
+	void AssetPack::close()
+	{
+		m_file.close();
+		m_entries = nullptr;
+		m_entry_count = 0;
+		m_paths = nullptr;
+	}
+
+	bool AssetPack::contains(const std::string& path) const
+	{
+		return find(normalize_pack_path(path)) != nullptr;
+	}
+
+	bool AssetPack::get(const std::string& path, FileSpan& span, std::vector<char>& storage) const
+	{
+		const AssetPackEntry* entry = find(normalize_pack_path(path));
+		if (!entry)
+			return false;
+
+		// Uncompressed files are read straight from the mapping
+		if (entry->compressed == 0)
+		{
+			span.data = m_file.get_data() + entry->offset;
+			span.size = static_cast<size_t>(entry->size);
+			return true;
+		}
+
+		storage.resize(static_cast<size_t>(entry->size));
+		if (!decompress(m_file.get_data() + entry->offset, static_cast<size_t>(entry->stored_size), storage.data(), storage.size()))
+			return false;
+
+		span.data = storage.data();
+		span.size = storage.size();
+		return true;
+	}
+
+	const AssetPackEntry* AssetPack::find(const std::string& path) const
+	{
+		if (!m_entries)
+			return nullptr;
+
+		const uint64_t hash = hash_pack_path(path);
+		const AssetPackEntry* end = m_entries + m_entry_count;
+
+		// Paths with the same hash sit next to each other
+		for 
+		(
+			const AssetPackEntry* entry = std::lower_bound(m_entries, end, hash, [](const AssetPackEntry& e, uint64_t h) { return e.hash < h; });
+			entry != end && entry->hash == hash;
+			++entry
+		)
+			if (entry->path_length == path.size() && std::memcmp(m_paths + entry->path_offset, path.data(), path.size()) == 0)
+				return entry;
+
+		return nullptr;
+	}
+
+
+
+	bool AssetPackWriter::add(const std::string& path, const char* data, size_t len, bool compress)
+	{
+		File file = {};
+		file.path = normalize_pack_path(path);
+		file.size = static_cast<uint64_t>(len);
+
+		for (const auto& other : m_files)
+			if (other.path == file.path)
+				return false;
+
+		if (compress)
+		{
+			dk::compress(data, len, file.data);
+			file.compressed = file.data.size() <= len - (len / 8) && len > 0;
+		}
+
+		if (!file.compressed)
+			file.data.assign(data, data + len);
+
+		m_files.push_back(std::move(file));
+		return true;
+	}
+
+	bool AssetPackWriter::add_file(const std::string& path, bool compress)
+	{
+		std::vector<char> data = {};
+		if (!try_read_binary_file(path, data))
+			return false;
+
+		return add(path, data.data(), data.size(), compress);
+	}
+
+	bool AssetPackWriter::write(const std::string& path) const
+	{
+		// Sort by hash so readers can binary search
+		std::vector<size_t> order(m_files.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+
+		std::vector<uint64_t> hashes(m_files.size());
+		for (size_t i = 0; i < m_files.size(); ++i)
+			hashes[i] = hash_pack_path(m_files[i].path);
+
+		std::sort(order.begin(), order.end(), [&hashes](size_t a, size_t b) { return hashes[a] < hashes[b]; });
+
+		AssetPackHeader header = {};
+		header.magic = AssetPack::magic;
+		header.version = AssetPack::version;
+		header.entry_count = m_files.size();
+
+		std::vector<AssetPackEntry> entries(m_files.size());
+		std::string paths = "";
+
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			const File& file = m_files[order[i]];
+			entries[i].hash = hashes[order[i]];
+			entries[i].size = file.size;
+			entries[i].stored_size = file.data.size();
+			entries[i].compressed = file.compressed ? 1 : 0;
+			entries[i].path_offset = static_cast<uint32_t>(paths.size());
+			entries[i].path_length = static_cast<uint32_t>(file.path.size());
+			paths += file.path;
+		}
+
+		header.paths_size = paths.size();
+
+		// Lay out the data after the path table
+		const auto align = [](uint64_t offset) { return (offset + AssetPack::alignment - 1) & ~(AssetPack::alignment - 1); };
+		uint64_t offset = align(sizeof(AssetPackHeader) + (sizeof(AssetPackEntry) * entries.size()) + paths.size());
+
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			entries[i].offset = offset;
+			offset = align(offset + entries[i].stored_size);
+		}
+
+		std::vector<char> buffer(static_cast<size_t>(offset), 0);
+		std::memcpy(buffer.data(), &header, sizeof(header));
+
+		if (!entries.empty())
+			std::memcpy(buffer.data() + sizeof(header), entries.data(), sizeof(AssetPackEntry) * entries.size());
+
+		std::memcpy(buffer.data() + sizeof(header) + (sizeof(AssetPackEntry) * entries.size()), paths.data(), paths.size());
+
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			const File& file = m_files[order[i]];
+			if (!file.data.empty())
+				std::memcpy(buffer.data() + entries[i].offset, file.data.data(), file.data.size());
+		}
+
+		return write_binary_file(path, buffer.data(), buffer.size());
+	}
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+/**
+ * @file asset_pack.hpp
+ * @brief Single file asset archive header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "file_io.hpp"
+
+namespace dk
+{
+	/**
+	 * A file in an asset pack's table of contents.
+	 */
+	struct AssetPackEntry
+	{
+		/** Hash of the path. Entries are sorted by it. */
+		uint64_t hash = 0;
+
+		/** Offset of the stored data from the start of the pack. */
+		uint64_t offset = 0;
+
+		/** Length of the file. */
+		uint64_t size = 0;
+
+		/** Length of the stored data. Smaller than the file if it's compressed. */
+		uint64_t stored_size = 0;
+
+		/** Offset of the path in the pack's path table. */
+		uint32_t path_offset = 0;
+
+		/** Length of the path. */
+		uint32_t path_length = 0;
+
+		/** Is the stored data compressed? */
+		uint32_t compressed = 0;
+
+		/** Unused. Keeps entries a multiple of 8 bytes long. */
+		uint32_t padding = 0;
+	};
+
+	/**
+	 * Put a path in the form asset packs store paths in.
+	 * @param Path.
+	 * @return Path with forward slashes and no "." or empty directories.
+	 * @note "./meshes//cube.dkmesh" and "meshes\cube.dkmesh" both become "meshes/cube.dkmesh".
+	 */
+	extern std::string normalize_pack_path(const std::string& path);
+
+	/**
+	 * Hash a path for an asset pack's table of contents.
+	 * @param Normalized path.
+	 * @return Hash.
+	 */
+	extern uint64_t hash_pack_path(const std::string& path);
+
+
+
+	/**
+	 * Memory mapped archive of many files.
+	 * @note A pack is a header, a table of contents sorted by path hash, a path table, and
+	 *       then the data of every file aligned to 16 bytes. Uncompressed files are handed out
+	 *       as views of the mapping, so reading them copies nothing. Finding a file is a
+	 *       binary search of the hashes.
+	 * @note Reading is thread safe once the pack is open.
+	 */
+	class AssetPack
+	{
+	public:
+
+		/** Identifies an asset pack. */
+		static const uint32_t magic = 0x4B504B44;
+
+		/** Asset pack format version. */
+		static const uint32_t version = 1;
+
+		/** Alignment of the data of each file. */
+		static const uint64_t alignment = 16;
+
+		/**
+		 * Default constructor.
+		 */
+		AssetPack() = default;
+
+		/**
+		 * Map an asset pack.
+		 * @param Path to the pack.
+		 * @return If the file is a valid pack of the current version.
+		 */
+		bool open(const std::string& path);
+
+		/**
+		 * Unmap the pack.
+		 */
+		void close();
+
+		/**
+		 * Check if a pack is open.
+		 * @return If a pack is open.
+		 */
+		bool is_open() const
+		{
+			return m_entries != nullptr;
+		}
+
+		/**
+		 * Get the number of files in the pack.
+		 * @return Number of files.
+		 */
+		size_t get_file_count() const
+		{
+			return m_entry_count;
+		}
+
+		/**
+		 * Check if the pack has a file.
+		 * @param Path to the file. Normalized first.
+		 * @return If the pack has the file.
+		 */
+		bool contains(const std::string& path) const;
+
+		/**
+		 * Get a file.
+		 * @param Path to the file. Normalized first.
+		 * @param Span to point at the file. Valid while the pack is open and the storage is unchanged.
+		 * @param Storage for the file if it has to be decompressed. Untouched otherwise.
+		 * @return If the pack has the file and it could be decompressed.
+		 */
+		bool get(const std::string& path, FileSpan& span, std::vector<char>& storage) const;
+
+	private:
+
+		/**
+		 * Find a file.
+		 * @param Path to the file.
+		 * @return Entry of the file. Null if the pack doesn't have it.
+		 */
+		const AssetPackEntry* find(const std::string& path) const;
+
+
+
+		/** Mapped pack. */
+		MappedFile m_file = {};
+
+		/** Table of contents. Points into the mapping. */
+		const AssetPackEntry* m_entries = nullptr;
+
+		/** Number of entries. */
+		size_t m_entry_count = 0;
+
+		/** Path table. Points into the mapping. */
+		const char* m_paths = nullptr;
+	};
+
+
+
+	/**
+	 * Builds asset packs.
+	 */
+	class AssetPackWriter
+	{
+	public:
+
+		/**
+		 * Default constructor.
+		 */
+		AssetPackWriter() = default;
+
+		/**
+		 * Add a file.
+		 * @param Path the file is found by. Normalized first.
+		 * @param Data.
+		 * @param Data length.
+		 * @param Try to compress the data? It's only kept compressed if that saves at least an eighth.
+		 * @return If the file was added. False if the pack already has a file at the path.
+		 */
+		bool add(const std::string& path, const char* data, size_t len, bool compress = false);
+
+		/**
+		 * Add a file from disk.
+		 * @param Path the file is found by and read from. Normalized first.
+		 * @param Try to compress the data?
+		 * @return If the file could be read and was added.
+		 */
+		bool add_file(const std::string& path, bool compress = false);
+
+		/**
+		 * Write the pack.
+		 * @param Path to the pack.
+		 * @return If the pack could be written.
+		 */
+		bool write(const std::string& path) const;
+
+		/**
+		 * Get the number of files added.
+		 * @return Number of files.
+		 */
+		size_t get_file_count() const
+		{
+			return m_files.size();
+		}
+
+	private:
+
+		/**
+		 * A file waiting to be written.
+		 */
+		struct File
+		{
+			/** Normalized path. */
+			std::string path = "";
+
+			/** Stored data. */
+			std::vector<char> data = {};
+
+			/** Length of the file. */
+			uint64_t size = 0;
+
+			/** Is the stored data compressed? */
+			bool compressed = false;
+		};
+
+		/** Files to write. */
+		std::vector<File> m_files = {};
+	};
+}
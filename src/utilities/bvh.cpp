@@ -0,0 +1,594 @@
+/**
+ * @file bvh.cpp
+ * @brief Dynamic bounding volume hierarchy source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <limits>
+#include "bvh.hpp"
+
+namespace dk
+{
+	/**
+	 * Get the surface area of a box.
+	 * @param Minimum.
+	 * @param Maximum.
+	 * @return Surface area.
+	 */
+	static float surface_area(const glm::vec3& min, const glm::vec3& max)
+	{
+		const glm::vec3 d = max - min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	/**
+	 * Relation between a box and a frustum.
+	 */
+	enum class FrustumOverlap
+	{
+		outside = 0,
+		intersecting = 1,
+		inside = 2
+	};
+
+	/**
+	 * Classify a box against a frustum.
+	 * @param Frustum.
+	 * @param Box center.
+	 * @param Box extent.
+	 * @return Overlap.
+	 */
+	static FrustumOverlap classify(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent)
+	{
+		FrustumOverlap overlap = FrustumOverlap::inside;
+
+		for (size_t i = 0; i < 6; ++i)
+		{
+			const glm::vec3 normal = glm::vec3(frustum.planes[i]);
+			const float d = glm::dot(center, normal) + frustum.planes[i].w;
+			const float r = glm::dot(extent, glm::abs(normal));
+
+			if (d + r < 0.0f)
+				return FrustumOverlap::outside;
+
+			if (d - r < 0.0f)
+				overlap = FrustumOverlap::intersecting;
+		}
+
+		return overlap;
+	}
+
+	/**
+	 * Intersect a ray with a box.
+	 * @param Ray origin.
+	 * @param Inverse ray direction.
+	 * @param Box minimum.
+	 * @param Box maximum.
+	 * @param Maximum distance along the ray.
+	 * @param Distance to the hit.
+	 * @return If the ray hit the box.
+	 */
+	static bool ray_intersects(const glm::vec3& origin, const glm::vec3& inv_dir, const glm::vec3& min, const glm::vec3& max, float max_distance, float& distance)
+	{
+		float t_min = 0.0f;
+		float t_max = max_distance;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			float t0 = (min[i] - origin[i]) * inv_dir[i];
+			float t1 = (max[i] - origin[i]) * inv_dir[i];
+
+			if (t0 > t1)
+				std::swap(t0, t1);
+
+			t_min = std::max(t_min, t0);
+			t_max = std::min(t_max, t1);
+
+			if (t_min > t_max)
+				return false;
+		}
+
+		distance = t_min;
+		return true;
+	}
+
+
+
+	DynamicBVH::DynamicBVH(float margin) : m_margin(margin)
+	{
+
+	}
+
+	int32_t DynamicBVH::insert(const AABB& aabb, uint32_t data)
+	{
+		const int32_t proxy = allocate_node();
+
+		auto& node = m_nodes[proxy];
+		node.bounds = aabb;
+		node.min = aabb.center - aabb.extent - glm::vec3(m_margin);
+		node.max = aabb.center + aabb.extent + glm::vec3(m_margin);
+		node.data = data;
+		node.height = 0;
+
+		insert_leaf(proxy);
+		++m_proxy_count;
+
+		return proxy;
+	}
+
+	void DynamicBVH::remove(int32_t proxy)
+	{
+		dk_assert(proxy >= 0 && proxy < static_cast<int32_t>(m_nodes.size()));
+		dk_assert(m_nodes[proxy].is_leaf());
+
+		remove_leaf(proxy);
+		free_node(proxy);
+		--m_proxy_count;
+	}
+
+	bool DynamicBVH::move(int32_t proxy, const AABB& aabb)
+	{
+		dk_assert(proxy >= 0 && proxy < static_cast<int32_t>(m_nodes.size()));
+		dk_assert(m_nodes[proxy].is_leaf());
+
+		auto& node = m_nodes[proxy];
+		node.bounds = aabb;
+
+		const glm::vec3 min = aabb.center - aabb.extent;
+		const glm::vec3 max = aabb.center + aabb.extent;
+
+		// Still inside the fattened box
+		if (
+			min.x >= node.min.x && min.y >= node.min.y && min.z >= node.min.z &&
+			max.x <= node.max.x && max.y <= node.max.y && max.z <= node.max.z
+			)
+			return false;
+
+		// Reinsert
+		remove_leaf(proxy);
+
+		m_nodes[proxy].min = min - glm::vec3(m_margin);
+		m_nodes[proxy].max = max + glm::vec3(m_margin);
+
+		insert_leaf(proxy);
+		return true;
+	}
+
+	void DynamicBVH::clear()
+	{
+		m_nodes.clear();
+		m_root = null_node;
+		m_free_list = null_node;
+		m_proxy_count = 0;
+	}
+
+	void DynamicBVH::query(const Frustum& frustum, std::vector<uint32_t>& data) const
+	{
+		if (m_root == null_node)
+			return;
+
+		std::vector<int32_t> stack = {};
+		stack.reserve(64);
+		stack.push_back(m_root);
+
+		while (stack.size() > 0)
+		{
+			const int32_t id = stack.back();
+			stack.pop_back();
+
+			const auto& node = m_nodes[id];
+			const FrustumOverlap overlap = classify(frustum, (node.min + node.max) * 0.5f, (node.max - node.min) * 0.5f);
+
+			if (overlap == FrustumOverlap::outside)
+				continue;
+
+			if (node.is_leaf())
+			{
+				// The fattened box might only be partially visible, so check the tight box
+				if (overlap == FrustumOverlap::inside || classify(frustum, node.bounds.center, node.bounds.extent) != FrustumOverlap::outside)
+					data.push_back(node.data);
+			}
+			else if (overlap == FrustumOverlap::inside)
+				collect_leaves(id, data);
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+
+	void DynamicBVH::query(const AABB& aabb, std::vector<uint32_t>& data) const
+	{
+		if (m_root == null_node)
+			return;
+
+		const glm::vec3 min = aabb.center - aabb.extent;
+		const glm::vec3 max = aabb.center + aabb.extent;
+
+		std::vector<int32_t> stack = {};
+		stack.reserve(64);
+		stack.push_back(m_root);
+
+		while (stack.size() > 0)
+		{
+			const int32_t id = stack.back();
+			stack.pop_back();
+
+			const auto& node = m_nodes[id];
+
+			if (
+				node.max.x < min.x || node.max.y < min.y || node.max.z < min.z ||
+				node.min.x > max.x || node.min.y > max.y || node.min.z > max.z
+				)
+				continue;
+
+			if (node.is_leaf())
+			{
+				const glm::vec3 leaf_min = node.bounds.center - node.bounds.extent;
+				const glm::vec3 leaf_max = node.bounds.center + node.bounds.extent;
+
+				if (
+					leaf_max.x >= min.x && leaf_max.y >= min.y && leaf_max.z >= min.z &&
+					leaf_min.x <= max.x && leaf_min.y <= max.y && leaf_min.z <= max.z
+					)
+					data.push_back(node.data);
+			}
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+
+	bool DynamicBVH::raycast(glm::vec3 origin, glm::vec3 direction, float max_distance, uint32_t& data, float& distance) const
+	{
+		if (m_root == null_node)
+			return false;
+
+		const glm::vec3 inv_dir = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		float closest = max_distance;
+		bool hit = false;
+
+		std::vector<int32_t> stack = {};
+		stack.reserve(64);
+		stack.push_back(m_root);
+
+		while (stack.size() > 0)
+		{
+			const int32_t id = stack.back();
+			stack.pop_back();
+
+			const auto& node = m_nodes[id];
+			float t = 0.0f;
+
+			// Skip nodes further away than the closest hit
+			if (!ray_intersects(origin, inv_dir, node.min, node.max, closest, t))
+				continue;
+
+			if (node.is_leaf())
+			{
+				if (ray_intersects(origin, inv_dir, node.bounds.center - node.bounds.extent, node.bounds.center + node.bounds.extent, closest, t))
+				{
+					closest = t;
+					data = node.data;
+					hit = true;
+				}
+			}
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+
+		if (hit)
+			distance = closest;
+
+		return hit;
+	}
+
+	int32_t DynamicBVH::allocate_node()
+	{
+		// Grow the node pool
+		if (m_free_list == null_node)
+		{
+			m_nodes.push_back(Node());
+			return static_cast<int32_t>(m_nodes.size() - 1);
+		}
+
+		const int32_t id = m_free_list;
+		m_free_list = m_nodes[id].parent;
+		m_nodes[id] = Node();
+
+		return id;
+	}
+
+	void DynamicBVH::free_node(int32_t node)
+	{
+		m_nodes[node] = Node();
+		m_nodes[node].parent = m_free_list;
+		m_free_list = node;
+	}
+
+	void DynamicBVH::insert_leaf(int32_t leaf)
+	{
+		if (m_root == null_node)
+		{
+			m_root = leaf;
+			m_nodes[leaf].parent = null_node;
+			return;
+		}
+
+		const glm::vec3 leaf_min = m_nodes[leaf].min;
+		const glm::vec3 leaf_max = m_nodes[leaf].max;
+
+		// Find the best sibling using the surface area heuristic
+		int32_t index = m_root;
+		while (!m_nodes[index].is_leaf())
+		{
+			const auto& node = m_nodes[index];
+			const int32_t child1 = node.child1;
+			const int32_t child2 = node.child2;
+
+			const float area = surface_area(node.min, node.max);
+			const float combined_area = surface_area(glm::min(node.min, leaf_min), glm::max(node.max, leaf_max));
+
+			// Cost of creating a new parent for this node and the new leaf
+			const float cost = 2.0f * combined_area;
+
+			// Minimum cost of pushing the leaf further down the tree
+			const float inheritance_cost = 2.0f * (combined_area - area);
+
+			// Cost of descending into a child
+			float child_costs[2] = {};
+			const int32_t children[2] = { child1, child2 };
+
+			for (size_t i = 0; i < 2; ++i)
+			{
+				const auto& child = m_nodes[children[i]];
+				const float new_area = surface_area(glm::min(child.min, leaf_min), glm::max(child.max, leaf_max));
+
+				child_costs[i] = child.is_leaf() ?
+					new_area + inheritance_cost :
+					(new_area - surface_area(child.min, child.max)) + inheritance_cost;
+			}
+
+			// Descend according to the minimum cost
+			if (cost < child_costs[0] && cost < child_costs[1])
+				break;
+
+			index = child_costs[0] < child_costs[1] ? child1 : child2;
+		}
+
+		const int32_t sibling = index;
+
+		// Create a new parent
+		const int32_t old_parent = m_nodes[sibling].parent;
+		const int32_t new_parent = allocate_node();
+
+		m_nodes[new_parent].parent = old_parent;
+		m_nodes[new_parent].min = glm::min(m_nodes[sibling].min, leaf_min);
+		m_nodes[new_parent].max = glm::max(m_nodes[sibling].max, leaf_max);
+		m_nodes[new_parent].height = m_nodes[sibling].height + 1;
+		m_nodes[new_parent].child1 = sibling;
+		m_nodes[new_parent].child2 = leaf;
+
+		if (old_parent != null_node)
+		{
+			// The sibling was not the root
+			if (m_nodes[old_parent].child1 == sibling)
+				m_nodes[old_parent].child1 = new_parent;
+			else
+				m_nodes[old_parent].child2 = new_parent;
+		}
+		else
+			m_root = new_parent;
+
+		m_nodes[sibling].parent = new_parent;
+		m_nodes[leaf].parent = new_parent;
+
+		// Walk back up the tree fixing heights and bounds
+		refit(m_nodes[leaf].parent);
+	}
+
+	void DynamicBVH::remove_leaf(int32_t leaf)
+	{
+		if (leaf == m_root)
+		{
+			m_root = null_node;
+			return;
+		}
+
+		const int32_t parent = m_nodes[leaf].parent;
+		const int32_t grand_parent = m_nodes[parent].parent;
+		const int32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+		if (grand_parent != null_node)
+		{
+			// Destroy the parent and connect the sibling to the grand parent
+			if (m_nodes[grand_parent].child1 == parent)
+				m_nodes[grand_parent].child1 = sibling;
+			else
+				m_nodes[grand_parent].child2 = sibling;
+
+			m_nodes[sibling].parent = grand_parent;
+			free_node(parent);
+
+			// Adjust ancestor bounds
+			refit(grand_parent);
+		}
+		else
+		{
+			m_root = sibling;
+			m_nodes[sibling].parent = null_node;
+			free_node(parent);
+		}
+
+		m_nodes[leaf].parent = null_node;
+	}
+
+	void DynamicBVH::refit(int32_t index)
+	{
+		while (index != null_node)
+		{
+			index = balance(index);
+
+			auto& node = m_nodes[index];
+			const auto& child1 = m_nodes[node.child1];
+			const auto& child2 = m_nodes[node.child2];
+
+			node.height = 1 + std::max(child1.height, child2.height);
+			node.min = glm::min(child1.min, child2.min);
+			node.max = glm::max(child1.max, child2.max);
+
+			index = node.parent;
+		}
+	}
+
+	int32_t DynamicBVH::balance(int32_t a_id)
+	{
+		auto& a = m_nodes[a_id];
+		if (a.is_leaf() || a.height < 2)
+			return a_id;
+
+		const int32_t b_id = a.child1;
+		const int32_t c_id = a.child2;
+		auto& b = m_nodes[b_id];
+		auto& c = m_nodes[c_id];
+
+		const int32_t balance = c.height - b.height;
+
+		// Rotate C up
+		if (balance > 1)
+		{
+			const int32_t f_id = c.child1;
+			const int32_t g_id = c.child2;
+			auto& f = m_nodes[f_id];
+			auto& g = m_nodes[g_id];
+
+			// Swap A and C
+			c.child1 = a_id;
+			c.parent = a.parent;
+			a.parent = c_id;
+
+			// A's old parent should point to C
+			if (c.parent != null_node)
+			{
+				if (m_nodes[c.parent].child1 == a_id)
+					m_nodes[c.parent].child1 = c_id;
+				else
+					m_nodes[c.parent].child2 = c_id;
+			}
+			else
+				m_root = c_id;
+
+			// Rotate
+			if (f.height > g.height)
+			{
+				c.child2 = f_id;
+				a.child2 = g_id;
+				g.parent = a_id;
+				a.min = glm::min(b.min, g.min);
+				a.max = glm::max(b.max, g.max);
+				c.min = glm::min(a.min, f.min);
+				c.max = glm::max(a.max, f.max);
+				a.height = 1 + std::max(b.height, g.height);
+				c.height = 1 + std::max(a.height, f.height);
+			}
+			else
+			{
+				c.child2 = g_id;
+				a.child2 = f_id;
+				f.parent = a_id;
+				a.min = glm::min(b.min, f.min);
+				a.max = glm::max(b.max, f.max);
+				c.min = glm::min(a.min, g.min);
+				c.max = glm::max(a.max, g.max);
+				a.height = 1 + std::max(b.height, f.height);
+				c.height = 1 + std::max(a.height, g.height);
+			}
+
+			return c_id;
+		}
+
+		// Rotate B up
+		if (balance < -1)
+		{
+			const int32_t d_id = b.child1;
+			const int32_t e_id = b.child2;
+			auto& d = m_nodes[d_id];
+			auto& e = m_nodes[e_id];
+
+			// Swap A and B
+			b.child1 = a_id;
+			b.parent = a.parent;
+			a.parent = b_id;
+
+			// A's old parent should point to B
+			if (b.parent != null_node)
+			{
+				if (m_nodes[b.parent].child1 == a_id)
+					m_nodes[b.parent].child1 = b_id;
+				else
+					m_nodes[b.parent].child2 = b_id;
+			}
+			else
+				m_root = b_id;
+
+			// Rotate
+			if (d.height > e.height)
+			{
+				b.child2 = d_id;
+				a.child1 = e_id;
+				e.parent = a_id;
+				a.min = glm::min(c.min, e.min);
+				a.max = glm::max(c.max, e.max);
+				b.min = glm::min(a.min, d.min);
+				b.max = glm::max(a.max, d.max);
+				a.height = 1 + std::max(c.height, e.height);
+				b.height = 1 + std::max(a.height, d.height);
+			}
+			else
+			{
+				b.child2 = e_id;
+				a.child1 = d_id;
+				d.parent = a_id;
+				a.min = glm::min(c.min, d.min);
+				a.max = glm::max(c.max, d.max);
+				b.min = glm::min(a.min, e.min);
+				b.max = glm::max(a.max, e.max);
+				a.height = 1 + std::max(c.height, d.height);
+				b.height = 1 + std::max(a.height, e.height);
+			}
+
+			return b_id;
+		}
+
+		return a_id;
+	}
+
+	void DynamicBVH::collect_leaves(int32_t node, std::vector<uint32_t>& data) const
+	{
+		std::vector<int32_t> stack = {};
+		stack.reserve(64);
+		stack.push_back(node);
+
+		while (stack.size() > 0)
+		{
+			const auto& n = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (n.is_leaf())
+				data.push_back(n.data);
+			else
+			{
+				stack.push_back(n.child1);
+				stack.push_back(n.child2);
+			}
+		}
+	}
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+/**
+ * @file bvh.hpp
+ * @brief Dynamic bounding volume hierarchy header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stdint.h>
+#include "debugging.hpp"
+#include "frustum.hpp"
+
+namespace dk
+{
+	/**
+	 * A dynamic bounding volume hierarchy of AABB bounding boxes.
+	 * @note Leaves are stored with a fattened bounding box so small movements 
+	 *       only refit the leaf instead of reinserting it. Tree nodes are kept 
+	 *       balanced using rotations.
+	 */
+	class DynamicBVH
+	{
+	public:
+
+		/** ID of a node that doesn't exist. */
+		static const int32_t null_node = -1;
+
+		/**
+		 * Constructor.
+		 * @param Amount leaf bounding boxes are fattened by in every direction.
+		 */
+		DynamicBVH(float margin = 0.1f);
+
+		/**
+		 * Default destructor.
+		 */
+		~DynamicBVH() = default;
+
+		/**
+		 * Insert a bounding box into the tree.
+		 * @param World space bounding box.
+		 * @param User data associated with the box.
+		 * @return Proxy ID.
+		 */
+		int32_t insert(const AABB& aabb, uint32_t data);
+
+		/**
+		 * Remove a bounding box from the tree.
+		 * @param Proxy ID.
+		 */
+		void remove(int32_t proxy);
+
+		/**
+		 * Move a bounding box.
+		 * @param Proxy ID.
+		 * @param New world space bounding box.
+		 * @return If the proxy had to be reinserted.
+		 * @note The proxy is only reinserted if the new box leaves the fattened box.
+		 */
+		bool move(int32_t proxy, const AABB& aabb);
+
+		/**
+		 * Get the user data of a proxy.
+		 * @param Proxy ID.
+		 * @return User data.
+		 */
+		uint32_t get_data(int32_t proxy) const
+		{
+			dk_assert(proxy >= 0 && proxy < static_cast<int32_t>(m_nodes.size()));
+			return m_nodes[proxy].data;
+		}
+
+		/**
+		 * Get the number of proxies in the tree.
+		 * @return Number of proxies.
+		 */
+		size_t size() const
+		{
+			return m_proxy_count;
+		}
+
+		/**
+		 * Get the height of the tree.
+		 * @return Height.
+		 */
+		int32_t get_height() const
+		{
+			return m_root == null_node ? 0 : m_nodes[m_root].height;
+		}
+
+		/**
+		 * Remove every proxy.
+		 */
+		void clear();
+
+		/**
+		 * Find every proxy whose bounding box is inside a frustum.
+		 * @param Frustum.
+		 * @param List the user data of visible proxies is appended to.
+		 * @note Subtrees completely inside the frustum are accepted without testing their leaves.
+		 */
+		void query(const Frustum& frustum, std::vector<uint32_t>& data) const;
+
+		/**
+		 * Find every proxy whose bounding box overlaps another bounding box.
+		 * @param Bounding box.
+		 * @param List the user data of overlapping proxies is appended to.
+		 */
+		void query(const AABB& aabb, std::vector<uint32_t>& data) const;
+
+		/**
+		 * Find the closest proxy whose bounding box is hit by a ray.
+		 * @param Ray origin.
+		 * @param Ray direction.
+		 * @param Maximum distance along the ray.
+		 * @param User data of the proxy that was hit.
+		 * @param Distance along the ray the hit occured.
+		 * @return If a proxy was hit.
+		 */
+		bool raycast(glm::vec3 origin, glm::vec3 direction, float max_distance, uint32_t& data, float& distance) const;
+
+	private:
+
+		/**
+		 * Node in the tree.
+		 */
+		struct Node
+		{
+			/** Bounding box minimum. Fattened for leaves. */
+			glm::vec3 min = {};
+
+			/** Bounding box maximum. Fattened for leaves. */
+			glm::vec3 max = {};
+
+			/** Tight bounding box of a leaf. */
+			AABB bounds = {};
+
+			/** Parent node, or next free node when unused. */
+			int32_t parent = null_node;
+
+			/** First child. */
+			int32_t child1 = null_node;
+
+			/** Second child. */
+			int32_t child2 = null_node;
+
+			/** Height of the node. Leaves are 0 and unused nodes are -1. */
+			int32_t height = -1;
+
+			/** User data. */
+			uint32_t data = 0;
+
+			/**
+			 * Check if the node is a leaf.
+			 * @return If the node is a leaf.
+			 */
+			bool is_leaf() const
+			{
+				return child1 == null_node;
+			}
+		};
+
+		/**
+		 * Allocate a node.
+		 * @return Node ID.
+		 */
+		int32_t allocate_node();
+
+		/**
+		 * Return a node to the free list.
+		 * @param Node ID.
+		 */
+		void free_node(int32_t node);
+
+		/**
+		 * Insert a leaf into the tree.
+		 * @param Leaf node ID.
+		 */
+		void insert_leaf(int32_t leaf);
+
+		/**
+		 * Remove a leaf from the tree.
+		 * @param Leaf node ID.
+		 */
+		void remove_leaf(int32_t leaf);
+
+		/**
+		 * Perform a rotation if a node is imbalanced.
+		 * @param Node ID.
+		 * @return ID of the node now in the original nodes place.
+		 */
+		int32_t balance(int32_t node);
+
+		/**
+		 * Refit the bounds and height of every ancestor of a node.
+		 * @param First ancestor to refit.
+		 */
+		void refit(int32_t node);
+
+		/**
+		 * Append the user data of every leaf in a subtree.
+		 * @param Root of the subtree.
+		 * @param List to append to.
+		 */
+		void collect_leaves(int32_t node, std::vector<uint32_t>& data) const;
+
+
+
+		/** Nodes. */
+		std::vector<Node> m_nodes = {};
+
+		/** Root node. */
+		int32_t m_root = null_node;
+
+		/** Head of the free node list. */
+		int32_t m_free_list = null_node;
+
+		/** Number of proxies. */
+		size_t m_proxy_count = 0;
+
+		/** Amount leaf bounding boxes are fattened by. */
+		float m_margin = 0.1f;
+	};
+}
@@ -0,0 +1,309 @@
+/**
+ * @file clustering.cpp
+ * @brief Clustered light assignment source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cmath>
+#include <cstring>
+#include <array>
+#include <algorithm>
+#include "debugging.hpp"
+#include "clustering.hpp"
+
+namespace dk
+{
+	/** Minimum number of lights a worker thread finds the clusters of. */
+	static const size_t MIN_CLUSTER_JOB_SIZE = 256;
+
+	/** Number of clusters in a depth slice. */
+	static const uint32_t CLUSTERS_PER_SLICE = LightClusterGrid::grid_width * LightClusterGrid::grid_height;
+
+	// Cluster bounds are stored in bytes
+	static_assert(LightClusterGrid::grid_width <= 256, "Too many tiles across the screen.");
+	static_assert(LightClusterGrid::grid_height <= 256, "Too many tiles down the screen.");
+	static_assert(LightClusterGrid::grid_depth <= 256, "Too many depth slices.");
+
+	/**
+	 * Find the range of normalized device coordinates a box covers on one axis.
+	 * @param Projection scale for the axis.
+	 * @param Min view space coordinate.
+	 * @param Max view space coordinate.
+	 * @param Min view depth.
+	 * @param Max view depth.
+	 * @param Set to the min normalized device coordinate.
+	 * @param Set to the max normalized device coordinate.
+	 */
+	static void project_extents(float scale, float min_coord, float max_coord, float min_depth, float max_depth, float& min_ndc, float& max_ndc)
+	{
+		// Coordinate over depth is monotonic in both, so the extremes are at the corners
+		const float a = (scale * min_coord) / min_depth;
+		const float b = (scale * min_coord) / max_depth;
+		const float c = (scale * max_coord) / min_depth;
+		const float d = (scale * max_coord) / max_depth;
+
+		min_ndc = std::min(std::min(a, b), std::min(c, d));
+		max_ndc = std::max(std::max(a, b), std::max(c, d));
+	}
+
+	/**
+	 * Find the tile a normalized device coordinate falls in.
+	 * @param Normalized device coordinate.
+	 * @param Number of tiles.
+	 * @return Tile.
+	 */
+	static uint8_t get_tile(float ndc, uint32_t tile_count)
+	{
+		const float tile = std::floor(((ndc * 0.5f) + 0.5f) * static_cast<float>(tile_count));
+		return static_cast<uint8_t>(std::min(std::max(tile, 0.0f), static_cast<float>(tile_count - 1)));
+	}
+
+
+
+	const uint32_t LightClusterGrid::grid_width;
+	const uint32_t LightClusterGrid::grid_height;
+	const uint32_t LightClusterGrid::grid_depth;
+	const uint32_t LightClusterGrid::cluster_count;
+
+	LightClusterGrid::LightClusterGrid() : m_clusters(cluster_count) {}
+
+	void LightClusterGrid::build
+	(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		float near_plane,
+		float far_plane,
+		const float* spheres,
+		size_t stride,
+		size_t count,
+		ThreadPool* thread_pool
+	)
+	{
+		dk_assert(near_plane > 0.0f);
+		dk_assert(far_plane > near_plane);
+		dk_assert(count == 0 || spheres);
+
+		m_view = view;
+		m_projection = projection;
+		m_near_plane = near_plane;
+		m_far_plane = far_plane;
+		m_spheres = spheres;
+		m_stride = stride;
+
+		// Slices grow exponentially so clusters stay roughly cube shaped
+		const float log_range = std::log(far_plane / near_plane);
+		m_slice_scale = static_cast<float>(grid_depth) / log_range;
+		m_slice_bias = -(static_cast<float>(grid_depth) * std::log(near_plane)) / log_range;
+
+		const size_t worker_count = thread_pool ? thread_pool->workers.size() : 0;
+		m_bounds.resize(count);
+
+		// Find the clusters each light touches
+		if (count < MIN_CLUSTER_JOB_SIZE * 2 || worker_count < 2)
+			compute_bounds(0, count);
+		else
+		{
+			const size_t job_size = std::max(MIN_CLUSTER_JOB_SIZE, (count + worker_count - 1) / worker_count);
+
+			for (size_t i = 0; i < worker_count; ++i)
+			{
+				const size_t begin = i * job_size;
+				const size_t end = std::min(begin + job_size, count);
+
+				if (begin >= end)
+					continue;
+
+				thread_pool->workers[i]->add_job([this, begin, end]()
+				{
+					compute_bounds(begin, end);
+				});
+			}
+
+			thread_pool->wait();
+		}
+
+		// Assign lights to clusters one group of depth slices at a time
+		const uint32_t job_count = worker_count < 2 ? 1 : static_cast<uint32_t>(std::min<size_t>(worker_count, grid_depth));
+		split_slices(job_count);
+		m_job_indices.resize(job_count);
+
+		if (job_count == 1)
+			assign_slices(0, grid_depth, m_job_indices[0]);
+		else
+		{
+			for (uint32_t i = 0; i < job_count; ++i)
+			{
+				auto& indices = m_job_indices[i];
+				indices.clear();
+
+				const uint32_t begin = m_job_slices[i];
+				const uint32_t end = m_job_slices[i + 1];
+
+				if (begin >= end)
+					continue;
+
+				thread_pool->workers[i]->add_job([this, &indices, begin, end]()
+				{
+					assign_slices(begin, end, indices);
+				});
+			}
+
+			thread_pool->wait();
+		}
+
+		// Jobs own contiguous clusters, so their lists are concatenated in order
+		size_t total = 0;
+		for (const auto& indices : m_job_indices)
+			total += indices.size();
+		m_light_indices.resize(total);
+
+		uint32_t base = 0;
+		for (uint32_t i = 0; i < job_count; ++i)
+		{
+			const auto& indices = m_job_indices[i];
+
+			for (uint32_t j = m_job_slices[i] * CLUSTERS_PER_SLICE; j < m_job_slices[i + 1] * CLUSTERS_PER_SLICE; ++j)
+				m_clusters[j].offset += base;
+
+			if (indices.size() > 0)
+				std::memcpy(m_light_indices.data() + base, indices.data(), sizeof(uint32_t) * indices.size());
+
+			base += static_cast<uint32_t>(indices.size());
+		}
+	}
+
+	void LightClusterGrid::split_slices(uint32_t job_count)
+	{
+		m_job_slices.resize(job_count + 1);
+		m_job_slices[0] = 0;
+		m_job_slices[job_count] = grid_depth;
+
+		if (job_count == 1)
+			return;
+
+		// Lights bunch up in a few slices, so slices are split by the work they hold instead of evenly
+		std::array<uint64_t, grid_depth> costs = {};
+		uint64_t total_cost = 0;
+
+		for (const auto& bounds : m_bounds)
+		{
+			const uint64_t area = static_cast<uint64_t>(bounds.max_x - bounds.min_x + 1) * static_cast<uint64_t>(bounds.max_y - bounds.min_y + 1);
+
+			for (uint32_t z = bounds.min_z; z <= bounds.max_z; ++z)
+			{
+				costs[z] += area;
+				total_cost += area;
+			}
+		}
+
+		uint64_t cost = 0;
+		uint32_t job = 1;
+
+		for (uint32_t z = 0; z < grid_depth && job < job_count; ++z)
+		{
+			cost += costs[z];
+
+			if (cost * job_count >= total_cost * job)
+				m_job_slices[job++] = z + 1;
+		}
+
+		// Jobs that got nothing are given empty ranges
+		for (; job < job_count; ++job)
+			m_job_slices[job] = grid_depth;
+	}
+
+	void LightClusterGrid::compute_bounds(size_t begin, size_t end)
+	{
+		const float scale_x = m_projection[0][0];
+		const float scale_y = m_projection[1][1];
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			const float* sphere = reinterpret_cast<const float*>(reinterpret_cast<const char*>(m_spheres) + (i * m_stride));
+			const glm::vec4 center = m_view * glm::vec4(sphere[0], sphere[1], sphere[2], 1.0f);
+			const float radius = sphere[3];
+
+			ClusterBounds bounds = {};
+			m_bounds[i] = bounds;
+
+			// Cameras look down negative Z
+			const float depth = -center.z;
+			const float min_depth = std::max(depth - radius, m_near_plane);
+			const float max_depth = std::min(depth + radius, m_far_plane);
+
+			if (radius <= 0.0f || min_depth > max_depth)
+				continue;
+
+			// Screen space extents of the lights bounding box
+			float min_x = 0.0f, max_x = 0.0f, min_y = 0.0f, max_y = 0.0f;
+			project_extents(scale_x, center.x - radius, center.x + radius, min_depth, max_depth, min_x, max_x);
+			project_extents(scale_y, center.y - radius, center.y + radius, min_depth, max_depth, min_y, max_y);
+
+			if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f)
+				continue;
+
+			bounds.min_x = get_tile(min_x, grid_width);
+			bounds.max_x = get_tile(max_x, grid_width);
+			bounds.min_y = get_tile(min_y, grid_height);
+			bounds.max_y = get_tile(max_y, grid_height);
+			bounds.min_z = static_cast<uint8_t>(get_slice(min_depth));
+			bounds.max_z = static_cast<uint8_t>(get_slice(max_depth));
+			m_bounds[i] = bounds;
+		}
+	}
+
+	void LightClusterGrid::assign_slices(uint32_t begin, uint32_t end, std::vector<uint32_t>& indices)
+	{
+		const uint32_t first_cluster = begin * CLUSTERS_PER_SLICE;
+		const uint32_t last_cluster = end * CLUSTERS_PER_SLICE;
+
+		for (uint32_t i = first_cluster; i < last_cluster; ++i)
+			m_clusters[i] = {};
+
+		// Count the lights in each cluster
+		for (const auto& bounds : m_bounds)
+		{
+			const uint32_t min_z = std::max<uint32_t>(bounds.min_z, begin);
+			const uint32_t max_z = std::min<uint32_t>(bounds.max_z + 1, end);
+
+			for (uint32_t z = min_z; z < max_z; ++z)
+				for (uint32_t y = bounds.min_y; y <= bounds.max_y; ++y)
+					for (uint32_t x = bounds.min_x; x <= bounds.max_x; ++x)
+						++m_clusters[x + (y * grid_width) + (z * CLUSTERS_PER_SLICE)].count;
+		}
+
+		// Give each cluster its own range of the list
+		uint32_t total = 0;
+		for (uint32_t i = first_cluster; i < last_cluster; ++i)
+		{
+			m_clusters[i].offset = total;
+			total += m_clusters[i].count;
+			m_clusters[i].count = 0;
+		}
+
+		indices.resize(total);
+
+		// Write light indices. Lights are visited in order, so each cluster's list is sorted.
+		for (size_t i = 0; i < m_bounds.size(); ++i)
+		{
+			const auto& bounds = m_bounds[i];
+			const uint32_t min_z = std::max<uint32_t>(bounds.min_z, begin);
+			const uint32_t max_z = std::min<uint32_t>(bounds.max_z + 1, end);
+
+			for (uint32_t z = min_z; z < max_z; ++z)
+				for (uint32_t y = bounds.min_y; y <= bounds.max_y; ++y)
+					for (uint32_t x = bounds.min_x; x <= bounds.max_x; ++x)
+					{
+						auto& cluster = m_clusters[x + (y * grid_width) + (z * CLUSTERS_PER_SLICE)];
+						indices[cluster.offset + cluster.count++] = static_cast<uint32_t>(i);
+					}
+		}
+	}
+
+	uint32_t LightClusterGrid::get_slice(float depth) const
+	{
+		const float slice = std::floor((std::log(depth) * m_slice_scale) + m_slice_bias);
+		return static_cast<uint32_t>(std::min(std::max(slice, 0.0f), static_cast<float>(grid_depth - 1)));
+	}
+}
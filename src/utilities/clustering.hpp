@@ -0,0 +1,215 @@
+#pragma once
+
+/**
+ * @file clustering.hpp
+ * @brief Clustered light assignment header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stdint.h>
+#include <glm\glm.hpp>
+#include "threading.hpp"
+
+namespace dk
+{
+	/**
+	 * Splits the view frustum into a grid of clusters and finds the lights touching each one.
+	 * @note Clusters are screen space tiles in X and Y and exponentially sized view depth
+	 * slices in Z. Cluster (x, y, z) has index x + (y * grid_width) + (z * grid_width * grid_height).
+	 * @note Work is split across worker threads by depth slice, so every thread writes to
+	 * its own clusters and the results don't depend on the number of threads.
+	 */
+	class LightClusterGrid
+	{
+	public:
+
+		/** Number of tiles across the screen. Must match the shaders. */
+		static const uint32_t grid_width = 16;
+
+		/** Number of tiles down the screen. Must match the shaders. */
+		static const uint32_t grid_height = 9;
+
+		/** Number of depth slices. Must match the shaders. */
+		static const uint32_t grid_depth = 24;
+
+		/** Total number of clusters. */
+		static const uint32_t cluster_count = grid_width * grid_height * grid_depth;
+
+		/**
+		 * The lights touching a cluster.
+		 * @note Laid out like a uvec2 in a std430 buffer.
+		 */
+		struct Cluster
+		{
+			/** Index of the clusters first light index. */
+			uint32_t offset = 0;
+
+			/** Number of lights. */
+			uint32_t count = 0;
+		};
+
+		/**
+		 * Constructor.
+		 */
+		LightClusterGrid();
+
+		/**
+		 * Assign lights to clusters.
+		 * @param View matrix.
+		 * @param Projection matrix. Must be a symmetric perspective projection.
+		 * @param Near clipping plane.
+		 * @param Far clipping plane.
+		 * @param Pointer to the first light. The center is X, Y, and Z and the radius is W.
+		 * @param Number of bytes between each light.
+		 * @param Number of lights.
+		 * @param Thread pool to split the work across. Runs on the calling thread if null.
+		 */
+		void build
+		(
+			const glm::mat4& view,
+			const glm::mat4& projection,
+			float near_plane,
+			float far_plane,
+			const float* spheres,
+			size_t stride,
+			size_t count,
+			ThreadPool* thread_pool = nullptr
+		);
+
+		/**
+		 * Get the clusters.
+		 * @return Clusters.
+		 */
+		const std::vector<Cluster>& get_clusters() const
+		{
+			return m_clusters;
+		}
+
+		/**
+		 * Get the light indices every cluster points into.
+		 * @return Light indices.
+		 */
+		const std::vector<uint32_t>& get_light_indices() const
+		{
+			return m_light_indices;
+		}
+
+		/**
+		 * Get the scale used to find the depth slice of a view depth.
+		 * @return Slice scale.
+		 * @note slice = floor(log(depth) * scale + bias)
+		 */
+		float get_slice_scale() const
+		{
+			return m_slice_scale;
+		}
+
+		/**
+		 * Get the bias used to find the depth slice of a view depth.
+		 * @return Slice bias.
+		 * @note slice = floor(log(depth) * scale + bias)
+		 */
+		float get_slice_bias() const
+		{
+			return m_slice_bias;
+		}
+
+	private:
+
+		/**
+		 * The clusters a light touches.
+		 * @note Bounds are inclusive. Lights outside the frustum have a min Z greater than their max Z.
+		 */
+		struct ClusterBounds
+		{
+			/** Min X. */
+			uint8_t min_x = 0;
+
+			/** Max X. */
+			uint8_t max_x = 0;
+
+			/** Min Y. */
+			uint8_t min_y = 0;
+
+			/** Max Y. */
+			uint8_t max_y = 0;
+
+			/** Min Z. */
+			uint8_t min_z = 1;
+
+			/** Max Z. */
+			uint8_t max_z = 0;
+		};
+
+		/**
+		 * Find the clusters a range of lights touch.
+		 * @param Index of the first light.
+		 * @param One past the index of the last light.
+		 */
+		void compute_bounds(size_t begin, size_t end);
+
+		/**
+		 * Split the depth slices between jobs.
+		 * @param Number of jobs.
+		 */
+		void split_slices(uint32_t job_count);
+
+		/**
+		 * Assign lights to a range of depth slices.
+		 * @param First slice.
+		 * @param One past the last slice.
+		 * @param List to write light indices to. Cluster offsets are relative to it.
+		 */
+		void assign_slices(uint32_t begin, uint32_t end, std::vector<uint32_t>& indices);
+
+		/**
+		 * Get the depth slice a view depth falls in.
+		 * @param View depth.
+		 * @return Depth slice.
+		 */
+		uint32_t get_slice(float depth) const;
+
+
+
+		/** View matrix. */
+		glm::mat4 m_view = {};
+
+		/** Projection matrix. */
+		glm::mat4 m_projection = {};
+
+		/** Near clipping plane. */
+		float m_near_plane = 0.0f;
+
+		/** Far clipping plane. */
+		float m_far_plane = 0.0f;
+
+		/** Depth slice scale. */
+		float m_slice_scale = 0.0f;
+
+		/** Depth slice bias. */
+		float m_slice_bias = 0.0f;
+
+		/** Light spheres. */
+		const float* m_spheres = nullptr;
+
+		/** Number of bytes between each light sphere. */
+		size_t m_stride = 0;
+
+		/** Clusters each light touches. */
+		std::vector<ClusterBounds> m_bounds = {};
+
+		/** First depth slice of each job. The last entry is the number of slices. */
+		std::vector<uint32_t> m_job_slices = {};
+
+		/** Light indices written by each job. */
+		std::vector<std::vector<uint32_t>> m_job_indices = {};
+
+		/** Clusters. */
+		std::vector<Cluster> m_clusters = {};
+
+		/** Light indices. */
+		std::vector<uint32_t> m_light_indices = {};
+	};
+}
@@ -0,0 +1,207 @@
+/**
+ * @file compression.cpp
+ * @brief Lossless LZ77 compression source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cstring>
+#include "compression.hpp"
+
+namespace dk
+{
+	/** Shortest copy worth encoding. */
+	static const size_t MIN_MATCH = 4;
+
+	/** Furthest back a copy can start. */
+	static const size_t MAX_OFFSET = 65535;
+
+	/** Number of bits used to hash the next four bytes when looking for copies. */
+	static const uint32_t HASH_BITS = 14;
+
+	/** Bytes at the end of the data that are always literals, so matching never reads past it. */
+	static const size_t END_LITERALS = 5;
+
+	/**
+	 * Read four bytes.
+	 * @param Data.
+	 * @return Bytes.
+	 */
+	static uint32_t read32(const char* data)
+	{
+		uint32_t value = 0;
+		std::memcpy(&value, data, sizeof(uint32_t));
+		return value;
+	}
+
+	/**
+	 * Hash four bytes.
+	 * @param Bytes.
+	 * @return Hash with HASH_BITS bits.
+	 */
+	static uint32_t hash32(uint32_t value)
+	{
+		return (value * 2654435761U) >> (32 - HASH_BITS);
+	}
+
+	/**
+	 * Write the part of a length that doesn't fit in its token.
+	 * @param Output.
+	 * @param Length minus the 15 the token holds.
+	 */
+	static void write_length(std::vector<char>& out, size_t len)
+	{
+		for (; len >= 255; len -= 255)
+			out.push_back(static_cast<char>(255));
+
+		out.push_back(static_cast<char>(len));
+	}
+
+	/**
+	 * Write a sequence of literals followed by a copy.
+	 * @param Output.
+	 * @param First literal.
+	 * @param Number of literals.
+	 * @param Distance back to copy from. Ignored if there's no copy.
+	 * @param Length of the copy. Zero for the final sequence, which has no copy.
+	 */
+	static void write_sequence(std::vector<char>& out, const char* literals, size_t literal_len, size_t offset, size_t match_len)
+	{
+		const size_t match_code = match_len > 0 ? match_len - MIN_MATCH : 0;
+		const uint8_t token = static_cast<uint8_t>((literal_len < 15 ? literal_len : 15) << 4) | static_cast<uint8_t>(match_code < 15 ? match_code : 15);
+		out.push_back(static_cast<char>(token));
+
+		if (literal_len >= 15)
+			write_length(out, literal_len - 15);
+
+		out.insert(out.end(), literals, literals + literal_len);
+
+		if (match_len == 0)
+			return;
+
+		out.push_back(static_cast<char>(offset & 0xFF));
+		out.push_back(static_cast<char>(offset >> 8));
+
+		if (match_code >= 15)
+			write_length(out, match_code - 15);
+	}
+
+	/**
+	 * Read the part of a length that didn't fit in its token.
+	 * @param Read position. Advanced past the length.
+	 * @param End of the input.
+	 * @param Length to add to.
+	 * @return If the length was inside the input.
+	 */
+	static bool read_length(const uint8_t*& in, const uint8_t* end, size_t& len)
+	{
+		uint8_t byte = 255;
+		while (byte == 255)
+		{
+			if (in == end)
+				return false;
+
+			byte = *in++;
+			len += byte;
+		}
+
+		return true;
+	}
+
+	void compress(const char* data, size_t len, std::vector<char>& compressed)
+	{
+		compressed.clear();
+		compressed.reserve(len + (len / 255) + 16);
+
+		// Last position each hash was seen at, plus one so zero means never
+		std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_BITS, 0);
+
+		size_t anchor = 0;
+		size_t pos = 0;
+
+		// Copies must stop before the final literals
+		const size_t match_limit = len > END_LITERALS ? len - END_LITERALS : 0;
+
+		while (pos + MIN_MATCH <= match_limit)
+		{
+			const uint32_t bytes = read32(data + pos);
+			const uint32_t hash = hash32(bytes);
+			const size_t candidate = table[hash];
+			table[hash] = static_cast<uint32_t>(pos + 1);
+
+			if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET || read32(data + candidate - 1) != bytes)
+			{
+				++pos;
+				continue;
+			}
+
+			// Extend the copy as far as it goes
+			const size_t match = candidate - 1;
+			size_t match_len = MIN_MATCH;
+			while (pos + match_len < match_limit && data[match + match_len] == data[pos + match_len])
+				++match_len;
+
+			write_sequence(compressed, data + anchor, pos - anchor, pos - match, match_len);
+
+			pos += match_len;
+			anchor = pos;
+		}
+
+		write_sequence(compressed, data + anchor, len - anchor, 0, 0);
+	}
+
+	bool decompress(const char* compressed, size_t compressed_len, char* data, size_t len)
+	{
+		const uint8_t* in = reinterpret_cast<const uint8_t*>(compressed);
+		const uint8_t* in_end = in + compressed_len;
+		size_t out = 0;
+
+		while (in < in_end)
+		{
+			const uint8_t token = *in++;
+
+			// Literals
+			size_t literal_len = token >> 4;
+			if (literal_len == 15 && !read_length(in, in_end, literal_len))
+				return false;
+
+			if (literal_len > static_cast<size_t>(in_end - in) || literal_len > len - out)
+				return false;
+
+			if (literal_len > 0)
+				std::memcpy(data + out, in, literal_len);
+
+			in += literal_len;
+			out += literal_len;
+
+			// The final sequence has no copy
+			if (in == in_end)
+				break;
+
+			// Copy
+			if (in_end - in < 2)
+				return false;
+
+			const size_t offset = static_cast<size_t>(in[0]) | (static_cast<size_t>(in[1]) << 8);
+			in += 2;
+
+			size_t match_len = token & 0x0F;
+			if (match_len == 15 && !read_length(in, in_end, match_len))
+				return false;
+
+			match_len += MIN_MATCH;
+
+			if (offset == 0 || offset > out || match_len > len - out)
+				return false;
+
+			// Copies may overlap themselves, so go a byte at a time
+			const size_t match = out - offset;
+			for (size_t i = 0; i < match_len; ++i)
+				data[out + i] = data[match + i];
+
+			out += match_len;
+		}
+
+		return out == len;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+/**
+ * @file compression.hpp
+ * @brief Lossless LZ77 compression header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dk
+{
+	/**
+	 * Compress data.
+	 * @param Data.
+	 * @param Data length.
+	 * @param Vector to fill with the compressed data.
+	 * @note The data is split into runs of literals followed by copies of earlier data,
+	 *       in the style of LZ4 blocks. It favours fast decompression over a small output.
+	 *       Incompressible data grows by at most about 0.4%.
+	 */
+	extern void compress(const char* data, size_t len, std::vector<char>& compressed);
+
+	/**
+	 * Decompress data.
+	 * @param Compressed data.
+	 * @param Compressed data length.
+	 * @param Buffer to decompress into.
+	 * @param Length of the data before it was compressed. The buffer must be this long.
+	 * @return If the data decompressed to exactly the given length. False for damaged data.
+	 */
+	extern bool decompress(const char* compressed, size_t compressed_len, char* data, size_t len);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file culling.cpp
+ * @brief Visibility culling utilities source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cmath>
+#include "debugging.hpp"
+#include "simd.hpp"
+#include "culling.hpp"
+
+namespace dk
+{
+	void AABBList::push_back(const AABB& aabb)
+	{
+		center_x.push_back(aabb.center.x);
+		center_y.push_back(aabb.center.y);
+		center_z.push_back(aabb.center.z);
+		extent_x.push_back(aabb.extent.x);
+		extent_y.push_back(aabb.extent.y);
+		extent_z.push_back(aabb.extent.z);
+	}
+
+	void AABBList::clear()
+	{
+		center_x.clear();
+		center_y.clear();
+		center_z.clear();
+		extent_x.clear();
+		extent_y.clear();
+		extent_z.clear();
+	}
+
+	AABB AABBList::get(size_t i) const
+	{
+		dk_assert(i < size());
+
+		AABB aabb = {};
+		aabb.center = glm::vec3(center_x[i], center_y[i], center_z[i]);
+		aabb.extent = glm::vec3(extent_x[i], extent_y[i], extent_z[i]);
+		return aabb;
+	}
+
+	void cull_aabbs(const Frustum& frustum, const AABBList& bounds, size_t begin, size_t end, std::vector<uint32_t>& visible)
+	{
+		dk_assert(begin <= end && end <= bounds.size());
+
+		size_t i = begin;
+
+#if DK_SIMD_SSE
+		// Splat plane equations
+		__m128 plane_x[6], plane_y[6], plane_z[6];
+		__m128 abs_x[6], abs_y[6], abs_z[6];
+		__m128 neg_w[6];
+
+		for (size_t p = 0; p < 6; ++p)
+		{
+			plane_x[p] = _mm_set1_ps(frustum.planes[p].x);
+			plane_y[p] = _mm_set1_ps(frustum.planes[p].y);
+			plane_z[p] = _mm_set1_ps(frustum.planes[p].z);
+			abs_x[p] = _mm_set1_ps(std::abs(frustum.planes[p].x));
+			abs_y[p] = _mm_set1_ps(std::abs(frustum.planes[p].y));
+			abs_z[p] = _mm_set1_ps(std::abs(frustum.planes[p].z));
+			neg_w[p] = _mm_set1_ps(-frustum.planes[p].w);
+		}
+
+		// Test 4 boxes at a time
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 cx = _mm_loadu_ps(&bounds.center_x[i]);
+			const __m128 cy = _mm_loadu_ps(&bounds.center_y[i]);
+			const __m128 cz = _mm_loadu_ps(&bounds.center_z[i]);
+			const __m128 ex = _mm_loadu_ps(&bounds.extent_x[i]);
+			const __m128 ey = _mm_loadu_ps(&bounds.extent_y[i]);
+			const __m128 ez = _mm_loadu_ps(&bounds.extent_z[i]);
+
+			__m128 outside = _mm_setzero_ps();
+
+			for (size_t p = 0; p < 6; ++p)
+			{
+				// Signed distance of the center and projected radius of the box
+				const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, plane_x[p]), _mm_mul_ps(cy, plane_y[p])), _mm_mul_ps(cz, plane_z[p]));
+				const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, abs_x[p]), _mm_mul_ps(ey, abs_y[p])), _mm_mul_ps(ez, abs_z[p]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), neg_w[p]));
+			}
+
+			const int mask = ~_mm_movemask_ps(outside) & 0xF;
+
+			for (uint32_t j = 0; j < 4; ++j)
+				if (mask & (1 << j))
+					visible.push_back(static_cast<uint32_t>(i + j));
+		}
+#endif
+
+		// Remaining boxes
+		for (; i < end; ++i)
+		{
+			bool inside = true;
+
+			for (size_t p = 0; p < 6; ++p)
+			{
+				const glm::vec4& plane = frustum.planes[p];
+				const float d = bounds.center_x[i] * plane.x + bounds.center_y[i] * plane.y + bounds.center_z[i] * plane.z;
+				const float r = bounds.extent_x[i] * std::abs(plane.x) + bounds.extent_y[i] * std::abs(plane.y) + bounds.extent_z[i] * std::abs(plane.z);
+
+				if (d + r < -plane.w)
+				{
+					inside = false;
+					break;
+				}
+			}
+
+			if (inside)
+				visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * @file culling.hpp
+ * @brief Visibility culling utilities header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stdint.h>
+#include "frustum.hpp"
+
+namespace dk
+{
+	/**
+	 * A list of AABB bounding boxes stored as a structure of arrays
+	 * so they can be tested several at a time.
+	 */
+	struct AABBList
+	{
+		/** Center X components. */
+		std::vector<float> center_x = {};
+
+		/** Center Y components. */
+		std::vector<float> center_y = {};
+
+		/** Center Z components. */
+		std::vector<float> center_z = {};
+
+		/** Extent X components. */
+		std::vector<float> extent_x = {};
+
+		/** Extent Y components. */
+		std::vector<float> extent_y = {};
+
+		/** Extent Z components. */
+		std::vector<float> extent_z = {};
+
+		/**
+		 * Get the number of bounding boxes.
+		 * @return Number of bounding boxes.
+		 */
+		size_t size() const
+		{
+			return center_x.size();
+		}
+
+		/**
+		 * Add a bounding box to the end of the list.
+		 * @param AABB bounding box.
+		 */
+		void push_back(const AABB& aabb);
+
+		/**
+		 * Remove every bounding box.
+		 */
+		void clear();
+
+		/**
+		 * Get a bounding box.
+		 * @param Index.
+		 * @return AABB bounding box.
+		 */
+		AABB get(size_t i) const;
+	};
+
+	/**
+	 * Test a range of bounding boxes against a frustum.
+	 * @param Frustum.
+	 * @param Bounding boxes.
+	 * @param Index of the first bounding box to test.
+	 * @param One past the index of the last bounding box to test.
+	 * @param List the indices of visible bounding boxes are appended to.
+	 * @note Boxes are tested 4 at a time when SSE is available.
+	 */
+	extern void cull_aabbs(const Frustum& frustum, const AABBList& bounds, size_t begin, size_t end, std::vector<uint32_t>& visible);
+}
@@ -9,6 +9,17 @@
 #include "file_io.hpp"
 #include "debugging.hpp"
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 namespace dk
 {
 	std::vector<char> read_binary_file(const std::string& path)
@@ -26,4 +37,139 @@ namespace dk
 
 		return data;
 	}
-}
\ No newline at end of file
+
+	bool try_read_binary_file(const std::string& path, std::vector<char>& data)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		const size_t file_size = static_cast<size_t>(file.tellg());
+		data.resize(file_size);
+
+		file.seekg(0);
+		file.read(data.data(), file_size);
+
+		return static_cast<bool>(file);
+	}
+
+	bool write_binary_file(const std::string& path, const char* data, size_t len)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write(data, len);
+		return static_cast<bool>(file);
+	}
+
+	uint64_t hash_binary(const char* data, size_t len, uint64_t hash)
+	{
+		for (size_t i = 0; i < len; ++i)
+		{
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
+
+
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#if defined(_WIN32)
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size = {};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		m_file = file;
+		m_mapping = mapping;
+		m_data = static_cast<const char*>(data);
+		m_size = static_cast<size_t>(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+			UnmapViewOfFile(m_data);
+
+		if (m_mapping)
+			CloseHandle(m_mapping);
+
+		if (m_file)
+			CloseHandle(m_file);
+
+		m_data = nullptr;
+		m_size = 0;
+		m_mapping = nullptr;
+		m_file = nullptr;
+	}
+#else
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+
+		const int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat status = {};
+		if (fstat(file, &status) != 0 || status.st_size == 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		// The mapping keeps the file alive on its own
+		void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+
+		if (data == MAP_FAILED)
+			return false;
+
+		m_data = static_cast<const char*>(data);
+		m_size = static_cast<size_t>(status.st_size);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+			munmap(const_cast<char*>(m_data), m_size);
+
+		m_data = nullptr;
+		m_size = 0;
+	}
+#endif
+}
@@ -9,6 +9,7 @@
 /** Includes. */
 #include <string>
 #include <vector>
+#include <stdint.h>
 
 namespace dk
 {
@@ -18,4 +19,115 @@ namespace dk
 	 * @return Binary data contained in the file.
 	 */
 	std::vector<char> read_binary_file(const std::string& path);
+
+	/**
+	 * Read a binary file if it exists.
+	 * @param Path to the file.
+	 * @param Vector to fill with the data contained in the file.
+	 * @return If the file could be read.
+	 */
+	bool try_read_binary_file(const std::string& path, std::vector<char>& data);
+
+	/**
+	 * Write a binary file, replacing it if it exists.
+	 * @param Path to the file.
+	 * @param Binary data.
+	 * @param Binary data length.
+	 * @return If the file could be written.
+	 */
+	bool write_binary_file(const std::string& path, const char* data, size_t len);
+
+	/**
+	 * Hash binary data with 64 bit FNV-1a.
+	 * @param Binary data.
+	 * @param Binary data length.
+	 * @param Hash to continue from.
+	 * @return Hash.
+	 */
+	uint64_t hash_binary(const char* data, size_t len, uint64_t hash = 14695981039346656037ULL);
+
+
+
+	/**
+	 * View of file data owned by something else.
+	 */
+	struct FileSpan
+	{
+		/** First byte. */
+		const char* data = nullptr;
+
+		/** Length in bytes. */
+		size_t size = 0;
+	};
+
+
+
+	/**
+	 * Read only memory mapping of a file.
+	 * @note Pages are read from disk the first time they are touched.
+	 */
+	class MappedFile
+	{
+	public:
+
+		/**
+		 * Default constructor.
+		 */
+		MappedFile() = default;
+
+		/**
+		 * Destructor.
+		 */
+		~MappedFile();
+
+		/** Mappings can't be copied. */
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+		 * Map a file, unmapping the previous one.
+		 * @param Path to the file.
+		 * @return If the file could be mapped. Empty files can't be.
+		 */
+		bool open(const std::string& path);
+
+		/**
+		 * Unmap the file.
+		 */
+		void close();
+
+		/**
+		 * Get the mapped data.
+		 * @return Mapped data. Null if no file is mapped.
+		 */
+		const char* get_data() const
+		{
+			return m_data;
+		}
+
+		/**
+		 * Get the size of the mapped file.
+		 * @return Size of the mapped file in bytes.
+		 */
+		size_t get_size() const
+		{
+			return m_size;
+		}
+
+	private:
+
+		/** Mapped data. */
+		const char* m_data = nullptr;
+
+		/** Size of the mapped file in bytes. */
+		size_t m_size = 0;
+
+#if defined(_WIN32)
+		/** File handle. */
+		void* m_file = nullptr;
+
+		/** File mapping handle. */
+		void* m_mapping = nullptr;
+#endif
+	};
 }
\ No newline at end of file
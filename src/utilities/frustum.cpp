@@ -6,22 +6,50 @@
 
 /** Includes. */
 #include "debugging.hpp"
+#include "simd.hpp"
 #include "frustum.hpp"
 
 namespace dk
 {
 	AABB& AABB::transform(glm::mat4 model)
 	{
-		const glm::vec3 scale =
-		{
-			glm::length(glm::vec3(model[0][0], model[1][0], model[2][0])),
-			glm::length(glm::vec3(model[0][1], model[1][1], model[2][1])),
-			glm::length(glm::vec3(model[0][2], model[1][2], model[2][2]))
-		};
+		// Arvo's method. The new center is the transformed center and each new
+		// extent is the old extents projected onto the absolute matrix rows.
+#if DK_SIMD_SSE
+		const __m128 sign_mask = _mm_set1_ps(-0.0f);
+		const __m128 col0 = _mm_loadu_ps(&model[0][0]);
+		const __m128 col1 = _mm_loadu_ps(&model[1][0]);
+		const __m128 col2 = _mm_loadu_ps(&model[2][0]);
+		const __m128 col3 = _mm_loadu_ps(&model[3][0]);
+
+		const __m128 new_center = _mm_add_ps
+		(
+			_mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(center.x)), _mm_mul_ps(col1, _mm_set1_ps(center.y))),
+			_mm_add_ps(_mm_mul_ps(col2, _mm_set1_ps(center.z)), col3)
+		);
+
+		const __m128 new_extent = _mm_add_ps
+		(
+			_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, col0), _mm_set1_ps(extent.x)), _mm_mul_ps(_mm_andnot_ps(sign_mask, col1), _mm_set1_ps(extent.y))),
+			_mm_mul_ps(_mm_andnot_ps(sign_mask, col2), _mm_set1_ps(extent.z))
+		);
+
+		float c[4], e[4];
+		_mm_storeu_ps(c, new_center);
+		_mm_storeu_ps(e, new_extent);
 
-		center = glm::vec3(model * glm::vec4(center, 1.0f));
-		extent *= scale;
+		center = glm::vec3(c[0], c[1], c[2]);
+		extent = glm::vec3(e[0], e[1], e[2]);
+#else
+		const glm::vec3 new_center = glm::vec3(model * glm::vec4(center, 1.0f));
+		const glm::vec3 new_extent = 
+			glm::abs(glm::vec3(model[0])) * extent.x + 
+			glm::abs(glm::vec3(model[1])) * extent.y + 
+			glm::abs(glm::vec3(model[2])) * extent.z;
 
+		center = new_center;
+		extent = new_extent;
+#endif
 		return *this;
 	}
 
@@ -70,6 +98,6 @@ namespace dk
 		const float dist01 = glm::min(distance(0, c), distance(1, c));
 		const float dist23 = glm::min(distance(2, c), distance(3, c));
 		const float dist45 = glm::min(distance(4, c), distance(5, c));
-		return glm::min(glm::min(dist01, dist23), dist45) + r;
+		return glm::min(glm::min(dist01, dist23), dist45) + r >= 0.0f;
 	}
 }
\ No newline at end of file
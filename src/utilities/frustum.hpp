@@ -27,6 +27,7 @@ namespace dk
 		 * @brief Transform the AABB by a model matrix.
 		 * @param Model matrix.
 		 * @return This.
+		 * @note The result tightly encloses the rotated box.
 		 */
 		AABB& transform(glm::mat4 model);
 	};
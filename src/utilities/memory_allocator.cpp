@@ -0,0 +1,422 @@
+/**
+ * @file memory_allocator.cpp
+ * @brief Block based memory sub-allocator source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include "memory_allocator.hpp"
+
+namespace dk
+{
+	/**
+	 * @brief Round a value up to the next power of two.
+	 * @param Value.
+	 * @return Power of two.
+	 */
+	static uint64_t next_power_of_two(uint64_t v)
+	{
+		uint64_t p = 1;
+		while (p < v)
+			p <<= 1;
+		return p;
+	}
+
+	/**
+	 * @brief Round a value up to a multiple of an alignment.
+	 * @param Value.
+	 * @param Alignment. Must be a power of two.
+	 * @return Aligned value.
+	 */
+	static uint64_t align_up(uint64_t v, uint64_t alignment)
+	{
+		return (v + alignment - 1) & ~(alignment - 1);
+	}
+
+
+
+	const uint64_t MemoryAllocator::min_buddy_size;
+	const uint64_t MemoryAllocator::default_block_size;
+
+	MemoryAllocator::MemoryAllocator(MemoryBackend* backend, uint64_t block_size) :
+		m_backend(backend),
+		m_block_size(next_power_of_two(std::max(block_size, min_buddy_size)))
+	{
+		dk_assert(m_backend);
+		m_max_order = get_order(m_block_size);
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+		for (size_t i = 0; i < m_blocks.size(); ++i)
+			if (m_blocks[i])
+				destroy_block(i);
+	}
+
+	bool MemoryAllocator::allocate(const MemoryRequest& request, MemoryAllocation& allocation)
+	{
+		dk_assert(request.size > 0);
+		dk_assert((request.alignment & (request.alignment - 1)) == 0);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		allocation = {};
+
+		// Large allocations get their own block
+		if (std::max(request.size, request.alignment) > m_block_size / 2)
+		{
+			const int64_t block = create_block(request.memory_type, get_pool(request), request.size, true);
+			if (block < 0)
+				return false;
+
+			m_blocks[block]->allocation_count = 1;
+			m_blocks[block]->used = request.size;
+			create_record(static_cast<size_t>(block), request, 0, request.size, allocation);
+			return true;
+		}
+
+		// Look for room in an existing block
+		const uint32_t pool = get_pool(request);
+		uint64_t offset = 0;
+		uint64_t reserved = 0;
+
+		for (size_t i = 0; i < m_blocks.size(); ++i)
+			if (m_blocks[i] && !m_blocks[i]->dedicated && m_blocks[i]->pool == pool && allocate_from_block(i, request, offset, reserved))
+			{
+				create_record(i, request, offset, reserved, allocation);
+				return true;
+			}
+
+		// Every block is full so make a new one
+		const int64_t block = create_block(request.memory_type, pool, m_block_size, false);
+		if (block < 0 || !allocate_from_block(static_cast<size_t>(block), request, offset, reserved))
+			return false;
+
+		create_record(static_cast<size_t>(block), request, offset, reserved, allocation);
+		return true;
+	}
+
+	void MemoryAllocator::free(const MemoryAllocation& allocation)
+	{
+		if (allocation.id == 0)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		free_record(allocation.id);
+	}
+
+	size_t MemoryAllocator::defragment(const DefragmentationCallback& move, size_t max_moves)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t moves = 0;
+
+		// Shared buddy blocks from least to most used
+		std::vector<size_t> blocks = {};
+		for (size_t i = 0; i < m_blocks.size(); ++i)
+			if (m_blocks[i] && !m_blocks[i]->dedicated && m_blocks[i]->free_lists.size() > 0 && m_blocks[i]->allocation_count > 0)
+				blocks.push_back(i);
+
+		std::sort(blocks.begin(), blocks.end(), [this](size_t a, size_t b)
+		{
+			return m_blocks[a]->used < m_blocks[b]->used;
+		});
+
+		// Empty the sparse blocks into the dense ones
+		for (size_t src = 0; src < blocks.size() && moves < max_moves; ++src)
+		{
+			const size_t source = blocks[src];
+
+			// Stop once the block has been emptied and given back
+			for (uint32_t id = 1; id <= m_records.size() && moves < max_moves && m_blocks[source]; ++id)
+			{
+				Record& record = m_records[id - 1];
+				if (!record.live || record.block != source)
+					continue;
+
+				// Find room in a denser block of the same pool
+				for (size_t dst = src + 1; dst < blocks.size(); ++dst)
+				{
+					const size_t destination = blocks[dst];
+					if (!m_blocks[destination] || m_blocks[destination]->pool != m_blocks[source]->pool)
+						continue;
+
+					uint64_t offset = 0;
+					uint64_t reserved = 0;
+					if (!allocate_from_block(destination, record.request, offset, reserved))
+						continue;
+
+					// Current allocation
+					MemoryAllocation from = {};
+					from.block = m_blocks[source]->handle;
+					from.offset = record.offset;
+					from.size = record.request.size;
+					from.mapped = m_blocks[source]->mapped ? m_blocks[source]->mapped + record.offset : nullptr;
+					from.memory_type = record.request.memory_type;
+					from.id = id;
+
+					// Let the owner move its data
+					const MemoryRequest request = record.request;
+					MemoryAllocation to = {};
+					create_record(destination, request, offset, reserved, to);
+
+					if (move(from, to, request.user_data))
+					{
+						free_record(from.id);
+						++moves;
+					}
+					else
+						free_record(to.id);
+
+					break;
+				}
+			}
+		}
+
+		// Give back blocks that were emptied
+		for (size_t i = 0; i < m_blocks.size(); ++i)
+			if (m_blocks[i] && m_blocks[i]->allocation_count == 0)
+				destroy_block(i);
+
+		return moves;
+	}
+
+	void MemoryAllocator::trim()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (size_t i = 0; i < m_blocks.size(); ++i)
+			if (m_blocks[i] && m_blocks[i]->allocation_count == 0)
+				destroy_block(i);
+	}
+
+	MemoryStatistics MemoryAllocator::get_statistics() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		MemoryStatistics stats = {};
+
+		for (const auto& block : m_blocks)
+			if (block)
+			{
+				++stats.block_count;
+				stats.allocation_count += block->allocation_count;
+				stats.dedicated_count += block->dedicated ? 1 : 0;
+				stats.reserved_bytes += block->size;
+				stats.used_bytes += block->used;
+			}
+
+		return stats;
+	}
+
+	MemoryStatistics MemoryAllocator::get_statistics(uint32_t memory_type) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		MemoryStatistics stats = {};
+
+		for (const auto& block : m_blocks)
+			if (block && block->memory_type == memory_type)
+			{
+				++stats.block_count;
+				stats.allocation_count += block->allocation_count;
+				stats.dedicated_count += block->dedicated ? 1 : 0;
+				stats.reserved_bytes += block->size;
+				stats.used_bytes += block->used;
+			}
+
+		return stats;
+	}
+
+	uint32_t MemoryAllocator::get_pool(const MemoryRequest& request)
+	{
+		return (request.memory_type << 2) | (request.linear_resource ? 2 : 0) | static_cast<uint32_t>(request.strategy);
+	}
+
+	uint32_t MemoryAllocator::get_order(uint64_t size)
+	{
+		uint32_t order = 0;
+		while ((min_buddy_size << order) < size)
+			++order;
+		return order;
+	}
+
+	int64_t MemoryAllocator::create_block(uint32_t memory_type, uint32_t pool, uint64_t size, bool dedicated)
+	{
+		void* mapped = nullptr;
+		const uint64_t handle = m_backend->allocate_block(memory_type, size, &mapped);
+		if (handle == 0)
+			return -1;
+
+		auto block = std::make_unique<Block>();
+		block->handle = handle;
+		block->size = size;
+		block->mapped = static_cast<char*>(mapped);
+		block->memory_type = memory_type;
+		block->pool = pool;
+		block->dedicated = dedicated;
+
+		// The whole block starts out as one free buddy region
+		if (!dedicated && static_cast<AllocationStrategy>(pool & 1) == AllocationStrategy::Buddy)
+		{
+			block->free_lists.resize(m_max_order + 1);
+			block->free_lists[m_max_order].insert(0);
+		}
+
+		// Reuse a destroyed block's slot
+		for (size_t i = 0; i < m_blocks.size(); ++i)
+			if (!m_blocks[i])
+			{
+				m_blocks[i] = std::move(block);
+				return static_cast<int64_t>(i);
+			}
+
+		m_blocks.push_back(std::move(block));
+		return static_cast<int64_t>(m_blocks.size() - 1);
+	}
+
+	void MemoryAllocator::destroy_block(size_t block)
+	{
+		m_backend->free_block(m_blocks[block]->memory_type, m_blocks[block]->handle);
+		m_blocks[block].reset();
+	}
+
+	bool MemoryAllocator::allocate_from_block(size_t block_index, const MemoryRequest& request, uint64_t& offset, uint64_t& reserved)
+	{
+		Block& block = *m_blocks[block_index];
+
+		// Linear blocks bump the head forward
+		if (block.free_lists.size() == 0)
+		{
+			const uint64_t start = align_up(block.head, request.alignment);
+			if (start + request.size > block.size)
+				return false;
+
+			offset = start;
+			reserved = (start + request.size) - block.head;
+			block.head = start + request.size;
+			++block.allocation_count;
+			block.used += reserved;
+			return true;
+		}
+
+		// Buddy regions are aligned to their size, so alignment only affects the size class
+		const uint64_t size = next_power_of_two(std::max(std::max(request.size, request.alignment), min_buddy_size));
+		const uint32_t order = get_order(size);
+
+		// Smallest free region that fits
+		uint32_t found = order;
+		while (found <= m_max_order && block.free_lists[found].empty())
+			++found;
+
+		if (found > m_max_order)
+			return false;
+
+		offset = *block.free_lists[found].begin();
+		block.free_lists[found].erase(block.free_lists[found].begin());
+
+		// Split it down to the size needed and keep the upper halves
+		while (found > order)
+		{
+			--found;
+			block.free_lists[found].insert(offset + (min_buddy_size << found));
+		}
+
+		reserved = size;
+		++block.allocation_count;
+		block.used += reserved;
+		return true;
+	}
+
+	void MemoryAllocator::free_from_block(size_t block_index, uint64_t offset, uint64_t reserved)
+	{
+		Block& block = *m_blocks[block_index];
+		dk_assert(block.allocation_count > 0);
+
+		--block.allocation_count;
+		block.used -= reserved;
+
+		// Linear blocks can only be reused once everything in them is gone
+		if (block.free_lists.size() == 0)
+		{
+			if (block.allocation_count == 0)
+				block.head = 0;
+			return;
+		}
+
+		// Merge with free buddies
+		uint32_t order = get_order(reserved);
+		while (order < m_max_order)
+		{
+			const uint64_t buddy = offset ^ (min_buddy_size << order);
+			auto it = block.free_lists[order].find(buddy);
+			if (it == block.free_lists[order].end())
+				break;
+
+			block.free_lists[order].erase(it);
+			offset = std::min(offset, buddy);
+			++order;
+		}
+
+		block.free_lists[order].insert(offset);
+	}
+
+	void MemoryAllocator::create_record(size_t block, const MemoryRequest& request, uint64_t offset, uint64_t reserved, MemoryAllocation& allocation)
+	{
+		uint32_t id = 0;
+		if (m_free_records.size() > 0)
+		{
+			id = m_free_records.back();
+			m_free_records.pop_back();
+		}
+		else
+		{
+			m_records.push_back({});
+			id = static_cast<uint32_t>(m_records.size());
+		}
+
+		Record& record = m_records[id - 1];
+		record.block = block;
+		record.offset = offset;
+		record.reserved = reserved;
+		record.request = request;
+		record.live = true;
+
+		allocation.block = m_blocks[block]->handle;
+		allocation.offset = offset;
+		allocation.size = request.size;
+		allocation.mapped = m_blocks[block]->mapped ? m_blocks[block]->mapped + offset : nullptr;
+		allocation.memory_type = request.memory_type;
+		allocation.id = id;
+	}
+
+	void MemoryAllocator::free_record(uint32_t id)
+	{
+		dk_assert(id > 0 && id <= m_records.size());
+		Record& record = m_records[id - 1];
+		dk_assert(record.live);
+
+		const size_t block = record.block;
+		record.live = false;
+		m_free_records.push_back(id);
+
+		// Dedicated blocks go straight back to the backend
+		if (m_blocks[block]->dedicated)
+		{
+			destroy_block(block);
+			return;
+		}
+
+		free_from_block(block, record.offset, record.reserved);
+
+		// Keep at most one empty block per pool around for reuse
+		if (m_blocks[block]->allocation_count == 0 && has_other_empty_block(m_blocks[block]->pool, block))
+			destroy_block(block);
+	}
+
+	bool MemoryAllocator::has_other_empty_block(uint32_t pool, size_t block) const
+	{
+		for (size_t i = 0; i < m_blocks.size(); ++i)
+			if (i != block && m_blocks[i] && !m_blocks[i]->dedicated && m_blocks[i]->pool == pool && m_blocks[i]->allocation_count == 0)
+				return true;
+
+		return false;
+	}
+}
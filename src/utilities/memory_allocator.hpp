@@ -0,0 +1,379 @@
+#pragma once
+
+/**
+ * @file memory_allocator.hpp
+ * @brief Block based memory sub-allocator header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <stdint.h>
+#include "debugging.hpp"
+
+namespace dk
+{
+	/**
+	 * @brief How memory is carved out of a block.
+	 */
+	enum class AllocationStrategy
+	{
+		Buddy = 0,	// Power of two size classes. Good for long lived resources.
+		Linear = 1	// Bump allocation. Good for short lived resources freed together.
+	};
+
+	/**
+	 * @brief Provides the large blocks of memory allocations are carved out of.
+	 * @note Implemented on top of the graphics API, or faked for testing.
+	 */
+	class MemoryBackend
+	{
+	public:
+
+		/**
+		 * @brief Destructor.
+		 */
+		virtual ~MemoryBackend() = default;
+
+		/**
+		 * @brief Allocate a block of memory.
+		 * @param Memory type index.
+		 * @param Size in bytes.
+		 * @param Set to a pointer to the start of the block if the memory can be mapped.
+		 * @return Block handle. Zero if the allocation failed.
+		 */
+		virtual uint64_t allocate_block(uint32_t memory_type, uint64_t size, void** mapped) = 0;
+
+		/**
+		 * @brief Free a block of memory.
+		 * @param Memory type index.
+		 * @param Block handle.
+		 */
+		virtual void free_block(uint32_t memory_type, uint64_t block) = 0;
+	};
+
+	/**
+	 * @brief A region of a memory block.
+	 */
+	struct MemoryAllocation
+	{
+		/** Backend handle of the block the region is in. */
+		uint64_t block = 0;
+
+		/** Offset in bytes from the start of the block. */
+		uint64_t offset = 0;
+
+		/** Size in bytes. */
+		uint64_t size = 0;
+
+		/** Pointer to the start of the region, or null if the memory isn't mappable. */
+		void* mapped = nullptr;
+
+		/** Memory type index. */
+		uint32_t memory_type = 0;
+
+		/** Allocator record ID. Zero if the allocation is invalid. */
+		uint32_t id = 0;
+	};
+
+	/**
+	 * @brief Description of an allocation.
+	 */
+	struct MemoryRequest
+	{
+		/** Size in bytes. */
+		uint64_t size = 0;
+
+		/** Required alignment in bytes. Must be a power of two. */
+		uint64_t alignment = 1;
+
+		/** Memory type index. */
+		uint32_t memory_type = 0;
+
+		/**
+		 * Is the memory for a buffer or linearly tiled image? Linear and optimally
+		 * tiled resources are kept in separate blocks so they never share a page.
+		 */
+		bool linear_resource = true;
+
+		/** Allocation strategy. */
+		AllocationStrategy strategy = AllocationStrategy::Buddy;
+
+		/** Data passed back to defragmentation callbacks. */
+		void* user_data = nullptr;
+	};
+
+	/**
+	 * @brief Memory usage statistics.
+	 */
+	struct MemoryStatistics
+	{
+		/** Number of blocks allocated from the backend. */
+		size_t block_count = 0;
+
+		/** Number of live allocations. */
+		size_t allocation_count = 0;
+
+		/** Number of allocations given their own block. */
+		size_t dedicated_count = 0;
+
+		/** Bytes allocated from the backend. */
+		uint64_t reserved_bytes = 0;
+
+		/** Bytes handed out to allocations, including padding. */
+		uint64_t used_bytes = 0;
+	};
+
+	/**
+	 * @brief Called when defragmentation wants to move an allocation.
+	 * @param Current allocation.
+	 * @param New allocation.
+	 * @param User data of the allocation.
+	 * @return If the owner copied its data and now uses the new allocation.
+	 *         The old allocation is freed if true and the new one otherwise.
+	 * @note Called with the allocator locked. Don't allocate or free from inside the callback.
+	 */
+	using DefragmentationCallback = std::function<bool(const MemoryAllocation&, const MemoryAllocation&, void*)>;
+
+
+
+	/**
+	 * @brief Sub-allocates small regions out of large memory blocks.
+	 * @note Blocks are grouped into pools by memory type, resource kind, and strategy.
+	 *       Buddy blocks round allocations up to power of two size classes and merge
+	 *       neighbours when freed. Linear blocks bump a pointer and rewind when every
+	 *       allocation in them has been freed. Allocations larger than half a block get
+	 *       a dedicated block. Every method is thread safe.
+	 */
+	class MemoryAllocator
+	{
+	public:
+
+		/** Smallest region handed out by a buddy block. */
+		static const uint64_t min_buddy_size = 256;
+
+		/** Default size of a block. */
+		static const uint64_t default_block_size = 64 * 1024 * 1024;
+
+		/**
+		 * @brief Constructor.
+		 * @param Backend to allocate blocks from.
+		 * @param Size of a block in bytes. Rounded up to a power of two.
+		 */
+		MemoryAllocator(MemoryBackend* backend, uint64_t block_size = default_block_size);
+
+		/**
+		 * @brief Destructor.
+		 * @note Every block is returned to the backend.
+		 */
+		~MemoryAllocator();
+
+		/**
+		 * @brief Allocate memory.
+		 * @param Description of the allocation.
+		 * @param Allocation to fill in.
+		 * @return If the allocation succeeded.
+		 */
+		bool allocate(const MemoryRequest& request, MemoryAllocation& allocation);
+
+		/**
+		 * @brief Free memory.
+		 * @param Allocation to free. Invalid allocations are ignored.
+		 */
+		void free(const MemoryAllocation& allocation);
+
+		/**
+		 * @brief Move allocations out of sparsely used buddy blocks into fuller ones.
+		 * @param Called for every move.
+		 * @param Maximum number of moves.
+		 * @return Number of allocations moved.
+		 * @note Blocks left empty are returned to the backend.
+		 */
+		size_t defragment(const DefragmentationCallback& move, size_t max_moves = SIZE_MAX);
+
+		/**
+		 * @brief Return every empty block to the backend.
+		 */
+		void trim();
+
+		/**
+		 * @brief Get usage statistics for every memory type.
+		 * @return Statistics.
+		 */
+		MemoryStatistics get_statistics() const;
+
+		/**
+		 * @brief Get usage statistics for a memory type.
+		 * @param Memory type index.
+		 * @return Statistics.
+		 */
+		MemoryStatistics get_statistics(uint32_t memory_type) const;
+
+		/**
+		 * @brief Get the size of a block.
+		 * @return Block size in bytes.
+		 */
+		uint64_t get_block_size() const
+		{
+			return m_block_size;
+		}
+
+	private:
+
+		/**
+		 * @brief A block of memory from the backend.
+		 */
+		struct Block
+		{
+			/** Backend handle. */
+			uint64_t handle = 0;
+
+			/** Size in bytes. */
+			uint64_t size = 0;
+
+			/** Mapping of the start of the block. */
+			char* mapped = nullptr;
+
+			/** Memory type index. */
+			uint32_t memory_type = 0;
+
+			/** Pool the block belongs to. */
+			uint32_t pool = 0;
+
+			/** Is the block owned by a single allocation? */
+			bool dedicated = false;
+
+			/** Number of live allocations. */
+			size_t allocation_count = 0;
+
+			/** Bytes handed out. */
+			uint64_t used = 0;
+
+			/** Free region offsets of each buddy order. */
+			std::vector<std::set<uint64_t>> free_lists = {};
+
+			/** Next free offset of a linear block. */
+			uint64_t head = 0;
+		};
+
+		/**
+		 * @brief Book keeping for a live allocation.
+		 */
+		struct Record
+		{
+			/** Index of the block. */
+			size_t block = 0;
+
+			/** Offset within the block. */
+			uint64_t offset = 0;
+
+			/** Bytes reserved in the block. */
+			uint64_t reserved = 0;
+
+			/** Original request. */
+			MemoryRequest request = {};
+
+			/** Is the record in use? */
+			bool live = false;
+		};
+
+		/**
+		 * @brief Get the pool of a request.
+		 * @param Request.
+		 * @return Pool ID.
+		 */
+		static uint32_t get_pool(const MemoryRequest& request);
+
+		/**
+		 * @brief Get the buddy order of a size.
+		 * @param Size in bytes. Must be a power of two of at least min_buddy_size.
+		 * @return Order.
+		 */
+		static uint32_t get_order(uint64_t size);
+
+		/**
+		 * @brief Create a block.
+		 * @param Memory type index.
+		 * @param Pool ID.
+		 * @param Size in bytes.
+		 * @param Is the block for a single allocation?
+		 * @return Block index. Negative if the backend is out of memory.
+		 */
+		int64_t create_block(uint32_t memory_type, uint32_t pool, uint64_t size, bool dedicated);
+
+		/**
+		 * @brief Return a block to the backend.
+		 * @param Block index.
+		 */
+		void destroy_block(size_t block);
+
+		/**
+		 * @brief Try to carve a region out of a block.
+		 * @param Block index.
+		 * @param Request.
+		 * @param Offset of the region.
+		 * @param Bytes reserved for the region.
+		 * @return If the block had room.
+		 */
+		bool allocate_from_block(size_t block, const MemoryRequest& request, uint64_t& offset, uint64_t& reserved);
+
+		/**
+		 * @brief Give a region back to its block.
+		 * @param Block index.
+		 * @param Offset of the region.
+		 * @param Bytes reserved for the region.
+		 */
+		void free_from_block(size_t block, uint64_t offset, uint64_t reserved);
+
+		/**
+		 * @brief Create a record for a region and fill in an allocation.
+		 * @param Block index.
+		 * @param Request.
+		 * @param Offset of the region.
+		 * @param Bytes reserved for the region.
+		 * @param Allocation to fill in.
+		 */
+		void create_record(size_t block, const MemoryRequest& request, uint64_t offset, uint64_t reserved, MemoryAllocation& allocation);
+
+		/**
+		 * @brief Free a record and its region.
+		 * @param Record ID.
+		 */
+		void free_record(uint32_t id);
+
+		/**
+		 * @brief Check if a pool has an empty block other than the given one.
+		 * @param Pool ID.
+		 * @param Block index to ignore.
+		 * @return If another empty block exists.
+		 */
+		bool has_other_empty_block(uint32_t pool, size_t block) const;
+
+
+
+		/** Backend. */
+		MemoryBackend* m_backend = nullptr;
+
+		/** Size of a shared block. */
+		uint64_t m_block_size = 0;
+
+		/** Highest buddy order. */
+		uint32_t m_max_order = 0;
+
+		/** Blocks. Destroyed blocks are null. */
+		std::vector<std::unique_ptr<Block>> m_blocks = {};
+
+		/** Allocation records. Record IDs are indices plus one. */
+		std::vector<Record> m_records = {};
+
+		/** Indices of unused records. */
+		std::vector<uint32_t> m_free_records = {};
+
+		/** Lock. */
+		mutable std::mutex m_mutex;
+	};
+}
@@ -0,0 +1,407 @@
+/**
+ * @file mesh_lod.cpp
+ * @brief Mesh simplification and level of detail selection source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cmath>
+#include <array>
+#include <limits>
+#include <algorithm>
+#include "debugging.hpp"
+#include "mesh_lod.hpp"
+
+namespace dk
+{
+	/** Sum of squared distances to a set of planes, stored as the upper triangle of a symmetric 4x4 matrix. */
+	using Quadric = std::array<double, 10>;
+
+	/**
+	 * A possible edge collapse.
+	 */
+	struct EdgeCollapse
+	{
+		/** Error the collapse adds. */
+		double cost = 0.0;
+
+		/** Vertex that is removed. */
+		uint32_t from = 0;
+
+		/** Vertex it is moved onto. */
+		uint32_t to = 0;
+	};
+
+	/**
+	 * Get a vertex position.
+	 * @param Pointer to the first vertex position.
+	 * @param Number of bytes between each vertex position.
+	 * @param Vertex index.
+	 * @return Position.
+	 */
+	static glm::vec3 get_position(const float* positions, size_t stride, size_t index)
+	{
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + (index * stride));
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+
+	/**
+	 * Add a plane to a quadric.
+	 * @param Quadric.
+	 * @param Plane normal.
+	 * @param Plane distance.
+	 */
+	static void add_plane(Quadric& q, const glm::vec3& n, float d)
+	{
+		const double a = n.x, b = n.y, c = n.z, w = d;
+		q[0] += a * a; q[1] += a * b; q[2] += a * c; q[3] += a * w;
+		q[4] += b * b; q[5] += b * c; q[6] += b * w;
+		q[7] += c * c; q[8] += c * w;
+		q[9] += w * w;
+	}
+
+	/**
+	 * Find the error of a point.
+	 * @param First quadric.
+	 * @param Second quadric.
+	 * @param Point.
+	 * @return Error of the point against the sum of both quadrics.
+	 */
+	static double evaluate(const Quadric& q0, const Quadric& q1, const glm::vec3& p)
+	{
+		Quadric q = {};
+		for (size_t i = 0; i < q.size(); ++i)
+			q[i] = q0[i] + q1[i];
+
+		const double x = p.x, y = p.y, z = p.z;
+		const double error =
+			(q[0] * x * x) + (2.0 * q[1] * x * y) + (2.0 * q[2] * x * z) + (2.0 * q[3] * x) +
+			(q[4] * y * y) + (2.0 * q[5] * y * z) + (2.0 * q[6] * y) +
+			(q[7] * z * z) + (2.0 * q[8] * z) +
+			q[9];
+
+		return std::max(error, 0.0);
+	}
+
+	std::vector<uint32_t> simplify_mesh
+	(
+		const std::vector<uint32_t>& indices,
+		const float* positions,
+		size_t stride,
+		size_t vertex_count,
+		size_t target_index_count,
+		float max_error
+	)
+	{
+		dk_assert(indices.size() % 3 == 0);
+		dk_assert(vertex_count == 0 || positions);
+
+		std::vector<uint32_t> result = indices;
+		if (result.size() <= target_index_count || vertex_count == 0)
+			return result;
+
+		// Weld vertices sharing a position so seams can be found
+		std::vector<uint32_t> order(vertex_count);
+		for (size_t i = 0; i < vertex_count; ++i)
+			order[i] = static_cast<uint32_t>(i);
+
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+		{
+			const glm::vec3 pa = get_position(positions, stride, a);
+			const glm::vec3 pb = get_position(positions, stride, b);
+
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		});
+
+		std::vector<uint32_t> position_ids(vertex_count);
+		std::vector<uint32_t> wedge_counts(vertex_count, 0);
+		glm::vec3 min_position = get_position(positions, stride, 0);
+		glm::vec3 max_position = min_position;
+
+		for (size_t i = 0; i < vertex_count; ++i)
+		{
+			const uint32_t v = order[i];
+			const glm::vec3 p = get_position(positions, stride, v);
+			const bool shared = i > 0 && get_position(positions, stride, order[i - 1]) == p;
+
+			position_ids[v] = shared ? position_ids[order[i - 1]] : v;
+			++wedge_counts[position_ids[v]];
+			min_position = glm::min(min_position, p);
+			max_position = glm::max(max_position, p);
+		}
+
+		// Seams can't move without tearing attributes apart
+		std::vector<uint8_t> locked(vertex_count, 0);
+		for (size_t i = 0; i < vertex_count; ++i)
+			if (wedge_counts[position_ids[i]] > 1)
+				locked[position_ids[i]] = 1;
+
+		// Open and non-manifold edges can't move without changing the outline
+		std::vector<uint64_t> edges = {};
+		edges.reserve(result.size());
+
+		for (size_t i = 0; i < result.size(); i += 3)
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const uint64_t a = position_ids[result[i + j]];
+				const uint64_t b = position_ids[result[i + ((j + 1) % 3)]];
+
+				if (a != b)
+					edges.push_back((std::min(a, b) << 32) | std::max(a, b));
+			}
+
+		std::sort(edges.begin(), edges.end());
+
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j] == edges[i])
+				++j;
+
+			if (j - i != 2)
+			{
+				locked[edges[i] >> 32] = 1;
+				locked[edges[i] & 0xFFFFFFFF] = 1;
+			}
+
+			i = j;
+		}
+
+		for (size_t i = 0; i < vertex_count; ++i)
+			locked[i] = locked[position_ids[i]];
+
+		// Every vertex measures its distance to the planes of the triangles around it
+		std::vector<Quadric> quadrics(vertex_count, Quadric());
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const glm::vec3 p0 = get_position(positions, stride, result[i]);
+			const glm::vec3 p1 = get_position(positions, stride, result[i + 1]);
+			const glm::vec3 p2 = get_position(positions, stride, result[i + 2]);
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(n);
+
+			if (length <= 0.0f)
+				continue;
+
+			const glm::vec3 normal = n / length;
+			const float d = -glm::dot(normal, p0);
+			add_plane(quadrics[position_ids[result[i]]], normal, d);
+			add_plane(quadrics[position_ids[result[i + 1]]], normal, d);
+			add_plane(quadrics[position_ids[result[i + 2]]], normal, d);
+		}
+
+		const double max_distance = static_cast<double>(max_error) * static_cast<double>(glm::length(max_position - min_position));
+		const double max_cost = max_distance * max_distance;
+
+		std::vector<uint32_t> remap(vertex_count);
+		for (size_t i = 0; i < vertex_count; ++i)
+			remap[i] = static_cast<uint32_t>(i);
+
+		std::vector<uint32_t> triangle_offsets(vertex_count + 1);
+		std::vector<uint32_t> triangle_cursors(vertex_count);
+		std::vector<uint32_t> vertex_triangles = {};
+		std::vector<uint8_t> touched(vertex_count);
+		std::vector<EdgeCollapse> collapses = {};
+		std::vector<uint32_t> neighbors = {};
+
+		// Each pass collapses as many independent edges as it can
+		while (result.size() > target_index_count)
+		{
+			// Find the triangles around each vertex
+			std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+			for (const uint32_t v : result)
+				++triangle_offsets[v + 1];
+
+			for (size_t i = 0; i < vertex_count; ++i)
+				triangle_offsets[i + 1] += triangle_offsets[i];
+
+			std::copy(triangle_offsets.begin(), triangle_offsets.end() - 1, triangle_cursors.begin());
+			vertex_triangles.resize(result.size());
+
+			for (size_t i = 0; i < result.size(); ++i)
+				vertex_triangles[triangle_cursors[result[i]]++] = static_cast<uint32_t>(i / 3);
+
+			// Every edge of a closed surface shows up once in each direction
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+				for (size_t j = 0; j < 3; ++j)
+				{
+					const uint32_t from = result[i + j];
+					const uint32_t to = result[i + ((j + 1) % 3)];
+
+					if (locked[from])
+						continue;
+
+					EdgeCollapse collapse = {};
+					collapse.cost = evaluate(quadrics[position_ids[from]], quadrics[position_ids[to]], get_position(positions, stride, to));
+					collapse.from = from;
+					collapse.to = to;
+
+					if (collapse.cost <= max_cost)
+						collapses.push_back(collapse);
+				}
+
+			std::sort(collapses.begin(), collapses.end(), [](const EdgeCollapse& a, const EdgeCollapse& b)
+			{
+				if (a.cost != b.cost) return a.cost < b.cost;
+				if (a.from != b.from) return a.from < b.from;
+				return a.to < b.to;
+			});
+
+			std::fill(touched.begin(), touched.end(), 0);
+			const size_t excess = result.size() - target_index_count;
+			size_t removed = 0;
+			size_t applied = 0;
+
+			for (const auto& collapse : collapses)
+			{
+				if (removed >= excess)
+					break;
+
+				// Collapses in the same pass can't share triangles
+				const uint32_t from = collapse.from;
+				const uint32_t to = collapse.to;
+				if (touched[from] || touched[to])
+					continue;
+
+				const glm::vec3 to_position = get_position(positions, stride, to);
+				bool valid = true;
+				neighbors.clear();
+
+				for (uint32_t t = triangle_offsets[from]; t < triangle_offsets[from + 1] && valid; ++t)
+				{
+					const uint32_t* tri = &result[vertex_triangles[t] * 3];
+					const bool removed_triangle = tri[0] == to || tri[1] == to || tri[2] == to;
+
+					for (size_t j = 0; j < 3; ++j)
+					{
+						neighbors.push_back(tri[j]);
+
+						// Moving onto one side of a seam would stretch attributes on the other
+						if (tri[j] != to && position_ids[tri[j]] == position_ids[to])
+							valid = false;
+					}
+
+					if (removed_triangle)
+						continue;
+
+					// Reject collapses that flip triangles over
+					glm::vec3 p[3] = {};
+					glm::vec3 q[3] = {};
+					for (size_t j = 0; j < 3; ++j)
+					{
+						p[j] = get_position(positions, stride, tri[j]);
+						q[j] = tri[j] == from ? to_position : p[j];
+					}
+
+					const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					const glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+					if (glm::dot(before, after) <= 0.0f)
+						valid = false;
+				}
+
+				// Vertices next to both ends must share a triangle with the edge, or the surface pinches
+				for (uint32_t t = triangle_offsets[to]; t < triangle_offsets[to + 1] && valid; ++t)
+				{
+					const uint32_t* tri = &result[vertex_triangles[t] * 3];
+					if (tri[0] == from || tri[1] == from || tri[2] == from)
+						continue;
+
+					for (size_t j = 0; j < 3; ++j)
+					{
+						if (tri[j] == to || std::find(neighbors.begin(), neighbors.end(), tri[j]) == neighbors.end())
+							continue;
+
+						bool shared = false;
+						for (uint32_t s = triangle_offsets[from]; s < triangle_offsets[from + 1] && !shared; ++s)
+						{
+							const uint32_t* other = &result[vertex_triangles[s] * 3];
+							const bool has_to = other[0] == to || other[1] == to || other[2] == to;
+							const bool has_vertex = other[0] == tri[j] || other[1] == tri[j] || other[2] == tri[j];
+							shared = has_to && has_vertex;
+						}
+
+						if (!shared)
+							valid = false;
+					}
+				}
+
+				if (!valid)
+					continue;
+
+				// Apply the collapse
+				for (uint32_t t = triangle_offsets[from]; t < triangle_offsets[from + 1]; ++t)
+				{
+					const uint32_t* tri = &result[vertex_triangles[t] * 3];
+					if (tri[0] == to || tri[1] == to || tri[2] == to)
+						removed += 3;
+
+					touched[tri[0]] = 1;
+					touched[tri[1]] = 1;
+					touched[tri[2]] = 1;
+				}
+
+				touched[to] = 1;
+				remap[from] = to;
+
+				Quadric& q = quadrics[position_ids[to]];
+				const Quadric& q_from = quadrics[position_ids[from]];
+				for (size_t i = 0; i < q.size(); ++i)
+					q[i] += q_from[i];
+
+				++applied;
+			}
+
+			if (applied == 0)
+				break;
+
+			// Rebuild the index list without collapsed triangles
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				const uint32_t a = remap[result[i]];
+				const uint32_t b = remap[result[i + 1]];
+				const uint32_t c = remap[result[i + 2]];
+
+				if (a == b || b == c || a == c)
+					continue;
+
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+
+			result.resize(write);
+		}
+
+		return result;
+	}
+
+	float get_screen_size(float distance, float radius, const glm::mat4& projection)
+	{
+		if (distance <= radius)
+			return std::numeric_limits<float>::max();
+
+		// Vulkan projections may flip Y
+		return (radius * std::abs(projection[1][1])) / std::sqrt((distance * distance) - (radius * radius));
+	}
+
+	uint32_t select_lod(float screen_size, const float* screen_sizes, uint32_t count, uint32_t current, float hysteresis)
+	{
+		dk_assert(count == 0 || screen_sizes);
+		uint32_t lod = std::min(current, count);
+
+		// Coarser levels must be passed by the hysteresis before switching
+		while (lod < count && screen_size < screen_sizes[lod] * (1.0f - hysteresis))
+			++lod;
+
+		// Same for finer levels
+		while (lod > 0 && screen_size >= screen_sizes[lod - 1] * (1.0f + hysteresis))
+			--lod;
+
+		return lod;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+/**
+ * @file mesh_lod.hpp
+ * @brief Mesh simplification and level of detail selection header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stdint.h>
+#include <glm\glm.hpp>
+
+namespace dk
+{
+	/**
+	 * Simplify a triangle mesh by collapsing edges with the smallest quadric error.
+	 * @param Indices. Every three make a triangle.
+	 * @param Pointer to the first vertex position.
+	 * @param Number of bytes between each vertex position.
+	 * @param Number of vertices.
+	 * @param Number of indices to stop at.
+	 * @param Largest distance a surface may move as a fraction of the meshes size.
+	 * @return Indices of the simplified mesh. They refer to the same vertices.
+	 * @note Vertices on open edges and on seams (vertices sharing a position but
+	 *       not other attributes) never move, so outlines and texture mapping are kept.
+	 *       The result may have more indices than asked for if the error limit is hit.
+	 */
+	extern std::vector<uint32_t> simplify_mesh
+	(
+		const std::vector<uint32_t>& indices,
+		const float* positions,
+		size_t stride,
+		size_t vertex_count,
+		size_t target_index_count,
+		float max_error
+	);
+
+	/**
+	 * Find how much of the screen a bounding sphere covers.
+	 * @param Distance from the camera to the center of the sphere.
+	 * @param Sphere radius.
+	 * @param Projection matrix.
+	 * @return Projected radius as a fraction of half the screen height.
+	 * @note Spheres around the camera cover the whole screen and return the largest float.
+	 */
+	extern float get_screen_size(float distance, float radius, const glm::mat4& projection);
+
+	/**
+	 * Choose a level of detail.
+	 * @param Screen size of the object.
+	 * @param Screen size each level past the first is used below. Must be decreasing.
+	 * @param Number of screen sizes.
+	 * @param Level used last frame.
+	 * @param Fraction a screen size must be passed by before the level changes.
+	 * @return Level to use. Zero is the most detailed level.
+	 * @note Hysteresis stops objects near a threshold from switching back and forth every frame.
+	 */
+	extern uint32_t select_lod(float screen_size, const float* screen_sizes, uint32_t count, uint32_t current, float hysteresis);
+}
@@ -0,0 +1,441 @@
+/**
+ * @file mesh_optimize.cpp
+ * @brief Triangle and vertex ordering optimizations source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <glm\glm.hpp>
+#include "debugging.hpp"
+#include "mesh_optimize.hpp"
+
+namespace dk
+{
+	/** Vertex that has never been put in the cache. */
+	static const uint32_t NOT_CACHED = std::numeric_limits<uint32_t>::max();
+
+	/**
+	 * FIFO post transform cache.
+	 * @note A vertex is cached if fewer than cache size vertices were transformed after it.
+	 */
+	class FifoVertexCache
+	{
+	public:
+
+		/**
+		 * Constructor.
+		 * @param Number of vertices.
+		 * @param Cache size.
+		 */
+		FifoVertexCache(size_t vertex_count, size_t cache_size) :
+			m_timestamps(vertex_count, NOT_CACHED),
+			m_cache_size(static_cast<uint32_t>(cache_size))
+		{}
+
+		/**
+		 * Use a vertex.
+		 * @param Vertex index.
+		 * @return If the vertex had to be transformed.
+		 */
+		bool use(uint32_t vertex)
+		{
+			if (m_timestamps[vertex] != NOT_CACHED && m_time - m_timestamps[vertex] < m_cache_size)
+				return false;
+
+			m_timestamps[vertex] = m_time++;
+			return true;
+		}
+
+		/**
+		 * Empty the cache.
+		 */
+		void flush()
+		{
+			m_time += m_cache_size;
+		}
+
+	private:
+
+		/** Time each vertex was put in the cache. */
+		std::vector<uint32_t> m_timestamps;
+
+		/** Number of vertices transformed. */
+		uint32_t m_time = 0;
+
+		/** Cache size. */
+		uint32_t m_cache_size;
+	};
+
+	/**
+	 * Get a vertex position.
+	 * @param Pointer to the first vertex position.
+	 * @param Number of bytes between each vertex position.
+	 * @param Vertex index.
+	 * @return Position.
+	 */
+	static glm::vec3 get_position(const float* positions, size_t stride, size_t index)
+	{
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + (index * stride));
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+
+	/**
+	 * Get the number of vertices an index list refers to.
+	 * @param Indices.
+	 * @return One past the largest index.
+	 */
+	static size_t get_vertex_count(const std::vector<uint32_t>& indices)
+	{
+		size_t count = 0;
+		for (const uint32_t index : indices)
+			count = std::max(count, static_cast<size_t>(index) + 1);
+
+		return count;
+	}
+
+	std::vector<uint32_t> optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size)
+	{
+		dk_assert(indices.size() % 3 == 0);
+		dk_assert(cache_size > 0);
+
+		std::vector<uint32_t> clusters = {};
+		const size_t triangle_count = indices.size() / 3;
+		if (triangle_count == 0)
+			return clusters;
+
+		// Triangles around each vertex
+		std::vector<uint32_t> triangle_offsets(vertex_count + 1, 0);
+		for (const uint32_t v : indices)
+			++triangle_offsets[v + 1];
+
+		for (size_t i = 0; i < vertex_count; ++i)
+			triangle_offsets[i + 1] += triangle_offsets[i];
+
+		std::vector<uint32_t> vertex_triangles(indices.size());
+		std::vector<uint32_t> cursors(triangle_offsets.begin(), triangle_offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+			vertex_triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		// Number of unemitted triangles around each vertex
+		std::vector<uint32_t> live_triangles(vertex_count);
+		for (size_t i = 0; i < vertex_count; ++i)
+			live_triangles[i] = triangle_offsets[i + 1] - triangle_offsets[i];
+
+		std::vector<uint32_t> cache_times(vertex_count, 0);
+		std::vector<uint8_t> emitted(triangle_count, 0);
+		std::vector<uint32_t> dead_ends = {};
+		std::vector<uint32_t> candidates = {};
+		std::vector<uint32_t> result = {};
+		result.reserve(indices.size());
+
+		const uint32_t k = static_cast<uint32_t>(cache_size);
+		uint32_t time = k + 1;
+		size_t cursor = 0;
+		int64_t fan = indices[0];
+
+		clusters.push_back(0);
+
+		while (fan >= 0)
+		{
+			// Emit every remaining triangle around the fanning vertex
+			candidates.clear();
+			for (uint32_t t = triangle_offsets[fan]; t < triangle_offsets[fan + 1]; ++t)
+			{
+				const uint32_t triangle = vertex_triangles[t];
+				if (emitted[triangle])
+					continue;
+
+				for (size_t j = 0; j < 3; ++j)
+				{
+					const uint32_t v = indices[(triangle * 3) + j];
+					result.push_back(v);
+					dead_ends.push_back(v);
+					candidates.push_back(v);
+					--live_triangles[v];
+
+					if (time - cache_times[v] > k)
+						cache_times[v] = time++;
+				}
+
+				emitted[triangle] = 1;
+			}
+
+			// Pick the candidate that will still be cached once its triangles are emitted and has been in the cache longest
+			int64_t next = -1;
+			int64_t best = -1;
+			for (const uint32_t v : candidates)
+			{
+				if (live_triangles[v] == 0)
+					continue;
+
+				int64_t priority = 0;
+				if (time - cache_times[v] + (2 * live_triangles[v]) <= k)
+					priority = time - cache_times[v];
+
+				if (priority > best)
+				{
+					best = priority;
+					next = v;
+				}
+			}
+
+			if (next >= 0)
+			{
+				fan = next;
+				continue;
+			}
+
+			// Dead end. Try recently used vertices first, then walk the input in order.
+			fan = -1;
+			while (dead_ends.size() > 0 && fan < 0)
+			{
+				const uint32_t v = dead_ends.back();
+				dead_ends.pop_back();
+
+				if (live_triangles[v] > 0)
+					fan = v;
+			}
+
+			while (fan < 0 && cursor < indices.size())
+			{
+				const uint32_t v = indices[cursor++];
+				if (live_triangles[v] > 0)
+					fan = v;
+			}
+
+			if (fan >= 0 && result.size() < indices.size())
+				clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+		}
+
+		dk_assert(result.size() == indices.size());
+		indices = std::move(result);
+
+		return clusters;
+	}
+
+	void optimize_overdraw
+	(
+		std::vector<uint32_t>& indices,
+		const float* positions,
+		size_t stride,
+		const std::vector<uint32_t>& clusters,
+		float threshold,
+		size_t cache_size
+	)
+	{
+		dk_assert(indices.size() % 3 == 0);
+
+		const size_t triangle_count = indices.size() / 3;
+		if (triangle_count == 0 || clusters.size() == 0)
+			return;
+
+		dk_assert(positions);
+		dk_assert(clusters[0] == 0);
+
+		// Split clusters wherever their miss ratio is already close to the whole clusters
+		FifoVertexCache cache(get_vertex_count(indices), cache_size);
+		std::vector<uint32_t> soft_clusters = {};
+
+		for (size_t c = 0; c < clusters.size(); ++c)
+		{
+			const size_t begin = clusters[c];
+			const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+			size_t cluster_misses = 0;
+			cache.flush();
+			for (size_t i = begin * 3; i < end * 3; ++i)
+				cluster_misses += cache.use(indices[i]) ? 1 : 0;
+
+			const float cluster_acmr = static_cast<float>(cluster_misses) / static_cast<float>(end - begin);
+
+			soft_clusters.push_back(static_cast<uint32_t>(begin));
+			size_t start = begin;
+			size_t misses = 0;
+			cache.flush();
+
+			for (size_t t = begin; t + 1 < end; ++t)
+			{
+				for (size_t j = 0; j < 3; ++j)
+					misses += cache.use(indices[(t * 3) + j]) ? 1 : 0;
+
+				if (static_cast<float>(misses) / static_cast<float>(t + 1 - start) <= cluster_acmr * threshold)
+				{
+					soft_clusters.push_back(static_cast<uint32_t>(t + 1));
+					start = t + 1;
+					misses = 0;
+					cache.flush();
+				}
+			}
+		}
+
+		// Area weighted center and normal of each cluster
+		const size_t cluster_count = soft_clusters.size();
+		std::vector<glm::vec3> centers(cluster_count, glm::vec3());
+		std::vector<glm::vec3> normals(cluster_count, glm::vec3());
+		std::vector<float> areas(cluster_count, 0.0f);
+		glm::vec3 mesh_center = {};
+		float mesh_area = 0.0f;
+
+		for (size_t c = 0; c < cluster_count; ++c)
+		{
+			const size_t begin = soft_clusters[c];
+			const size_t end = c + 1 < cluster_count ? soft_clusters[c + 1] : triangle_count;
+			glm::vec3 center = {};
+
+			for (size_t t = begin; t < end; ++t)
+			{
+				const glm::vec3 p0 = get_position(positions, stride, indices[(t * 3) + 0]);
+				const glm::vec3 p1 = get_position(positions, stride, indices[(t * 3) + 1]);
+				const glm::vec3 p2 = get_position(positions, stride, indices[(t * 3) + 2]);
+				const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				const float area = glm::length(n);
+
+				center += ((p0 + p1 + p2) / 3.0f) * area;
+				normals[c] += n;
+				areas[c] += area;
+			}
+
+			centers[c] = areas[c] > 0.0f ? center / areas[c] : center;
+			mesh_center += center;
+			mesh_area += areas[c];
+		}
+
+		if (mesh_area > 0.0f)
+			mesh_center /= mesh_area;
+
+		// Clusters facing away from the center are drawn first
+		std::vector<float> keys(cluster_count, 0.0f);
+		for (size_t c = 0; c < cluster_count; ++c)
+		{
+			const float length = glm::length(normals[c]);
+			if (length > 0.0f)
+				keys[c] = glm::dot(centers[c] - mesh_center, normals[c] / length);
+		}
+
+		std::vector<uint32_t> order(cluster_count);
+		for (size_t c = 0; c < cluster_count; ++c)
+			order[c] = static_cast<uint32_t>(c);
+
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+		{
+			return keys[a] > keys[b];
+		});
+
+		// Write clusters in their new order
+		std::vector<uint32_t> result = {};
+		result.reserve(indices.size());
+
+		for (const uint32_t c : order)
+		{
+			const size_t begin = soft_clusters[c];
+			const size_t end = c + 1 < cluster_count ? soft_clusters[c + 1] : triangle_count;
+			result.insert(result.end(), indices.begin() + (begin * 3), indices.begin() + (end * 3));
+		}
+
+		indices = std::move(result);
+	}
+
+	std::vector<uint32_t> optimize_vertex_fetch(std::vector<uint32_t>& indices, size_t vertex_count)
+	{
+		std::vector<uint32_t> remap(vertex_count, std::numeric_limits<uint32_t>::max());
+		uint32_t next = 0;
+
+		for (auto& index : indices)
+		{
+			dk_assert(index < vertex_count);
+
+			if (remap[index] == std::numeric_limits<uint32_t>::max())
+				remap[index] = next++;
+
+			index = remap[index];
+		}
+
+		return remap;
+	}
+
+	size_t deduplicate_vertices(const float* vertices, size_t vertex_count, size_t vertex_size, std::vector<uint32_t>& remap)
+	{
+		dk_assert(vertex_size > 0 && vertex_size % sizeof(float) == 0);
+		const size_t float_count = vertex_size / sizeof(float);
+
+		// Keys are the index of the first copy of each vertex, so vertices are never copied
+		const auto hash = [vertices, float_count](uint32_t vertex)
+		{
+			const float* values = vertices + (vertex * float_count);
+			uint64_t hash = 14695981039346656037ULL;
+
+			for (size_t i = 0; i < float_count; ++i)
+			{
+				// Negative zero must hash like zero since they compare equal
+				const float value = values[i] + 0.0f;
+				uint32_t bits = 0;
+				std::memcpy(&bits, &value, sizeof(bits));
+
+				hash ^= bits;
+				hash *= 1099511628211ULL;
+			}
+
+			return static_cast<size_t>(hash);
+		};
+
+		const auto equal = [vertices, float_count](uint32_t a, uint32_t b)
+		{
+			const float* a_values = vertices + (a * float_count);
+			const float* b_values = vertices + (b * float_count);
+
+			for (size_t i = 0; i < float_count; ++i)
+				if (a_values[i] != b_values[i])
+					return false;
+
+			return true;
+		};
+
+		std::unordered_map<uint32_t, uint32_t, decltype(hash), decltype(equal)> unique_vertices(vertex_count, hash, equal);
+		remap.resize(vertex_count);
+
+		for (size_t i = 0; i < vertex_count; ++i)
+		{
+			const auto unique = unique_vertices.insert({ static_cast<uint32_t>(i), static_cast<uint32_t>(unique_vertices.size()) });
+			remap[i] = unique.first->second;
+		}
+
+		return unique_vertices.size();
+	}
+
+	VertexCacheStatistics analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size)
+	{
+		dk_assert(indices.size() % 3 == 0);
+		dk_assert(cache_size > 0);
+
+		VertexCacheStatistics statistics = {};
+		FifoVertexCache cache(vertex_count, cache_size);
+		std::vector<uint8_t> used(vertex_count, 0);
+		size_t used_count = 0;
+
+		for (const uint32_t index : indices)
+		{
+			dk_assert(index < vertex_count);
+
+			if (cache.use(index))
+				++statistics.transformed_vertices;
+
+			if (!used[index])
+			{
+				used[index] = 1;
+				++used_count;
+			}
+		}
+
+		if (indices.size() > 0)
+		{
+			statistics.acmr = static_cast<float>(statistics.transformed_vertices) / static_cast<float>(indices.size() / 3);
+			statistics.atvr = static_cast<float>(statistics.transformed_vertices) / static_cast<float>(used_count);
+		}
+
+		return statistics;
+	}
+}
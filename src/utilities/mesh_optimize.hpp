@@ -0,0 +1,96 @@
+#pragma once
+
+/**
+ * @file mesh_optimize.hpp
+ * @brief Triangle and vertex ordering optimizations header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stdint.h>
+
+namespace dk
+{
+	/** Number of entries in the post transform cache the optimizations and statistics assume. */
+	static const size_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+	/**
+	 * How well a triangle order uses the post transform vertex cache.
+	 */
+	struct VertexCacheStatistics
+	{
+		/** Number of vertices transformed. */
+		size_t transformed_vertices = 0;
+
+		/** Average cache miss ratio. Vertices transformed per triangle. 0.5 is ideal for large grids and 3 is the worst. */
+		float acmr = 0.0f;
+
+		/** Average transform to vertex ratio. Vertices transformed per vertex used. 1 is ideal. */
+		float atvr = 0.0f;
+	};
+
+	/**
+	 * Reorder triangles to make good use of the post transform vertex cache.
+	 * @param Indices. Every three make a triangle. Triangles are reordered in place.
+	 * @param Number of vertices.
+	 * @param Cache size to optimize for.
+	 * @return Index of the first triangle of each cluster. Clusters end where the order
+	 *         had to jump to an unrelated part of the mesh.
+	 * @note Uses Tipsify (Sander, Nehab, and Barczak 2007), which runs in linear time.
+	 *       Triangles keep their winding.
+	 */
+	extern std::vector<uint32_t> optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+	/**
+	 * Reorder clusters of triangles so surfaces facing out from the mesh are drawn first.
+	 * @param Indices ordered by optimize_vertex_cache(). Triangles are reordered in place.
+	 * @param Pointer to the first vertex position.
+	 * @param Number of bytes between each vertex position.
+	 * @param Clusters returned by optimize_vertex_cache().
+	 * @param How much worse than its clusters miss ratio a smaller cluster may be. Larger values make more clusters.
+	 * @param Cache size to optimize for.
+	 * @note Clusters are split further wherever the cache miss ratio stays within the threshold,
+	 *       then sorted by how far their surface faces away from the center of the mesh. Outer
+	 *       surfaces tend to hide inner ones, so fewer pixels are shaded more than once.
+	 */
+	extern void optimize_overdraw
+	(
+		std::vector<uint32_t>& indices,
+		const float* positions,
+		size_t stride,
+		const std::vector<uint32_t>& clusters,
+		float threshold = 1.05f,
+		size_t cache_size = DEFAULT_VERTEX_CACHE_SIZE
+	);
+
+	/**
+	 * Renumber vertices in the order the triangles first use them.
+	 * @param Indices. Rewritten to use the new numbering.
+	 * @param Number of vertices.
+	 * @return New index of every old vertex. Unused vertices map to UINT32_MAX and should be dropped.
+	 * @note Neighboring triangles then fetch neighboring vertex memory.
+	 */
+	extern std::vector<uint32_t> optimize_vertex_fetch(std::vector<uint32_t>& indices, size_t vertex_count);
+
+	/**
+	 * Find the vertices that are equal to an earlier one.
+	 * @param Pointer to the first vertex. Every attribute must be a float.
+	 * @param Number of vertices.
+	 * @param Number of bytes in each vertex. A multiple of the size of a float.
+	 * @param Index of the unique vertex each vertex is equal to. Unique vertices are numbered in the order they first appear.
+	 * @return Number of unique vertices.
+	 * @note Attributes are compared by value, so negative zero equals zero and NaN equals nothing.
+	 *       Runs in linear time with a hash map.
+	 */
+	extern size_t deduplicate_vertices(const float* vertices, size_t vertex_count, size_t vertex_size, std::vector<uint32_t>& remap);
+
+	/**
+	 * Measure how well a triangle order uses a FIFO post transform vertex cache.
+	 * @param Indices.
+	 * @param Number of vertices.
+	 * @param Cache size.
+	 * @return Statistics.
+	 */
+	extern VertexCacheStatistics analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+}
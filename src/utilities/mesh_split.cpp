@@ -0,0 +1,111 @@
+/**
+ * @file mesh_split.cpp
+ * @brief Spatial mesh splitting source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <glm\glm.hpp>
+#include "debugging.hpp"
+#include "mesh_split.hpp"
+
+namespace dk
+{
+	std::vector<MeshPart> split_mesh(std::vector<uint32_t>& indices, const float* positions, size_t stride, size_t max_triangles)
+	{
+		dk_assert(indices.size() % 3 == 0);
+		dk_assert(max_triangles > 0);
+
+		std::vector<MeshPart> parts = {};
+		const size_t triangle_count = indices.size() / 3;
+
+		if (triangle_count <= max_triangles)
+		{
+			if (triangle_count > 0)
+			{
+				MeshPart part = {};
+				part.index_count = indices.size();
+				parts.push_back(part);
+			}
+
+			return parts;
+		}
+
+		dk_assert(positions);
+
+		// Triangle centers
+		const char* vertices = reinterpret_cast<const char*>(positions);
+		std::vector<glm::vec3> centers(triangle_count);
+
+		for (size_t i = 0; i < triangle_count; ++i)
+		{
+			glm::vec3 center = {};
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const float* p = reinterpret_cast<const float*>(vertices + (indices[(i * 3) + j] * stride));
+				center += glm::vec3(p[0], p[1], p[2]);
+			}
+
+			centers[i] = center / 3.0f;
+		}
+
+		std::vector<uint32_t> order(triangle_count);
+		for (size_t i = 0; i < triangle_count; ++i)
+			order[i] = static_cast<uint32_t>(i);
+
+		// Split ranges of triangles in half. The lower half is always handled first so parts come out in order.
+		std::vector<std::pair<size_t, size_t>> stack = { { 0, triangle_count } };
+
+		while (stack.size() > 0)
+		{
+			const size_t begin = stack.back().first;
+			const size_t end = stack.back().second;
+			stack.pop_back();
+
+			if (end - begin <= max_triangles)
+			{
+				MeshPart part = {};
+				part.first_index = begin * 3;
+				part.index_count = (end - begin) * 3;
+				parts.push_back(part);
+				continue;
+			}
+
+			// Longest axis of the centers
+			glm::vec3 min = centers[order[begin]];
+			glm::vec3 max = min;
+			for (size_t i = begin + 1; i < end; ++i)
+			{
+				min = glm::min(min, centers[order[i]]);
+				max = glm::max(max, centers[order[i]]);
+			}
+
+			const glm::vec3 size = max - min;
+			const size_t axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+
+			// Ties are broken by triangle index so the split doesn't depend on the standard library
+			const size_t middle = begin + ((end - begin) / 2);
+			std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](uint32_t a, uint32_t b)
+			{
+				if (centers[a][axis] != centers[b][axis]) return centers[a][axis] < centers[b][axis];
+				return a < b;
+			});
+
+			stack.push_back({ middle, end });
+			stack.push_back({ begin, middle });
+		}
+
+		// Keep the original order within each part so vertex cache optimizations survive
+		for (const auto& part : parts)
+			std::sort(order.begin() + (part.first_index / 3), order.begin() + ((part.first_index + part.index_count) / 3));
+
+		// Write triangles in their new order
+		const std::vector<uint32_t> source = indices;
+		for (size_t i = 0; i < triangle_count; ++i)
+			for (size_t j = 0; j < 3; ++j)
+				indices[(i * 3) + j] = source[(order[i] * 3) + j];
+
+		return parts;
+	}
+}
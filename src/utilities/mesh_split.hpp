@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * @file mesh_split.hpp
+ * @brief Spatial mesh splitting header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stdint.h>
+
+namespace dk
+{
+	/**
+	 * A contiguous range of triangles in an index list.
+	 */
+	struct MeshPart
+	{
+		/** Index of the first index. */
+		size_t first_index = 0;
+
+		/** Number of indices. */
+		size_t index_count = 0;
+	};
+
+	/**
+	 * Reorder the triangles of a mesh into spatially compact parts.
+	 * @param Indices. Every three make a triangle. Triangles are reordered in place.
+	 * @param Pointer to the first vertex position.
+	 * @param Number of bytes between each vertex position.
+	 * @param Most triangles a part may have.
+	 * @return Parts in index order. Together they cover every index.
+	 * @note Triangles are split in half along the longest axis of their centers until every
+	 *       part is small enough, so parts are balanced and their bounds rarely overlap much.
+	 *       Triangles keep their relative order within a part, so earlier vertex cache
+	 *       optimizations still apply. Vertices are left alone and may be shared between parts.
+	 */
+	extern std::vector<MeshPart> split_mesh(std::vector<uint32_t>& indices, const float* positions, size_t stride, size_t max_triangles);
+}
@@ -0,0 +1,328 @@
+/**
+ * @file occlusion.cpp
+ * @brief Software occlusion culling source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include "debugging.hpp"
+#include "simd.hpp"
+#include "occlusion.hpp"
+
+namespace dk
+{
+	/** Anything closer than this is treated as crossing the near plane. */
+	static const float MIN_CLIP_W = 1e-4f;
+
+	/** Coverage mask of a fully covered tile. */
+	static const uint32_t FULL_COVERAGE = 0xFFFFFFFF;
+
+	static_assert(OcclusionBuffer::tile_width * OcclusionBuffer::tile_height == 32, "Tiles must fit in a 32 bit coverage mask.");
+
+	OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+	{
+		resize(width, height);
+	}
+
+	void OcclusionBuffer::resize(uint32_t width, uint32_t height)
+	{
+		const uint32_t block_pixel_width = tile_width * block_width;
+		const uint32_t block_pixel_height = tile_height * block_height;
+
+		m_block_columns = std::max<uint32_t>((width + block_pixel_width - 1) / block_pixel_width, 1);
+		m_block_rows = std::max<uint32_t>((height + block_pixel_height - 1) / block_pixel_height, 1);
+		m_tile_columns = m_block_columns * block_width;
+		m_tile_rows = m_block_rows * block_height;
+
+		m_tiles.resize(m_tile_columns * m_tile_rows);
+		m_block_depths.resize(m_block_columns * m_block_rows);
+		clear();
+	}
+
+	void OcclusionBuffer::clear()
+	{
+		Tile tile = {};
+		tile.depth0 = std::numeric_limits<float>::max();
+		std::fill(m_tiles.begin(), m_tiles.end(), tile);
+		std::fill(m_block_depths.begin(), m_block_depths.end(), std::numeric_limits<float>::max());
+		m_triangles.clear();
+	}
+
+	void OcclusionBuffer::add_occluder(const glm::mat4& mvp, const float* positions, size_t stride, const uint32_t* indices, size_t index_count)
+	{
+		dk_assert(index_count % 3 == 0);
+
+		const float width = static_cast<float>(get_width());
+		const float height = static_cast<float>(get_height());
+		const char* vertices = reinterpret_cast<const char*>(positions);
+
+		for (size_t i = 0; i < index_count; i += 3)
+		{
+			glm::vec2 screen[3] = {};
+			float depth = 0.0f;
+			bool clipped = false;
+
+			// Project to screen space
+			for (size_t j = 0; j < 3; ++j)
+			{
+				glm::vec3 position = {};
+				std::memcpy(&position, vertices + indices[i + j] * stride, sizeof(glm::vec3));
+
+				const glm::vec4 clip = mvp * glm::vec4(position, 1.0f);
+				if (clip.w < MIN_CLIP_W)
+				{
+					clipped = true;
+					break;
+				}
+
+				const float inv_w = 1.0f / clip.w;
+				screen[j].x = (clip.x * inv_w * 0.5f + 0.5f) * width;
+				screen[j].y = (clip.y * inv_w * 0.5f + 0.5f) * height;
+				depth = std::max(depth, clip.w);
+			}
+
+			if (clipped)
+				continue;
+
+			// Skip degenerate triangles and make the winding counter clockwise
+			const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+			if (std::abs(area) < 1e-6f)
+				continue;
+
+			if (area < 0.0f)
+				std::swap(screen[1], screen[2]);
+
+			// Bounding rectangle
+			const glm::vec2 min = glm::min(screen[0], glm::min(screen[1], screen[2]));
+			const glm::vec2 max = glm::max(screen[0], glm::max(screen[1], screen[2]));
+
+			if (max.x < 0.0f || max.y < 0.0f || min.x >= width || min.y >= height)
+				continue;
+
+			Triangle triangle = {};
+			triangle.depth = depth;
+			triangle.min_x = static_cast<uint32_t>(std::max(min.x, 0.0f)) / tile_width;
+			triangle.min_y = static_cast<uint32_t>(std::max(min.y, 0.0f)) / tile_height;
+			triangle.max_x = static_cast<uint32_t>(std::min(max.x, width - 1.0f)) / tile_width;
+			triangle.max_y = static_cast<uint32_t>(std::min(max.y, height - 1.0f)) / tile_height;
+
+			// Edge functions. Positive on the inside of the triangle. Pixels exactly on
+			// an edge count as covered so shared edges leave no gaps.
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const glm::vec2& a = screen[j];
+				const glm::vec2& b = screen[(j + 1) % 3];
+				triangle.a[j] = a.y - b.y;
+				triangle.b[j] = b.x - a.x;
+				triangle.c[j] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+			}
+
+			m_triangles.push_back(triangle);
+		}
+	}
+
+	void OcclusionBuffer::rasterize(uint32_t first_row, uint32_t last_row)
+	{
+		dk_assert(first_row <= last_row && last_row <= m_block_rows);
+
+		const uint32_t first_tile_row = first_row * block_height;
+		const uint32_t last_tile_row = last_row * block_height;
+
+		for (const auto& triangle : m_triangles)
+		{
+			const uint32_t min_y = std::max(triangle.min_y, first_tile_row);
+			const uint32_t max_y = std::min(triangle.max_y + 1, last_tile_row);
+
+			for (uint32_t y = min_y; y < max_y; ++y)
+				for (uint32_t x = triangle.min_x; x <= triangle.max_x; ++x)
+				{
+					Tile& tile = m_tiles[y * m_tile_columns + x];
+
+					// Triangle is behind everything in the tile
+					if (triangle.depth >= tile.depth0)
+						continue;
+
+					const uint32_t coverage = compute_coverage(triangle, x, y);
+					if (coverage != 0)
+						merge(tile, coverage, triangle.depth);
+				}
+		}
+
+		// Update block depths
+		for (uint32_t by = first_row; by < last_row; ++by)
+			for (uint32_t bx = 0; bx < m_block_columns; ++bx)
+			{
+				float depth = 0.0f;
+
+				for (uint32_t y = by * block_height; y < (by + 1) * block_height; ++y)
+					for (uint32_t x = bx * block_width; x < (bx + 1) * block_width; ++x)
+						depth = std::max(depth, m_tiles[y * m_tile_columns + x].depth0);
+
+				m_block_depths[by * m_block_columns + bx] = depth;
+			}
+	}
+
+	bool OcclusionBuffer::test(const glm::mat4& vp, const AABB& aabb) const
+	{
+		const float width = static_cast<float>(get_width());
+		const float height = static_cast<float>(get_height());
+
+		glm::vec2 min = glm::vec2(std::numeric_limits<float>::max());
+		glm::vec2 max = glm::vec2(-std::numeric_limits<float>::max());
+		float depth = std::numeric_limits<float>::max();
+
+		// Project corners to find the screen rectangle and nearest depth
+		for (int i = 0; i < 8; ++i)
+		{
+			const glm::vec3 corner = aabb.center + aabb.extent * glm::vec3
+			(
+				(i & 1) ? 1.0f : -1.0f,
+				(i & 2) ? 1.0f : -1.0f,
+				(i & 4) ? 1.0f : -1.0f
+			);
+
+			const glm::vec4 clip = vp * glm::vec4(corner, 1.0f);
+
+			// Boxes crossing the near plane are always visible
+			if (clip.w < MIN_CLIP_W)
+				return true;
+
+			const float inv_w = 1.0f / clip.w;
+			const glm::vec2 screen = glm::vec2
+			(
+				(clip.x * inv_w * 0.5f + 0.5f) * width,
+				(clip.y * inv_w * 0.5f + 0.5f) * height
+			);
+
+			min = glm::min(min, screen);
+			max = glm::max(max, screen);
+			depth = std::min(depth, clip.w);
+		}
+
+		// Off screen boxes are left to frustum culling
+		if (max.x < 0.0f || max.y < 0.0f || min.x >= width || min.y >= height)
+			return true;
+
+		const uint32_t min_x = static_cast<uint32_t>(std::max(min.x, 0.0f)) / tile_width;
+		const uint32_t min_y = static_cast<uint32_t>(std::max(min.y, 0.0f)) / tile_height;
+		const uint32_t max_x = static_cast<uint32_t>(std::min(max.x, width - 1.0f)) / tile_width;
+		const uint32_t max_y = static_cast<uint32_t>(std::min(max.y, height - 1.0f)) / tile_height;
+
+		// Walk blocks and only look at the tiles of blocks that might contain the box
+		for (uint32_t by = min_y / block_height; by <= max_y / block_height; ++by)
+			for (uint32_t bx = min_x / block_width; bx <= max_x / block_width; ++bx)
+			{
+				if (depth > m_block_depths[by * m_block_columns + bx])
+					continue;
+
+				const uint32_t tile_min_x = std::max(min_x, bx * block_width);
+				const uint32_t tile_max_x = std::min(max_x, (bx + 1) * block_width - 1);
+				const uint32_t tile_min_y = std::max(min_y, by * block_height);
+				const uint32_t tile_max_y = std::min(max_y, (by + 1) * block_height - 1);
+
+				for (uint32_t y = tile_min_y; y <= tile_max_y; ++y)
+					for (uint32_t x = tile_min_x; x <= tile_max_x; ++x)
+						if (depth <= m_tiles[y * m_tile_columns + x].depth0)
+							return true;
+			}
+
+		return false;
+	}
+
+	void OcclusionBuffer::resolve(std::vector<float>& depth) const
+	{
+		const uint32_t width = get_width();
+		depth.resize(width * get_height());
+
+		for (uint32_t y = 0; y < m_tile_rows; ++y)
+			for (uint32_t x = 0; x < m_tile_columns; ++x)
+			{
+				const Tile& tile = m_tiles[y * m_tile_columns + x];
+
+				for (uint32_t py = 0; py < tile_height; ++py)
+					for (uint32_t px = 0; px < tile_width; ++px)
+					{
+						const bool covered = (tile.mask >> (py * tile_width + px)) & 1;
+						depth[(y * tile_height + py) * width + x * tile_width + px] = covered ? std::min(tile.depth0, tile.depth1) : tile.depth0;
+					}
+			}
+	}
+
+	uint32_t OcclusionBuffer::compute_coverage(const Triangle& triangle, uint32_t x, uint32_t y)
+	{
+		const float tile_x = static_cast<float>(x * tile_width);
+		const float tile_y = static_cast<float>(y * tile_height);
+		uint32_t coverage = 0;
+
+#if DK_SIMD_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+		for (uint32_t row = 0; row < tile_height; ++row)
+		{
+			const float py = tile_y + static_cast<float>(row) + 0.5f;
+
+			for (uint32_t half = 0; half < tile_width / 4; ++half)
+			{
+				const __m128 px = _mm_add_ps(_mm_set1_ps(tile_x + static_cast<float>(half * 4)), offsets);
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+				for (size_t i = 0; i < 3; ++i)
+				{
+					const __m128 e = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.a[i]), px), _mm_set1_ps(triangle.b[i] * py + triangle.c[i]));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+				}
+
+				coverage |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (row * tile_width + half * 4);
+			}
+		}
+#else
+		for (uint32_t row = 0; row < tile_height; ++row)
+		{
+			const float py = tile_y + static_cast<float>(row) + 0.5f;
+
+			for (uint32_t column = 0; column < tile_width; ++column)
+			{
+				const float px = tile_x + static_cast<float>(column) + 0.5f;
+				bool inside = true;
+
+				for (size_t i = 0; i < 3; ++i)
+					inside = inside && (triangle.a[i] * px + triangle.b[i] * py + triangle.c[i] >= 0.0f);
+
+				if (inside)
+					coverage |= 1u << (row * tile_width + column);
+			}
+		}
+#endif
+
+		return coverage;
+	}
+
+	void OcclusionBuffer::merge(Tile& tile, uint32_t coverage, float depth)
+	{
+		// Start a new working layer when the triangle is closer to the
+		// reference layer than the current working layer
+		if (tile.mask == 0 || std::abs(depth - tile.depth1) > tile.depth0 - depth)
+		{
+			tile.depth1 = depth;
+			tile.mask = coverage;
+		}
+		else
+		{
+			tile.depth1 = std::max(tile.depth1, depth);
+			tile.mask |= coverage;
+		}
+
+		// A full working layer becomes the new reference layer
+		if (tile.mask == FULL_COVERAGE)
+		{
+			tile.depth0 = std::min(tile.depth0, tile.depth1);
+			tile.depth1 = 0.0f;
+			tile.mask = 0;
+		}
+	}
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+/**
+ * @file occlusion.hpp
+ * @brief Software occlusion culling header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stdint.h>
+#include "frustum.hpp"
+
+namespace dk
+{
+	/**
+	 * A low resolution, CPU rasterized depth buffer used to find objects hidden behind occluders.
+	 * @note The screen is split into 8x4 pixel tiles. Each tile stores a coverage mask
+	 * and two depth layers instead of per pixel depth. Tiles are grouped into 4x4 tile
+	 * blocks which store the farthest depth of their tiles to speed up testing.
+	 * @note Depth is clip space W, so larger values are further away.
+	 */
+	class OcclusionBuffer
+	{
+	public:
+
+		/** Width of a tile in pixels. */
+		static const uint32_t tile_width = 8;
+
+		/** Height of a tile in pixels. */
+		static const uint32_t tile_height = 4;
+
+		/** Width of a block in tiles. */
+		static const uint32_t block_width = 4;
+
+		/** Height of a block in tiles. */
+		static const uint32_t block_height = 4;
+
+		/**
+		 * Constructor.
+		 * @param Width in pixels.
+		 * @param Height in pixels.
+		 */
+		OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+		/**
+		 * Default destructor.
+		 */
+		~OcclusionBuffer() = default;
+
+		/**
+		 * Change the resolution of the buffer.
+		 * @param Width in pixels.
+		 * @param Height in pixels.
+		 * @note Dimensions are rounded up to a multiple of the block size.
+		 */
+		void resize(uint32_t width, uint32_t height);
+
+		/**
+		 * Clear the depth buffer and remove every occluder.
+		 */
+		void clear();
+
+		/**
+		 * Add an occluder mesh.
+		 * @param Model-view-projection matrix.
+		 * @param Pointer to the first vertex position.
+		 * @param Distance in bytes between vertex positions.
+		 * @param Triangle indices.
+		 * @param Number of indices.
+		 * @note Triangles crossing the near plane are skipped.
+		 */
+		void add_occluder(const glm::mat4& mvp, const float* positions, size_t stride, const uint32_t* indices, size_t index_count);
+
+		/**
+		 * Rasterize every occluder into a range of block rows.
+		 * @param First block row.
+		 * @param One past the last block row.
+		 * @note Disjoint ranges may be rasterized concurrently.
+		 */
+		void rasterize(uint32_t first_row, uint32_t last_row);
+
+		/**
+		 * Rasterize every occluder into the whole buffer.
+		 */
+		void rasterize()
+		{
+			rasterize(0, m_block_rows);
+		}
+
+		/**
+		 * Check if a bounding box might be visible.
+		 * @param View-projection matrix.
+		 * @param World space AABB bounding box.
+		 * @return If the box is not hidden by the occluders.
+		 * @note Safe to call from multiple threads once rasterization is finished.
+		 */
+		bool test(const glm::mat4& vp, const AABB& aabb) const;
+
+		/**
+		 * Get the width of the buffer in pixels.
+		 * @return Width.
+		 */
+		inline uint32_t get_width() const
+		{
+			return m_tile_columns * tile_width;
+		}
+
+		/**
+		 * Get the height of the buffer in pixels.
+		 * @return Height.
+		 */
+		inline uint32_t get_height() const
+		{
+			return m_tile_rows * tile_height;
+		}
+
+		/**
+		 * Get the number of block rows.
+		 * @return Number of block rows.
+		 */
+		inline uint32_t get_block_rows() const
+		{
+			return m_block_rows;
+		}
+
+		/**
+		 * Get the number of occluder triangles.
+		 * @return Number of triangles.
+		 */
+		inline size_t get_triangle_count() const
+		{
+			return m_triangles.size();
+		}
+
+		/**
+		 * Get the depth of every pixel.
+		 * @param Depth values, written row by row.
+		 * @note Intended for debugging and comparing against reference images.
+		 */
+		void resolve(std::vector<float>& depth) const;
+
+	private:
+
+		/**
+		 * A triangle set up for rasterization.
+		 */
+		struct Triangle
+		{
+			/** Edge function X coefficients. */
+			float a[3] = {};
+
+			/** Edge function Y coefficients. */
+			float b[3] = {};
+
+			/** Edge function constants. */
+			float c[3] = {};
+
+			/** Farthest depth of the triangle. */
+			float depth = 0.0f;
+
+			/** Bounding rectangle in tiles. */
+			uint32_t min_x = 0;
+			uint32_t min_y = 0;
+			uint32_t max_x = 0;
+			uint32_t max_y = 0;
+		};
+
+		/**
+		 * Depth information for a tile.
+		 */
+		struct Tile
+		{
+			/** Conservative depth of the whole tile. */
+			float depth0 = 0.0f;
+
+			/** Depth of the pixels in the coverage mask. */
+			float depth1 = 0.0f;
+
+			/** Pixels covered by the working layer. */
+			uint32_t mask = 0;
+		};
+
+		/**
+		 * Get the pixels of a tile covered by a triangle.
+		 * @param Triangle.
+		 * @param Tile X coordinate.
+		 * @param Tile Y coordinate.
+		 * @return Coverage mask.
+		 */
+		static uint32_t compute_coverage(const Triangle& triangle, uint32_t x, uint32_t y);
+
+		/**
+		 * Merge a triangle into a tile.
+		 * @param Tile.
+		 * @param Coverage mask.
+		 * @param Triangle depth.
+		 */
+		static void merge(Tile& tile, uint32_t coverage, float depth);
+
+
+
+		/** Number of tile columns. */
+		uint32_t m_tile_columns = 0;
+
+		/** Number of tile rows. */
+		uint32_t m_tile_rows = 0;
+
+		/** Number of block columns. */
+		uint32_t m_block_columns = 0;
+
+		/** Number of block rows. */
+		uint32_t m_block_rows = 0;
+
+		/** Tiles. */
+		std::vector<Tile> m_tiles = {};
+
+		/** Farthest depth of each block. */
+		std::vector<float> m_block_depths = {};
+
+		/** Occluder triangles. */
+		std::vector<Triangle> m_triangles = {};
+	};
+}
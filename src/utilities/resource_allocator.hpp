@@ -191,6 +191,17 @@ namespace dk
 			return &m_resources.at(id);
 		}
 
+		/**
+		 * Get the ID of a resource.
+		 * @param Resource. Must be owned by the allocator.
+		 * @return Resource ID.
+		 */
+		resource_id get_id(const T* resource) const
+		{
+			dk_assert(resource >= m_resources.data() && resource < m_resources.data() + m_resources.size());
+			return static_cast<resource_id>(resource - m_resources.data());
+		}
+
 	private:
 
 		/**
@@ -0,0 +1,18 @@
+#pragma once
+
+/**
+ * @file simd.hpp
+ * @brief SIMD utilities.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	/** SSE2 intrinsics are available. */
+	#define DK_SIMD_SSE 1
+
+	/** Includes. */
+	#include <emmintrin.h>
+#else
+	/** SSE2 intrinsics are unavailable. Scalar fallbacks are used instead. */
+	#define DK_SIMD_SSE 0
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file sorting.cpp
+ * @brief Sorting utilities source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <array>
+#include "debugging.hpp"
+#include "sorting.hpp"
+
+namespace dk
+{
+	void radix_sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values)
+	{
+		dk_assert(keys.size() == values.size());
+
+		const size_t count = keys.size();
+		if (count < 2)
+			return;
+
+		// Build a histogram for every byte in a single pass
+		std::array<std::array<size_t, 256>, 8> histograms = {};
+		for (size_t i = 0; i < count; ++i)
+			for (size_t byte = 0; byte < 8; ++byte)
+				++histograms[byte][(keys[i] >> (byte * 8)) & 0xFF];
+
+		std::vector<uint64_t> tmp_keys(count);
+		std::vector<uint32_t> tmp_values(count);
+
+		for (size_t byte = 0; byte < 8; ++byte)
+		{
+			auto& histogram = histograms[byte];
+
+			// Every key has the same byte so this pass would do nothing
+			if (histogram[(keys[0] >> (byte * 8)) & 0xFF] == count)
+				continue;
+
+			// Convert counts into offsets
+			size_t offset = 0;
+			for (size_t i = 0; i < 256; ++i)
+			{
+				const size_t bucket_count = histogram[i];
+				histogram[i] = offset;
+				offset += bucket_count;
+			}
+
+			// Scatter
+			for (size_t i = 0; i < count; ++i)
+			{
+				const size_t dst = histogram[(keys[i] >> (byte * 8)) & 0xFF]++;
+				tmp_keys[dst] = keys[i];
+				tmp_values[dst] = values[i];
+			}
+
+			keys.swap(tmp_keys);
+			values.swap(tmp_values);
+		}
+	}
+}
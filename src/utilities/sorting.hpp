@@ -0,0 +1,23 @@
+#pragma once
+
+/**
+ * @file sorting.hpp
+ * @brief Sorting utilities header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <vector>
+#include <stdint.h>
+
+namespace dk
+{
+	/**
+	 * Sort a list of 64 bit keys and their values in ascending key order.
+	 * @param Keys.
+	 * @param Values associated with each key.
+	 * @note This is a stable LSD radix sort over bytes. Bytes that
+	 *       are identical for every key are skipped.
+	 */
+	extern void radix_sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values);
+}
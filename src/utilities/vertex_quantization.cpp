@@ -0,0 +1,130 @@
+/**
+ * @file vertex_quantization.cpp
+ * @brief Vertex attribute quantization source.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "vertex_quantization.hpp"
+
+namespace dk
+{
+	/**
+	 * Get the sign of a value, treating zero as positive.
+	 * @param Value.
+	 * @return -1 or 1.
+	 */
+	static float sign_not_zero(float value)
+	{
+		return value < 0.0f ? -1.0f : 1.0f;
+	}
+
+	uint16_t float_to_half(float value)
+	{
+		uint32_t bits = 0;
+		std::memcpy(&bits, &value, sizeof(float));
+
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+		// Rebias the exponent from 127 to 15 and round the mantissa to 10 bits
+		uint32_t half = (magnitude - (112 << 23) + (1 << 12)) >> 13;
+
+		// Too small for a normal half
+		if (magnitude < (113 << 23))
+			half = 0;
+
+		// Too large for a half
+		if (magnitude >= (143 << 23))
+			half = 0x7C00;
+
+		// NaN
+		if (magnitude > (255 << 23))
+			half = 0x7E00;
+
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	float half_to_float(uint16_t value)
+	{
+		const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+		const uint32_t exponent = (value >> 10) & 0x1F;
+		const uint32_t mantissa = value & 0x3FF;
+
+		// Subnormal halves are normal floats, so compute them directly
+		if (exponent == 0)
+		{
+			const float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+			return sign ? -magnitude : magnitude;
+		}
+
+		uint32_t bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+		// Infinity and NaN
+		if (exponent == 0x1F)
+			bits = sign | 0x7F800000 | (mantissa << 13);
+
+		float result = 0.0f;
+		std::memcpy(&result, &bits, sizeof(float));
+		return result;
+	}
+
+	uint16_t quantize_unorm16(float value)
+	{
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		return static_cast<uint16_t>((value * 65535.0f) + 0.5f);
+	}
+
+	float dequantize_unorm16(uint16_t value)
+	{
+		return static_cast<float>(value) / 65535.0f;
+	}
+
+	int16_t quantize_snorm16(float value)
+	{
+		value = std::min(std::max(value, -1.0f), 1.0f);
+		return static_cast<int16_t>(std::floor((value * 32767.0f) + 0.5f));
+	}
+
+	float dequantize_snorm16(int16_t value)
+	{
+		return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+	}
+
+	glm::vec2 encode_octahedral(const glm::vec3& v)
+	{
+		const float length = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+		if (length == 0.0f)
+			return glm::vec2(0.0f, 0.0f);
+
+		glm::vec2 e = glm::vec2(v.x, v.y) / length;
+
+		// Fold the lower half over the upper half
+		if (v.z < 0.0f)
+			e = glm::vec2
+			(
+				(1.0f - std::abs(e.y)) * sign_not_zero(e.x),
+				(1.0f - std::abs(e.x)) * sign_not_zero(e.y)
+			);
+
+		return e;
+	}
+
+	glm::vec3 decode_octahedral(const glm::vec2& e)
+	{
+		glm::vec3 v = glm::vec3(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+
+		// Unfold the lower half
+		if (v.z < 0.0f)
+		{
+			const float x = v.x;
+			v.x = (1.0f - std::abs(v.y)) * sign_not_zero(x);
+			v.y = (1.0f - std::abs(x)) * sign_not_zero(v.y);
+		}
+
+		return glm::normalize(v);
+	}
+}
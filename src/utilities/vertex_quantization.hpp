@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * @file vertex_quantization.hpp
+ * @brief Vertex attribute quantization header.
+ * @author Connor J. Bramham (ReeCocho)
+ */
+
+/** Includes. */
+#include <stdint.h>
+#include <glm\glm.hpp>
+
+namespace dk
+{
+	/**
+	 * Convert a float to a half precision float.
+	 * @param Value.
+	 * @return IEEE 754 half precision bits. Rounded to nearest.
+	 * @note Values too small for a normal half become zero and values too large
+	 *       become infinity. NaN stays NaN.
+	 */
+	extern uint16_t float_to_half(float value);
+
+	/**
+	 * Convert a half precision float to a float.
+	 * @param IEEE 754 half precision bits.
+	 * @return Value.
+	 */
+	extern float half_to_float(uint16_t value);
+
+	/**
+	 * Quantize a value in [0, 1] to a 16 bit unsigned normalized integer.
+	 * @param Value. Clamped to [0, 1].
+	 * @return Quantized value.
+	 */
+	extern uint16_t quantize_unorm16(float value);
+
+	/**
+	 * Convert a 16 bit unsigned normalized integer to a float.
+	 * @param Quantized value.
+	 * @return Value in [0, 1].
+	 */
+	extern float dequantize_unorm16(uint16_t value);
+
+	/**
+	 * Quantize a value in [-1, 1] to a 16 bit signed normalized integer.
+	 * @param Value. Clamped to [-1, 1].
+	 * @return Quantized value.
+	 */
+	extern int16_t quantize_snorm16(float value);
+
+	/**
+	 * Convert a 16 bit signed normalized integer to a float.
+	 * @param Quantized value.
+	 * @return Value in [-1, 1].
+	 * @note Both -32768 and -32767 are -1, like Vulkan does.
+	 */
+	extern float dequantize_snorm16(int16_t value);
+
+	/**
+	 * Encode a unit vector with an octahedral mapping.
+	 * @param Unit vector.
+	 * @return Point in [-1, 1] on the unfolded octahedron.
+	 * @note The vector is projected onto an octahedron whose lower half is folded over the
+	 *       upper half (Meyer et al. 2010), so two numbers cover every direction evenly.
+	 */
+	extern glm::vec2 encode_octahedral(const glm::vec3& v);
+
+	/**
+	 * Decode a unit vector encoded with encode_octahedral().
+	 * @param Point in [-1, 1] on the unfolded octahedron.
+	 * @return Unit vector.
+	 */
+	extern glm::vec3 decode_octahedral(const glm::vec2& e);
+}